@@ -30,8 +30,6 @@
 
 #include <limits.h>
 
-#ifndef XXL
-
 namespace surfit {
 
 static int bits_per_byte = 32;
@@ -384,7 +382,7 @@ void bitvec::NOT() {
 };
 
 size_t bitvec::write_file(int file) const {
-	return write(file, data, datasize*sizeof(surfit_int32));
+	return write(file, data, (byte_size+1)*sizeof(surfit_int32));
 };
 
 size_t bitvec::read_file(int file, size_t size) {
@@ -393,5 +391,3 @@ size_t bitvec::read_file(int file, size_t size) {
 
 }; // namespace surfit;
 
-#endif
-
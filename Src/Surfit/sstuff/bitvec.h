@@ -32,10 +32,6 @@
 #define surfit_int32 uint32_t
 #endif
 
-#ifdef XXL
-#include "../../src_xxl/sstuff/bitvec_xxl.h"
-#else
-
 #include <math.h>
 #include <memory.h>
 #include <assert.h>
@@ -188,5 +184,3 @@ protected:
 
 #endif
 
-#endif
-
@@ -24,8 +24,11 @@
 #include "../sstuff/boolvec.h"
 #include "shortvec.h"
 #include "../sstuff/bitvec.h"
+#include "../sstuff/mapfile.h"
 #include "intvec.h"
 #include "strvec.h"
+#include "interp.h"
+#include "realzip.h"
 
 #include <stdarg.h>
 #include <errno.h>
@@ -39,6 +42,7 @@
 #endif
 
 #include <float.h>
+#include <limits.h>
 
 //#include <tcl.h>
 
@@ -53,6 +57,9 @@
 namespace surfit {
 
 int datafile_modE = 1; // 1 - create new file, 0 - create or append if file already exists
+int datafile_mmap = 0; // 1 - read real arrays from memory-mapped file
+int datafile_parallel = 0; // 1 - serialize objects in parallel
+int datafile_compress = 0; // 1 - write compressed real arrays
 
 void add_word(char * contents, const char * word) {
 	int old_len = strlen(contents);
@@ -72,14 +79,41 @@ datafile::datafile(const char * filename, int imode) {
 
 	file = -1;
 	File = NULL;
+	mf = NULL;
+	directory = NULL;
+	tag_level = 0;
+	directory_checked = false;
+	wbuf = NULL;
+	wbuf_size = 0;
+	wbuf_capacity = 0;
+	memory = false;
+	serial = false;
 
 	datafile_filename = strdup(filename);
 
 	extern int datafile_modE;
 
+	// memory mode: objects are written into the growing buffer
+	if (imode == DF_MODE_MEMORY) {
+		memory = true;
+		directory = new std::vector<datafile_dir_entry>;
+		return;
+	}
+
 	// write mode
 	if (imode == DF_MODE_WRITE) {
 
+		wbuf = (char *)malloc(DF_WRITE_BUFFER);
+		if (wbuf)
+			wbuf_capacity = DF_WRITE_BUFFER;
+
+		// arrays loaded from this file should not see its new contents
+		mapfile_detach_all(filename);
+
+		// directory is written for new files or for files that already have it
+		if (datafile_modE == 1)
+			directory = new std::vector<datafile_dir_entry>;
+
 		if (datafile_modE == 0) {
 #if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
 			file = open(filename, O_BINARY|O_RDWR);
@@ -120,6 +154,9 @@ datafile::datafile(const char * filename, int imode) {
 			}
 		};
 
+		if ( (datafile_modE == 0) && condition() )
+			readDirectory();
+
 	} 
 
 	// read mode
@@ -136,11 +173,19 @@ datafile::datafile(const char * filename, int imode) {
 		}
 		
 		skipHeader(filename);
+
+		if (condition() && datafile_mmap)
+			mf = create_mapfile(filename, true);
 	};
 
 };
 
 datafile::~datafile() {
+	flush();
+	free(wbuf);
+	freeDirectory();
+	if (mf)
+		mf->release();
 	if (file != -1)
 		close(file);
 	if (File)
@@ -149,7 +194,7 @@ datafile::~datafile() {
 };
 
 bool datafile::condition() const {
-	return (file != -1);
+	return (file != -1) || memory;
 };
 
 const char * datafile::getWord() const {
@@ -269,9 +314,47 @@ bool datafile::findTagEof() {
 	return true;
 };
 
-bool datafile::findTag(const char * tag, const char * tag2) {
+bool datafile::findTag(const char * tag, const char * tag2, const char * object_name) {
 	char tagname[TAG_WORD_SIZE];
 	char error[] = "find_tag : wrong datafile format";
+
+	// direct seek to the next matching object
+	if ( (strcmp(tag, "filedata") != 0) && (strcmp(tag, "eof") != 0) && readDirectory() ) {
+#ifdef XXL
+		__int64 file_pos = _lseeki64(file, 0, SEEK_CUR);
+#else
+		long file_pos = lseek(file, 0, SEEK_CUR);
+#endif
+		size_t i;
+		for (i = 0; i < directory->size(); i++) {
+			const datafile_dir_entry & entry = (*directory)[i];
+			if (entry.offset < file_pos)
+				continue;
+			if ( (strcmp(entry.type, tag) != 0) && ((tag2 == NULL) || (strcmp(entry.type, tag2) != 0)) )
+				continue;
+			if ( object_name && (strcmp(object_name, entry.name) != 0) && !StringMatch(object_name, entry.name) )
+				continue;
+#ifdef XXL
+			_lseeki64(file, (__int64)entry.offset, SEEK_SET);
+#else
+			lseek(file, (long)entry.offset, SEEK_SET);
+#endif
+			if ( readTagName(tagname) && (strcmp(tagname, entry.type) == 0) )
+				return true;
+
+			// directory doesn't match the file, so scanning it
+			writelog(LOG_WARNING, "%s : wrong datafile directory", datafile_filename);
+			freeDirectory();
+#ifdef XXL
+			_lseeki64(file, file_pos, SEEK_SET);
+#else
+			lseek(file, file_pos, SEEK_SET);
+#endif
+			break;
+		}
+		if (directory)
+			return false;
+	}
 	
 	if (!readTagName(tagname)) {
 		writelog(LOG_ERROR, error);
@@ -474,6 +557,7 @@ bool datafile::skipStringArray(bool skip_name) {
 		for (i = 0; i < size; i++)
 			if (!readWord())
 				return false;
+		return true;
 	}
 	return false;
 };
@@ -485,6 +569,13 @@ bool datafile::skipRealArray(bool skip_name) {
 	
 	surfit_int32 size = 0;
 	if ( read( file, &size, sizeof(surfit_int32)) > 0 ) {
+		if (size == DF_COMPRESSED_ARRAY) {
+			char header[sizeof(realzip_header)];
+			size_t count = 0, bytes = 0;
+			if ( (read(file, header, sizeof(header)) != sizeof(header)) || !realzip_info(header, count, bytes) )
+				return false;
+			return skipBytes(bytes - sizeof(header));
+		}
 		return skipBytes(size*sizeof(REAL));
 	}
 	return false;
@@ -570,6 +661,12 @@ bool datafile::writeHeader() {
 	bool res = true; 
 	bool op = false;
 	char buf[200];
+	// header check could move the position beyond the end of file
+#ifdef XXL
+	_lseeki64(file, 0, SEEK_END);
+#else
+	lseek(file, 0, SEEK_END);
+#endif
 	op = writeString("roff-bin");
 	res = ( op && res );
 	op = writeString("#ROFF file#"); res = ( op && res );
@@ -584,27 +681,308 @@ bool datafile::writeHeader() {
 bool datafile::writeTag(const char * string) {
 	bool res = true;
 	bool op;
+
+	// top-level tags are objects for directory
+	if ( directory && (tag_level == 0) && 
+	     (strcmp(string, "eof") != 0) && (strcmp(string, "filedata") != 0) ) 
+	{
+		datafile_dir_entry entry;
+		entry.type = strdup(string);
+		entry.name = NULL;
+		entry.offset = writePos();
+		entry.size = 0;
+		directory->push_back(entry);
+	}
+	tag_level++;
+
 	op = writeString("tag");		res = (op && res);
 	op = writeString(string);		res = (op && res);
 	return res;
 };
 
 bool datafile::writeEndTag() {
-	return writeString("endtag");
+	bool res = writeString("endtag");
+	if (tag_level > 0)
+		tag_level--;
+	if ( directory && (tag_level == 0) && (directory->size() > 0) ) {
+		datafile_dir_entry & entry = directory->back();
+		if (entry.size == 0)
+			entry.size = writePos() - entry.offset;
+	}
+	return res;
 };
 
 bool datafile::writeEof() {
 	bool res = true;
 	bool op;
+	REAL dir_pos = writePos();
+	bool dir = false;
+	if ( directory && (directory->size() > 0) ) {
+		op = writeDirectory();			res = (op && res);
+		dir = true;
+	}
 	op = writeTag("eof");			res = (op && res);
 	op = writeEndTag();				res = (op && res);
+	// trailer: offset of directory tag and signature
+	if (dir) {
+		op = (writeBytes(&dir_pos, sizeof(REAL)) == sizeof(REAL));	res = (op && res);
+		op = (writeBytes(DF_DIRECTORY_MAGIC, 8) == 8);			res = (op && res);
+	}
+	op = flush();					res = (op && res);
 	return res;
 };
 
+bool datafile::writeDatafile(const datafile * mem_df) {
+	REAL pos = writePos();
+	if (mem_df->wbuf_size > 0) {
+		if (writeBytes(mem_df->wbuf, mem_df->wbuf_size) != mem_df->wbuf_size)
+			return false;
+	}
+	if ( directory && mem_df->directory && (tag_level == 0) ) {
+		size_t i;
+		for (i = 0; i < mem_df->directory->size(); i++) {
+			datafile_dir_entry entry = (*(mem_df->directory))[i];
+			entry.type = strdup(entry.type);
+			entry.name = entry.name ? strdup(entry.name) : NULL;
+			entry.offset += pos;
+			directory->push_back(entry);
+		}
+	}
+	return true;
+};
+
+bool datafile::flush() {
+	if (memory || (wbuf_size == 0))
+		return true;
+	size_t size = wbuf_size;
+	wbuf_size = 0;
+	if (file == -1)
+		return false;
+	return ( (size_t)write(file, wbuf, size) == size );
+};
+
+size_t datafile::writeBytes(const void * data, size_t size) {
+	if (size == 0)
+		return 0;
+	if (wbuf_size + size > wbuf_capacity) {
+		if (memory) {
+			size_t new_capacity = MAX(2*wbuf_capacity, wbuf_size + size);
+			char * new_wbuf = (char *)realloc(wbuf, new_capacity);
+			if (new_wbuf == NULL)
+				return 0;
+			wbuf = new_wbuf;
+			wbuf_capacity = new_capacity;
+		} else {
+			if (!flush())
+				return 0;
+			// large arrays are written directly
+			if (size >= wbuf_capacity) {
+				int r = write(file, data, size);
+				return (r > 0) ? (size_t)r : 0;
+			}
+		}
+	}
+	memcpy(wbuf + wbuf_size, data, size);
+	wbuf_size += size;
+	return size;
+};
+
+REAL datafile::writePos() {
+	if (memory)
+		return (REAL)wbuf_size;
+#ifdef XXL
+	return (REAL)(_lseeki64(file, 0, SEEK_CUR) + wbuf_size);
+#else
+	return (REAL)(lseek(file, 0, SEEK_CUR) + wbuf_size);
+#endif
+};
+
+bool datafile::writeDirectory() {
+	// directory tag is not an object
+	std::vector<datafile_dir_entry> * entries = directory;
+	directory = NULL;
+
+	strvec * types = create_strvec();
+	strvec * names = create_strvec();
+	vec * offsets = create_vec(entries->size(), 0, false);
+	vec * sizes = create_vec(entries->size(), 0, false);
+	size_t i;
+	for (i = 0; i < entries->size(); i++) {
+		const datafile_dir_entry & entry = (*entries)[i];
+		types->push_back(entry.type);
+		names->push_back(entry.name ? entry.name : "");
+		(*offsets)(i) = entry.offset;
+		(*sizes)(i) = entry.size;
+	}
+
+	bool res = true;
+	bool op;
+	op = writeTag("directory");			res = (op && res);
+	op = writeStringArray("types", types);		res = (op && res);
+	op = writeStringArray("names", names);		res = (op && res);
+	op = writeRealArray("offsets", offsets);	res = (op && res);
+	op = writeRealArray("sizes", sizes);		res = (op && res);
+	op = writeEndTag();				res = (op && res);
+
+	types->release();
+	names->release();
+	offsets->release();
+	sizes->release();
+
+	directory = entries;
+	return res;
+};
+
+bool datafile::readDirectory() {
+
+	if (directory_checked)
+		return (directory != NULL);
+	directory_checked = true;
+
+	if ( (file == -1) || !flush() )
+		return false;
+
+#ifdef XXL
+	__int64 file_pos = _lseeki64(file, 0, SEEK_CUR);
+	__int64 file_size = _lseeki64(file, 0, SEEK_END);
+#else
+	long file_pos = lseek(file, 0, SEEK_CUR);
+	long file_size = lseek(file, 0, SEEK_END);
+#endif
+
+	bool res = false;
+	REAL dir_pos = 0;
+	char magic[8];
+	char tagname[TAG_WORD_SIZE];
+	strvec * types = NULL;
+	strvec * names = NULL;
+	vec * offsets = NULL;
+	vec * sizes = NULL;
+
+	if (file_size < (long)(sizeof(REAL) + 8))
+		goto exit;
+
+#ifdef XXL
+	_lseeki64(file, file_size - sizeof(REAL) - 8, SEEK_SET);
+#else
+	lseek(file, file_size - sizeof(REAL) - 8, SEEK_SET);
+#endif
+	if (read(file, &dir_pos, sizeof(REAL)) != sizeof(REAL))
+		goto exit;
+	if (read(file, magic, 8) != 8)
+		goto exit;
+	if (strncmp(magic, DF_DIRECTORY_MAGIC, 8) != 0)
+		goto exit;
+	if ( (dir_pos < 0) || (dir_pos >= file_size) )
+		goto exit;
+
+#ifdef XXL
+	_lseeki64(file, (__int64)dir_pos, SEEK_SET);
+#else
+	lseek(file, (long)dir_pos, SEEK_SET);
+#endif
+	if ( !readTagName(tagname) || (strcmp(tagname, "directory") != 0) )
+		goto exit;
+	if ( !skipTagName() )
+		goto exit;
+	if ( !readWord() )
+		goto exit;
+
+	while ( !isWord("endtag") ) {
+		if ( isWord("array") ) {
+			if ( !readWord() ) goto exit;
+			if ( isWord("string") ) {
+				if ( !readWord() ) goto exit;
+				if ( isWord("types") && (types == NULL) ) {
+					if ( !readStringArray(types) ) goto exit;
+					if ( !readWord() ) goto exit;
+					continue;
+				}
+				if ( isWord("names") && (names == NULL) ) {
+					if ( !readStringArray(names) ) goto exit;
+					if ( !readWord() ) goto exit;
+					continue;
+				}
+				if ( !skipStringArray(false) ) goto exit;
+				if ( !readWord() ) goto exit;
+				continue;
+			}
+			if ( isWord(REAL_NAME) ) {
+				if ( !readWord() ) goto exit;
+				if ( isWord("offsets") && (offsets == NULL) ) {
+					if ( !readRealArray(offsets) ) goto exit;
+					if ( !readWord() ) goto exit;
+					continue;
+				}
+				if ( isWord("sizes") && (sizes == NULL) ) {
+					if ( !readRealArray(sizes) ) goto exit;
+					if ( !readWord() ) goto exit;
+					continue;
+				}
+				if ( !skipRealArray(false) ) goto exit;
+				if ( !readWord() ) goto exit;
+				continue;
+			}
+			if ( !skipArray(false) ) goto exit;
+			if ( !readWord() ) goto exit;
+			continue;
+		}
+		if ( !skip(false) ) goto exit;
+		if ( !readWord() ) goto exit;
+	}
+
+	if ( !types || !names || !offsets || !sizes )
+		goto exit;
+	if ( (types->size() != names->size()) || (types->size() != offsets->size()) || (types->size() != sizes->size()) )
+		goto exit;
+
+	{
+		directory = new std::vector<datafile_dir_entry>(types->size());
+		size_t i;
+		for (i = 0; i < types->size(); i++) {
+			datafile_dir_entry & entry = (*directory)[i];
+			entry.type = strdup( (*types)(i) );
+			entry.name = strdup( (*names)(i) );
+			entry.offset = (*offsets)(i);
+			entry.size = (*sizes)(i);
+		}
+		res = true;
+	}
+
+exit:
+	if (types)
+		types->release();
+	if (names)
+		names->release();
+	if (offsets)
+		offsets->release();
+	if (sizes)
+		sizes->release();
+
+#ifdef XXL
+	_lseeki64(file, file_pos, SEEK_SET);
+#else
+	lseek(file, file_pos, SEEK_SET);
+#endif
+	return res;
+};
+
+void datafile::freeDirectory() {
+	if (!directory)
+		return;
+	size_t i;
+	for (i = 0; i < directory->size(); i++) {
+		free( (*directory)[i].type );
+		free( (*directory)[i].name );
+	}
+	delete directory;
+	directory = NULL;
+};
+
 size_t datafile::writeBinaryString(const char * name) {
 	size_t r = 0;
-	r += write(file, name, strlen(name));
-	r += write(file, &zero, 1);
+	r += writeBytes(name, strlen(name));
+	r += writeBytes(&zero, 1);
 	return r;
 };
 
@@ -614,43 +992,49 @@ bool datafile::writeTextString(const char * string) {
 };
 
 bool datafile::writeString(const char * string) {
-	size_t r = write(file, string, strlen(string));
-	r += write(file, &zero, 1);
+	size_t r = writeBytes(string, strlen(string));
+	r += writeBytes(&zero, 1);
 	return (r > 0);
 };
 
 bool datafile::writeString(const char * name, const char * string) {
+	// name of top-level object for directory
+	if ( directory && (tag_level == 1) && (directory->size() > 0) && (strcmp(name, "name") == 0) ) {
+		datafile_dir_entry & entry = directory->back();
+		if (entry.name == NULL)
+			entry.name = strdup(string);
+	}
 	size_t r = writeBinaryString("char");
 	r += writeBinaryString(name);
-	r += write(file, string, strlen(string)+1);
+	r += writeBytes(string, strlen(string)+1);
 	return ( r > 0 );
 };
 
 bool datafile::writeInt(const char * name, const int & i) {
 	size_t r = writeBinaryString("int");
 	r += writeBinaryString(name);
-	r += write(file, (void *)&i, sizeof(int));
+	r += writeBytes((void *)&i, sizeof(int));
 	return ( r > 0 );
 };
 
 bool datafile::writeShort(const char * name, const short & i) {
 	size_t r = writeBinaryString("short");
 	r += writeBinaryString(name);
-	r += write(file, (void *)&i, sizeof(short));
+	r += writeBytes((void *)&i, sizeof(short));
 	return ( r > 0 );
 };
 
 bool datafile::writeReal(const char * name, const REAL & d) {
 	size_t r = writeBinaryString(REAL_NAME);
 	r += writeBinaryString(name);
-	r += write(file, (void *)&d, sizeof(REAL));
+	r += writeBytes((void *)&d, sizeof(REAL));
 	return (r > 0);
 };
 
 bool datafile::writeChar(const char * name, const char * c) {
 	size_t r = writeBinaryString("char");
 	r += writeBinaryString(name);
-	//r += write(file, (void *)c, strlen(csizeof(char));
+	//r += writeBytes((void *)c, strlen(csizeof(char));
 	r += writeBinaryString(c);
 	return (r > 0);
 };
@@ -660,33 +1044,41 @@ bool datafile::writeStringArray(const char * name, const strvec * data) {
 	size_t r = writeBinaryString("array");
 	r += writeBinaryString("string");
 	r += writeBinaryString(name);
-	r += write(file, (void *)&size, sizeof(surfit_int32));
+	r += writeBytes((void *)&size, sizeof(surfit_int32));
 	size_t i;
 	for (i = 0; i < data->size(); i++)
 		r += writeBinaryString( (*data)(i) );
 	return (r > 0);
 };
 
-bool datafile::writeRealArray(const char * name, const vec * data) {
+bool datafile::writeRealArray(const char * name, const vec * data, size_t stride) {
 	surfit_int32 size = (surfit_int32)data->size();
 	size_t r = writeBinaryString("array");
 	r += writeBinaryString(REAL_NAME);
 	r += writeBinaryString(name);
-	r += write(file, (void *)&size, sizeof(surfit_int32));
-	r += data->write_file(file, size);
-	//r += write(file, data->begin(), size*sizeof(REAL));
+	if ( datafile_compress && (data->size() >= DF_COMPRESS_MIN_SIZE) ) {
+		std::vector<char> stream;
+		if (realzip_compress(data->const_begin(), data->size(), stride, stream, serial)) {
+			surfit_int32 marker = DF_COMPRESSED_ARRAY;
+			r += writeBytes((void *)&marker, sizeof(surfit_int32));
+			r += writeBytes(&stream[0], stream.size());
+			return (r > 0);
+		}
+	}
+	r += writeBytes((void *)&size, sizeof(surfit_int32));
+	r += writeBytes(data->const_begin(), size*sizeof(REAL));
 	return (r > 0);
 };
 
 #ifdef XXL
-bool datafile::writeRealArray(const char * name, const extvec * data) {
+bool datafile::writeRealArray(const char * name, const extvec * data, size_t stride) {
 	surfit_int32 size = (surfit_int32)data->size();
 	size_t r = writeBinaryString("array");
 	r += writeBinaryString(REAL_NAME);
 	r += writeBinaryString(name);
-	r += write(file, (void *)&size, sizeof(surfit_int32));
-	r += data->write_file(file, size);
-	//r += write(file, data->begin(), size*sizeof(REAL));
+	r += writeBytes((void *)&size, sizeof(surfit_int32));
+	if (flush())
+		r += data->write_file(file, size);
 	return (r > 0);
 };
 #endif
@@ -696,8 +1088,8 @@ bool datafile::writeBoolArray(const char * name, const boolvec * data) {
 	surfit_int32 size = (surfit_int32)data->size();
 	r += writeBinaryString("bool");
 	r += writeBinaryString(name);
-	r += write(file, (void *)&size, sizeof(surfit_int32));
-	r += write(file, data->begin(), size*sizeof(bool));
+	r += writeBytes((void *)&size, sizeof(surfit_int32));
+	r += writeBytes(data->begin(), size*sizeof(bool));
 	return (r > 0);
 };
 
@@ -707,10 +1099,14 @@ bool datafile::writeBitArray(const char * name, const bitvec * data) {
 	surfit_int32 size = (surfit_int32)data->size();
 	r += writeBinaryString("bit");
 	r += writeBinaryString(name);
-	r += write(file, &size, sizeof(surfit_int32));
-	r += write(file, (void *)&int_size, sizeof(surfit_int32));
-	r += data->write_file(file);
-	//r += write(file, data->const_begin(), (int_size)*sizeof(surfit_int32));
+	r += writeBytes(&size, sizeof(surfit_int32));
+	r += writeBytes((void *)&int_size, sizeof(surfit_int32));
+#ifdef XXL
+	if (flush())
+		r += data->write_file(file);
+#else
+	r += writeBytes(data->const_begin(), int_size*sizeof(surfit_int32));
+#endif
 	return (r > 0);
 };
 
@@ -719,9 +1115,13 @@ bool datafile::writeShortArray(const char * name, const shortvec * data) {
 	surfit_int32 size = (surfit_int32)data->size();
 	r += writeBinaryString("short");
 	r += writeBinaryString(name);
-	r += write(file, (void *)&size, sizeof(surfit_int32));
-	r += data->write_file(file, size);
-	//r += write(file, data->begin(), size*sizeof(short));
+	r += writeBytes((void *)&size, sizeof(surfit_int32));
+#ifdef XXL
+	if (flush())
+		r += data->write_file(file, size);
+#else
+	r += writeBytes(data->const_begin(), size*sizeof(short));
+#endif
 	return (r > 0);
 };
 
@@ -730,8 +1130,19 @@ bool datafile::writeIntArray(const char * name, const intvec * data) {
 	surfit_int32 size = (surfit_int32)data->size();
 	r += writeBinaryString("int");
 	r += writeBinaryString(name);
-	r += write(file, (void *)&size, sizeof(surfit_int32));
-	r += write(file, data->begin(), size*sizeof(int));
+	r += writeBytes((void *)&size, sizeof(surfit_int32));
+	r += writeBytes(data->begin(), size*sizeof(int));
+	return (r > 0);
+};
+
+bool datafile::writeByteArray(const char * name, const std::vector<char> & data) {
+	size_t r = writeBinaryString("array");
+	surfit_int32 size = (surfit_int32)data.size();
+	r += writeBinaryString("byte");
+	r += writeBinaryString(name);
+	r += writeBytes((void *)&size, sizeof(surfit_int32));
+	if (size > 0)
+		r += writeBytes((void *)&data[0], size*sizeof(char));
 	return (r > 0);
 };
 
@@ -819,10 +1230,34 @@ bool datafile::readReal(REAL & d) {
 	return (r > 0);
 };
 
+bool datafile::checkArraySize(unsigned int size, size_t elem_size) {
+	// sizes are written as int, larger values come from negative or corrupted sizes
+	bool res = (size <= (unsigned int)INT_MAX);
+	if (res) {
+#ifdef XXL
+		__int64 pos = _lseeki64(file, 0, SEEK_CUR);
+		__int64 end = _lseeki64(file, 0, SEEK_END);
+		_lseeki64(file, pos, SEEK_SET);
+#else
+		long pos = lseek(file, 0, SEEK_CUR);
+		long end = lseek(file, 0, SEEK_END);
+		lseek(file, pos, SEEK_SET);
+#endif
+		if ( (pos >= 0) && (end >= pos) )
+			res = ( (unsigned long long)size*elem_size <= (unsigned long long)(end - pos) );
+	}
+	if (!res)
+		writelog(LOG_ERROR, "%s : wrong array size %u", datafile_filename, (unsigned int)size);
+	return res;
+};
+
 bool datafile::readStringArray(strvec *& data) {
 	size_t r = 0;
 	surfit_int32 size = 0;
 	if (read( file, &size, sizeof(surfit_int32)) > 0) {
+
+		if (!checkArraySize(size, 1))
+			return false;
 		
 		data = create_strvec(size);
 		if (data == NULL) {
@@ -846,6 +1281,35 @@ bool datafile::readRealArray(vec *& data) {
 	size_t r = 0;
 	surfit_int32 size = 0;
 	if (read( file, &size, sizeof(surfit_int32)) > 0) {
+
+		if (size == DF_COMPRESSED_ARRAY)
+			return readCompressedRealArray(data);
+
+		if (!checkArraySize(size, sizeof(REAL)))
+			return false;
+
+		// aligned arrays are used directly from the mapped file
+		if (mf) {
+#ifdef XXL
+			__int64 file_pos = _lseeki64(file, 0, SEEK_CUR);
+#else
+			long file_pos = lseek(file, 0, SEEK_CUR);
+#endif
+			size_t bytes = size*sizeof(REAL);
+			const char * ptr = mf->begin() + file_pos;
+			if ( (file_pos >= 0) && ((size_t)file_pos + bytes <= mf->size()) && 
+			     ((size_t)ptr % sizeof(REAL) == 0) ) 
+			{
+#ifdef XXL
+				_lseeki64(file, file_pos + bytes, SEEK_SET);
+#else
+				lseek(file, file_pos + bytes, SEEK_SET);
+#endif
+				// mapping is copy-on-write, so data can be modified
+				data = create_vec(mf, (REAL *)ptr, size);
+				return true;
+			}
+		}
 		
 		data = create_vec(size,0,0); // don't fill
 		if (data == NULL) {
@@ -867,11 +1331,79 @@ bool datafile::readRealArray(vec *& data) {
 	return false;
 };
 
+bool datafile::readCompressedRealArray(vec *& data) {
+#ifdef XXL
+	__int64 file_pos = _lseeki64(file, 0, SEEK_CUR);
+#else
+	long file_pos = lseek(file, 0, SEEK_CUR);
+#endif
+	char header[sizeof(realzip_header)];
+	size_t count = 0, bytes = 0;
+	if ( (read(file, header, sizeof(header)) != sizeof(header)) || !realzip_info(header, count, bytes) ) {
+		writelog(LOG_ERROR, "%s : wrong compressed array", datafile_filename);
+		return false;
+	}
+
+	// values are limited as for raw arrays, stream should fit into the file.
+	// Count can't be checked against the file size: runs of predicted values take a few bytes
+	size_t rest = bytes - sizeof(header);
+	if ( (count > (size_t)INT_MAX) || (rest > (size_t)INT_MAX) || !checkArraySize((unsigned int)rest, 1) ) {
+		writelog(LOG_ERROR, "%s : wrong compressed array", datafile_filename);
+		return false;
+	}
+
+	// mapped file is decompressed in place
+	const char * stream = NULL;
+	char * buf = NULL;
+	if ( mf && (file_pos >= 0) && ((size_t)file_pos + bytes <= mf->size()) )
+		stream = mf->begin() + file_pos;
+	else {
+		buf = (char *)malloc(bytes);
+		if (buf == NULL) {
+			writelog(LOG_ERROR,"Out of memory");
+			return false;
+		}
+		memcpy(buf, header, sizeof(header));
+		if ((size_t)read(file, buf + sizeof(header), rest) != rest) {
+			free(buf);
+			return false;
+		}
+		stream = buf;
+	}
+
+#ifdef XXL
+	_lseeki64(file, file_pos + bytes, SEEK_SET);
+#else
+	lseek(file, file_pos + bytes, SEEK_SET);
+#endif
+
+	data = create_vec(count, 0, 0); // don't fill
+	bool res = (data != NULL);
+	if (!res)
+		writelog(LOG_ERROR,"Out of memory");
+	else if ( !realzip_decompress(stream, bytes, data->begin()) ) {
+		writelog(LOG_ERROR, "%s : wrong compressed array", datafile_filename);
+		data->release();
+		data = NULL;
+		res = false;
+	}
+	free(buf);
+	return res;
+};
+
 #ifdef XXL
 bool datafile::readRealArray(extvec *& data) {
 	size_t r = 0;
 	surfit_int32 size = 0;
 	if (read( file,  &size, sizeof(surfit_int32)) > 0) {
+
+		if (size == DF_COMPRESSED_ARRAY) {
+			writelog(LOG_ERROR, "%s : compressed arrays are not supported", datafile_filename);
+			return false;
+		}
+
+		if (!checkArraySize(size, sizeof(REAL)))
+			return false;
 		
 		data = create_extvec(size,0,0); // don't fill
 		if (data == NULL) {
@@ -899,6 +1431,9 @@ bool datafile::readBoolArray(boolvec *& data) {
 	surfit_int32 size = 0;
 	if (read( file,  &size, sizeof(surfit_int32)) > 0) {
 		
+		if (!checkArraySize(size, sizeof(bool)))
+			return false;
+
 		data = create_boolvec(size,0,0); // don't fill
 		
 		r = read( file, data->begin(), sizeof(bool)*size );
@@ -920,8 +1455,11 @@ bool datafile::readBitArray(bitvec *& data) {
 	surfit_int32 size = 0;
 	if (read( file,  &size, sizeof(surfit_int32)) > 0) {
 		
-		size_t elements = 0;
+		surfit_int32 elements = 0;
 		r = read( file, &elements, sizeof(surfit_int32) );
+
+		if (!checkArraySize(elements, sizeof(surfit_int32)))
+			return false;
 		
 		data = create_bitvec(size);
 		
@@ -945,6 +1483,9 @@ bool datafile::readShortArray(shortvec *& data) {
 	surfit_int32 size = 0;
 	if (read( file, &size, sizeof(surfit_int32)) > 0) {
 		
+		if (!checkArraySize(size, sizeof(short)))
+			return false;
+
 		data = create_shortvec(size,0,0); // don't fill
 		
 		r = data->read_file(file, size);
@@ -967,6 +1508,9 @@ bool datafile::readIntArray(intvec *& data) {
 	surfit_int32 size = 0;
 	if (read( file,  &size, sizeof(surfit_int32)) > 0) {
 		
+		if (!checkArraySize(size, sizeof(int)))
+			return false;
+
 		data = create_intvec(size,0,0); // don't fill
 		
 		r = read( file, data->begin(), sizeof(int)*size );
@@ -983,6 +1527,28 @@ bool datafile::readIntArray(intvec *& data) {
 	return false;
 };
 
+bool datafile::readByteArray(std::vector<char> & data) {
+	surfit_int32 size = 0;
+	if (read( file,  &size, sizeof(surfit_int32)) > 0) {
+
+		if (!checkArraySize(size, sizeof(char)))
+			return false;
+
+		data.resize(size);
+		if (size == 0)
+			return true;
+
+		size_t r = read( file, &data[0], sizeof(char)*size );
+
+		if ( r == size*sizeof(char) )
+			return true;
+		data.resize(0);
+		return false;
+	};
+
+	return false;
+};
+
 void datafile::file_info(char *& contents) {
 	
 	int count = 0;
@@ -1107,5 +1673,9 @@ const char * datafile::get_filename() const {
 	return datafile_filename;
 };
 
+void datafile::set_serial(bool iserial) {
+	serial = iserial;
+};
+
 }; // namespace surfit;
 
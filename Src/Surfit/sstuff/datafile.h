@@ -25,6 +25,7 @@
 */
 
 #include <stdio.h>
+#include <vector>
 #include "../sstuff/vec.h"
 
 namespace surfit {
@@ -34,10 +35,20 @@ class shortvec;
 class bitvec;
 class boolvec;
 class strvec;
+class mapfile;
 
 //! 1 - create new file, 0 - create or append if file already exists
 extern SSTUFF_EXPORT int datafile_modE;
 
+//! 1 - real arrays are read from memory-mapped file without copying, 0 - arrays are copied
+extern SSTUFF_EXPORT int datafile_mmap;
+
+//! 1 - independent objects are serialized in parallel (if threads are enabled), 0 - sequentially
+extern SSTUFF_EXPORT int datafile_parallel;
+
+//! 1 - real arrays are written compressed (see \ref realzip.h), 0 - arrays are written as is
+extern SSTUFF_EXPORT int datafile_compress;
+
 //! buffer size for reading
 #define BUFFER 2048
 
@@ -50,6 +61,37 @@ extern SSTUFF_EXPORT int datafile_modE;
 //! datafile class should work in read mode
 #define DF_MODE_READ       1
 
+/*! datafile class should write into memory buffer (see \ref datafile::writeDatafile).
+    Not supported in XXL version.
+*/
+#define DF_MODE_MEMORY     2
+
+//! size of output buffer for writing
+#define DF_WRITE_BUFFER    262144
+
+//! array size value, which means that compressed real array follows
+#define DF_COMPRESSED_ARRAY 0xFFFFFFFF
+
+//! real arrays shorter than this are never compressed
+#define DF_COMPRESS_MIN_SIZE 256
+
+//! signature of the directory trailer at the end of datafile
+#define DF_DIRECTORY_MAGIC "surfdir1"
+
+/*! \struct datafile_dir_entry
+    \brief description of top-level tag (saved object) in datafile directory
+*/
+struct datafile_dir_entry {
+	//! tag name (object type)
+	char * type;
+	//! object name ("" for unnamed objects)
+	char * name;
+	//! offset of the tag in file
+	REAL offset;
+	//! tag size in bytes
+	REAL size;
+};
+
 /*! \class datafile
     \brief supports surfit binary file format
 
@@ -60,7 +102,7 @@ class SSTUFF_EXPORT datafile {
 public:
 	/*! constructor
 	\param filename filename for input/output
-	\param mode (write = 0, read = 1)
+	\param mode (write = 0, read = 1, memory = 2)
 	*/
 	datafile(const char * filename, int mode);
 
@@ -76,6 +118,14 @@ public:
 	bool writeEndTag();
 	//! writes "tag eof endtag" 
 	bool writeEof();
+
+	/*! \brief writes contents of memory datafile (\ref DF_MODE_MEMORY) 
+	    Objects are written exactly as they would be written directly into this file.
+	*/
+	bool writeDatafile(const datafile * mem_df);
+
+	//! writes buffered data to file
+	bool flush();
 		
 	//! writes named string
 	bool writeString(const char * name, const char * string);
@@ -107,10 +157,11 @@ public:
 	/*! writes array of REALs
 	    \param name array name
 	    \param data \ref vec "array of REAL"
+	    \param stride row length for arrays of 2D grid values (helps compression), or 0
 	*/
-	bool writeRealArray(const char * name, const vec * data);
+	bool writeRealArray(const char * name, const vec * data, size_t stride = 0);
 #ifdef XXL
-	bool writeRealArray(const char * name, const extvec * data);
+	bool writeRealArray(const char * name, const extvec * data, size_t stride = 0);
 #endif
 
 	/*! writes array of shorts */
@@ -127,6 +178,9 @@ public:
 
 	/*! writes array of strings */
 	bool writeStringArray(const char * name, const strvec * data);
+
+	/*! writes array of bytes */
+	bool writeByteArray(const char * name, const std::vector<char> & data);
 	
 	//! reads word
 	bool readWord();
@@ -166,12 +220,20 @@ public:
 
 	/*! reads string array */
 	bool readStringArray(strvec *& data);
+
+	/*! reads array of bytes */
+	bool readByteArray(std::vector<char> & data);
 	
 	/*! checks usability of datafile */
 	bool condition() const;
 
-	//! finds begin of tag named "tagname"
-	bool findTag(const char * tagname, const char * another_tagname = NULL);
+	/*! \brief finds begin of tag named "tagname"
+	    \param tagname tag name
+	    \param another_tagname alternative tag name
+	    \param object_name if not NULL and file has directory, tags with names not matching 
+	    object_name are skipped without reading
+	*/
+	bool findTag(const char * tagname, const char * another_tagname = NULL, const char * object_name = NULL);
 
 	//! finds begin of tag named "eof"
 	bool findTagEof();
@@ -270,6 +332,10 @@ public:
 	// internal writing
 	//
 
+	//! (internal) writes bytes to output buffer, returns amount of written bytes
+	size_t writeBytes(const void * data, size_t size);
+	//! (internal) returns current writing position
+	REAL writePos();
 	//! (internal) writes string as binary
 	size_t writeBinaryString(const char * string);
 	//! (internal) writes string
@@ -280,6 +346,8 @@ public:
 	bool writeHeader();
 	//! (internal) checks for roff-header
 	bool checkHeader(const char * filename);
+	//! (internal) checks array size read from file: it should be non-negative int and fit into the rest of file
+	bool checkArraySize(unsigned int size, size_t elem_size);
 	
 	//
 	// internal reading
@@ -294,6 +362,8 @@ public:
 
 	//! skips some bytes
 	bool skipBytes(long how_much);
+	//! reads compressed real array (after its size)
+	bool readCompressedRealArray(vec *& data);
 	//! skips header
 	void skipHeader(const char * filename);
 	//! skips tag
@@ -305,6 +375,8 @@ public:
 	FILE * File;
 	//! returns filename
 	const char * get_filename() const;
+	//! if true, arrays are compressed without threads (datafile is filled inside job)
+	void set_serial(bool iserial);
 	//! buffer for reading words
 	char word[TAG_WORD_SIZE]; 
 	
@@ -314,6 +386,38 @@ public:
 	//! name of ROFF file
 	char * datafile_filename;
 
+	//! memory-mapped file contents (read mode with \ref datafile_mmap only)
+	mapfile * mf;
+
+	//! output buffer
+	char * wbuf;
+	//! amount of bytes in output buffer
+	size_t wbuf_size;
+	//! size of output buffer
+	size_t wbuf_capacity;
+	//! true for memory datafile (\ref DF_MODE_MEMORY)
+	bool memory;
+	//! true if compression should not use threads
+	bool serial;
+
+	//
+	// directory
+	//
+
+	//! (internal) writes directory tag and trailer
+	bool writeDirectory();
+	//! (internal) reads directory, if file has it
+	bool readDirectory();
+	//! (internal) frees directory entries
+	void freeDirectory();
+
+	//! top-level tags written to file (write mode) or read from directory (read mode)
+	std::vector<datafile_dir_entry> * directory;
+	//! nesting level of tags being written
+	int tag_level;
+	//! true if directory was searched for (read mode)
+	bool directory_checked;
+
 };
 
 }; // namespace surfit;
@@ -0,0 +1,301 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "sstuff_ie.h"
+#include "mapfile.h"
+#include "fileio.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_THREADS
+#include "ptypes/pasync.h"
+USING_PTYPES
+#endif
+
+namespace surfit {
+
+//! all existing mappings
+static std::vector<mapfile *> mapfiles;
+
+#ifdef HAVE_THREADS
+//! guards mapfiles and users of mappings
+static mutex mapfiles_mutex;
+#endif
+
+inline
+void mapfiles_lock() {
+#ifdef HAVE_THREADS
+	mapfiles_mutex.enter();
+#endif
+};
+
+inline
+void mapfiles_unlock() {
+#ifdef HAVE_THREADS
+	mapfiles_mutex.leave();
+#endif
+};
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+
+//! gets volume and file index of the opened file
+static bool get_file_id(void * file, unsigned long long & dev, unsigned long long & id) {
+	BY_HANDLE_FILE_INFORMATION info;
+	if (!GetFileInformationByHandle((HANDLE)file, &info))
+		return false;
+	dev = info.dwVolumeSerialNumber;
+	id = ((unsigned long long)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+	return true;
+};
+
+//! gets volume and file index of the file by name
+static bool get_file_id(const char * filename, unsigned long long & dev, unsigned long long & id) {
+	HANDLE file = CreateFileA(filename, 0, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, 
+				  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	bool res = get_file_id((void *)file, dev, id);
+	CloseHandle(file);
+	return res;
+};
+
+#else
+
+//! gets device and inode of the file by name
+static bool get_file_id(const char * filename, unsigned long long & dev, unsigned long long & id) {
+	struct stat st;
+	if (stat(filename, &st) != 0)
+		return false;
+	dev = (unsigned long long)st.st_dev;
+	id = (unsigned long long)st.st_ino;
+	return true;
+};
+
+#endif
+
+mapfile * create_mapfile(const char * filename, bool copy_on_write) {
+	mapfile * res = new mapfile(filename, copy_on_write);
+	if (res->is_open())
+		return res;
+	res->release();
+	return NULL;
+};
+
+void mapfile_detach_all(const char * filename) {
+	// the same file can be reached by different names, so it is found by device and inode
+	unsigned long long dev, id;
+	if (!get_file_id(filename, dev, id))
+		return;
+
+	std::vector<mapfile *> found;
+	size_t i;
+	mapfiles_lock();
+	for (i = 0; i < mapfiles.size(); i++) {
+		if (mapfiles[i]->file_known && (mapfiles[i]->file_dev == dev) && (mapfiles[i]->file_id == id))
+			found.push_back(mapfiles[i]);
+	}
+	mapfiles_unlock();
+
+	for (i = 0; i < found.size(); i++) {
+		// detaching of the last user of released mapping deletes it
+		mapfile * mf = found[i];
+		for (;;) {
+			mapfiles_lock();
+			if ( (std::find(mapfiles.begin(), mapfiles.end(), mf) == mapfiles.end()) || (mf->users.size() == 0) ) {
+				mapfiles_unlock();
+				break;
+			}
+			std::pair<void *, void (*)(void *)> user = mf->users.back();
+			mapfiles_unlock();
+			// detach function calls mapfile::detach, so the lock is not held here
+			user.second(user.first);
+		}
+	}
+};
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+
+mapfile::mapfile(const char * filename, bool copy_on_write) {
+	data = NULL;
+	data_size = 0;
+	mapped = false;
+	mapping = NULL;
+	owned = true;
+	file_known = false;
+	file_dev = file_id = 0;
+	mapfiles_lock();
+	mapfiles.push_back(this);
+	mapfiles_unlock();
+
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 
+			   FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = NULL;
+		writelog(LOG_ERROR, "The file %s was not opened", filename);
+		return;
+	}
+	file_known = get_file_id(file, file_dev, file_id);
+
+	LARGE_INTEGER fsize;
+	if (!GetFileSizeEx((HANDLE)file, &fsize)) {
+		writelog(LOG_ERROR, "Can't get size of file %s", filename);
+		return;
+	}
+	data_size = (size_t)fsize.QuadPart;
+
+	// empty files can't be mapped
+	if (data_size == 0) {
+		data = "";
+		mapped = true;
+		return;
+	}
+
+	mapping = CreateFileMappingA((HANDLE)file, NULL, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		writelog(LOG_ERROR, "Can't map file %s into memory", filename);
+		return;
+	}
+
+	data = (const char *)MapViewOfFile((HANDLE)mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) {
+		writelog(LOG_ERROR, "Can't map file %s into memory", filename);
+		return;
+	}
+	mapped = true;
+};
+
+mapfile::~mapfile() {
+	if (mapped && (data_size > 0))
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle((HANDLE)mapping);
+	if (file)
+		CloseHandle((HANDLE)file);
+	mapfiles_lock();
+	mapfiles.erase(std::find(mapfiles.begin(), mapfiles.end(), this));
+	mapfiles_unlock();
+};
+
+#else
+
+mapfile::mapfile(const char * filename, bool copy_on_write) {
+	data = NULL;
+	data_size = 0;
+	mapped = false;
+	owned = true;
+	file_known = false;
+	file_dev = file_id = 0;
+	mapfiles_lock();
+	mapfiles.push_back(this);
+	mapfiles_unlock();
+
+	file = open(filename, O_RDONLY);
+	if (file == -1) {
+		writelog(LOG_ERROR, "The file %s was not opened: %s", filename, strerror( errno ));
+		return;
+	}
+
+	struct stat st;
+	if (fstat(file, &st) != 0) {
+		writelog(LOG_ERROR, "Can't get size of file %s: %s", filename, strerror( errno ));
+		return;
+	}
+	data_size = (size_t)st.st_size;
+	file_dev = (unsigned long long)st.st_dev;
+	file_id = (unsigned long long)st.st_ino;
+	file_known = true;
+
+	// empty files can't be mapped
+	if (data_size == 0) {
+		data = "";
+		mapped = true;
+		return;
+	}
+
+	void * ptr = mmap(NULL, data_size, copy_on_write ? (PROT_READ|PROT_WRITE) : PROT_READ, MAP_PRIVATE, file, 0);
+	if (ptr == MAP_FAILED) {
+		writelog(LOG_ERROR, "Can't map file %s into memory: %s", filename, strerror( errno ));
+		return;
+	}
+	data = (const char *)ptr;
+	mapped = true;
+};
+
+mapfile::~mapfile() {
+	if (mapped && (data_size > 0))
+		munmap((void *)data, data_size);
+	if (file != -1)
+		close(file);
+	mapfiles_lock();
+	mapfiles.erase(std::find(mapfiles.begin(), mapfiles.end(), this));
+	mapfiles_unlock();
+};
+
+#endif
+
+void mapfile::release() {
+	mapfiles_lock();
+	owned = false;
+	bool unused = (users.size() == 0);
+	mapfiles_unlock();
+	if (unused)
+		delete this;
+};
+
+void mapfile::attach(void * user, void (*detach_func)(void *)) {
+	mapfiles_lock();
+	users.push_back( std::make_pair(user, detach_func) );
+	mapfiles_unlock();
+};
+
+void mapfile::detach(void * user) {
+	mapfiles_lock();
+	size_t i;
+	for (i = users.size(); i > 0; i--) {
+		if (users[i-1].first == user) {
+			users.erase(users.begin() + (i-1));
+			break;
+		}
+	}
+	bool unused = (!owned && (users.size() == 0));
+	mapfiles_unlock();
+	if (unused)
+		delete this;
+};
+
+bool mapfile::is_open() const {
+	return mapped;
+};
+
+}; // namespace surfit;
+
@@ -0,0 +1,132 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __sstuff__mapfile__
+#define __sstuff__mapfile__
+
+#include <vector>
+
+/*! \file
+    \brief declaration of class mapfile - read-only memory-mapped file
+*/
+
+namespace surfit {
+
+class mapfile;
+
+/*! \brief maps file contents into memory for reading
+    \param filename file name
+    \param copy_on_write if true, mapped pages can be modified. Modified pages are 
+    copied by the operating system and are never written back to the file.
+    \return NULL if file can't be opened or mapped
+*/
+SSTUFF_EXPORT
+mapfile * create_mapfile(const char * filename, bool copy_on_write = false);
+
+/*! \brief detaches all objects using mapped memory of the file (see \ref mapfile::attach)
+    Should be called before the file is rewritten. Mappings are matched by device and 
+    inode, so any name of the file can be used.
+*/
+SSTUFF_EXPORT
+void mapfile_detach_all(const char * filename);
+
+/*! \class mapfile
+    \brief read-only view of the whole file contents
+
+    File pages are loaded by the operating system on demand, so large files
+    can be parsed without reading them into the allocated memory.
+*/
+class SSTUFF_EXPORT mapfile {
+protected:
+	//! constructor
+	mapfile(const char * filename, bool copy_on_write);
+
+	//! destructor
+	~mapfile();
+
+public:
+
+	friend SSTUFF_EXPORT
+	//! maps file contents into memory for reading
+	mapfile * create_mapfile(const char * filename, bool copy_on_write);
+
+	friend SSTUFF_EXPORT
+	//! detaches all objects using mapped memory of the file
+	void mapfile_detach_all(const char * filename);
+
+	//! destructor. Mapping stays alive while attached objects exist
+	void release();
+
+	/*! \brief registers object using mapped memory
+	    \param user object
+	    \param detach_func function which copies object data to the allocated memory 
+	    and calls \ref detach
+	*/
+	void attach(void * user, void (*detach_func)(void *));
+
+	//! unregisters object using mapped memory
+	void detach(void * user);
+
+	//! returns pointer to the first byte of the file
+	const char * begin() const { return data; };
+
+	//! returns pointer next to the last byte of the file
+	const char * end() const { return data + data_size; };
+
+	//! returns file size in bytes
+	size_t size() const { return data_size; };
+
+	//! returns true if file was mapped successfully
+	bool is_open() const;
+
+private:
+
+	//! mapped file contents
+	const char * data;
+	//! file size
+	size_t data_size;
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+	//! file handle
+	void * file;
+	//! file mapping handle
+	void * mapping;
+#else
+	//! file descriptor
+	int file;
+#endif
+	//! true if file was mapped
+	bool mapped;
+
+	//! true if device and inode of the mapped file are known
+	bool file_known;
+	//! device (volume serial number on Windows) of the mapped file
+	unsigned long long file_dev;
+	//! inode (file index on Windows) of the mapped file
+	unsigned long long file_id;
+	//! true until \ref release is called
+	bool owned;
+	//! objects using mapped memory and their detach functions
+	std::vector< std::pair<void *, void (*)(void *)> > users;
+};
+
+}; // namespace surfit;
+
+#endif
+
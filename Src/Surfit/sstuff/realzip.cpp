@@ -0,0 +1,371 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "sstuff_ie.h"
+#include "realzip.h"
+#include "threads.h"
+
+#include <string.h>
+
+namespace surfit {
+
+//! control byte for run of exactly predicted values
+#define REALZIP_RUN 0xFF
+
+typedef unsigned long long realzip_bits;
+
+inline
+realzip_bits real_bits(REAL value) {
+	realzip_bits res = 0;
+	memcpy(&res, &value, sizeof(REAL));
+	return res;
+};
+
+inline
+REAL bits_real(realzip_bits bits) {
+	REAL res;
+	memcpy(&res, &bits, sizeof(REAL));
+	return res;
+};
+
+//! bits used by REAL values
+const realzip_bits realzip_mask = (sizeof(REAL) < sizeof(realzip_bits)) ? 
+	((realzip_bits(1) << (8*sizeof(REAL))) - 1) : ~realzip_bits(0);
+
+/*! \brief predicts bits of data[i] from the previous values of the block, starting at position from
+    Prediction is made on integer bit patterns, so it is exact and the same on every 
+    platform regardless of floating point rounding, NaNs and infinities.
+*/
+inline
+realzip_bits realzip_predict(const REAL * data, size_t i, size_t from, size_t stride) {
+	if (i == from)
+		return 0;
+	if ( (stride == 0) || (i - from < stride) )
+		return real_bits(data[i-1]);
+	if ( (i - from) % stride == 0 )
+		return real_bits(data[i-stride]);
+	realzip_bits res = real_bits(data[i-1]) + real_bits(data[i-stride]) - real_bits(data[i-stride-1]);
+	return res & realzip_mask;
+};
+
+static void realzip_encode_block(const REAL * data, size_t from, size_t to, size_t stride,
+				 std::vector<char> & out)
+{
+	const int n_bytes = sizeof(REAL);
+	out.reserve((to - from)*2);
+	size_t i = from;
+	while (i < to) {
+		realzip_bits r = real_bits(data[i]) ^ realzip_predict(data, i, from, stride);
+		if (r == 0) {
+			size_t run = 1;
+			while ( (i + run < to) &&
+				(real_bits(data[i+run]) == realzip_predict(data, i+run, from, stride)) )
+				run++;
+			out.push_back((char)REALZIP_RUN);
+			// run length as varint
+			size_t len = run;
+			while (len >= 0x80) {
+				out.push_back((char)((len & 0x7F) | 0x80));
+				len >>= 7;
+			}
+			out.push_back((char)len);
+			i += run;
+			continue;
+		}
+		int tz = 0;
+		while ( ((r >> (8*tz)) & 0xFF) == 0 )
+			tz++;
+		int hi = n_bytes - 1;
+		while ( ((r >> (8*hi)) & 0xFF) == 0 )
+			hi--;
+		out.push_back((char)(((n_bytes - 1 - hi) << 4) | tz));
+		int b;
+		for (b = tz; b <= hi; b++)
+			out.push_back((char)((r >> (8*b)) & 0xFF));
+		i++;
+	}
+};
+
+static bool realzip_decode_block(const unsigned char * src, const unsigned char * src_end,
+				 REAL * data, size_t from, size_t to, size_t stride)
+{
+	const int n_bytes = sizeof(REAL);
+	size_t i = from;
+	while (i < to) {
+		if (src >= src_end)
+			return false;
+		unsigned char c = *src++;
+		if (c == REALZIP_RUN) {
+			size_t run = 0;
+			int shift = 0;
+			for (;;) {
+				if ( (src >= src_end) || (shift > 56) )
+					return false;
+				unsigned char v = *src++;
+				run |= (size_t)(v & 0x7F) << shift;
+				if ((v & 0x80) == 0)
+					break;
+				shift += 7;
+			}
+			if ( (run == 0) || (run > to - i) )
+				return false;
+			size_t j;
+			for (j = 0; j < run; j++, i++)
+				data[i] = bits_real(realzip_predict(data, i, from, stride));
+			continue;
+		}
+		int lz = c >> 4;
+		int tz = c & 0x0F;
+		if (lz + tz >= n_bytes)
+			return false;
+		int n = n_bytes - lz - tz;
+		if (src_end - src < n)
+			return false;
+		realzip_bits r = 0;
+		int b;
+		for (b = 0; b < n; b++)
+			r |= (realzip_bits)(*src++) << (8*(tz + b));
+		data[i] = bits_real(realzip_predict(data, i, from, stride) ^ r);
+		i++;
+	}
+	return (src == src_end);
+};
+
+//! amount of values in one block: whole rows for 2D arrays
+static size_t realzip_block_size(size_t stride) {
+	if (stride == 0)
+		return REALZIP_BLOCK_SIZE;
+	size_t rows = MAX(1, REALZIP_BLOCK_SIZE/stride);
+	return rows*stride;
+};
+
+#ifdef HAVE_THREADS
+struct realzip_job : public job
+{
+	realzip_job()
+	{
+		data = NULL;
+		cdata = NULL;
+		size = 0;
+		stride = 0;
+		block_size = 0;
+		parts = NULL;
+		src = NULL;
+		offsets = NULL;
+		results = NULL;
+		from = 0;
+		step = 1;
+	};
+	void set_encode(const REAL * idata, size_t isize, size_t istride, size_t iblock_size,
+			std::vector< std::vector<char> > * iparts, size_t ifrom, size_t istep)
+	{
+		data = NULL;
+		cdata = idata;
+		size = isize;
+		stride = istride;
+		block_size = iblock_size;
+		parts = iparts;
+		src = NULL;
+		offsets = NULL;
+		results = NULL;
+		from = ifrom;
+		step = istep;
+	};
+	void set_decode(REAL * idata, size_t isize, size_t istride, size_t iblock_size,
+			const unsigned char * isrc, const std::vector<realzip_bits> * ioffsets,
+			std::vector<char> * iresults, size_t ifrom, size_t istep)
+	{
+		data = idata;
+		cdata = NULL;
+		size = isize;
+		stride = istride;
+		block_size = iblock_size;
+		parts = NULL;
+		src = isrc;
+		offsets = ioffsets;
+		results = iresults;
+		from = ifrom;
+		step = istep;
+	};
+	virtual void do_job()
+	{
+		// blocks are compressed with different speed, so every job takes each step-th block
+		size_t blocks = (size + block_size - 1)/block_size;
+		size_t b;
+		for (b = from; b < blocks; b += step) {
+			size_t block_from = b*block_size;
+			size_t block_to = MIN(size, block_from + block_size);
+			if (parts)
+				realzip_encode_block(cdata, block_from, block_to, stride, (*parts)[b]);
+			else
+				(*results)[b] = realzip_decode_block(src + (*offsets)[b], src + (*offsets)[b+1],
+								     data, block_from, block_to, stride);
+		}
+	};
+
+	REAL * data;
+	const REAL * cdata;
+	size_t size;
+	size_t stride;
+	size_t block_size;
+	std::vector< std::vector<char> > * parts;
+	const unsigned char * src;
+	const std::vector<realzip_bits> * offsets;
+	std::vector<char> * results;
+	size_t from, step;
+};
+
+realzip_job realzip_jobs[MAX_CPU];
+#endif
+
+bool realzip_compress(const REAL * data, size_t size, size_t stride, std::vector<char> & stream, bool serial) {
+
+	size_t block_size = realzip_block_size(stride);
+	size_t blocks = (size + block_size - 1)/block_size;
+	std::vector< std::vector<char> > parts(blocks);
+	size_t b;
+
+#ifdef HAVE_THREADS
+	if (serial || (sstuff_get_threads() == 1) || (blocks < 2)) {
+#endif
+		for (b = 0; b < blocks; b++)
+			realzip_encode_block(data, b*block_size, MIN(size, (b+1)*block_size), stride, parts[b]);
+#ifdef HAVE_THREADS
+	} else {
+		size_t threads = MIN(sstuff_get_threads(), blocks);
+		size_t t;
+		for (t = 0; t < threads; t++) {
+			realzip_job & f = realzip_jobs[t];
+			f.set_encode(data, size, stride, block_size, &parts, t, threads);
+			set_job(&f, t);
+		}
+		do_jobs();
+	}
+#endif
+
+	std::vector<realzip_bits> offsets(blocks+1, 0);
+	for (b = 0; b < blocks; b++)
+		offsets[b+1] = offsets[b] + parts[b].size();
+
+	realzip_header hdr;
+	memcpy(hdr.magic, REALZIP_MAGIC, 4);
+	hdr.stride = (unsigned int)stride;
+	hdr.count = size;
+	hdr.block_size = block_size;
+	hdr.blocks = blocks;
+	hdr.bytes = sizeof(hdr) + (blocks+1)*sizeof(realzip_bits) + offsets[blocks];
+
+	stream.resize((size_t)hdr.bytes);
+	char * ptr = &stream[0];
+	memcpy(ptr, &hdr, sizeof(hdr));
+	ptr += sizeof(hdr);
+	memcpy(ptr, &offsets[0], (blocks+1)*sizeof(realzip_bits));
+	ptr += (blocks+1)*sizeof(realzip_bits);
+	for (b = 0; b < blocks; b++) {
+		if (parts[b].size() > 0)
+			memcpy(ptr, &(parts[b][0]), parts[b].size());
+		ptr += parts[b].size();
+	}
+
+	return true;
+};
+
+//! checks that header fields agree with each other, so they can be used for allocations
+static bool realzip_check_header(const realzip_header & hdr) {
+	if (memcmp(hdr.magic, REALZIP_MAGIC, 4) != 0)
+		return false;
+	if ( (hdr.block_size == 0) || (hdr.bytes < sizeof(hdr)) )
+		return false;
+	if ( (hdr.stride > 0) && (hdr.block_size % hdr.stride != 0) )
+		return false;
+	if ( hdr.blocks != hdr.count/hdr.block_size + ((hdr.count % hdr.block_size) ? 1 : 0) )
+		return false;
+	// table of block offsets should fit into the stream
+	if ( hdr.blocks >= (hdr.bytes - sizeof(hdr))/sizeof(realzip_bits) )
+		return false;
+	return true;
+};
+
+bool realzip_info(const char * header, size_t & count, size_t & bytes) {
+	realzip_header hdr;
+	memcpy(&hdr, header, sizeof(hdr));
+	if (!realzip_check_header(hdr))
+		return false;
+	count = (size_t)hdr.count;
+	bytes = (size_t)hdr.bytes;
+	return true;
+};
+
+bool realzip_decompress(const char * stream, size_t stream_size, REAL * data) {
+
+	if (stream_size < sizeof(realzip_header))
+		return false;
+
+	realzip_header hdr;
+	memcpy(&hdr, stream, sizeof(hdr));
+	if ( !realzip_check_header(hdr) || (hdr.bytes > stream_size) )
+		return false;
+
+	size_t size = (size_t)hdr.count;
+	size_t stride = hdr.stride;
+	size_t block_size = (size_t)hdr.block_size;
+	size_t blocks = (size_t)hdr.blocks;
+
+	size_t table_size = (blocks+1)*sizeof(realzip_bits);
+	std::vector<realzip_bits> offsets(blocks+1);
+	memcpy(&offsets[0], stream + sizeof(hdr), table_size);
+
+	const unsigned char * src = (const unsigned char *)stream + sizeof(hdr) + table_size;
+	realzip_bits src_size = hdr.bytes - sizeof(hdr) - table_size;
+	size_t b;
+	for (b = 0; b < blocks; b++) {
+		if ( (offsets[b] > offsets[b+1]) || (offsets[b+1] > src_size) )
+			return false;
+	}
+
+	std::vector<char> results(blocks, 0);
+
+#ifdef HAVE_THREADS
+	if ((sstuff_get_threads() == 1) || (blocks < 2)) {
+#endif
+		for (b = 0; b < blocks; b++)
+			results[b] = realzip_decode_block(src + offsets[b], src + offsets[b+1],
+							  data, b*block_size, MIN(size, (b+1)*block_size), stride);
+#ifdef HAVE_THREADS
+	} else {
+		size_t threads = MIN(sstuff_get_threads(), blocks);
+		size_t t;
+		for (t = 0; t < threads; t++) {
+			realzip_job & f = realzip_jobs[t];
+			f.set_decode(data, size, stride, block_size, src, &offsets, &results, t, threads);
+			set_job(&f, t);
+		}
+		do_jobs();
+	}
+#endif
+
+	for (b = 0; b < blocks; b++) {
+		if (!results[b])
+			return false;
+	}
+	return true;
+};
+
+}; // namespace surfit;
+
@@ -0,0 +1,94 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __sstuff__realzip__
+#define __sstuff__realzip__
+
+#include <vector>
+
+/*! \file
+    \brief lossless compression of REAL arrays
+
+    Array is divided into blocks, which are compressed and decompressed independently
+    (and in parallel, if threads are enabled). Every value is predicted from already
+    coded neighbours: from the previous value for 1D arrays, or from the left, upper
+    and upper-left values (a + b - c over the integer bit patterns) for 2D arrays stored
+    row by row. Prediction bits are XOR-ed with the value bits and the result is stored
+    without its leading and trailing zero bytes. Exactly predicted values (constant
+    regions and runs of undefined values) are stored as runs.
+
+    Stream layout: \ref realzip_header, table of (blocks+1) block offsets
+    (unsigned long long, relative to the end of the table), blocks data.
+*/
+
+namespace surfit {
+
+//! signature of compressed stream
+#define REALZIP_MAGIC "RZ01"
+
+//! approximate amount of values in one block
+#define REALZIP_BLOCK_SIZE 65536
+
+//! compressed stream header
+struct realzip_header
+{
+	//! REALZIP_MAGIC
+	char magic[4];
+	//! row length for 2D arrays, 0 for 1D arrays
+	unsigned int stride;
+	//! amount of values
+	unsigned long long count;
+	//! size of the whole stream in bytes (including header)
+	unsigned long long bytes;
+	//! amount of values in one block (whole rows for 2D arrays)
+	unsigned long long block_size;
+	//! amount of blocks
+	unsigned long long blocks;
+};
+
+/*! \brief compresses array
+    \param data values
+    \param size amount of values
+    \param stride row length for 2D arrays (0 for 1D arrays)
+    \param stream compressed stream
+    \param serial if true, blocks are compressed without threads (for calls from jobs, see \ref do_jobs)
+*/
+SSTUFF_EXPORT
+bool realzip_compress(const REAL * data, size_t size, size_t stride, std::vector<char> & stream, bool serial = false);
+
+/*! \brief checks header of compressed stream
+    \param header at least sizeof(realzip_header) bytes of the stream beginning
+    \param count amount of values in stream
+    \param bytes size of the whole stream
+*/
+SSTUFF_EXPORT
+bool realzip_info(const char * header, size_t & count, size_t & bytes);
+
+/*! \brief decompresses stream
+    \param stream compressed stream
+    \param stream_size size of stream in bytes
+    \param data array for (count) values (see \ref realzip_info)
+*/
+SSTUFF_EXPORT
+bool realzip_decompress(const char * stream, size_t stream_size, REAL * data);
+
+}; // namespace surfit;
+
+#endif
+
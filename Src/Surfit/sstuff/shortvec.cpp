@@ -37,8 +37,6 @@
 
 namespace surfit {
 
-#ifndef XXL
-
 shortvec * create_shortvec(size_t size, short default_value, bool fill_default, size_t grow_by) {
 	return new shortvec(size, default_value, fill_default, grow_by);
 };
@@ -200,8 +198,5 @@ size_t shortvec::read_file(int file, size_t size) {
 	return res;
 };
 
-#endif
-
 }; // namespace surfit;
 
-
@@ -27,10 +27,6 @@
 #include <stdio.h>
 #include "../sstuff/vec.h"
 
-#ifdef XXL
-#include "../../src_xxl/sstuff/shortvec_xxl.h"
-#endif
-
 namespace surfit {
 
 class shortvec;
@@ -43,8 +39,6 @@ shortvec * create_shortvec(size_t size = 0, short default_value = short(0), bool
 SSTUFF_EXPORT
 shortvec * create_shortvec(const shortvec &in);
 
-#ifndef XXL
-
 /*! \class shortvec
     \brief vector of short's
 */
@@ -170,8 +164,6 @@ protected:
 	size_t grow_by;
 };
 
-#endif
-
 }; // namespace surfit
 
 #endif
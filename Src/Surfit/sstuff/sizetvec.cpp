@@ -19,8 +19,6 @@
 
 #include "sstuff_ie.h"
 
-#ifndef XXL
-
 #include "sizetvec.h"
 
 namespace surfit {
@@ -61,5 +59,3 @@ void sizetvec::resize(size_t newsize)
 
 }; // namespace surfit
 
-#endif
-
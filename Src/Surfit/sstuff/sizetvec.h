@@ -25,10 +25,6 @@
     \brief sizetvec class (array of size_t values) declaration
 */
 
-#ifdef XXL
-#include "../../src_xxl/sstuff/sizetvec_xxl.h"
-#else
-
 #include <vector>
 
 namespace surfit {
@@ -127,5 +123,3 @@ private:
 
 #endif
 
-#endif
-
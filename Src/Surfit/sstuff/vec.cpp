@@ -41,6 +41,7 @@
 #endif
 
 #include "../sstuff/vec.h"
+#include "../sstuff/mapfile.h"
 
 namespace surfit {
 
@@ -59,7 +60,43 @@ vec * create_vec(const extvec &in) {
 };
 #endif
 
+vec * create_vec(mapfile * mf, REAL * ptr, size_t size) {
+	return new vec(mf, ptr, size);
+};
+
+//! detach function for \ref mapfile
+static void vec_unmap(void * v) {
+	((vec *)v)->unmap();
+};
+
+vec::vec(mapfile * mf, REAL * ptr, size_t size) {
+	data = ptr;
+	datasize = size;
+	real_datasize = size;
+	grow_by = 250;
+	mapped = mf;
+	mapped->attach(this, vec_unmap);
+};
+
+void vec::unmap() {
+	if (!mapped)
+		return;
+	REAL * tmpData = NULL;
+	if (datasize > 0) {
+		tmpData = (REAL*)malloc(sizeof(REAL)*datasize);
+		if (tmpData == NULL)
+			throw "out of memory";
+		memcpy(tmpData, data, sizeof(REAL)*datasize);
+	}
+	data = tmpData;
+	real_datasize = datasize;
+	mapfile * mf = mapped;
+	mapped = NULL;
+	mf->detach(this);
+};
+
 vec::vec(const vec &in) {
+	mapped = NULL;
 	if (this != &in) {
 		size_t newsize = in.size();
 		data = (REAL*)malloc(sizeof(REAL)*newsize);
@@ -78,6 +115,7 @@ vec::vec(const vec &in) {
 
 #ifdef XXL
 vec::vec(const extvec &in) {
+	mapped = NULL;
 	size_t newsize = in.size();
 	data = (REAL*)malloc(sizeof(REAL)*newsize);
 	if (data) {
@@ -95,6 +133,7 @@ vec::vec(const extvec &in) {
 
 vec::vec(size_t newsize, REAL default_value, bool fill_default, size_t igrow_by) {
 	grow_by = igrow_by;
+	mapped = NULL;
 	if (newsize == 0) {
 		data = NULL;
 		datasize = newsize;
@@ -119,6 +158,10 @@ vec::vec(size_t newsize, REAL default_value, bool fill_default, size_t igrow_by)
 };
 
 vec::~vec() {
+	if (mapped) {
+		mapped->detach(this);
+		return;
+	}
 	if (data) {
 		free(data);
 		datasize = 0;
@@ -134,6 +177,8 @@ void vec::release() {
 void vec::resize(size_t newsize, REAL default_value, bool fill_default) {
 	if (datasize == newsize)
 		return;
+	if (mapped)
+		unmap();
 	if ((newsize == 0) && (data = NULL)) {
 		datasize = 0;
 		real_datasize = 0;
@@ -194,6 +239,8 @@ void vec::set_grow(size_t igrow_by) {
 };
 
 void vec::reserve(size_t reserve_size) {
+	if (mapped)
+		unmap();
 	size_t oldsize = real_datasize;
 	if (oldsize < reserve_size) {
 		
@@ -246,6 +293,8 @@ void vec::erase(size_t index) {
 };
 
 void vec::drop_data() {
+	if (mapped)
+		unmap();
 	data = NULL;
 	datasize = 0;
 	real_datasize = 0;
@@ -255,6 +304,8 @@ vec& vec::operator=(const vec & copy) {
 	if (this == &copy) {
 		return *this;
 	}
+	if (mapped)
+		unmap();
 	if (datasize != copy.size()) {
 		free(data);
 		data = (REAL *) malloc(copy.size() * sizeof(REAL));
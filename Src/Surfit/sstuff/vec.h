@@ -22,6 +22,7 @@
 namespace surfit {
 
 class vec;
+class mapfile;
 #ifndef XXL
 //! vector that can be saved on hard drive (external vector)
 typedef vec extvec;
@@ -44,6 +45,17 @@ vec * create_vec(const vec &in);
 SSTUFF_EXPORT
 vec * create_vec(const extvec &in);
 
+/*! \brief creates vec object over memory-mapped data without copying
+    \param mf copy-on-write \ref mapfile
+    \param ptr pointer to the first element inside mapped memory
+    \param size size of the vector
+    
+    Data is copied to the allocated memory only when vector changes its size 
+    or when \ref mapfile_detach_all is called for the file.
+*/
+SSTUFF_EXPORT
+vec * create_vec(mapfile * mf, REAL * ptr, size_t size);
+
 /*! \brief creates extvec object
 
     \param size size of the vector
@@ -103,6 +115,9 @@ protected:
 	
 	//! Copy constructor
 	vec(const vec &in);
+
+	//! constructor over memory-mapped data
+	vec(mapfile * mf, REAL * ptr, size_t size);
 #ifdef XXL
 	//! Copy constructor
 	vec(const extvec &in);
@@ -139,6 +154,10 @@ public:
 	vec * create_vec(const extvec &in);
 #endif
 
+	friend SSTUFF_EXPORT
+	//! creates vec object over memory-mapped data without copying
+	vec * create_vec(mapfile * mf, REAL * ptr, size_t size);
+
 public:
 	//! destructor
 	void release();
@@ -212,6 +231,9 @@ public:
 	size_t write_file(int file, size_t size) const;
 	//! reads vector content from the file
 	size_t read_file(int file, size_t size);
+
+	//! copies memory-mapped data to the allocated memory
+	void unmap();
 	
 private:
 	//! pointer to vector-array
@@ -225,6 +247,9 @@ private:
 	
 	//! grow factor
 	size_t grow_by;
+
+	//! \ref mapfile with data (NULL if data is allocated)
+	mapfile * mapped;
 };
 
 }; // namespace surfit
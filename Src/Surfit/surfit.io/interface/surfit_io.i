@@ -121,6 +121,7 @@ namespace surfit {
 
 surfit::boolvec * pnts_load_shp(const char * filename, const char * pntsname=NULL, const char * param = "VALUE");
 surfit::boolvec * pnts_save_shp(const char * filename, const char * points_name = "*");
+surfit::boolvec * pnts_load_las(const char * filename, const char * pntsname = NULL, const char * classes = "*", const char * returns = "*", REAL step = 0, const char * mode = "mean");
 
 surfit::boolvec * curv_load_bln(const char * filename, const char * curvname = NULL);
 surfit::boolvec * curv_load_shp(const char * filename, const char * curvname = NULL);
@@ -138,6 +139,7 @@ surfit::boolvec * cntr_save_shp(const char * filename, const char * cntr_name =
 surfit::boolvec * cntr_save_bln(const char * filename, const char * cntr_name = "*");
 
 surfit::boolvec * surf_load_grd(const char * filename, const char * surfname = 0);
+surfit::boolvec * surf_load_grd_paged(const char * filename, const char * surfname = 0, int cache_size = 256);
 surfit::boolvec * surf_load_gmt(const char * filename, const char * surfname = 0);
 surfit::boolvec * surf_load_grass(const char * filename, const char * surfname = 0);
 surfit::boolvec * surf_load_arcgis(const char * filename, const char * surfname = 0);
@@ -156,6 +158,8 @@ surfit::boolvec * surf_save_arcgis(const char * filename, const char * surface_n
 surfit::boolvec * surf_save_xyz(const char * filename, const char * surface_name = "*");
 surfit::boolvec * surf_save_jpg(const char * filename, const char * surface_name = "*", int quality = 255);
 surfit::boolvec * surf_save_bmp(const char * filename, const char * surface_name = "*");
+surfit::boolvec * surf_save_tiff(const char * filename, const char * surface_name = "*", int format = 0);
+surfit::boolvec * surf_save_tiff_pyramid(const char * filename, const char * surface_name = "*", int format = 0);
 
 surfit::boolvec * mask_save_grd(const char * filename, const char * mask_name = "*");
 surfit::boolvec * mask_save_xyz(const char * filename, const char * mask_name = "*");
@@ -29,5 +29,18 @@ d_points * _pnts_load_shp(const char * filename, const char * pntsname, const ch
 SURFIT_IO_EXPORT
 bool _pnts_save_shp(const d_points * pnts, const char * filename);
 
+/*! \brief reads points from LAS 1.0-1.4 file (uncompressed point data record formats 0-10)
+    \param filename LAS file name
+    \param pntsname name for points (file name if NULL)
+    \param classes list of classification codes to read ("2 9"), "*" for all points
+    \param returns "*" - all returns, "first", "last" or "single" returns only
+    \param step if positive, points are decimated by square cells with step size
+    \param mode value for decimation cell: "mean", "min" or "max"
+*/
+SURFIT_IO_EXPORT
+d_points * _pnts_load_las(const char * filename, const char * pntsname = NULL, 
+			  const char * classes = "*", const char * returns = "*", 
+			  REAL step = 0, const char * mode = "mean");
+
 }; // namespace surfit;
 
@@ -48,6 +48,28 @@ boolvec * pnts_load_shp(const char * filename, const char * pntsname, const char
 	return res;
 };
 
+boolvec * pnts_load_las(const char * filename, const char * pntsname, 
+			const char * classes, const char * returns, 
+			REAL step, const char * mode) 
+{
+	boolvec * res = create_boolvec();
+	const char * fname = find_first(filename);
+
+	while (fname != NULL) {
+		d_points * pnts = _pnts_load_las(fname, pntsname, classes, returns, step, mode);
+		if (pnts) {
+			surfit_pnts->push_back(pnts);
+			res->push_back(true);
+		} else
+			res->push_back(false);
+
+		fname = find_next();
+	}
+
+	find_close();
+	return res;
+};
+
 struct match_pnts_save_shp
 {
 	match_pnts_save_shp(const char * ifilename, const char * ipos) : pos(ipos), filename(ifilename), res(NULL) {};
@@ -38,6 +38,35 @@ class boolvec;
 */
 boolvec * pnts_load_shp(const char * filename, const char * pntsname = "*", const char * param = "VALUE");
 
+/*! \ingroup tcl_pnts_save_load
+    \fn bool pnts_load_las(const char * filename, const char * pntsname = NULL, const char * classes = "*", const char * returns = "*", REAL step = 0, const char * mode = "mean");
+    
+    \par Tcl syntax:
+    pnts_load_las \ref file "filename" "pntsname" "classes" "returns" step "mode"
+
+    \par Description:
+    reads \ref d_points "points" from LAS 1.0-1.4 file (uncompressed point data record formats 0-10).
+    File is mapped into memory and points are read without intermediate text conversion.
+
+    \param filename LAS file name
+    \param pntsname name for points (file name is used by default)
+    \param classes list of classification codes to read, for example "2 9". "*" means all points
+    \param returns "*" - all returns, "first", "last" or "single" returns only
+    \param step if positive, points are decimated on the fly: one point is stored for every 
+    square cell with "step" size
+    \param mode value for decimation cell: "mean" - mean of the cell points, 
+    "min" or "max" - point with minimal or maximal value
+
+    \par Example:
+    pnts_load_las "C:\\tile.las" "ground" "2" "last" 1 "min"
+
+    \par Implemented in library:
+    libsurfit_io
+*/
+boolvec * pnts_load_las(const char * filename, const char * pntsname = NULL, 
+			const char * classes = "*", const char * returns = "*", 
+			REAL step = 0, const char * mode = "mean");
+
 /*! \ingroup tcl_pnts_save_load
     \fn bool pnts_save_shp(const char * filename, const char * points_name = "*");
     
@@ -0,0 +1,503 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_io_ie.h"
+#include "pnts_io.h"
+
+// sstuff includes
+#include "sstuff.h"
+#include "mapfile.h"
+
+// surfit includes
+#include "points.h"
+#include "fileio.h"
+#include "vec.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include <vector>
+#include <algorithm>
+
+namespace surfit {
+
+//! size of LAS 1.0-1.2 public header block
+#define LAS_HEADER_SIZE 227
+//! size of LAS 1.4 public header block
+#define LAS_HEADER_SIZE_14 375
+
+//! minimal point record length for point data record formats 0..10
+static const unsigned short las_record_length[11] = {20, 28, 26, 34, 57, 63, 30, 36, 38, 59, 67};
+
+//! reads little-endian value from LAS file
+template<class T>
+inline
+T las_get(const char * ptr) {
+	T val;
+	memcpy(&val, ptr, sizeof(T));
+	return val;
+};
+
+//! LAS public header block fields used for reading points
+struct las_header
+{
+	//! point data record format (0..10)
+	unsigned char format;
+	//! point data record length
+	unsigned short record_length;
+	//! offset to the first point record
+	size_t point_offset;
+	//! amount of point records
+	size_t points_count;
+	//! coordinates scale factors
+	double scale[3];
+	//! coordinates offsets
+	double offset[3];
+	//! points bounds
+	double minX, maxX, minY, maxY;
+};
+
+static bool las_read_header(const mapfile * mf, const char * filename, las_header & hdr) 
+{
+	const char * ptr = mf->begin();
+	size_t file_size = mf->size();
+
+	if ( (file_size < LAS_HEADER_SIZE) || (strncmp(ptr, "LASF", 4) != 0) ) {
+		writelog(LOG_ERROR, "%s : not a LAS file", filename);
+		return false;
+	}
+
+	unsigned char version_major = las_get<unsigned char>(ptr + 24);
+	unsigned char version_minor = las_get<unsigned char>(ptr + 25);
+	unsigned short header_size = las_get<unsigned short>(ptr + 94);
+
+	if ( (version_major != 1) || (version_minor > 4) ) {
+		writelog(LOG_ERROR, "%s : LAS version %d.%d is not supported", filename, version_major, version_minor);
+		return false;
+	}
+
+	hdr.point_offset = las_get<unsigned int>(ptr + 96);
+	hdr.format = las_get<unsigned char>(ptr + 104);
+	hdr.record_length = las_get<unsigned short>(ptr + 105);
+	hdr.points_count = las_get<unsigned int>(ptr + 107);
+
+	// LAS 1.4 64-bit point count
+	if ( (version_minor >= 4) && (header_size >= LAS_HEADER_SIZE_14) && (file_size >= LAS_HEADER_SIZE_14) ) {
+		unsigned long long count = las_get<unsigned long long>(ptr + 247);
+		if (count > 0)
+			hdr.points_count = (size_t)count;
+	}
+
+	if (hdr.format & 0xC0) {
+		writelog(LOG_ERROR, "%s : compressed LAS (LAZ) files are not supported", filename);
+		return false;
+	}
+
+	if (hdr.format > 10) {
+		writelog(LOG_ERROR, "%s : unknown point data record format %d", filename, hdr.format);
+		return false;
+	}
+
+	if (hdr.record_length < las_record_length[hdr.format]) {
+		writelog(LOG_ERROR, "%s : wrong point record length %d for format %d", 
+			 filename, hdr.record_length, hdr.format);
+		return false;
+	}
+
+	int i;
+	for (i = 0; i < 3; i++) {
+		hdr.scale[i] = las_get<double>(ptr + 131 + i*8);
+		hdr.offset[i] = las_get<double>(ptr + 155 + i*8);
+	}
+	hdr.maxX = las_get<double>(ptr + 179);
+	hdr.minX = las_get<double>(ptr + 187);
+	hdr.maxY = las_get<double>(ptr + 195);
+	hdr.minY = las_get<double>(ptr + 203);
+
+	if (hdr.point_offset > file_size) {
+		writelog(LOG_ERROR, "%s : wrong offset to point data", filename);
+		return false;
+	}
+
+	size_t max_count = (file_size - hdr.point_offset) / hdr.record_length;
+	if (hdr.points_count > max_count) {
+		writelog(LOG_WARNING, "%s : file is truncated, only %d points of %d can be read", 
+			 filename, (int)max_count, (int)hdr.points_count);
+		hdr.points_count = max_count;
+	}
+
+	return true;
+};
+
+//! parses classes list ("2 9" or "2,9"; "*" means all classes)
+static bool las_parse_classes(const char * classes, bool * use_class) 
+{
+	int i;
+	bool all = (classes == NULL) || (strcmp(classes, "*") == 0) || (*classes == '\0');
+	for (i = 0; i < 256; i++)
+		use_class[i] = all;
+	if (all)
+		return true;
+
+	const char * ptr = classes;
+	while (*ptr) {
+		if ( (*ptr == ' ') || (*ptr == ',') || (*ptr == ';') || (*ptr == '\t') ) {
+			ptr++;
+			continue;
+		}
+		char * end = NULL;
+		long cls = strtol(ptr, &end, 10);
+		if ( (end == ptr) || (cls < 0) || (cls > 255) ) {
+			writelog(LOG_ERROR, "wrong LAS classes list \"%s\"", classes);
+			return false;
+		}
+		use_class[cls] = true;
+		ptr = end;
+	}
+	return true;
+};
+
+//! filter for return numbers
+enum las_returns_mode {
+	LAS_RETURNS_ALL,
+	LAS_RETURNS_FIRST,
+	LAS_RETURNS_LAST,
+	LAS_RETURNS_SINGLE
+};
+
+static bool las_parse_returns(const char * returns, las_returns_mode & mode) 
+{
+	if ( (returns == NULL) || (strcmp(returns, "*") == 0) || (strcmp(returns, "all") == 0) ) {
+		mode = LAS_RETURNS_ALL;
+		return true;
+	}
+	if (strcmp(returns, "first") == 0) {
+		mode = LAS_RETURNS_FIRST;
+		return true;
+	}
+	if (strcmp(returns, "last") == 0) {
+		mode = LAS_RETURNS_LAST;
+		return true;
+	}
+	if (strcmp(returns, "single") == 0) {
+		mode = LAS_RETURNS_SINGLE;
+		return true;
+	}
+	writelog(LOG_ERROR, "wrong LAS returns filter \"%s\" (use \"*\", \"first\", \"last\" or \"single\")", returns);
+	return false;
+};
+
+//! cell value mode for decimation
+enum las_decimation_mode {
+	LAS_CELL_MEAN,
+	LAS_CELL_MIN,
+	LAS_CELL_MAX
+};
+
+//! decimation cell: accumulated coordinates and amount of points
+struct las_cell {
+	unsigned long long key;
+	REAL x, y, z;
+	unsigned int cnt;
+};
+
+//! orders cells by key (row-major cell order)
+inline
+bool las_cell_less(const las_cell & a, const las_cell & b) 
+{
+	return a.key < b.key;
+};
+
+/*! \brief open addressing hash of occupied decimation cells
+    memory is proportional to amount of occupied cells, not to the decimation grid size
+*/
+class las_cell_table {
+public:
+	las_cell_table() : used(0), mask(0) {
+		grow();
+	};
+
+	//! returns cell for key, creates empty cell if not found
+	las_cell & get(unsigned long long key) {
+		if (2*(used+1) > cells.size())
+			grow();
+		size_t pos = find(key);
+		if (cells[pos].cnt == 0) {
+			cells[pos].key = key;
+			used++;
+		}
+		return cells[pos];
+	};
+
+	//! moves occupied cells into res, sorted by key
+	void extract(std::vector<las_cell> & res) {
+		res.clear();
+		res.reserve(used);
+		size_t i;
+		for (i = 0; i < cells.size(); i++) {
+			if (cells[i].cnt > 0)
+				res.push_back(cells[i]);
+		}
+		std::vector<las_cell>().swap(cells);
+		used = 0;
+		std::sort(res.begin(), res.end(), las_cell_less);
+	};
+
+protected:
+	size_t find(unsigned long long key) const {
+		size_t pos = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 20) & mask;
+		while ( (cells[pos].cnt > 0) && (cells[pos].key != key) )
+			pos = (pos + 1) & mask;
+		return pos;
+	};
+
+	void grow() {
+		std::vector<las_cell> old;
+		old.swap(cells);
+		las_cell empty;
+		empty.key = 0;
+		empty.x = empty.y = empty.z = 0;
+		empty.cnt = 0;
+		cells.assign(old.empty() ? 1024 : old.size()*2, empty);
+		mask = cells.size()-1;
+		size_t i;
+		for (i = 0; i < old.size(); i++) {
+			if (old[i].cnt > 0)
+				cells[find(old[i].key)] = old[i];
+		}
+	};
+
+	std::vector<las_cell> cells;
+	size_t used;
+	size_t mask;
+};
+
+//! returns true if point record passes classification and return filters
+inline
+bool las_point_filter(const char * rec, unsigned char format, const bool * use_class, las_returns_mode returns) 
+{
+	int ret, ret_cnt, cls;
+	if (format < 6) {
+		unsigned char bits = las_get<unsigned char>(rec + 14);
+		ret = bits & 7;
+		ret_cnt = (bits >> 3) & 7;
+		cls = las_get<unsigned char>(rec + 15) & 31;
+	} else {
+		unsigned char bits = las_get<unsigned char>(rec + 14);
+		ret = bits & 15;
+		ret_cnt = (bits >> 4) & 15;
+		cls = las_get<unsigned char>(rec + 16);
+	}
+
+	if (!use_class[cls])
+		return false;
+
+	switch (returns) {
+	case LAS_RETURNS_FIRST:
+		return (ret == 1);
+	case LAS_RETURNS_LAST:
+		return (ret == ret_cnt);
+	case LAS_RETURNS_SINGLE:
+		return (ret_cnt == 1);
+	default:
+		return true;
+	}
+};
+
+d_points * _pnts_load_las(const char * filename, const char * pntsname, 
+			  const char * classes, const char * returns, 
+			  REAL step, const char * mode)
+{
+	bool use_class[256];
+	if (!las_parse_classes(classes, use_class))
+		return NULL;
+
+	las_returns_mode returns_mode;
+	if (!las_parse_returns(returns, returns_mode))
+		return NULL;
+
+	las_decimation_mode cell_mode = LAS_CELL_MEAN;
+	if (step > 0) {
+		if ( (mode == NULL) || (strcmp(mode, "mean") == 0) )
+			cell_mode = LAS_CELL_MEAN;
+		else if (strcmp(mode, "min") == 0)
+			cell_mode = LAS_CELL_MIN;
+		else if (strcmp(mode, "max") == 0)
+			cell_mode = LAS_CELL_MAX;
+		else {
+			writelog(LOG_ERROR, "wrong decimation mode \"%s\" (use \"mean\", \"min\" or \"max\")", mode);
+			return NULL;
+		}
+	}
+
+	mapfile * mf = create_mapfile(filename);
+	if (mf == NULL)
+		return NULL;
+
+	las_header hdr;
+	if (!las_read_header(mf, filename, hdr)) {
+		mf->release();
+		return NULL;
+	}
+
+	const char * data = mf->begin() + hdr.point_offset;
+	size_t rec_len = hdr.record_length;
+	size_t p;
+
+	vec * X = NULL;
+	vec * Y = NULL;
+	vec * Z = NULL;
+
+	if (step <= 0) {
+
+		// all points passed the filters
+		X = create_vec(hdr.points_count, 0, false);
+		Y = create_vec(hdr.points_count, 0, false);
+		Z = create_vec(hdr.points_count, 0, false);
+		vec::iterator x_ptr = X->begin();
+		vec::iterator y_ptr = Y->begin();
+		vec::iterator z_ptr = Z->begin();
+		size_t cnt = 0;
+
+		for (p = 0; p < hdr.points_count; p++) {
+			const char * rec = data + p*rec_len;
+			if (!las_point_filter(rec, hdr.format, use_class, returns_mode))
+				continue;
+			*(x_ptr + cnt) = las_get<int>(rec    )*hdr.scale[0] + hdr.offset[0];
+			*(y_ptr + cnt) = las_get<int>(rec + 4)*hdr.scale[1] + hdr.offset[1];
+			*(z_ptr + cnt) = las_get<int>(rec + 8)*hdr.scale[2] + hdr.offset[2];
+			cnt++;
+		}
+
+		X->resize(cnt);
+		Y->resize(cnt);
+		Z->resize(cnt);
+
+	} else {
+
+		// header bounds define decimation grid; points outside are binded to border cells
+		double minX = hdr.minX, maxX = hdr.maxX;
+		double minY = hdr.minY, maxY = hdr.maxY;
+		if ( (maxX < minX) || (maxY < minY) ) {
+			minX = minY = DBL_MAX;
+			maxX = maxY = -DBL_MAX;
+			for (p = 0; p < hdr.points_count; p++) {
+				const char * rec = data + p*rec_len;
+				double x = las_get<int>(rec    )*hdr.scale[0] + hdr.offset[0];
+				double y = las_get<int>(rec + 4)*hdr.scale[1] + hdr.offset[1];
+				minX = MIN(minX, x); maxX = MAX(maxX, x);
+				minY = MIN(minY, y); maxY = MAX(maxY, y);
+			}
+		}
+
+		double cellsX = 0, cellsY = 0;
+		if (maxX >= minX) {
+			cellsX = floor( (maxX - minX)/step ) + 1;
+			cellsY = floor( (maxY - minY)/step ) + 1;
+		}
+		// cell keys i + j*NN must fit 64 bit integer
+		if (cellsX*cellsY > 1e18) {
+			writelog(LOG_ERROR, "%s : decimation step %g is too small", filename, step);
+			mf->release();
+			return NULL;
+		}
+
+		unsigned long long NN = (unsigned long long)cellsX;
+		unsigned long long MM = (unsigned long long)cellsY;
+		las_cell_table table;
+
+		for (p = 0; p < hdr.points_count; p++) {
+			const char * rec = data + p*rec_len;
+			if (!las_point_filter(rec, hdr.format, use_class, returns_mode))
+				continue;
+			REAL x = las_get<int>(rec    )*hdr.scale[0] + hdr.offset[0];
+			REAL y = las_get<int>(rec + 4)*hdr.scale[1] + hdr.offset[1];
+			REAL z = las_get<int>(rec + 8)*hdr.scale[2] + hdr.offset[2];
+
+			double fi = floor( (x - minX)/step );
+			double fj = floor( (y - minY)/step );
+			unsigned long long i = (fi < 0) ? 0 : MIN((unsigned long long)fi, NN-1);
+			unsigned long long j = (fj < 0) ? 0 : MIN((unsigned long long)fj, MM-1);
+
+			las_cell & cell = table.get(i + j*NN);
+			if (cell.cnt == 0) {
+				cell.x = x;
+				cell.y = y;
+				cell.z = z;
+			} else {
+				switch (cell_mode) {
+				case LAS_CELL_MEAN:
+					cell.x += x;
+					cell.y += y;
+					cell.z += z;
+					break;
+				case LAS_CELL_MIN:
+					if (z < cell.z) {
+						cell.x = x;
+						cell.y = y;
+						cell.z = z;
+					}
+					break;
+				case LAS_CELL_MAX:
+					if (z > cell.z) {
+						cell.x = x;
+						cell.y = y;
+						cell.z = z;
+					}
+					break;
+				}
+			}
+			cell.cnt++;
+		}
+
+		std::vector<las_cell> cells;
+		table.extract(cells);
+
+		X = create_vec(cells.size(), 0, false);
+		Y = create_vec(cells.size(), 0, false);
+		Z = create_vec(cells.size(), 0, false);
+		for (p = 0; p < cells.size(); p++) {
+			const las_cell & cell = cells[p];
+			REAL mult = (cell_mode == LAS_CELL_MEAN) ? REAL(1)/REAL(cell.cnt) : REAL(1);
+			(*X)(p) = cell.x*mult;
+			(*Y)(p) = cell.y*mult;
+			(*Z)(p) = cell.z*mult;
+		}
+
+	}
+
+	mf->release();
+
+	writelog(LOG_MESSAGE, "%s : %d points of %d loaded", filename, (int)X->size(), (int)hdr.points_count);
+
+	d_points * res = NULL;
+	if (pntsname)
+		res = create_points(X, Y, Z, pntsname);
+	else {
+		char * fname = get_name(filename);
+		res = create_points(X, Y, Z, fname);
+		sstuff_free_char(fname);
+	}
+	return res;
+};
+
+}; // namespace surfit
+
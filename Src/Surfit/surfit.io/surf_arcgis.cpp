@@ -19,9 +19,11 @@
 
 #include "surfit_io_ie.h"
 #include "surf_io.h"
+#include "text_grid.h"
 
 // sstuff includes
 #include "sstuff.h"
+#include "mapfile.h"
 
 // surfit includes
 #include "surf.h"
@@ -40,11 +42,15 @@ d_surf * _surf_load_arcgis(const char * filename, const char * surfname) {
 	
 	writelog(LOG_MESSAGE, "loading surface from ArcGIS ASCII file %s",filename);
 
-	FILE * file = fopen(filename,"r");
+	mapfile * file = create_mapfile(filename);
 	if (!file) {
-		writelog(LOG_ERROR, "surf_load_arcgis : the file %s was not opened: %s",filename,strerror( errno ));
+		writelog(LOG_ERROR, "surf_load_arcgis : the file %s was not opened",filename);
 		return NULL;
 	};
+	const char * ptr = file->begin();
+	const char * end = file->end();
+	const char * token = NULL;
+	size_t len = 0;
 
 	size_t nx = UINT_MAX, ny = UINT_MAX;
 	REAL xllcorner = FLT_MAX;
@@ -61,30 +67,40 @@ d_surf * _surf_load_arcgis(const char * filename, const char * surfname) {
 
 	char buf[200];
 	char buf2[200];
+	char nodata_text[200];
+	nodata_text[0] = '\0';
 	
-	if ( fread(buf, sizeof(char), 6, file) != 6)
+	if (file->size() < 6)
 		goto exit;
+	memcpy(buf, ptr, 6);
+	ptr += 6;
 	buf[6]='\0';
 		
 	if (strcmp(buf,"ncols ") != 0) 
 		goto exit;
 
-	if (fscanf(file, "%s", buf) != 1)
+	if (!text_word(ptr, end, buf, sizeof(buf)))
 		goto exit;
 	nx = atoi(buf);
 	
-	size_t ix, iy;
-
 	while ( true ) 
 	{
-		if (fscanf(file, "%s", buf) != 1)
+		if (!text_token(ptr, end, token, len))
 			goto exit;
 
 		// if !word
-		if ((buf[0] >= '0') && (buf[0] <='9'))
+		if ( ((token[0] >= '0') && (token[0] <= '9')) || (token[0] == '-') || (token[0] == '+') || (token[0] == '.') ) {
+			// data starts from this token
+			ptr = token;
 			break;
+		}
+
+		if (len >= sizeof(buf))
+			goto exit;
+		memcpy(buf, token, len);
+		buf[len] = '\0';
 
-		if (fscanf(file, "%s", buf2) != 1)
+		if (!text_word(ptr, end, buf2, sizeof(buf2)))
 			goto exit;
 
 		if (strcmp(buf, "nrows") == 0) {
@@ -113,6 +129,7 @@ d_surf * _surf_load_arcgis(const char * filename, const char * surfname) {
 		}
 		if (strcmp(buf, "nodata_value") == 0) {
 			surf_undef = atof(buf2);
+			strcpy(nodata_text, buf2);
 			continue;
 		}
 		
@@ -129,28 +146,13 @@ d_surf * _surf_load_arcgis(const char * filename, const char * surfname) {
 	if (step == FLT_MAX)
 		goto exit;
 	
-	data = create_extvec(nx*ny);
-	REAL value;
-
-	for(iy=0; iy<ny; iy++) {
-		for(ix=0; ix<nx; ix++) {
-			
-			value = atof(buf);
-			if (value != surf_undef)
-				(*data)(ix + (ny-1-iy)*nx) = value;
-			else 
-				(*data)(ix + (ny-1-iy)*nx) = undef_value;
-			
-			if (fscanf(file, "%s", buf) != 1)
-				break;
-	
-		}
-	}
-
-	if ((iy != ny) || (ix+1 != nx))
+	if ((nx == 0) || (ny == 0))
 		goto exit;
 
-	if (fscanf(file, "%s", buf) == 1)
+	// rows are stored from north to south
+	data = create_extvec(nx*ny, 0, false); // don't fill
+	if (!read_text_grid(ptr, end, data, nx, ny, true, -DBL_MAX, DBL_MAX, surf_undef, 
+			    (nodata_text[0] != '\0') ? nodata_text : NULL))
 		goto exit;
 
 	if (xllcenter != FLT_MAX) {
@@ -177,7 +179,7 @@ d_surf * _surf_load_arcgis(const char * filename, const char * surfname) {
 
 	res = create_surf(data, grd);
 
-	fclose(file);
+	file->release();
 
 	if (surfname)
 		res->setName(surfname);
@@ -198,7 +200,7 @@ exit:
 		data->release();
 	if (grd)
 		grd->release();
-	fclose(file);
+	file->release();
 	return NULL;
 };
 
@@ -255,20 +257,19 @@ bool _surf_save_arcgis(const d_surf * srf, const char * filename) {
 	fprintf(f, "cellsize %g\n", stepX);
 	fprintf(f, "nodata_value %g\n",  save_srf->undef_value);
 	
-	int i,j;
-	for (j = 0; j < ny; j++) {
-		for (i = 0; i < nx; i++) {
-			fprintf(f,"%g ", save_srf->getValueIJ(i,ny-1-j));
-		}
-		fprintf(f,"\n");
-	}
+	// rows from north to south
+	flipped_text_rows rows(save_srf);
+	bool res = write_text_rows(f, ny, &rows);
 
 	fclose(f);
 
 	if (prj_srf)
 		prj_srf->release();
 
-	return true;
+	if (!res)
+		writelog(LOG_ERROR, "Can't write data to file %s",filename);
+
+	return res;
 };
 
 };
@@ -460,7 +460,8 @@ bool _surf_save_gmt(const d_surf * srf, const char * filename) {
 	for (j = first_row, j2 = pad[3]; j <= last_row; j++, j2++) {
 		for (i = first_col, i2 = pad[0]; i <= last_col; i++, i2++) {
 			ij = (j2 * width_in + i2) * inc;
-			if ((*(srf->coeff))(ij) == srf->undef_value) 
+			REAL val = srf->getValue(ij);
+			if (val == srf->undef_value) 
 				continue;
 			/*
 			if (GMT_is_fnan (grid[ij])) {
@@ -468,8 +469,8 @@ bool _surf_save_gmt(const d_surf * srf, const char * filename) {
 				continue;
 			}
 			*/
-			header.z_min = MIN (header.z_min, (*(srf->coeff))(ij));
-			header.z_max = MAX (header.z_max, (*(srf->coeff))(ij));
+			header.z_min = MIN (header.z_min, val);
+			header.z_max = MAX (header.z_max, val);
 		}
 	}
 	
@@ -501,11 +502,11 @@ bool _surf_save_gmt(const d_surf * srf, const char * filename) {
 		ij = j2 * width_in + i2;
 		start[0] = j * width_out;
 		for (i = 0; i < width_out; i++) {
-			REAL val = (*(srf->coeff))(inc * (ij+k[i]));
+			REAL val = srf->getValue(inc * (ij+k[i]));
 			if (val == srf->undef_value)
 				GMT_make_fnan(tmp[i]);
 			else 
-				tmp[i] = (float)(*(srf->coeff))(inc * (ij+k[i]));
+				tmp[i] = (float)val;
 		}
 		check_nc_status (nc_put_vara_float (cdfid, z_id, start, edge, tmp));
 	}
@@ -19,9 +19,11 @@
 
 #include "surfit_io_ie.h"
 #include "surf_io.h"
+#include "text_grid.h"
 
 // sstuff includes
 #include "sstuff.h"
+#include "mapfile.h"
 
 // surfit includes
 #include "surf.h"
@@ -38,11 +40,15 @@ namespace surfit {
 d_surf * _surf_load_grass(const char * filename, const char * surfname) {
 	writelog(LOG_MESSAGE, "loading surface from GRASS ASCII file %s",filename);
 
-	FILE * file = fopen(filename,"r");
+	mapfile * file = create_mapfile(filename);
 	if (!file) {
-		writelog(LOG_ERROR, "surf_load_grass : the file %s was not opened: %s",filename,strerror( errno ));
+		writelog(LOG_ERROR, "surf_load_grass : the file %s was not opened",filename);
 		return NULL;
 	};
+	const char * ptr = file->begin();
+	const char * end = file->end();
+	const char * token = NULL;
+	size_t len = 0;
 
 	size_t nx = UINT_MAX, ny = UINT_MAX;
 	REAL miny = FLT_MAX, maxy = FLT_MAX;
@@ -55,27 +61,36 @@ d_surf * _surf_load_grass(const char * filename, const char * surfname) {
 
 	char buf[200];
 	char buf2[200];
+	char null_text[200];
+	null_text[0] = '\0';
 	
-	if ( fread(buf, sizeof(char), 6, file) != 6)
+	if (file->size() < 6)
 		goto exit;
+	memcpy(buf, ptr, 6);
+	ptr += 6;
 	buf[6]='\0';
 		
 	if (strcmp(buf,"north:") != 0) 
 		goto exit;
 
-	if (fscanf(file, "%s", buf) != 1)
+	if (!text_word(ptr, end, buf, sizeof(buf)))
 		goto exit;
 	maxy = atof(buf);
 	
-	size_t ix, iy;
-
 	while ( true ) 
 	{
-		if (fscanf(file, "%s", buf) != 1)
+		if (!text_token(ptr, end, token, len))
 			goto exit;
-		if (strchr(buf, ':') == NULL)
+		if (memchr(token, ':', len) == NULL) {
+			// data starts from this token
+			ptr = token;
 			break;
-		if (fscanf(file, "%s", buf2) != 1)
+		}
+		if (len >= sizeof(buf))
+			goto exit;
+		memcpy(buf, token, len);
+		buf[len] = '\0';
+		if (!text_word(ptr, end, buf2, sizeof(buf2)))
 			goto exit;
 		if (strcmp(buf, "south:") == 0) {
 			miny = atof(buf2);
@@ -98,7 +113,10 @@ d_surf * _surf_load_grass(const char * filename, const char * surfname) {
 			continue;
 		}
 		if (strcmp(buf, "null:") == 0) {
-			surf_undef = atof(buf2);
+			// null value can be a word (like "*")
+			if (!parse_real(buf2, strlen(buf2), surf_undef))
+				surf_undef = FLT_MAX;
+			strcpy(null_text, buf2);
 			continue;
 		}
 	}
@@ -117,28 +135,13 @@ d_surf * _surf_load_grass(const char * filename, const char * surfname) {
 		goto exit;
 
 
-	data = create_extvec(nx*ny);
-	REAL value;
-
-	for(iy=0; iy<ny; iy++) {
-		for(ix=0; ix<nx; ix++) {
-			
-			value = atof(buf);
-			if (value != surf_undef)
-				(*data)(ix + (ny-1-iy)*nx) = value;
-			else 
-				(*data)(ix + (ny-1-iy)*nx) = undef_value;
-			
-			if (fscanf(file, "%s", buf) != 1)
-				break;
-	
-		}
-	}
-
-	if ((iy != ny) || (ix+1 != nx))
+	if ((nx == 0) || (ny == 0))
 		goto exit;
 
-	if (fscanf(file, "%s", buf) == 1)
+	// rows are stored from north to south
+	data = create_extvec(nx*ny, 0, false); // don't fill
+	if (!read_text_grid(ptr, end, data, nx, ny, true, -DBL_MAX, DBL_MAX, surf_undef, 
+			    (null_text[0] != '\0') ? null_text : NULL))
 		goto exit;
 
 	stepX = (maxx-minx)/(nx-1);
@@ -148,7 +151,7 @@ d_surf * _surf_load_grass(const char * filename, const char * surfname) {
 
 	res = create_surf(data, grd);
 
-	fclose(file);
+	file->release();
 
 	if (surfname)
 		res->setName(surfname);
@@ -169,7 +172,7 @@ exit:
 		data->release();
 	if (grd)
 		grd->release();
-	fclose(file);
+	file->release();
 	return NULL;
 };
 
@@ -209,17 +212,16 @@ bool _surf_save_grass(const d_surf * srf, const char * filename) {
 	fprintf(f, "null: %g\n",  srf->undef_value);
 	fprintf(f, "type: float\n");
 
-	int i,j;
-	for (j = 0; j < ny; j++) {
-		for (i = 0; i < nx; i++) {
-			fprintf(f,"%g ", srf->getValueIJ(i,ny-1-j));
-		}
-		fprintf(f,"\n");
-	}
+	// rows from north to south
+	flipped_text_rows rows(srf);
+	bool res = write_text_rows(f, ny, &rows);
 
 	fclose(f);
 
-	return true;
+	if (!res)
+		writelog(LOG_ERROR, "Can't write data to file %s",filename);
+
+	return res;
 };
 
 };
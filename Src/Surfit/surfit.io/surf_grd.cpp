@@ -19,9 +19,11 @@
 
 #include "surfit_io_ie.h"
 #include "surf_io.h"
+#include "text_grid.h"
 
 // sstuff includes
 #include "sstuff.h"
+#include "mapfile.h"
 
 // surfit includes
 #include "surf.h"
@@ -31,6 +33,7 @@
 #include "grid.h"
 #include "curv.h"
 #include "free_elements.h"
+#include "surf_paged.h"
 
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
@@ -51,11 +54,13 @@ namespace surfit {
 d_surf * _surf_load_grd(const char * filename, const char * surfname) 
 {
 
-	FILE * file = fopen(filename,"r");
+	mapfile * file = create_mapfile(filename);
 	if (!file) {
-		writelog(LOG_ERROR, "surf_load_grd : the file %s was not opened: %s",filename,strerror( errno ));
+		writelog(LOG_ERROR, "surf_load_grd : the file %s was not opened",filename);
 		return NULL;
 	};
+	const char * ptr = file->begin();
+	const char * end = file->end();
 
 	int nx, ny;
 	REAL miny, maxy;
@@ -68,80 +73,66 @@ d_surf * _surf_load_grd(const char * filename, const char * surfname)
 
 	char buf[200];
 	
-	//if ( fscanf(file, "%s", buf) == 0)
-	//	goto exit;
-	if ( fread(buf, sizeof(char), 4, file) != 4)
+	if (file->size() < 4)
 		goto exit;
+	memcpy(buf, ptr, 4);
+	ptr += 4;
 	buf[4]='\0';
 
 	if (strcmp(buf,"DSAA") == 0)
 		writelog(LOG_MESSAGE, "loading surface from Surfer GRD-ASCII format file %s",filename);
 
 	if (strcmp(buf,"DSBB") == 0) {
-		fclose(file);
+		file->release();
 		return _surf_load_grd_bin(filename, surfname);
 	}
 
 	if (strcmp(buf,"DSRB") == 0) {
-		fclose(file);
+		file->release();
 		return _surf_load_grd_bin7(filename, surfname);
 	}
 		
 	if (strcmp(buf,"DSAA") != 0) 
 		goto exit;
 	
-	int ix, iy;
-
-	if (fscanf(file, "%s", buf) != 1)
+	if (!text_word(ptr, end, buf, sizeof(buf)))
 		goto exit;
 	nx = atoi(buf);
 
-	if (fscanf(file, "%s", buf) != 1)
+	if (!text_word(ptr, end, buf, sizeof(buf)))
 		goto exit;
 	ny = atoi(buf);
 
-	if (fscanf(file, "%s", buf) != 1)
+	if (!text_word(ptr, end, buf, sizeof(buf)))
 		goto exit;
 	minx = atof(buf);
 
-	if (fscanf(file, "%s", buf) != 1)
+	if (!text_word(ptr, end, buf, sizeof(buf)))
 		goto exit;
 	maxx = atof(buf);
 
-	if (fscanf(file, "%s", buf) != 1)
+	if (!text_word(ptr, end, buf, sizeof(buf)))
 		goto exit;
 	miny = atof(buf);
 
-	if (fscanf(file, "%s", buf) != 1)
+	if (!text_word(ptr, end, buf, sizeof(buf)))
 		goto exit;
 	maxy = atof(buf);
 
-	if (fscanf(file, "%s", buf) != 1)
+	if (!text_word(ptr, end, buf, sizeof(buf)))
 		goto exit;
 	minz = atof(buf);
 
-	if (fscanf(file, "%s", buf) != 1)
+	if (!text_word(ptr, end, buf, sizeof(buf)))
 		goto exit;
 	maxz = atof(buf);
 
-	data = create_extvec(nx*ny);
-	REAL value;
-
-	for(iy=0; iy<ny; iy++) {
-		for(ix=0; ix<nx; ix++) {
-			
-			if (fscanf(file, "%s", buf) != 1)
-				goto exit;
-	
-			value = atof(buf);
-			if ((value >= minz) && (value <= maxz))
-				(*data)(ix + iy*nx) = value;
-			else 
-				(*data)(ix + iy*nx) = undef_value;
-		}
-	}
+	if ((nx <= 0) || (ny <= 0))
+		goto exit;
 
-	if (fscanf(file, "%s", buf) == 1)
+	// values outside of [minz, maxz] are undefined
+	data = create_extvec(nx*ny, 0, false); // don't fill
+	if (!read_text_grid(ptr, end, data, nx, ny, false, minz, maxz, undef_value, NULL))
 		goto exit;
 
 	stepX = (maxx-minx)/(nx-1);
@@ -151,7 +142,7 @@ d_surf * _surf_load_grd(const char * filename, const char * surfname)
 
 	res = create_surf(data, grd);
 
-	fclose(file);
+	file->release();
 
 	if (surfname)
 		res->setName(surfname);
@@ -172,7 +163,7 @@ exit:
 		data->release();
 	if (grd)
 		grd->release();
-	fclose(file);
+	file->release();
 	return NULL;
 };
 
@@ -569,6 +560,151 @@ exit:
 	return NULL;
 };
 
+//! reads 4-byte integer of Surfer7 GRD file from mapped memory
+static bool grd7_read_int(const char *& ptr, const char * end, int & value) {
+	if (end - ptr < 4)
+		return false;
+	memcpy(&value, ptr, 4);
+	ptr += 4;
+	return true;
+};
+
+//! reads double of Surfer7 GRD file from mapped memory
+static bool grd7_read_double(const char *& ptr, const char * end, double & value) {
+	if (end - ptr < (int)sizeof(double))
+		return false;
+	memcpy(&value, ptr, sizeof(double));
+	ptr += sizeof(double);
+	return true;
+};
+
+d_surf * _surf_load_grd_paged(const char * filename, const char * surfname, size_t cache_size) 
+{
+	mapfile * file = create_mapfile(filename);
+	if (!file) {
+		writelog(LOG_ERROR, "surf_load_grd_paged : the file %s was not opened",filename);
+		return NULL;
+	};
+
+	const char * ptr = file->begin();
+	const char * end = file->end();
+	int id, size, version;
+	int nx = 0, ny = 0;
+	double minx, miny, stepX, stepY, minz, maxz, rotation, blank;
+	d_grid * grd = NULL;
+	d_surf * res = NULL;
+	size_t offset = 0;
+
+	if ( (file->size() < 4) || (memcmp(ptr, "DSRB", 4) != 0) ) {
+		writelog(LOG_ERROR, "surf_load_grd_paged : %s is not a Surfer7 GRD file", filename);
+		file->release();
+		return NULL;
+	}
+	ptr += 4;
+
+	writelog(LOG_MESSAGE, "loading surface from Surfer7 GRD format file %s (paged)",filename);
+
+	if (!grd7_read_int(ptr, end, size) || (size != 4))
+		goto exit;
+	if (!grd7_read_int(ptr, end, version))
+		goto exit;
+
+	while (ptr < end) {
+
+		if (!grd7_read_int(ptr, end, id))
+			goto exit;
+		if (!grd7_read_int(ptr, end, size))
+			goto exit;
+
+		if (id == 0x44495247) { // grid section
+			if (size != 72)
+				goto exit;
+			if (!grd7_read_int(ptr, end, ny) || !grd7_read_int(ptr, end, nx))
+				goto exit;
+			if (!grd7_read_double(ptr, end, minx) || !grd7_read_double(ptr, end, miny))
+				goto exit;
+			if (!grd7_read_double(ptr, end, stepX) || !grd7_read_double(ptr, end, stepY))
+				goto exit;
+			if (!grd7_read_double(ptr, end, minz) || !grd7_read_double(ptr, end, maxz))
+				goto exit;
+			if (!grd7_read_double(ptr, end, rotation) || !grd7_read_double(ptr, end, blank))
+				goto exit;
+			if ((nx <= 0) || (ny <= 0))
+				goto exit;
+			continue;
+		}
+
+		if (id == 0x41544144) { // data section
+			if ((nx <= 0) || (ny <= 0))
+				goto exit;
+			// section size can't be stored for grids larger than 2 Gb, so it is taken from grid size
+			size_t data_size = (size_t)nx*(size_t)ny*sizeof(double);
+			if ((size_t)(end - ptr) < data_size)
+				goto exit;
+			offset = ptr - file->begin();
+			break;
+		}
+
+		// skip other sections
+		if ((size < 0) || (end - ptr < size))
+			goto exit;
+		ptr += size;
+	}
+
+	if (offset == 0)
+		goto exit;
+
+	grd = create_grid(minx, stepX*(nx-1)+minx, stepX, miny, stepY*(ny-1)+miny, stepY);
+	res = create_surf_paged(file, offset, grd, minz, maxz, blank, cache_size);
+
+	if (surfname)
+		res->setName(surfname);
+	else {
+		char * name = get_name(filename);
+		res->setName(name);
+		sstuff_free_char(name);
+	}
+
+	return res;
+
+exit:
+	writelog(LOG_ERROR, "surf_load_grd_paged : Wrong file format %s", filename);
+	file->release();
+	return NULL;
+};
+
+//! formats rows of Surfer ASCII grid
+class grd_text_rows : public text_rows {
+public:
+	grd_text_rows(const d_surf * isrf, REAL uval) : srf(isrf) {
+		undef_len = format_real(undef_text, uval);
+		undef_text[undef_len++] = ' ';
+	};
+	virtual void format_row(size_t iy, std::vector<char> & buf) const {
+		size_t nx = srf->getCountX();
+		size_t ix;
+		int ncnt = 0;
+		for (ix = 0; ix < nx; ix++) {
+			REAL val = srf->getValue( ix + nx*iy );
+			if (val != srf->undef_value) {
+				text_append_real(buf, val);
+				buf.push_back(' ');
+			} else
+				text_append(buf, undef_text, undef_len);
+			if (ncnt>9) { 
+				buf.push_back('\n');
+				ncnt = 0;
+			}
+			ncnt++;
+		}
+		buf.push_back('\n');
+	};
+private:
+	const d_surf * srf;
+	char undef_text[FORMAT_REAL_SIZE];
+	size_t undef_len;
+};
+
 bool _surf_save_grd(const d_surf * srf, const char * filename) {
 
 	if (!filename)
@@ -606,40 +742,15 @@ bool _surf_save_grd(const d_surf * srf, const char * filename) {
 		uval = -999;
 
 	// matrix 
-	int iy, ix;
-	int ncnt;
-	int cnt = 0;
-	REAL val;
-	
-    
-	for(iy=0; iy<ny; iy++)	{
-		ncnt = 0;
-		
-		for(ix=0; ix<nx; ix++)	{
-			val = (*(srf->coeff))( ix + nx*iy );
-			if (val != srf->undef_value)
-				fprintf(f,"%lf ", val);
-			else
-			{
-				if (uval == -999)
-					fprintf(f,"-999 ");
-				else if (uval == -99999)
-					fprintf(f,"-99999 ");
-				else
-					fprintf(f,"%lf ", uval);
-			}
-			if (ncnt>9) { 
-				fprintf(f,"\n");
-				ncnt = 0;
-			}
-			ncnt++;
-		}
-		fprintf(f,"\n");
-	}
+	grd_text_rows rows(srf, uval);
+	bool res = write_text_rows(f, ny, &rows);
 
 	fclose(f);
 
-	return true;
+	if (!res)
+		writelog(LOG_ERROR, "Can't write data to file %s",filename);
+
+	return res;
 };
 
 bool _surf_save_grd_bin(const d_surf * srf, const char * filename) 
@@ -851,8 +962,20 @@ bool _surf_save_grd_bin7(const d_surf * srf, const char * filename)
 	if ( write(f, &size, sizeof(long)) != sizeof(long) )
 		goto exit;
 
-	if (srf->coeff->write_file(f, NN*MM) != NN*MM*sizeof(double))
-		goto exit;
+	if (srf->coeff) {
+		if (srf->coeff->write_file(f, NN*MM) != NN*MM*sizeof(double))
+			goto exit;
+	} else {
+		// surface without values in memory (float or paged) is written row by row
+		std::vector<double> row(NN);
+		size_t i, j;
+		for (j = 0; j < MM; j++) {
+			for (i = 0; i < NN; i++)
+				row[i] = srf->getValue(i + j*NN);
+			if ( write(f, &(row[0]), NN*sizeof(double)) != (int)(NN*sizeof(double)) )
+				goto exit;
+		}
+	}
 
 	close(f);
 
@@ -17,6 +17,8 @@
  *	Contact info: surfit.sourceforge.net
  *----------------------------------------------------------------------------*/
 
+#include <vector>
+
 namespace surfit {
 
 class d_surf;
@@ -33,6 +35,13 @@ d_surf * _surf_load_grd_bin(const char * filename, const char * surfname);
 SURFIT_IO_EXPORT
 d_surf * _surf_load_grd_bin7(const char * filename, const char * surfname); 
 
+/*! \brief loads surface from SURFER grd file (Surfer7 BINARY format) without reading values.
+    Values are read from the file on demand (see \ref d_surf_paged)
+    \param cache_size maximum size of cached values in bytes
+*/
+SURFIT_IO_EXPORT
+d_surf * _surf_load_grd_paged(const char * filename, const char * surfname, size_t cache_size); 
+
 //! loads surface from Generic Mapping Tools grd file (CDF format)
 SURFIT_IO_EXPORT
 d_surf * _surf_load_gmt(const char * filename, const char * surfname); 
@@ -97,5 +106,14 @@ bool _surf_save_jpg(const d_surf * srf, const char * filename, int quality = 255
 SURFIT_IO_EXPORT
 bool _surf_save_bmp(const d_surf * srf, const char * filename);
 
+/*! \brief saves surface to tiled GeoTIFF file with internal overviews
+    \param format 0 - float32 samples, 1 - float64 samples
+    \param overviews surfaces for overviews (covering the same area, larger first). If NULL,
+    overviews are calculated as block means of surface values
+*/
+SURFIT_IO_EXPORT
+bool _surf_save_tiff(const d_surf * srf, const char * filename, int format = 0,
+		     const std::vector<const d_surf *> * overviews = NULL);
+
 }; // namespace surfit;
 
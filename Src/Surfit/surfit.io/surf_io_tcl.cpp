@@ -25,6 +25,7 @@
 #include "surf.h"
 #include "surf_io.h"
 #include "surf_io_tcl.h"
+#include "surf_internal.h"
 
 #include <algorithm>
 
@@ -50,6 +51,26 @@ boolvec * surf_load_grd(const char * filename, const char * surfname)
 	return res;
 };
 
+boolvec * surf_load_grd_paged(const char * filename, const char * surfname, int cache_size) 
+{
+	boolvec * res = create_boolvec();
+	const char * fname = find_first(filename);
+
+	while (fname) {
+		d_surf * srf = _surf_load_grd_paged(fname, surfname, (size_t)MAX(1, cache_size)*1024*1024);
+		if (srf) {
+			surfit_surfs->push_back(srf);
+			res->push_back(true);
+		} else
+			res->push_back(false);
+
+		fname = find_next();
+
+	};
+	find_close();
+	return res;
+};
+
 boolvec * surf_load_gmt(const char * filename, const char * surfname) 
 {
 	boolvec * res = create_boolvec();
@@ -341,6 +362,52 @@ boolvec * surf_save_bmp(const char * filename, const char * pos)
 	return qq.res;
 };
 
+struct save_oper_tiff : public save_oper
+{
+	save_oper_tiff(int iformat) : format(iformat) {};
+	virtual bool do_oper(const char * filename, d_surf * srf)
+	{
+		if (!srf)
+			return false;
+		return _surf_save_tiff(srf, filename, format);
+	};
+	int format;
+};
+
+boolvec * surf_save_tiff(const char * filename, const char * pos, int format) 
+{
+	save_oper_tiff oper(format);
+	match_surf_save qq(filename, pos, &oper);
+	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
+	return qq.res;
+};
+
+struct save_oper_tiff_pyramid : public save_oper
+{
+	save_oper_tiff_pyramid(int iformat) : format(iformat) {};
+	virtual bool do_oper(const char * filename, d_surf * srf)
+	{
+		if (!srf)
+			return false;
+		std::vector<const d_surf *> levels;
+		_surf_pyramid_levels(srf, levels);
+		if (levels.size() == 0) {
+			writelog(LOG_ERROR, "surf_save_tiff_pyramid : no pyramid levels found for surf \"%s\"", srf->getName());
+			return false;
+		}
+		return _surf_save_tiff(srf, filename, format, &levels);
+	};
+	int format;
+};
+
+boolvec * surf_save_tiff_pyramid(const char * filename, const char * pos, int format) 
+{
+	save_oper_tiff_pyramid oper(format);
+	match_surf_save qq(filename, pos, &oper);
+	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
+	return qq.res;
+};
+
 }; // namespace surfit;
 
 
@@ -36,6 +36,26 @@ class boolvec;
 */
 boolvec * surf_load_grd(const char * filename, const char * surfname = 0);
 
+/*! \ingroup tcl_surf_save_load
+    \par Tcl syntax:
+    surf_load_grd_paged \ref file "filename" "surfname" cache_size
+
+    \par Description:
+    loads surface from SURFER grd file (Surfer7 binary format) without reading its values.
+    File stays opened, and values are read in tiles when they are needed. This allows 
+    to query values of grids larger than available memory.
+    Values queries (\ref surf_getValue, \ref surf_getValueIJ), statistics and projecting 
+    to another grid work with paged surfaces. Other operations need a surface loaded into memory.
+
+    \param filename Surfer grd file (Surfer7 binary format)
+    \param surfname name for the surface (optional)
+    \param cache_size maximum size of cached values in megabytes
+
+    \par Implemented in library:
+    libsurfit_io
+*/
+boolvec * surf_load_grd_paged(const char * filename, const char * surfname = 0, int cache_size = 256);
+
 /*! \ingroup tcl_surf_save_load
     \par Tcl syntax:
     surf_load_gmt \ref file "filename" "surfname"
@@ -220,5 +240,42 @@ boolvec * surf_save_jpg(const char * filename, const char * surface_name = "*",
 */
 boolvec * surf_save_bmp(const char * filename, const char * surface_name = "*");
 
+/*! \ingroup tcl_surf_save_load
+    \par Tcl syntax:
+    surf_save_tiff "filename" \ref str "surface_name" format
+
+    \par Description:
+    saves surface to GeoTIFF file. Values are written in 256x256 tiles,
+    undefined values are marked with GDAL_NODATA tag. Overviews with
+    2, 4, 8, ... times lower resolution (block means of surface values)
+    are stored in the same file.
+
+    \param filename GeoTIFF file
+    \param surface_name \ref str "name" of \ref d_surf "surface" dataset
+    \param format 0 - float32 samples, 1 - float64 samples
+
+    \par Implemented in library:
+    libsurfit_io
+*/
+boolvec * surf_save_tiff(const char * filename, const char * surface_name = "*", int format = 0);
+
+/*! \ingroup tcl_surf_save_load
+    \par Tcl syntax:
+    surf_save_tiff_pyramid "filename" \ref str "surface_name" format
+
+    \par Description:
+    saves surface to GeoTIFF file like \ref surf_save_tiff, but overviews are 
+    the pyramid levels of the surface (solutions of \ref surfit intermediate phases,
+    kept if \ref surf_pyramid is set), so no resampling is needed.
+
+    \param filename GeoTIFF file
+    \param surface_name \ref str "name" of \ref d_surf "surface" dataset
+    \param format 0 - float32 samples, 1 - float64 samples
+
+    \par Implemented in library:
+    libsurfit_io
+*/
+boolvec * surf_save_tiff_pyramid(const char * filename, const char * surface_name = "*", int format = 0);
+
 };
 
@@ -0,0 +1,542 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_io_ie.h"
+#include "surf_io.h"
+#include "text_grid.h"
+
+// sstuff includes
+#include "sstuff.h"
+#include "threads.h"
+
+// surfit includes
+#include "surf.h"
+#include "vec.h"
+#include "variables_tcl.h"
+#include "grid.h"
+
+#include <float.h>
+#include <math.h>
+#include <errno.h>
+#include <string.h>
+
+#include <vector>
+#include <algorithm>
+
+namespace surfit {
+
+//! tile side of GeoTIFF file
+#define TIFF_TILE 256
+
+// TIFF field types
+#define TIFF_ASCII	2
+#define TIFF_SHORT	3
+#define TIFF_LONG	4
+#define TIFF_DOUBLE	12
+#define TIFF_LONG8	16
+
+typedef unsigned long long tiff_offset;
+
+//! one level of the pyramid: full resolution image or overview
+struct tiff_level
+{
+	//! surface with level values (full resolution surface or given overview)
+	const d_surf * srf;
+	//! amount of surface nodes in one pixel side
+	size_t factor;
+	//! block means for factor > 1, row by row from north to south (built before writing)
+	std::vector<REAL> values;
+	//! amount of defined surface nodes in every block
+	std::vector<REAL> counts;
+	//! image width in pixels
+	size_t width;
+	//! image height in pixels
+	size_t height;
+	//! amount of tiles in row
+	size_t tiles_x;
+	//! amount of tiles rows
+	size_t tiles_y;
+	//! positions of tiles in file
+	std::vector<tiff_offset> offsets;
+};
+
+//! TIFF directory entry
+struct tiff_entry
+{
+	unsigned short tag;
+	unsigned short type;
+	tiff_offset count;
+	//! values in native byte order
+	std::vector<char> data;
+	bool operator < (const tiff_entry & e) const { return tag < e.tag; };
+};
+
+/*! \brief computes block means of the pyramid level from the previous level
+    Every pixel is the 2x2 block of the previous level, so surface nodes are read 
+    only for the first overview. Means are weighted by the amount of defined nodes, 
+    so pixels are exact means of the defined surface values in the block.
+*/
+static void tiff_build_level(tiff_level & lev, const tiff_level & prev) {
+	const d_surf * srf = lev.srf;
+	size_t NN = srf->getCountX();
+	size_t MM = srf->getCountY();
+	lev.values.assign(lev.width*lev.height, REAL(0));
+	lev.counts.assign(lev.width*lev.height, REAL(0));
+	size_t px, py, x, y;
+	for (py = 0; py < lev.height; py++) {
+		for (y = 2*py; y < MIN(2*py + 2, prev.height); y++) {
+			for (px = 0; px < lev.width; px++) {
+				size_t pos = px + py*lev.width;
+				for (x = 2*px; x < MIN(2*px + 2, prev.width); x++) {
+					REAL value, cnt = 1;
+					if (prev.factor == 1) {
+						// image rows go from north to south
+						value = srf->getValue(x + (MM-1-y)*NN);
+						if (value == srf->undef_value)
+							continue;
+					} else {
+						cnt = prev.counts[x + y*prev.width];
+						if (cnt == 0)
+							continue;
+						value = prev.values[x + y*prev.width]*cnt;
+					}
+					lev.values[pos] += value;
+					lev.counts[pos] += cnt;
+				}
+			}
+		}
+	}
+	size_t pos;
+	for (pos = 0; pos < lev.values.size(); pos++) {
+		if (lev.counts[pos] > 0)
+			lev.values[pos] /= lev.counts[pos];
+		else
+			lev.values[pos] = srf->undef_value;
+	}
+};
+
+//! returns pixel value of the pyramid level
+inline
+REAL tiff_pixel(const tiff_level & lev, size_t px, size_t py) {
+	if (lev.factor > 1)
+		return lev.values[px + py*lev.width];
+	// image rows go from north to south
+	const d_surf * srf = lev.srf;
+	return srf->getValue(px + (srf->getCountY()-1-py)*srf->getCountX());
+};
+
+//! fills tile buffer with samples of float or double type
+static void tiff_encode_tile(const tiff_level & lev, size_t tx, size_t ty,
+			     bool float64, REAL nodata, char * dst)
+{
+	const d_surf * srf = lev.srf;
+	size_t x, y;
+	for (y = 0; y < TIFF_TILE; y++) {
+		size_t py = ty*TIFF_TILE + y;
+		for (x = 0; x < TIFF_TILE; x++) {
+			size_t px = tx*TIFF_TILE + x;
+			// pixels outside of the image are padding
+			REAL value = nodata;
+			if ((px < lev.width) && (py < lev.height)) {
+				value = tiff_pixel(lev, px, py);
+				if (value == srf->undef_value)
+					value = nodata;
+			}
+			size_t pos = x + y*TIFF_TILE;
+			if (float64) {
+				double v = (double)value;
+				memcpy(dst + pos*sizeof(double), &v, sizeof(double));
+			} else {
+				float v = (float)value;
+				memcpy(dst + pos*sizeof(float), &v, sizeof(float));
+			}
+		}
+	}
+};
+
+#ifdef HAVE_THREADS
+struct tiff_tile_job : public job
+{
+	tiff_tile_job()
+	{
+		lev = NULL;
+		ty = 0;
+		tx_from = 0;
+		tx_to = 0;
+		float64 = false;
+		nodata = 0;
+		dst = NULL;
+	};
+	void set(const tiff_level * ilev, size_t ity, size_t itx_from, size_t itx_to,
+		 bool ifloat64, REAL inodata, char * idst)
+	{
+		lev = ilev;
+		ty = ity;
+		tx_from = itx_from;
+		tx_to = itx_to;
+		float64 = ifloat64;
+		nodata = inodata;
+		dst = idst;
+	};
+	virtual void do_job()
+	{
+		size_t tile_bytes = TIFF_TILE*TIFF_TILE*(float64 ? sizeof(double) : sizeof(float));
+		size_t tx;
+		for (tx = tx_from; tx < tx_to; tx++)
+			tiff_encode_tile(*lev, tx, ty, float64, nodata, dst + (tx - tx_from)*tile_bytes);
+	};
+
+	const tiff_level * lev;
+	size_t ty, tx_from, tx_to;
+	bool float64;
+	REAL nodata;
+	char * dst;
+};
+
+tiff_tile_job tiff_tile_jobs[MAX_CPU];
+#endif
+
+//! encodes one row of tiles
+static void tiff_encode_row(const tiff_level & lev, size_t ty,
+			    bool float64, REAL nodata, char * dst)
+{
+	size_t tile_bytes = TIFF_TILE*TIFF_TILE*(float64 ? sizeof(double) : sizeof(float));
+#ifdef HAVE_THREADS
+	if ((sstuff_get_threads() == 1) || (lev.tiles_x < 2)) {
+#endif
+		size_t tx;
+		for (tx = 0; tx < lev.tiles_x; tx++)
+			tiff_encode_tile(lev, tx, ty, float64, nodata, dst + tx*tile_bytes);
+#ifdef HAVE_THREADS
+		return;
+	}
+
+	size_t threads = MIN(sstuff_get_threads(), lev.tiles_x);
+	size_t step = lev.tiles_x / threads;
+	size_t ost = lev.tiles_x % threads;
+	size_t tx_from = 0;
+	size_t t;
+	for (t = 0; t < threads; t++) {
+		size_t tx_to = tx_from + step + ((t < ost) ? 1 : 0);
+		tiff_tile_job & f = tiff_tile_jobs[t];
+		f.set(&lev, ty, tx_from, tx_to, float64, nodata, dst + tx_from*tile_bytes);
+		set_job(&f, t);
+		tx_from = tx_to;
+	}
+	do_jobs();
+#endif
+};
+
+static void tiff_add(std::vector<tiff_entry> & entries, unsigned short tag, unsigned short type,
+		     tiff_offset count, const void * data, size_t size)
+{
+	tiff_entry e;
+	e.tag = tag;
+	e.type = type;
+	e.count = count;
+	e.data.resize(size);
+	if (size > 0)
+		memcpy(&(e.data[0]), data, size);
+	entries.push_back(e);
+};
+
+static void tiff_add_short(std::vector<tiff_entry> & entries, unsigned short tag, unsigned short value) {
+	tiff_add(entries, tag, TIFF_SHORT, 1, &value, sizeof(value));
+};
+
+static void tiff_add_long(std::vector<tiff_entry> & entries, unsigned short tag, unsigned int value) {
+	tiff_add(entries, tag, TIFF_LONG, 1, &value, sizeof(value));
+};
+
+//! adds array of offsets or sizes (LONG for TIFF, LONG8 for BigTIFF)
+static void tiff_add_offsets(std::vector<tiff_entry> & entries, unsigned short tag,
+			     const std::vector<tiff_offset> & values, bool big)
+{
+	size_t i;
+	if (big) {
+		tiff_add(entries, tag, TIFF_LONG8, values.size(), &(values[0]), values.size()*sizeof(tiff_offset));
+		return;
+	}
+	std::vector<unsigned int> v(values.size());
+	for (i = 0; i < values.size(); i++)
+		v[i] = (unsigned int)values[i];
+	tiff_add(entries, tag, TIFF_LONG, v.size(), &(v[0]), v.size()*sizeof(unsigned int));
+};
+
+static void tiff_append(std::vector<char> & buf, const void * data, size_t size) {
+	const char * ptr = (const char *)data;
+	buf.insert(buf.end(), ptr, ptr + size);
+};
+
+/*! \brief serializes directory which will be written at position pos
+    \param next position of the next directory (0 for the last one)
+*/
+static void tiff_write_ifd(std::vector<tiff_entry> & entries, tiff_offset pos, tiff_offset next,
+			   bool big, std::vector<char> & buf)
+{
+	std::sort(entries.begin(), entries.end());
+	size_t inline_size = big ? 8 : 4;
+	size_t ifd_size = big ? (8 + entries.size()*20 + 8) : (2 + entries.size()*12 + 4);
+	tiff_offset extra_pos = pos + ifd_size;
+	std::vector<char> extra;
+
+	buf.resize(0);
+	if (big) {
+		tiff_offset n = entries.size();
+		tiff_append(buf, &n, 8);
+	} else {
+		unsigned short n = (unsigned short)entries.size();
+		tiff_append(buf, &n, 2);
+	}
+
+	size_t i;
+	for (i = 0; i < entries.size(); i++) {
+		const tiff_entry & e = entries[i];
+		tiff_append(buf, &e.tag, 2);
+		tiff_append(buf, &e.type, 2);
+		if (big)
+			tiff_append(buf, &e.count, 8);
+		else {
+			unsigned int count = (unsigned int)e.count;
+			tiff_append(buf, &count, 4);
+		}
+		char value[8];
+		memset(value, 0, sizeof(value));
+		if (e.data.size() <= inline_size) {
+			if (e.data.size() > 0)
+				memcpy(value, &(e.data[0]), e.data.size());
+		} else {
+			// values are placed after the directory at word boundary
+			tiff_offset off = extra_pos + extra.size();
+			if (big)
+				memcpy(value, &off, 8);
+			else {
+				unsigned int off32 = (unsigned int)off;
+				memcpy(value, &off32, 4);
+			}
+			tiff_append(extra, &(e.data[0]), e.data.size());
+			if (extra.size() % 2)
+				extra.push_back(0);
+		}
+		tiff_append(buf, value, inline_size);
+	}
+
+	if (big)
+		tiff_append(buf, &next, 8);
+	else {
+		unsigned int next32 = (unsigned int)next;
+		tiff_append(buf, &next32, 4);
+	}
+	buf.insert(buf.end(), extra.begin(), extra.end());
+};
+
+//! adds pyramid level to the list of levels
+static void tiff_add_level(std::vector<tiff_level> & levels, const d_surf * srf, size_t factor, 
+			   size_t width, size_t height, size_t tile_bytes, tiff_offset & data_size)
+{
+	tiff_level lev;
+	lev.srf = srf;
+	lev.factor = factor;
+	lev.width = width;
+	lev.height = height;
+	lev.tiles_x = (lev.width + TIFF_TILE - 1)/TIFF_TILE;
+	lev.tiles_y = (lev.height + TIFF_TILE - 1)/TIFF_TILE;
+	levels.push_back(lev);
+	data_size += (tiff_offset)lev.tiles_x*lev.tiles_y*tile_bytes;
+};
+
+bool _surf_save_tiff(const d_surf * srf, const char * filename, int format,
+		     const std::vector<const d_surf *> * overviews) 
+{
+
+	if (!filename)
+		return false;
+
+	if (!srf) {
+		writelog(LOG_ERROR,"surf_save_tiff : no surf loaded");
+		return false;
+	}
+
+	writelog(LOG_MESSAGE,"Saving surf %s to GeoTIFF file %s", srf->getName(), filename);
+
+	bool float64 = (format == 1);
+	size_t NN = srf->getCountX();
+	size_t MM = srf->getCountY();
+	size_t sample_size = float64 ? sizeof(double) : sizeof(float);
+	size_t tile_bytes = TIFF_TILE*TIFF_TILE*sample_size;
+
+	// undefined values are written as nodata, which should fit into the sample type
+	REAL nodata = srf->undef_value;
+	if ( !float64 && (fabs(nodata) > FLT_MAX) )
+		nodata = -FLT_MAX;
+	if (!float64)
+		nodata = (REAL)(float)nodata;
+
+	std::vector<tiff_level> levels;
+	tiff_offset data_size = 0;
+	tiff_add_level(levels, srf, 1, NN, MM, tile_bytes, data_size);
+
+	size_t l;
+	if (overviews) {
+		// given surfaces cover the same area with coarser grids (larger first).
+		// Each overview should be smaller than the previous one in both directions
+		for (l = 0; l < overviews->size(); l++) {
+			const d_surf * ovr = (*overviews)[l];
+			const tiff_level & prev = levels.back();
+			size_t width = ovr->getCountX();
+			size_t height = ovr->getCountY();
+			if ((width >= prev.width) || (height >= prev.height))
+				continue;
+			tiff_add_level(levels, ovr, 1, width, height, tile_bytes, data_size);
+		}
+	} else {
+		// block mean overviews are added until the whole image fits into one tile
+		size_t factor = 1;
+		while ((levels.back().width > TIFF_TILE) || (levels.back().height > TIFF_TILE)) {
+			factor *= 2;
+			tiff_add_level(levels, srf, factor, (NN + factor - 1)/factor, (MM + factor - 1)/factor, 
+				       tile_bytes, data_size);
+		}
+	}
+
+	// BigTIFF is used for files larger than 4 Gb
+	bool big = (data_size + 1048576 > (tiff_offset)0xFFFFFFFF);
+
+	FILE * f = fopen(filename, "wb");
+	if (!f) {
+		writelog(LOG_ERROR, "Can't write data to file %s : %s",filename,strerror( errno ));
+		return false;
+	}
+
+	bool res = true;
+	unsigned short one = 1;
+	bool little_endian = (*(char *)&one == 1);
+
+	// header, first directory offset is written at the end
+	std::vector<char> buf;
+	tiff_append(buf, little_endian ? "II" : "MM", 2);
+	if (big) {
+		unsigned short version = 43, offset_size = 8, zero = 0;
+		tiff_offset first_ifd = 0;
+		tiff_append(buf, &version, 2);
+		tiff_append(buf, &offset_size, 2);
+		tiff_append(buf, &zero, 2);
+		tiff_append(buf, &first_ifd, 8);
+	} else {
+		unsigned short version = 42;
+		unsigned int first_ifd = 0;
+		tiff_append(buf, &version, 2);
+		tiff_append(buf, &first_ifd, 4);
+	}
+	if (fwrite(&(buf[0]), 1, buf.size(), f) != buf.size())
+		res = false;
+	tiff_offset pos = buf.size();
+
+	// tiles are written by rows, from the full resolution image to the smallest overview
+	for (l = 0; (l < levels.size()) && res; l++) {
+		tiff_level & lev = levels[l];
+		if (lev.factor > 1) {
+			tiff_build_level(lev, levels[l-1]);
+			// only the previous level is needed for the next one
+			std::vector<REAL>().swap(levels[l-1].values);
+			std::vector<REAL>().swap(levels[l-1].counts);
+		}
+		size_t row_bytes = lev.tiles_x*tile_bytes;
+		buf.resize(row_bytes);
+		size_t tx, ty;
+		for (ty = 0; (ty < lev.tiles_y) && res; ty++) {
+			tiff_encode_row(lev, ty, float64, nodata, &(buf[0]));
+			if (fwrite(&(buf[0]), 1, row_bytes, f) != row_bytes)
+				res = false;
+			for (tx = 0; tx < lev.tiles_x; tx++) {
+				lev.offsets.push_back(pos);
+				pos += tile_bytes;
+			}
+		}
+	}
+	std::vector<char>().swap(buf);
+
+	// directories
+	tiff_offset first_ifd = pos;
+	char nodata_text[FORMAT_REAL_SIZE];
+	format_real(nodata_text, nodata);
+	REAL startX = srf->getCoordNodeX(0) - srf->getStepX()/REAL(2);
+	REAL endY = srf->getCoordNodeY(MM-1) + srf->getStepY()/REAL(2);
+
+	for (l = 0; (l < levels.size()) && res; l++) {
+		const tiff_level & lev = levels[l];
+		std::vector<tiff_entry> entries;
+		if (l > 0)
+			tiff_add_long(entries, 254, 1); // NewSubfileType: reduced resolution image
+		tiff_add_long(entries, 256, (unsigned int)lev.width);
+		tiff_add_long(entries, 257, (unsigned int)lev.height);
+		tiff_add_short(entries, 258, (unsigned short)(sample_size*8)); // BitsPerSample
+		tiff_add_short(entries, 259, 1); // no compression
+		tiff_add_short(entries, 262, 1); // BlackIsZero
+		tiff_add_short(entries, 277, 1); // SamplesPerPixel
+		tiff_add_short(entries, 284, 1); // PlanarConfiguration
+		tiff_add_long(entries, 322, TIFF_TILE); // TileWidth
+		tiff_add_long(entries, 323, TIFF_TILE); // TileLength
+		tiff_add_offsets(entries, 324, lev.offsets, big); // TileOffsets
+		std::vector<tiff_offset> counts(lev.offsets.size(), tile_bytes);
+		tiff_add_offsets(entries, 325, counts, big); // TileByteCounts
+		tiff_add_short(entries, 339, 3); // SampleFormat: IEEE floating point
+		if (l == 0) {
+			double scale[3] = { srf->getStepX(), srf->getStepY(), 0 };
+			tiff_add(entries, 33550, TIFF_DOUBLE, 3, scale, sizeof(scale)); // ModelPixelScale
+			double tiepoint[6] = { 0, 0, 0, startX, endY, 0 };
+			tiff_add(entries, 33922, TIFF_DOUBLE, 6, tiepoint, sizeof(tiepoint)); // ModelTiepoint
+			// GeoKeyDirectory: version 1.1.0, one key: GTRasterTypeGeoKey = RasterPixelIsArea
+			unsigned short keys[8] = { 1, 1, 0, 1, 1025, 0, 1, 1 };
+			tiff_add(entries, 34735, TIFF_SHORT, 8, keys, sizeof(keys));
+		}
+		tiff_add(entries, 42113, TIFF_ASCII, strlen(nodata_text)+1, nodata_text, strlen(nodata_text)+1); // GDAL_NODATA
+
+		// size of this directory is needed for the next directory position
+		tiff_write_ifd(entries, pos, 0, big, buf);
+		tiff_offset next = (l + 1 < levels.size()) ? pos + buf.size() : 0;
+		tiff_write_ifd(entries, pos, next, big, buf);
+		if (fwrite(&(buf[0]), 1, buf.size(), f) != buf.size())
+			res = false;
+		pos += buf.size();
+	}
+
+	// first directory offset
+	if (res) {
+		if (fseek(f, big ? 8 : 4, SEEK_SET) != 0)
+			res = false;
+		if (big) {
+			if (fwrite(&first_ifd, 8, 1, f) != 1)
+				res = false;
+		} else {
+			unsigned int first_ifd32 = (unsigned int)first_ifd;
+			if (fwrite(&first_ifd32, 4, 1, f) != 1)
+				res = false;
+		}
+	}
+
+	fclose(f);
+
+	if (!res)
+		writelog(LOG_ERROR, "Can't write data to file %s",filename);
+
+	return res;
+};
+
+}; // namespace surfit;
+
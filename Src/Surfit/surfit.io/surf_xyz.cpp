@@ -19,6 +19,7 @@
 
 #include "surfit_io_ie.h"
 #include "surf_io.h"
+#include "text_grid.h"
 
 // sstuff includes
 #include "sstuff.h"
@@ -37,6 +38,31 @@
 
 namespace surfit {
 
+//! formats defined nodes of surface row as "x y z" lines
+class xyz_text_rows : public text_rows {
+public:
+	xyz_text_rows(const d_surf * isrf) : srf(isrf) {};
+	virtual void format_row(size_t iy, std::vector<char> & buf) const {
+		size_t nx = srf->getCountX();
+		size_t ix;
+		REAL x_coord, y_coord;
+		for (ix = 0; ix < nx; ix++) {
+			REAL val = srf->getValue( ix + nx*iy );
+			if (val == srf->undef_value)
+				continue;
+			srf->getCoordNode(ix, iy, x_coord, y_coord);
+			text_append_real(buf, x_coord);
+			buf.push_back(' ');
+			text_append_real(buf, y_coord);
+			buf.push_back(' ');
+			text_append_real(buf, val);
+			text_append(buf, " \n", 2);
+		}
+	};
+private:
+	const d_surf * srf;
+};
+
 bool _surf_save_xyz(const d_surf * srf, const char * filename) {
 
 	if (!filename)
@@ -56,28 +82,15 @@ bool _surf_save_xyz(const d_surf * srf, const char * filename) {
 		return false;
 	}
 
-	int nx = srf->getCountX();
-	int ny = srf->getCountY();
-
-	int iy, ix;
-	int cnt = 0;
-	REAL val;
-	REAL x_coord, y_coord;
-	
-    
-	for(iy=0; iy<ny; iy++)	{
-		for(ix=0; ix<nx; ix++)	{
-			srf->getCoordNode(ix, iy, x_coord, y_coord);
-			val = (*(srf->coeff))( ix + nx*iy );
-			if (val == srf->undef_value)
-				continue;
-			fprintf(f,"%lf %lf %lf \n", x_coord, y_coord, val);
-		}
-	}
+	xyz_text_rows rows(srf);
+	bool res = write_text_rows(f, srf->getCountY(), &rows);
 
 	fclose(f);
 
-	return true;
+	if (!res)
+		writelog(LOG_ERROR, "Can't write data to file %s",filename);
+
+	return res;
 };
 
 d_surf * _surf_load_xyz(const char * filename, const char * surfname, bool force) {
@@ -0,0 +1,461 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_io_ie.h"
+#include "text_grid.h"
+
+// sstuff includes
+#include "sstuff.h"
+#include "threads.h"
+
+// surfit includes
+#include "surf.h"
+#include "vec.h"
+#include "variables_tcl.h"
+
+#include <string.h>
+
+#include <stdlib.h>
+#include <math.h>
+
+namespace surfit {
+
+//! amount of bytes formatted by one job at once
+#define TEXT_JOB_BYTES 1048576
+
+//! text grids smaller than this are read without threads
+#define TEXT_READ_MIN_BYTES 65536
+
+size_t format_real(char * buf, REAL value) {
+
+	// integers are formatted without printf
+	if ( (value != 0) && (fabs(value) < REAL(1e15)) && (value == floor(value)) ) {
+		long long i = (long long)value;
+		char tmp[FORMAT_REAL_SIZE];
+		size_t len = 0;
+		bool neg = (i < 0);
+		if (neg)
+			i = -i;
+		while (i > 0) {
+			tmp[len++] = (char)('0' + i % 10);
+			i /= 10;
+		}
+		size_t pos = 0;
+		if (neg)
+			buf[pos++] = '-';
+		while (len > 0)
+			buf[pos++] = tmp[--len];
+		buf[pos] = '\0';
+		return pos;
+	}
+
+	// 15 significant digits are enough for most values, 17 digits are enough for any value
+	int len = sprintf(buf, "%.15g", value);
+	if (strtod(buf, NULL) != value) {
+		len = sprintf(buf, "%.16g", value);
+		if (strtod(buf, NULL) != value)
+			len = sprintf(buf, "%.17g", value);
+	}
+	return (size_t)len;
+};
+
+#ifdef HAVE_THREADS
+struct text_rows_job : public job
+{
+	text_rows_job()
+	{
+		formatter = NULL;
+		from = 0;
+		to = 0;
+	};
+	void set(const text_rows * iformatter, size_t ifrom, size_t ito)
+	{
+		formatter = iformatter;
+		from = ifrom;
+		to = ito;
+	};
+	virtual void do_job()
+	{
+		buf.resize(0);
+		size_t row;
+		for (row = from; row < to; row++)
+			formatter->format_row(row, buf);
+	};
+
+	const text_rows * formatter;
+	size_t from, to;
+	//! buffer is kept between calls to avoid reallocations
+	std::vector<char> buf;
+};
+
+text_rows_job text_rows_jobs[MAX_CPU];
+#endif
+
+bool write_text_rows(FILE * f, size_t rows, const text_rows * formatter) {
+
+	bool res = true;
+	// rows for one job are chosen to get about TEXT_JOB_BYTES of text
+	size_t rows_per_job = 16;
+	size_t row = 0;
+
+#ifdef HAVE_THREADS
+	if ((sstuff_get_threads() == 1) || (rows < 2)) {
+#endif
+		std::vector<char> buf;
+		while (row < rows) {
+			size_t to = MIN(rows, row + rows_per_job);
+			buf.resize(0);
+			size_t r;
+			for (r = row; r < to; r++)
+				formatter->format_row(r, buf);
+			if ( (buf.size() > 0) && (fwrite(&buf[0], 1, buf.size(), f) != buf.size()) )
+				res = false;
+			rows_per_job = MAX(1, TEXT_JOB_BYTES / MAX(1, buf.size()/(to - row)));
+			row = to;
+		}
+		return res;
+#ifdef HAVE_THREADS
+	}
+
+	size_t threads = sstuff_get_threads();
+	while (row < rows) {
+		size_t t;
+		size_t jobs = 0;
+		size_t from = row;
+		for (t = 0; (t < threads) && (from < rows); t++) {
+			size_t to = MIN(rows, from + rows_per_job);
+			text_rows_job & f = text_rows_jobs[t];
+			f.set(formatter, from, to);
+			set_job(&f, t);
+			from = to;
+			jobs++;
+		}
+		do_jobs();
+
+		size_t bytes = 0;
+		for (t = 0; t < jobs; t++) {
+			std::vector<char> & buf = text_rows_jobs[t].buf;
+			bytes += buf.size();
+			if ( (buf.size() > 0) && (fwrite(&buf[0], 1, buf.size(), f) != buf.size()) )
+				res = false;
+		}
+		rows_per_job = MAX(1, TEXT_JOB_BYTES / MAX(1, bytes/(from - row)));
+		row = from;
+	}
+
+	// free buffers
+	size_t t;
+	for (t = 0; t < threads; t++)
+		std::vector<char>().swap(text_rows_jobs[t].buf);
+
+	return res;
+#endif
+};
+
+//! exactly representable powers of 10
+static const REAL text_pow10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool parse_real(const char * str, size_t len, REAL & value) {
+
+	const char * ptr = str;
+	const char * end = str + len;
+	bool neg = false;
+	if ( (ptr < end) && ((*ptr == '-') || (*ptr == '+')) ) {
+		neg = (*ptr == '-');
+		ptr++;
+	}
+
+	// mantissa with at most 19 significant digits
+	unsigned long long mant = 0;
+	int digits = 0;
+	int exp10 = 0;
+	bool any = false;
+	bool fast = true;
+
+	while ( (ptr < end) && (*ptr >= '0') && (*ptr <= '9') ) {
+		if ( (mant != 0) || (*ptr != '0') ) {
+			if (digits == 19)
+				fast = false;
+			else {
+				mant = mant*10 + (*ptr - '0');
+				digits++;
+			}
+		}
+		any = true;
+		ptr++;
+	}
+	if ( (ptr < end) && (*ptr == '.') ) {
+		ptr++;
+		while ( (ptr < end) && (*ptr >= '0') && (*ptr <= '9') ) {
+			if ( (mant != 0) || (*ptr != '0') ) {
+				if (digits == 19)
+					fast = false;
+				else {
+					mant = mant*10 + (*ptr - '0');
+					digits++;
+				}
+			}
+			exp10--;
+			any = true;
+			ptr++;
+		}
+	}
+	if ( any && (ptr < end) && ((*ptr == 'e') || (*ptr == 'E')) ) {
+		ptr++;
+		bool exp_neg = false;
+		if ( (ptr < end) && ((*ptr == '-') || (*ptr == '+')) ) {
+			exp_neg = (*ptr == '-');
+			ptr++;
+		}
+		if ( (ptr == end) || (*ptr < '0') || (*ptr > '9') )
+			fast = false;
+		int e = 0;
+		while ( (ptr < end) && (*ptr >= '0') && (*ptr <= '9') ) {
+			if (e < 10000)
+				e = e*10 + (*ptr - '0');
+			ptr++;
+		}
+		exp10 += exp_neg ? -e : e;
+	}
+
+	// mantissa and power of 10 are exact, so the result is rounded correctly
+	if ( fast && any && (ptr == end) && (mant <= ((unsigned long long)1 << 53)) &&
+	     (exp10 >= -22) && (exp10 <= 22) ) 
+	{
+		value = (REAL)mant;
+		if (exp10 < 0)
+			value /= text_pow10[-exp10];
+		else
+			value *= text_pow10[exp10];
+		if (neg)
+			value = -value;
+		return true;
+	}
+
+	// long mantissas, large exponents, inf and nan
+	char buf[128];
+	if (len >= sizeof(buf))
+		return false;
+	memcpy(buf, str, len);
+	buf[len] = '\0';
+	char * buf_end = NULL;
+	value = strtod(buf, &buf_end);
+	return (buf_end == buf + len);
+};
+
+//! parameters of \ref read_text_grid
+struct text_grid_params
+{
+	extvec * data;
+	size_t nx, ny;
+	bool north_to_south;
+	REAL minz, maxz;
+	REAL nodata;
+	const char * nodata_text;
+	size_t nodata_len;
+};
+
+//! returns amount of tokens in text
+static size_t count_text_values(const char * ptr, const char * end) {
+	size_t res = 0;
+	bool space = true;
+	for (; ptr < end; ptr++) {
+		bool s = text_is_space(*ptr);
+		if (space && !s)
+			res++;
+		space = s;
+	}
+	return res;
+};
+
+//! reads values of text grid starting from value number "first"
+static bool read_text_values(const char * ptr, const char * end, size_t first, 
+			     const text_grid_params & prm, size_t & read)
+{
+	size_t count = prm.nx*prm.ny;
+	size_t pos = first;
+	const char * token;
+	size_t len;
+	REAL value;
+	size_t ix = first % prm.nx;
+	size_t iy = first / prm.nx;
+	while (text_token(ptr, end, token, len)) {
+		if (pos >= count)
+			return false;
+		if ( prm.nodata_text && (len == prm.nodata_len) && (memcmp(token, prm.nodata_text, len) == 0) )
+			value = undef_value;
+		else {
+			if (!parse_real(token, len, value))
+				return false;
+			if ( (value == prm.nodata) || (value < prm.minz) || (value > prm.maxz) )
+				value = undef_value;
+		}
+		if (prm.north_to_south)
+			(*(prm.data))(ix + (prm.ny-1-iy)*prm.nx) = value;
+		else
+			(*(prm.data))(pos) = value;
+		pos++;
+		ix++;
+		if (ix == prm.nx) {
+			ix = 0;
+			iy++;
+		}
+	}
+	read = pos - first;
+	return true;
+};
+
+#if defined(HAVE_THREADS) && !defined(XXL)
+struct text_grid_job : public job
+{
+	text_grid_job()
+	{
+		begin = NULL;
+		end = NULL;
+		prm = NULL;
+		first = 0;
+		values = 0;
+		result = false;
+	};
+	void set(const char * ibegin, const char * iend, const text_grid_params * iprm, size_t ifirst)
+	{
+		begin = ibegin;
+		end = iend;
+		prm = iprm;
+		first = ifirst;
+	};
+	virtual void do_job()
+	{
+		// counts values if parameters are not set
+		if (prm == NULL) {
+			values = count_text_values(begin, end);
+			result = true;
+			return;
+		}
+		size_t read = 0;
+		result = read_text_values(begin, end, first, *prm, read);
+		result = result && (read == values);
+	};
+
+	const char * begin;
+	const char * end;
+	const text_grid_params * prm;
+	size_t first;
+	size_t values;
+	bool result;
+};
+
+text_grid_job text_grid_jobs[MAX_CPU];
+#endif
+
+bool read_text_grid(const char * begin, const char * end, extvec * data, size_t nx, size_t ny, 
+		    bool north_to_south, REAL minz, REAL maxz, REAL nodata, const char * nodata_text)
+{
+	if ( (nx == 0) || (ny == 0) )
+		return false;
+
+	text_grid_params prm;
+	prm.data = data;
+	prm.nx = nx;
+	prm.ny = ny;
+	prm.north_to_south = north_to_south;
+	prm.minz = minz;
+	prm.maxz = maxz;
+	prm.nodata = nodata;
+	prm.nodata_text = nodata_text;
+	prm.nodata_len = nodata_text ? strlen(nodata_text) : 0;
+
+	size_t bytes = end - begin;
+
+#if defined(HAVE_THREADS) && !defined(XXL)
+	if ((sstuff_get_threads() == 1) || (bytes < TEXT_READ_MIN_BYTES)) {
+#endif
+		size_t read = 0;
+		if (!read_text_values(begin, end, 0, prm, read))
+			return false;
+		return (read == nx*ny);
+#if defined(HAVE_THREADS) && !defined(XXL)
+	}
+
+	// text is divided into parts at whitespaces, so tokens are not broken
+	size_t threads = sstuff_get_threads();
+	std::vector<const char *> parts(threads+1);
+	parts[0] = begin;
+	parts[threads] = end;
+	size_t t;
+	for (t = 1; t < threads; t++) {
+		const char * ptr = MAX(parts[t-1], begin + bytes/threads*t);
+		while ( (ptr < end) && !text_is_space(*ptr) )
+			ptr++;
+		parts[t] = ptr;
+	}
+
+	// values are counted to find the first value of each part
+	for (t = 0; t < threads; t++) {
+		text_grid_job & f = text_grid_jobs[t];
+		f.set(parts[t], parts[t+1], NULL, 0);
+		set_job(&f, t);
+	}
+	do_jobs();
+
+	size_t first = 0;
+	for (t = 0; t < threads; t++) {
+		text_grid_job & f = text_grid_jobs[t];
+		f.set(parts[t], parts[t+1], &prm, first);
+		first += f.values;
+	}
+	if (first != nx*ny)
+		return false;
+
+	for (t = 0; t < threads; t++)
+		set_job(&(text_grid_jobs[t]), t);
+	do_jobs();
+
+	for (t = 0; t < threads; t++) {
+		if (!text_grid_jobs[t].result)
+			return false;
+	}
+	return true;
+#endif
+};
+
+flipped_text_rows::flipped_text_rows(const d_surf * isrf) : srf(isrf) {
+	undef_len = sprintf(undef_text, "%g ", srf->undef_value);
+};
+
+void flipped_text_rows::format_row(size_t row, std::vector<char> & buf) const {
+	size_t nx = srf->getCountX();
+	size_t ny = srf->getCountY();
+	size_t i;
+	for (i = 0; i < nx; i++) {
+		REAL val = srf->getValueIJ(i, ny-1-row);
+		if (val == srf->undef_value)
+			text_append(buf, undef_text, undef_len);
+		else {
+			text_append_real(buf, val);
+			buf.push_back(' ');
+		}
+	}
+	buf.push_back('\n');
+};
+
+}; // namespace surfit;
+
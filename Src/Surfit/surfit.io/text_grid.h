@@ -0,0 +1,172 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit_io__text_grid__
+#define __surfit_io__text_grid__
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "vec.h"
+
+/*! \file
+    \brief fast reading and writing of text grid files (Surfer ASCII, ArcGIS, GRASS, XYZ)
+*/
+
+namespace surfit {
+
+class d_surf;
+
+//! maximum length of text produced by \ref format_real
+#define FORMAT_REAL_SIZE 32
+
+/*! \brief writes the shortest text, which is read back to the same value
+    \param buf buffer of at least FORMAT_REAL_SIZE chars
+    \return length of text
+*/
+SURFIT_IO_EXPORT
+size_t format_real(char * buf, REAL value);
+
+/*! \class text_rows
+    \brief text file, divided into rows, which are formatted independently
+*/
+class SURFIT_IO_EXPORT text_rows {
+public:
+	//! destructor
+	virtual ~text_rows() {};
+	//! appends text of row number "row" to buf
+	virtual void format_row(size_t row, std::vector<char> & buf) const = 0;
+};
+
+/*! \brief formats rows (in parallel if threads are enabled) and writes them to file in order
+    \param f opened file
+    \param rows amount of rows
+    \param formatter formats rows into buffers
+*/
+SURFIT_IO_EXPORT
+bool write_text_rows(FILE * f, size_t rows, const text_rows * formatter);
+
+/*! \class flipped_text_rows
+    \brief formats surface rows from north to south (ArcGIS and GRASS ASCII grids)
+
+    Undefined values are written with "%g" format, as in the file header.
+*/
+class SURFIT_IO_EXPORT flipped_text_rows : public text_rows {
+public:
+	//! constructor
+	flipped_text_rows(const d_surf * isrf);
+	virtual void format_row(size_t row, std::vector<char> & buf) const;
+private:
+	const d_surf * srf;
+	char undef_text[FORMAT_REAL_SIZE];
+	size_t undef_len;
+};
+
+/*! \brief converts the whole token to REAL (like strtod, but the text is not null-terminated)
+    \param str token text
+    \param len token length
+    \param value result
+    \return false if token is not a number
+*/
+SURFIT_IO_EXPORT
+bool parse_real(const char * str, size_t len, REAL & value);
+
+/*! \brief reads values of text grid (in parallel if threads are enabled)
+    \param begin text after the grid header
+    \param end end of text
+    \param data vector for nx*ny values
+    \param nx amount of columns
+    \param ny amount of rows
+    \param north_to_south rows are stored from north to south (ArcGIS, GRASS)
+    \param minz values less than minz are undefined
+    \param maxz values greater than maxz are undefined
+    \param nodata values equal to nodata are undefined
+    \param nodata_text token for undefined values, which is not a number (can be NULL)
+    \return false if text contains wrong tokens or amount of values differs from nx*ny
+*/
+SURFIT_IO_EXPORT
+bool read_text_grid(const char * begin, const char * end, extvec * data, size_t nx, size_t ny, 
+		    bool north_to_south, REAL minz, REAL maxz, REAL nodata, const char * nodata_text);
+
+//! returns true for whitespace characters
+inline
+bool text_is_space(char c) {
+	return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t') || (c == '\v') || (c == '\f');
+};
+
+/*! \brief finds the next whitespace-delimited token in text
+    \param ptr current position, moved to the end of token
+    \param end end of text
+    \param token token beginning
+    \param len token length
+    \return false if there are no more tokens
+*/
+inline
+bool text_token(const char *& ptr, const char * end, const char *& token, size_t & len) {
+	while ( (ptr < end) && text_is_space(*ptr) )
+		ptr++;
+	if (ptr == end)
+		return false;
+	token = ptr;
+	while ( (ptr < end) && !text_is_space(*ptr) )
+		ptr++;
+	len = ptr - token;
+	return true;
+};
+
+/*! \brief copies the next token of text into buf (like fscanf "%s")
+    \return false if there are no more tokens or token is too long
+*/
+inline
+bool text_word(const char *& ptr, const char * end, char * buf, size_t buf_size) {
+	const char * token;
+	size_t len;
+	if (!text_token(ptr, end, token, len))
+		return false;
+	if (len >= buf_size)
+		return false;
+	memcpy(buf, token, len);
+	buf[len] = '\0';
+	return true;
+};
+
+//! appends string to text buffer
+inline
+void text_append(std::vector<char> & buf, const char * str, size_t len) {
+	buf.insert(buf.end(), str, str + len);
+};
+
+//! appends string to text buffer
+inline
+void text_append(std::vector<char> & buf, const char * str) {
+	text_append(buf, str, strlen(str));
+};
+
+//! appends value with \ref format_real to text buffer
+inline
+void text_append_real(std::vector<char> & buf, REAL value) {
+	char tmp[FORMAT_REAL_SIZE];
+	size_t len = format_real(tmp, value);
+	text_append(buf, tmp, len);
+};
+
+}; // namespace surfit;
+
+#endif
+
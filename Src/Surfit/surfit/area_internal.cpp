@@ -122,7 +122,7 @@ d_area * _area_load_df(datafile * df, const char * areaname) {
 	
 	while ( !loaded ) {
 		
-		if (df->findTag("area")) {
+		if (df->findTag("area", NULL, areaname)) {
 			
 			df->skipTagName();
 			if (!df->readWord()) goto exit;
@@ -123,7 +123,7 @@ d_cntr * _cntr_load_df(datafile * df, const char * cntrname) {
 	
 	while (!loaded) {
 		
-		if (df->findTag("cntr")) {
+		if (df->findTag("cntr", NULL, cntrname)) {
 			
 			df->skipTagName();
 			
@@ -19,54 +19,28 @@
 
 #include "surfit_ie.h"
 #include "cntr_trace.h"
-#include "grid_user.h"
-#include "../sstuff/bitvec.h"
+#include "../sstuff/threads.h"
 
 #include <float.h>
+#include <limits.h>
 #include <math.h>
 #include <vector>
 #include <algorithm>
-#include <assert.h>
 
 namespace surfit {
 
-struct trace_info
-{
-	vec * levels;
-	vec * x_coords;
-	vec * y_coords;
-	extvec * data;
-	bitvec * checks;
-	size_t nn, mm;
-	REAL uval;
-	bool close_on_bound;
-};
-
-inline 
-size_t level_index(REAL level, trace_info & info)
-{
-	vec::iterator it = std::find(info.levels->begin(), info.levels->end(), level);
-	if (it != info.levels->end())
-		return it - info.levels->begin();
-	assert(0);
-	return UINT_MAX;
-};
-
-fiso::fiso(REAL ilevel, size_t ilevel_number, size_t ilevels, bitvec * ichecks, size_t inn, size_t imm)
+fiso::fiso(REAL ilevel, size_t ilevel_number, size_t ireserve)
 {	
-	x = create_vec(0,0,0,MAX(inn,imm));
-	x->reserve(MAX(inn,imm));
-	y = create_vec(0,0,0,MAX(inn,imm));
-	y->reserve(MAX(inn,imm));
+	x = create_vec();
+	y = create_vec();
+	if (ireserve > 0) {
+		x->reserve(ireserve);
+		y->reserve(ireserve);
+	}
 	flags = new std::vector<bool>();
 	level = ilevel;
-	levels = ilevels;
 	level_number = ilevel_number;
-	nn = inn;
-	mm = imm;
-	checks = ichecks;
 	fill_level = FLT_MAX;
-	checksum = 0;
 };
 
 fiso::~fiso()
@@ -86,18 +60,37 @@ size_t fiso::get_level_number() const
 	return level_number;
 };
 
-void fiso::add_point(REAL px, REAL py, size_t i, size_t j, bool visible)
+void fiso::add_point(REAL px, REAL py, bool visible)
 {
 	x->push_back(px);
 	y->push_back(py);
 	flags->push_back(visible);
-	if (level_number != UINT_MAX)
-	{
-		size_t pos;
-		pos = three2one(i, j, level_number, nn, mm, levels);
-		checks->set_true(pos);
+};
+
+void fiso::append(const fiso * iso, size_t from)
+{
+	size_t pos;
+	for (pos = from; pos < iso->size(); pos++) {
+		x->push_back( (*(iso->x))(pos) );
+		y->push_back( (*(iso->y))(pos) );
+		flags->push_back( (*(iso->flags))[pos] );
 	}
-	checksum += i+j;
+};
+
+void fiso::remove_points(const std::vector<bool> & keep)
+{
+	size_t pos, cnt = 0;
+	for (pos = 0; pos < size(); pos++) {
+		if (!keep[pos])
+			continue;
+		(*x)(cnt) = (*x)(pos);
+		(*y)(cnt) = (*y)(pos);
+		(*flags)[cnt] = (*flags)[pos];
+		cnt++;
+	}
+	x->resize(cnt);
+	y->resize(cnt);
+	flags->resize(cnt);
 };
 
 void fiso::get_point(size_t pos, REAL & px, REAL & py, bool & visible) const
@@ -127,11 +120,6 @@ void fiso::set_fill_level(REAL ival, bool force)
 		fill_level = ival; 
 };
 
-int fiso::get_checksum() const 
-{ 
-	return checksum; 
-};
-
 vec::iterator fiso::x_begin() const
 {
 	return x->begin();
@@ -157,956 +145,927 @@ vec::iterator fiso::y_end() const
 #define SIDE_TOP 2
 #define SIDE_RIGHT 3
 
-#define EPS 1e-6
-
-short opp_side[4]={SIDE_TOP, SIDE_RIGHT, SIDE_BOTTOM, SIDE_LEFT};
-
-// modifies value a little
-REAL bug_value(REAL val)
-{
-	if (val < 1)
-		return val + EPS;
-	REAL rank = log10(val);
-	return val + EPS*pow(10.,rank);
+//! tile width (cells)
+#define CNTR_TILE_X 128
+//! tile height (cells)
+#define CNTR_TILE_Y 128
+
+//! grids with less cells are traced in one thread
+#define CNTR_THREADS_MIN 65536
+
+//
+//        val2   val3
+//          o-----o
+//          |     |
+//          |     |
+//          o-----o
+//         val0   val1
+//
+//! segments of cell for nodes higher than level (bits: val0 - 1, val1 - 2, val2 - 4, val3 - 8)
+/*!
+    Each segment goes from side to side with higher nodes on the left,
+    so every crossed rib has one segment coming in and one going out.
+    In saddle cells val1 and val2 are cut off.
+*/
+static const short cell_segments[16][4] = {
+	{-1, -1, -1, -1},
+	{ SIDE_BOTTOM, SIDE_LEFT, -1, -1},
+	{ SIDE_RIGHT, SIDE_BOTTOM, -1, -1},
+	{ SIDE_RIGHT, SIDE_LEFT, -1, -1},
+	{ SIDE_LEFT, SIDE_TOP, -1, -1},
+	{ SIDE_BOTTOM, SIDE_TOP, -1, -1},
+	{ SIDE_RIGHT, SIDE_BOTTOM, SIDE_LEFT, SIDE_TOP},
+	{ SIDE_RIGHT, SIDE_TOP, -1, -1},
+	{ SIDE_TOP, SIDE_RIGHT, -1, -1},
+	{ SIDE_BOTTOM, SIDE_RIGHT, SIDE_TOP, SIDE_LEFT},
+	{ SIDE_TOP, SIDE_BOTTOM, -1, -1},
+	{ SIDE_TOP, SIDE_LEFT, -1, -1},
+	{ SIDE_LEFT, SIDE_RIGHT, -1, -1},
+	{ SIDE_BOTTOM, SIDE_RIGHT, -1, -1},
+	{ SIDE_LEFT, SIDE_BOTTOM, -1, -1},
+	{-1, -1, -1, -1}
 };
 
-// returns val1 >= val2
-inline
-bool cmp_vals(REAL val1, REAL val2, REAL uval)
+struct trace_info
 {
-	if (val1 == uval)
-		return true;
-	if (val2 == uval)
-		return false;
-	return (val1 >= val2);
+	//! levels with additional level for undefined area
+	const vec * levels;
+	const vec * x_coords;
+	const vec * y_coords;
+	const extvec * data;
+	size_t nn, mm;
+	REAL uval;
+	//! amount of horizontal ribs
+	size_t h_ribs;
 };
 
-// returns true in case of level lies between val1 and val2
+//
+// Ribs are numbered through the grid: horizontal rib from node (i,j) to (i+1,j) is
+// i + j*(nn-1), vertical rib from node (i,j) to (i,j+1) is h_ribs + i + j*nn
+//
+
 inline
-bool check_level_intersection(REAL val1, REAL val2, REAL level, REAL uval)
+REAL node_value(const trace_info & info, size_t pos)
 {
-        if (val1 == uval)
-		return (val2 < level);
-	if (val2 == uval)
-		return (val1 < level);
-        return ( ((val1 > level) && (val2 < level)) || ((val2 > level) && (val1 < level)));
+	REAL val = (*(info.data))(pos);
+	if (val == info.uval)
+		return FLT_MAX;
+	return val;
 };
 
 inline
-void calc_point(REAL level, short side, size_t i, size_t j,
-		REAL vals[4],
-		trace_info & info, REAL & x, REAL & y, bool & visible)
+bool is_bound_rib(const trace_info & info, size_t rib)
 {
-	REAL x0, x1;
-	REAL y0, y1;
-	visible = true;
-	REAL w;
-	switch(side) {
-		case SIDE_BOTTOM:
-			{
-				assert(vals[0] != vals[1]);
-				x0 = (*(info.x_coords))(i);
-				x1 = (*(info.x_coords))(i+1);
-				if ((vals[0] == info.uval) || (vals[1] == info.uval))
-				{
-					w = 0.5;
-					visible = false;
-				}
-				else
-					w = (level-vals[0])/(vals[1]-vals[0]);
-				x = x0 + (x1-x0)*w;
-				y = (*(info.y_coords))(j);
-			}
-			break;
-		case SIDE_LEFT:
-			{
-				x = (*(info.x_coords))(i);
-				if ((vals[0] == info.uval) || (vals[2] == info.uval))
-				{
-					w = 0.5;
-					visible = false;
-				}
-				else
-					w = (level-vals[0])/(vals[2]-vals[0]);
-				y0 = (*(info.y_coords))(j);
-				y1 = (*(info.y_coords))(j+1);
-				y = y0 + (y1-y0)*w;
-			}
-			break;
-		case SIDE_TOP:
-			{
-				x0 = (*(info.x_coords))(i);
-				x1 = (*(info.x_coords))(i+1);
-				if ((vals[2] == info.uval) || (vals[3] == info.uval))
-				{
-					w = 0.5;
-					visible = false;
-				}
-				else
-					w = (level-vals[2])/(vals[3]-vals[2]);
-				x = x0 + (x1-x0)*w;
-				y = (*(info.y_coords))(j+1);
-			}
-			break;
-		case SIDE_RIGHT:
-			{
-				x = (*(info.x_coords))(i+1);
-				if ((vals[3] == info.uval) || (vals[1] == info.uval))
-				{
-					w = 0.5;
-					visible = false;
-				}
-				else
-					w = (level-vals[1])/(vals[3]-vals[1]);
-				y0 = (*(info.y_coords))(j);
-				y1 = (*(info.y_coords))(j+1);
-				y = y0 + (y1-y0)*w;
-			}
-			break;
+	if (rib < info.h_ribs) {
+		size_t j = rib / (info.nn-1);
+		return (j == 0) || (j == info.mm-1);
 	}
+	size_t i = (rib - info.h_ribs) % info.nn;
+	return (i == 0) || (i == info.nn-1);
 };
 
-inline 
-bool is_edge_rib(short s, size_t i, size_t j, size_t nn, size_t mm)
+//! calculates point of isoline on rib
+static void calc_point(const trace_info & info, REAL level, size_t rib, REAL & x, REAL & y, bool & visible)
 {
-	return (( (i == 0) && (s == SIDE_LEFT) )	|| 
-		( (i == nn-2) && (s == SIDE_RIGHT) )	||
-		( (j == 0) && (s == SIDE_BOTTOM) )	|| 
-		( (j == mm-2) && (s == SIDE_TOP) ) );
+	size_t i, j, pos0, pos1;
+	bool horz = (rib < info.h_ribs);
+	if (horz) {
+		i = rib % (info.nn-1);
+		j = rib / (info.nn-1);
+		pos0 = i + j*info.nn;
+		pos1 = pos0 + 1;
+	} else {
+		rib -= info.h_ribs;
+		i = rib % info.nn;
+		j = rib / info.nn;
+		pos0 = i + j*info.nn;
+		pos1 = pos0 + info.nn;
+	}
+	REAL val0 = node_value(info, pos0);
+	REAL val1 = node_value(info, pos1);
+	REAL w = 0.5;
+	visible = false;
+	if ((val0 != FLT_MAX) && (val1 != FLT_MAX)) {
+		w = (level-val0)/(val1-val0);
+		visible = true;
+	}
+	if (horz) {
+		REAL x0 = (*(info.x_coords))(i);
+		REAL x1 = (*(info.x_coords))(i+1);
+		x = x0 + (x1-x0)*w;
+		y = (*(info.y_coords))(j);
+	} else {
+		REAL y0 = (*(info.y_coords))(j);
+		REAL y1 = (*(info.y_coords))(j+1);
+		x = (*(info.x_coords))(i);
+		y = y0 + (y1-y0)*w;
+	}
 };
 
 inline
-void update_vals(REAL vals[4], size_t i, size_t j, trace_info & info)
+void add_rib_point(const trace_info & info, fiso * iso, size_t rib)
 {
-	size_t pos = two2one(i, j, info.nn, info.mm);
-	vals[0] = (*(info.data))(pos);
-	pos++;
-	vals[1] = (*(info.data))(pos);
-	pos += info.nn-1;
-	vals[2] = (*(info.data))(pos);
-	pos++;
-	vals[3] = (*(info.data))(pos);
+	REAL x, y;
+	bool visible;
+	calc_point(info, iso->get_level(), rib, x, y, visible);
+	iso->add_point(x, y, visible);
 };
 
-inline 
-void add_bottom_edge(fiso * iso, size_t i_from, size_t i_to, trace_info & info)
+//! part of isoline from one bound of tile to another
+struct iso_part
 {
-	REAL x0, x1, y;
-	x0 = (*(info.x_coords))(i_from);
-	x1 = (*(info.x_coords))(i_to);
-	y = (*(info.y_coords))(0);
-	iso->add_point(x0, y, i_from, 0, false);
-	iso->add_point(x1, y, i_to, 0, false);
+	fiso * iso;
+	size_t first_rib;
+	size_t last_rib;
 };
 
-inline 
-void add_top_edge(fiso * iso, size_t i_from, size_t i_to, trace_info & info)
+//! tile of cells [i0,i1) x [j0,j1) with traced isolines
+struct cntr_tile
 {
-	REAL x0, x1, y;
-	x0 = (*(info.x_coords))(i_from);
-	x1 = (*(info.x_coords))(i_to);
-	y = (*(info.y_coords))( info.y_coords->size()-1 );
-	iso->add_point(x0, y, i_from, info.y_coords->size()-1, false );
-	iso->add_point(x1, y, i_to, info.y_coords->size()-1, false );
+	size_t i0, i1, j0, j1;
+	//! isolines closed inside the tile
+	std::vector<fiso *> closed;
+	//! parts of other isolines
+	std::vector<iso_part> parts;
 };
 
-inline 
-void add_left_edge(fiso * iso, size_t j_from, size_t j_to, trace_info & info)
+//! buffers of tile tracing
+struct tile_buffers
 {
-	REAL x, y0, y1;
-	y0 = (*(info.y_coords))(j_from);
-	y1 = (*(info.y_coords))(j_to);
-	x = (*(info.x_coords))(0);
-	iso->add_point(x, y0, 0, j_from, false);
-	iso->add_point(x, y1, 0, j_to, false);
+	//! values of tile nodes
+	std::vector<REAL> vals;
+	//! crossing table: next rib of isoline for every rib of the tile (-1 for uncrossed ribs)
+	std::vector<int> next;
+	//! ribs where segments start
+	std::vector<int> starts;
 };
 
-inline 
-void add_right_edge(fiso * iso, size_t j_from, size_t j_to, trace_info & info)
+//! returns grid rib for rib of the tile
+inline
+size_t tile_rib(const trace_info & info, const cntr_tile & tile, size_t rib)
 {
-	REAL x, y0, y1;
-	y0 = (*(info.y_coords))(j_from);
-	y1 = (*(info.y_coords))(j_to);
-	x = (*(info.x_coords))( info.x_coords->size()-1 );
-	iso->add_point(x, y0, info.x_coords->size()-1, j_from, false);
-	iso->add_point(x, y1, info.x_coords->size()-1, j_to, false);
+	size_t w = tile.i1 - tile.i0;
+	size_t h = tile.j1 - tile.j0;
+	size_t h_ribs = w*(h+1);
+	if (rib < h_ribs)
+		return (tile.i0 + rib % w) + (tile.j0 + rib / w)*(info.nn-1);
+	rib -= h_ribs;
+	return info.h_ribs + (tile.i0 + rib % (w+1)) + (tile.j0 + rib / (w+1))*info.nn;
 };
 
-struct next_rib_info
+//! returns true for rib on the bound of the tile
+inline
+bool is_tile_bound(const cntr_tile & tile, size_t rib)
 {
-	size_t first_i;
-	size_t first_j;
-	size_t first_side;
+	size_t w = tile.i1 - tile.i0;
+	size_t h = tile.j1 - tile.j0;
+	size_t h_ribs = w*(h+1);
+	if (rib < h_ribs) {
+		size_t j = rib / w;
+		return (j == 0) || (j == h);
+	}
+	size_t i = (rib - h_ribs) % (w+1);
+	return (i == 0) || (i == w);
 };
 
-inline
-void finalize_iso(fiso * iso, REAL level, size_t & i, size_t & j, short & res, trace_info & info, 
-		  next_rib_info & rib_info, short end_side)
+//! follows isoline in the crossing table from rib, clearing the table
+static fiso * trace_part(const trace_info & info, const cntr_tile & tile, tile_buffers & buf,
+			 REAL level, size_t level_number, size_t rib, size_t & last_rib)
 {
-	size_t k = level_index(level, info);
-	if (k == UINT_MAX)
-		return;
-	
-	// mark cell 
-	size_t pos;
-	pos = three2one(i, j, k, info.nn, info.mm, info.levels->size());
-	info.checks->set_true(pos);
-
-	short begin_side = rib_info.first_side;
-	size_t nn = info.nn;
-	size_t mm = info.mm;
-	size_t fi = rib_info.first_i;
-	size_t fj = rib_info.first_j;
-
-	if (begin_side == SIDE_BOTTOM)
-	{
-		if (end_side ==  SIDE_LEFT)
-		{
-			add_left_edge(iso, j, mm-1,info);
-			add_top_edge(iso, 0, nn-1, info);
-			add_right_edge(iso, mm-1, 0, info);
-			add_bottom_edge(iso, nn-1, fi, info);
-		}
-		if (end_side == SIDE_TOP)
-		{
-			add_top_edge(iso, i, nn-1, info);
-			add_right_edge(iso, mm-1, 0, info);
-			add_bottom_edge(iso, nn-1, fi, info);
-		}
-		if (end_side == SIDE_RIGHT)
-		{
-			add_right_edge(iso, j, 0, info);
-			add_bottom_edge(iso, nn-1, fi, info);
-		}
-		if (end_side == SIDE_BOTTOM)
-		{
-			add_bottom_edge(iso, i, fi, info);
-		}
+	fiso * iso = new fiso(level, level_number);
+	add_rib_point(info, iso, tile_rib(info, tile, rib));
+	while (buf.next[rib] != -1) {
+		size_t next_rib = buf.next[rib];
+		buf.next[rib] = -1;
+		rib = next_rib;
+		add_rib_point(info, iso, tile_rib(info, tile, rib));
 	}
-	if (begin_side == SIDE_LEFT)
-	{
-		if (end_side == SIDE_RIGHT)
-		{
-			add_right_edge(iso, j, mm-1, info);
-			add_top_edge(iso, nn-1, 0, info);
-			add_left_edge(iso, mm-1, fj, info);
-		}
-		if (end_side == SIDE_TOP)
-		{
-			add_top_edge(iso, i, 0, info);
-			add_left_edge(iso, mm-1, fj, info);
-		}
-		if (end_side == SIDE_LEFT)
-		{
-			add_left_edge(iso, j, fj, info);
+	last_rib = tile_rib(info, tile, rib);
+	return iso;
+};
+
+//! traces all levels crossing the tile
+static void trace_tile(const trace_info & info, cntr_tile & tile, tile_buffers & buf)
+{
+	size_t w = tile.i1 - tile.i0;
+	size_t h = tile.j1 - tile.j0;
+	size_t h_ribs = w*(h+1);
+	size_t i, j, k;
+
+	buf.vals.resize((w+1)*(h+1));
+	REAL minv = FLT_MAX, maxv = -FLT_MAX;
+	for (j = 0; j <= h; j++) {
+		for (i = 0; i <= w; i++) {
+			REAL val = node_value(info, (tile.i0 + i) + (tile.j0 + j)*info.nn);
+			buf.vals[i + j*(w+1)] = val;
+			minv = MIN(minv, val);
+			maxv = MAX(maxv, val);
 		}
 	}
-	if (begin_side == SIDE_TOP)
-	{
-		if (end_side == SIDE_RIGHT)
-		{
-			add_right_edge(iso, j, 0, info);
-			add_top_edge(iso, nn-1, fi, info);
+
+	// levels crossing the tile: minv <= level < maxv
+	size_t l_from = std::lower_bound(info.levels->const_begin(), info.levels->const_end(), minv) - info.levels->const_begin();
+	size_t l_to = std::lower_bound(info.levels->const_begin(), info.levels->const_end(), maxv) - info.levels->const_begin();
+
+	size_t l;
+	for (l = l_from; l < l_to; l++) {
+		REAL level = (*(info.levels))(l);
+
+		// crossing table
+		buf.starts.resize(0);
+		for (j = 0; j < h; j++) {
+			const REAL * row = &(buf.vals[j*(w+1)]);
+			for (i = 0; i < w; i++) {
+				int bits = 0;
+				if (row[i] > level)
+					bits |= 1;
+				if (row[i+1] > level)
+					bits |= 2;
+				if (row[i+w+1] > level)
+					bits |= 4;
+				if (row[i+w+2] > level)
+					bits |= 8;
+				if ((bits == 0) || (bits == 15))
+					continue;
+
+				int ribs[4];
+				ribs[SIDE_BOTTOM] = (int)(i + j*w);
+				ribs[SIDE_TOP] = (int)(i + (j+1)*w);
+				ribs[SIDE_LEFT] = (int)(h_ribs + i + j*(w+1));
+				ribs[SIDE_RIGHT] = ribs[SIDE_LEFT] + 1;
+
+				const short * segs = cell_segments[bits];
+				for (k = 0; (k < 4) && (segs[k] != -1); k += 2) {
+					int from = ribs[segs[k]];
+					buf.next[from] = ribs[segs[k+1]];
+					buf.starts.push_back(from);
+				}
+			}
 		}
-		if (end_side == SIDE_TOP)
-		{
-			add_top_edge(iso, i, fi, info);
+
+		// parts of isolines, coming from bounds of the tile
+		for (k = 0; k < buf.starts.size(); k++) {
+			size_t rib = buf.starts[k];
+			if ((buf.next[rib] == -1) || !is_tile_bound(tile, rib))
+				continue;
+			iso_part part;
+			part.first_rib = tile_rib(info, tile, rib);
+			part.iso = trace_part(info, tile, buf, level, l, rib, part.last_rib);
+			tile.parts.push_back(part);
 		}
-	}
-	if (begin_side == SIDE_RIGHT)
-	{
-		if (end_side == SIDE_RIGHT)
-		{
-			add_right_edge(iso, j, fj, info);
+
+		// the rest are closed inside the tile
+		for (k = 0; k < buf.starts.size(); k++) {
+			size_t rib = buf.starts[k];
+			if (buf.next[rib] == -1)
+				continue;
+			size_t last_rib;
+			tile.closed.push_back( trace_part(info, tile, buf, level, l, rib, last_rib) );
 		}
 	}
+};
 
-	// add first point
-	i = rib_info.first_i;
-	j = rib_info.first_j;
-	REAL x, y;
-	bool vis;
-	iso->get_point(0, x, y, vis);
-	iso->add_point(x, y, i, j, false);
-	
-	res = rib_info.first_side;
-	
+//! traces tiles [from, to)
+static void trace_tiles(const trace_info & info, std::vector<cntr_tile> & tiles, size_t from, size_t to)
+{
+	tile_buffers buf;
+	buf.next.assign(2*CNTR_TILE_X*CNTR_TILE_Y + CNTR_TILE_X + CNTR_TILE_Y, -1);
+	size_t t;
+	for (t = from; t < to; t++)
+		trace_tile(info, tiles[t], buf);
 };
 
-inline 
-short get_next_rib(REAL level, 
-		   short side, 
-		   size_t & i, size_t & j, 
-		   REAL vals[4], 
-		   trace_info & info, 
-		   bool closed, 
-		   bool & need_add, 
-		   fiso * iso, 
-		   next_rib_info & rib_info)
+#ifdef HAVE_THREADS
+struct cntr_trace_job : public job
 {
-	need_add = true;
-	short res = side;
-	short sx = 0, sy = 0;
-	switch (side)
+	cntr_trace_job()
 	{
-	case SIDE_BOTTOM:
-		{
-			if (check_level_intersection( vals[0], vals[3], level, info.uval ))
-			{
-				if (check_level_intersection(vals[0], vals[2], level, info.uval))
-				{
-					res = SIDE_RIGHT;
-					sx = -1;
-				}
-				else
-				{
-					res = SIDE_BOTTOM;
-					sy = 1;
-				}
-			} 
-			else 
-			{
-				res = SIDE_LEFT;
-				sx = 1;
-			}
-		};
-		break;
-	case SIDE_LEFT:
-		{
-			if (check_level_intersection( vals[0], vals[3], level, info.uval ))
-			{
-				if (check_level_intersection(vals[0], vals[1], level, info.uval))
-				{
-					res = SIDE_TOP;
-					sy = -1;
-				}
-				else
-				{
-					res = SIDE_LEFT;
-					sx = 1;
-				}
-			}
-			else 
-			{
-				res = SIDE_BOTTOM;
-				sy = 1;
-			}
-		};
-		break;
-	case SIDE_TOP:
-		{
-			if (check_level_intersection( vals[0], vals[3], level, info.uval ))
-			{
-				if (check_level_intersection( vals[1], vals[3], level, info.uval ))
-				{
-					res = SIDE_LEFT;
-					sx = 1;
-				}
-				else
-				{
-					res = SIDE_TOP;
-					sy = -1;
-				}
-			}
-			else
-			{
-				res = SIDE_RIGHT;
-				sx = -1;
-			}
-
-		};
-		break;
-	case SIDE_RIGHT:
-		{
-			if (check_level_intersection( vals[0], vals[3], level, info.uval ))
-			{
-				if (check_level_intersection( vals[2], vals[3], level, info.uval ))
-				{
-					res = SIDE_BOTTOM;
-					sy = 1;
-				}
-				else
-				{
-					res = SIDE_RIGHT;
-					sx = -1;
-				}
-			}
-			else
-			{
-				res = SIDE_TOP;
-				sy = -1;
-			}
-		};
-		break;
+		info = NULL;
+		tiles = NULL;
+		from = 0;
+		to = 0;
 	};
-
-	// check for bound
-	short oside = opp_side[res];
-	if ( is_edge_rib(oside, i, j, info.nn, info.mm) )
+	void set(const trace_info * iinfo, std::vector<cntr_tile> * itiles, size_t ifrom, size_t ito)
 	{
-		if (closed)
-		{
-			need_add = false;
-			return SHRT_MAX;
-		}
-		else 
-		{
-			if (info.close_on_bound)
-				finalize_iso(iso, level, i, j, res, info, rib_info, oside);
-			else {
-				REAL x, y;
-				bool visible;
-				calc_point(level, oside, i, j, vals, info, x, y, visible);
-				iso->add_point(x,y,i,j,visible);
-			}
-			need_add = false;
-			return res;
-		}
-	}
-	else
+		info = iinfo;
+		tiles = itiles;
+		from = ifrom;
+		to = ito;
+	};
+	virtual void do_job()
 	{
-		i += sx;
-		j += sy;
-		update_vals(vals, i, j, info);
-	}
+		trace_tiles(*info, *tiles, from, to);
+	};
 
-	return res;
+	const trace_info * info;
+	std::vector<cntr_tile> * tiles;
+	size_t from, to;
 };
 
-REAL get_fill_level(REAL level, short side, size_t i, size_t j, trace_info & info)
+cntr_trace_job cntr_trace_jobs[MAX_CPU];
+#endif
+
+//! traced isoline
+struct traced_iso
 {
-	size_t k = level_index(level, info);
-	
-	bool inc = 0;
-	if (side == SIDE_LEFT)
-		j++;
-	if (side == SIDE_BOTTOM)
-		i++;
-	if ((side == SIDE_RIGHT) || (side == SIDE_TOP))
+	fiso * iso;
+	size_t first_rib;
+	size_t last_rib;
+	bool closed;
+	//! polygon area (for close_on_bound)
+	REAL area;
+	//! true if polygon is on the higher side of isoline
+	bool high;
+};
+
+//! part starting at rib
+struct part_key
+{
+	size_t level_number;
+	size_t rib;
+	size_t part;
+	bool operator<(const part_key & key) const
 	{
-		i++;
-		j++;
-	}
+		if (level_number != key.level_number)
+			return level_number < key.level_number;
+		return rib < key.rib;
+	};
+};
 
-	size_t pos;
-	pos = two2one(i, j, info.nn, info.mm);
-	REAL check_val = (*(info.data))(pos);
-	int l_cnt = info.levels->size();
-	REAL added_level = (*(info.levels))(l_cnt-1);
+//! returns part, starting at rib, or UINT_MAX
+static size_t find_part(const std::vector<part_key> & keys, size_t level_number, size_t rib)
+{
+	part_key key;
+	key.level_number = level_number;
+	key.rib = rib;
+	key.part = UINT_MAX;
+	std::vector<part_key>::const_iterator it = std::lower_bound(keys.begin(), keys.end(), key);
+	if ((it == keys.end()) || (it->level_number != level_number) || (it->rib != rib))
+		return UINT_MAX;
+	return it->part;
+};
 
-	if ( cmp_vals(check_val, level, info.uval) )
-	{
-		if (k == l_cnt - 1) {
-			return added_level;
-		} else {
-			if (((*(info.levels))(k+1) == added_level) && (check_val > added_level))
-				return FLT_MAX;
-			return ((*(info.levels))(k) + (*(info.levels))(k+1) ) / 2.;
+//! joins parts of isolines across bounds of tiles
+static void stitch_parts(const trace_info & info, std::vector<cntr_tile> & tiles, std::vector<traced_iso> & res)
+{
+	std::vector<iso_part> parts;
+	size_t t, p;
+	for (t = 0; t < tiles.size(); t++) {
+		cntr_tile & tile = tiles[t];
+		for (p = 0; p < tile.closed.size(); p++) {
+			traced_iso iso;
+			iso.iso = tile.closed[p];
+			iso.first_rib = UINT_MAX;
+			iso.last_rib = UINT_MAX;
+			iso.closed = true;
+			res.push_back(iso);
 		}
+		parts.insert(parts.end(), tile.parts.begin(), tile.parts.end());
 	}
-	else
-	{
-		if (k == 0) {
-			return (*(info.levels))(k) / 2.;
-		} else {
-			return ((*(info.levels))(k) + (*(info.levels))(k-1) ) / 2.;
+
+	std::vector<part_key> keys(parts.size());
+	for (p = 0; p < parts.size(); p++) {
+		keys[p].level_number = parts[p].iso->get_level_number();
+		keys[p].rib = parts[p].first_rib;
+		keys[p].part = p;
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<bool> used(parts.size(), false);
+	size_t pass;
+	// isolines from grid bounds first, then closed ones
+	for (pass = 0; pass < 2; pass++) {
+		for (p = 0; p < parts.size(); p++) {
+			if (used[p])
+				continue;
+			if ((pass == 0) && !is_bound_rib(info, parts[p].first_rib))
+				continue;
+			used[p] = true;
+			traced_iso iso;
+			iso.iso = parts[p].iso;
+			iso.first_rib = parts[p].first_rib;
+			iso.last_rib = parts[p].last_rib;
+			iso.closed = (pass == 1);
+			size_t level_number = iso.iso->get_level_number();
+			while (!is_bound_rib(info, iso.last_rib)) {
+				size_t q = find_part(keys, level_number, iso.last_rib);
+				if ((q == UINT_MAX) || used[q])
+					break;
+				used[q] = true;
+				iso.iso->append(parts[q].iso, 1);
+				delete parts[q].iso;
+				iso.last_rib = parts[q].last_rib;
+			}
+			res.push_back(iso);
 		}
 	}
-	
-	return FLT_MAX;
-
 };
 
-fiso * trace_isoline(REAL level, short side, size_t i, size_t j, 
-		     REAL vals[4],  trace_info & info, bool closed)
+//! position of bound rib along the grid bound (counterclockwise, from node (0,0))
+static size_t bound_pos(const trace_info & info, size_t rib)
 {
-
-	bool need_add;
-	REAL x,y;
-	bool visible;
-	short curr_side = side;
-	next_rib_info rib_info;
-	rib_info.first_i = i;
-	rib_info.first_j = j;
-	rib_info.first_side = side;
-	size_t level_number = level_index(level, info);
-
-	fiso * iso = new fiso(level, level_number, info.levels->size(), info.checks, info.nn, info.mm);
-
-	// find first point
-	calc_point(level, side, i, j, vals, info, x, y, visible);
-	iso->add_point(x,y, i, j, visible);
-
-	if (info.close_on_bound)
-	{
-		REAL fill_level = get_fill_level(level, side, i, j, info);
-		iso->set_fill_level(fill_level);
+	size_t nn = info.nn, mm = info.mm;
+	if (rib < info.h_ribs) {
+		size_t i = rib % (nn-1);
+		if (rib / (nn-1) == 0)
+			return i; // bottom
+		return (nn-1) + (mm-1) + (nn-2-i); // top
 	}
+	rib -= info.h_ribs;
+	size_t j = rib / nn;
+	if (rib % nn == nn-1)
+		return (nn-1) + j; // right
+	return 2*(nn-1) + (mm-1) + (mm-2-j); // left
+};
 
-	// find second point
-	curr_side = get_next_rib(level, side, i, j, vals, info, closed, need_add, iso, rib_info);
-	calc_point(level, curr_side, i, j, vals, info, x, y, visible);
-	iso->add_point(x,y,i,j,visible);
-
-	// find the rest
-	while ( !( rib_info.first_i == i && rib_info.first_j == j && curr_side == side) )
-	{
-		short prev_side = curr_side;
-		size_t prev_i = i, prev_j = j;
-		curr_side = get_next_rib(level, curr_side, i, j, vals, info, closed, need_add, iso, rib_info);
-		if (!need_add)
-			break;
-
-		if (curr_side == SHRT_MAX) {
-			delete iso;
-			return NULL;
-		}
-
-		calc_point(level, curr_side, i, j, vals, info, x, y, visible);
- 		iso->add_point(x,y,i,j,visible);
-		if (closed == false) {
-			// BOTTOM
-			if ( ((curr_side == SIDE_LEFT) || (curr_side == SIDE_RIGHT)) && (j == 0))
-			{
-				if (prev_side == SIDE_TOP)
-				{
-					size_t pos = three2one(prev_i, prev_j, level_number, info.nn, info.mm, info.levels->size());
-					info.checks->set_false(pos);
-					continue;
-				}
-			}
-			// LEFT
-			if ( ((curr_side == SIDE_TOP) || (curr_side == SIDE_BOTTOM)) && (i == 0))
-			{
-				if (prev_side == SIDE_RIGHT)
-				{
-					size_t pos = three2one(prev_i, prev_j, level_number, info.nn, info.mm, info.levels->size());
-					info.checks->set_false(pos);
-					continue;
-				}
-			}
-			// TOP
-			if ( ((curr_side == SIDE_LEFT) || (curr_side == SIDE_RIGHT)) && (j == info.mm-1))
-			{
-				if (prev_side == SIDE_BOTTOM)
-				{
-					size_t pos = three2one(prev_i, prev_j, level_number, info.nn, info.mm, info.levels->size());
-					info.checks->set_false(pos);
-					continue;
-				}
-			}
-			// RIGHT
-			if ( ((curr_side == SIDE_TOP) || (curr_side == SIDE_BOTTOM)) && (i == info.nn-1))
-			{
-				if (prev_side == SIDE_LEFT)
-				{
-					size_t pos = three2one(prev_i, prev_j, level_number, info.nn, info.mm, info.levels->size());
-					info.checks->set_false(pos);
-					continue;
-				}
-			}
+//! returns grid corners passed along the bound from last to first point of isoline
+static void bound_corners(const trace_info & info, const traced_iso & iso, bool ccw, std::vector<size_t> & corners)
+{
+	size_t nn = info.nn, mm = info.mm;
+	size_t perimeter = 2*(nn-1) + 2*(mm-1);
+	size_t pos[4] = { 0, nn-1, (nn-1) + (mm-1), 2*(nn-1) + (mm-1) };
+	size_t p_first = bound_pos(info, iso.first_rib);
+	size_t p_last = bound_pos(info, iso.last_rib);
+
+	std::vector< std::pair<size_t, size_t> > passed;
+	size_t k;
+	for (k = 0; k < 4; k++) {
+		size_t dist, len;
+		if (ccw) {
+			dist = (pos[k] + perimeter - p_last) % perimeter;
+			len = (p_first + perimeter - p_last) % perimeter;
+			if ((dist > 0) && (dist <= len))
+				passed.push_back( std::pair<size_t, size_t>(dist, k) );
+		} else {
+			dist = (p_last + perimeter - pos[k]) % perimeter;
+			len = (p_last + perimeter - p_first) % perimeter;
+			if (dist < len)
+				passed.push_back( std::pair<size_t, size_t>(dist, k) );
 		}
 	}
+	std::sort(passed.begin(), passed.end());
+	corners.resize(0);
+	for (k = 0; k < passed.size(); k++)
+		corners.push_back(passed[k].second);
+};
 
-	update_vals(vals, rib_info.first_i, rib_info.first_j, info);
-
-	return iso;
+//! returns doubled signed area of points
+static REAL doubled_area(const std::vector<REAL> & x, const std::vector<REAL> & y)
+{
+	REAL res = 0;
+	size_t k, cnt = x.size();
+	for (k = 0; k < cnt; k++) {
+		size_t n = (k+1 == cnt) ? 0 : k+1;
+		res += x[k]*y[n] - x[n]*y[k];
+	}
+	return res;
 };
 
-fiso * trace_bound_rect(trace_info & info)
+//! value for filling area between levels band-1 and band
+static REAL band_fill(const vec * levels, size_t band)
 {
-	REAL val = (*(info.data))(0);
-        fiso * iso = NULL;
-	REAL level;
-	size_t level_number;
-	vec::iterator it;
+	size_t l_cnt = levels->size();
+	if (band >= l_cnt)
+		return FLT_MAX; // undefined area
+	if (band == 0) {
+		REAL step = (l_cnt > 2) ? (*levels)(1) - (*levels)(0) : REAL(1);
+		return (*levels)(0) - step/REAL(2);
+	}
+	return ((*levels)(band-1) + (*levels)(band))/REAL(2);
+};
 
-	if (val == info.uval)
-		goto ret_bound_iso_null;
-
-	it = std::lower_bound(info.levels->begin(), info.levels->end(), val);
-	if (it == info.levels->end())
-		goto ret_bound_iso_null;
-	
-	level = *it;
-	level_number = it - info.levels->begin();
-        iso = new fiso(level, UINT_MAX, info.levels->size(), info.checks, info.nn, info.mm);
-	iso->set_fill_level(val, true);
-
-	add_bottom_edge(iso, 0, info.nn-1, info);
-	add_right_edge(iso, 0, info.mm-1, info);
-	add_top_edge(iso, info.nn-1, 0, info);
-	add_left_edge(iso, info.mm-1, 0, info);
-	
-ret_bound_iso_null:
-	return iso;
+//! isolines are painted from larger polygons to smaller ones
+struct paint_order
+{
+	REAL area_eps;
+	bool operator()(const traced_iso & a, const traced_iso & b) const
+	{
+		REAL area_a = floor(a.area/area_eps);
+		REAL area_b = floor(b.area/area_eps);
+		if (area_a != area_b)
+			return area_a > area_b;
+		// polygons on the same place: inner one has higher (lower) level
+		REAL key_a = a.high ? REAL(a.iso->get_level_number()) : -REAL(a.iso->get_level_number());
+		REAL key_b = b.high ? REAL(b.iso->get_level_number()) : -REAL(b.iso->get_level_number());
+		return key_a < key_b;
+	};
 };
 
-bool add_isoline(fiso * iso, std::vector<fiso *> * isos)
+struct level_order
 {
-	if (isos->size() > 0)
+	bool operator()(const traced_iso & a, const traced_iso & b) const
 	{
-		fiso * prev_iso = (*isos)[ isos->size() - 1 ];
-		if (prev_iso->get_level() == iso->get_level())
-		if (prev_iso->size() == iso->size())
-		{
-			if (prev_iso->get_checksum() == iso->get_checksum()) // isolines are the same
-			{
-				delete prev_iso;
-				(*isos)[ isos->size() - 1 ] = iso;
-				return true;
+		return a.iso->get_level_number() < b.iso->get_level_number();
+	};
+};
+
+//! closes isolines along the grid bound and sets fill levels
+static void close_isos(const trace_info & info, std::vector<traced_iso> & isos, std::vector<fiso *> * res)
+{
+	REAL cx[4], cy[4];
+	cx[0] = (*(info.x_coords))(0);
+	cy[0] = (*(info.y_coords))(0);
+	cx[2] = (*(info.x_coords))(info.nn-1);
+	cy[2] = (*(info.y_coords))(info.mm-1);
+	cx[1] = cx[2]; cy[1] = cy[0];
+	cx[3] = cx[0]; cy[3] = cy[2];
+	REAL rect_area = (cx[2]-cx[0])*(cy[2]-cy[0]);
+
+	std::vector<REAL> x, y;
+	std::vector<size_t> ccw_corners, cw_corners;
+	size_t q, k;
+	for (q = 0; q < isos.size(); q++) {
+		traced_iso & iso = isos[q];
+		fiso * f = iso.iso;
+		x.assign(f->x_begin(), f->x_end());
+		y.assign(f->y_begin(), f->y_end());
+		size_t level_number = f->get_level_number();
+
+		if (iso.closed) {
+			REAL area = doubled_area(x, y)/REAL(2);
+			iso.high = (area > 0);
+			iso.area = fabs(area);
+		} else {
+			// polygon with counterclockwise bound is on the left (higher) side of isoline
+			bound_corners(info, iso, true, ccw_corners);
+			for (k = 0; k < ccw_corners.size(); k++) {
+				x.push_back(cx[ccw_corners[k]]);
+				y.push_back(cy[ccw_corners[k]]);
+			}
+			REAL area = doubled_area(x, y)/REAL(2);
+			// the smaller part is taken, so polygons are nested or disjoint
+			iso.high = (area <= rect_area - area);
+			iso.area = iso.high ? area : rect_area - area;
+			if (iso.high) {
+				for (k = 0; k < ccw_corners.size(); k++)
+					f->add_point(cx[ccw_corners[k]], cy[ccw_corners[k]], false);
+			} else {
+				bound_corners(info, iso, false, cw_corners);
+				for (k = 0; k < cw_corners.size(); k++)
+					f->add_point(cx[cw_corners[k]], cy[cw_corners[k]], false);
 			}
+			REAL px, py;
+			bool visible;
+			f->get_point(0, px, py, visible);
+			f->add_point(px, py, false);
 		}
+		f->set_fill_level( band_fill(info.levels, iso.high ? level_number+1 : level_number), true );
 	}
-	if (iso->size() > 0)
-	{
-		isos->push_back(iso);
-		return true;
-	}
-	else
-	{
-		delete iso;
-		return false;
+
+	paint_order order;
+	order.area_eps = (rect_area > 0) ? rect_area*1e-9 : REAL(1);
+	std::stable_sort(isos.begin(), isos.end(), order);
+
+	// area outside of all polygons
+	size_t band;
+	if (isos.size() > 0) {
+		size_t level_number = isos[0].iso->get_level_number();
+		band = isos[0].high ? level_number : level_number+1;
+	} else {
+		REAL val = node_value(info, 0);
+		band = std::lower_bound(info.levels->const_begin(), info.levels->const_end(), val) - info.levels->const_begin();
 	}
+
+	size_t l_cnt = info.levels->size();
+	fiso * bound = new fiso((*(info.levels))(MIN(band, l_cnt-1)), UINT_MAX, 5);
+	bound->set_fill_level(band_fill(info.levels, band), true);
+	for (k = 0; k < 5; k++)
+		bound->add_point(cx[k%4], cy[k%4], false);
+	res->push_back(bound);
 };
 
-std::vector<fiso *> * trace_isos(vec * levels,
-				 vec * x_coords,
-				 vec * y_coords,
-				 extvec * data,
+std::vector<fiso *> * trace_isos(const vec * levels,
+				 const vec * x_coords,
+				 const vec * y_coords,
+				 const extvec * data,
 				 size_t nn, size_t mm,
 				 REAL uval,
 				 bool close_on_bound)
 {
 	if (levels->size() == 0)
 		return NULL;
-	size_t pos;
-	size_t i,j; // for navigating inside matrix
-	size_t l; // for levels
-	REAL level; // current level;
-	bool swap_order;
 
-	REAL added_level = (*levels)(levels->size()-1) + FLT_MAX/2.;
-	levels->push_back(added_level);
-	size_t l_cnt = levels->size();
+	std::vector<fiso *> * res = new std::vector<fiso *>();
+	if ((nn < 2) || (mm < 2))
+		return res;
 
-        bitvec * checks = create_bitvec( l_cnt*nn*mm );
-	checks->init_false();
-	std::vector<fiso *> * isos = new std::vector<fiso *>();
-	vec * bugged_levels = create_vec(*levels);
+	vec * all_levels = create_vec(*levels);
+	REAL added_level = (*levels)(levels->size()-1) + FLT_MAX/2.;
+	all_levels->push_back(added_level);
 
 	trace_info info;
-	info.levels = levels;
+	info.levels = all_levels;
 	info.x_coords = x_coords;
 	info.y_coords = y_coords;
 	info.data = data;
 	info.nn = nn;
 	info.mm = mm;
-	info.uval = FLT_MAX;
-	info.checks = checks;
-	info.close_on_bound = close_on_bound;
-
-	for (pos = 0; pos < bugged_levels->size(); pos++)
-	{
-		REAL lev = (*bugged_levels)(pos);
-		REAL bugged_level = bug_value(lev);
-		(*bugged_levels)(pos) = bugged_level;
+	info.uval = uval;
+	info.h_ribs = (nn-1)*mm;
+
+	std::vector<cntr_tile> tiles;
+	size_t i, j;
+	for (j = 0; j < mm-1; j += CNTR_TILE_Y) {
+		for (i = 0; i < nn-1; i += CNTR_TILE_X) {
+			cntr_tile tile;
+			tile.i0 = i;
+			tile.i1 = MIN(nn-1, i + CNTR_TILE_X);
+			tile.j0 = j;
+			tile.j1 = MIN(mm-1, j + CNTR_TILE_Y);
+			tiles.push_back(tile);
+		}
 	}
 
-	vec::iterator it;
-	for (pos = 0; pos < nn*mm; pos++)
-	{
-		REAL val = (*data)(pos);
-		if (val == uval)
-		{
-			if (uval != FLT_MAX)
-				(*data)(pos) = FLT_MAX;
-			continue;
-		}
-		it = std::lower_bound(levels->begin(), levels->end(), val);
-		if (it != levels->end())
-		{
-			if (*it == val)
-			{
-				int dpos = it-levels->begin();
-				REAL bugged_value = (*bugged_levels)(it-levels->begin());
-				(*data)(pos) = bugged_value;
-			}
+#ifdef HAVE_THREADS
+	size_t threads = sstuff_get_threads();
+	if ((threads == 1) || (nn*mm < CNTR_THREADS_MIN)) {
+#endif
+		trace_tiles(info, tiles, 0, tiles.size());
+#ifdef HAVE_THREADS
+	} else {
+		threads = MIN(threads, tiles.size());
+		size_t step = tiles.size() / threads;
+		size_t ost = tiles.size() % threads;
+		size_t from = 0;
+		size_t t;
+		for (t = 0; t < threads; t++) {
+			size_t to = from + step + ((t < ost) ? 1 : 0);
+			cntr_trace_job & f = cntr_trace_jobs[t];
+			f.set(&info, &tiles, from, to);
+			set_job(&f, t);
+			from = to;
 		}
+		do_jobs();
 	}
+#endif
+
+	std::vector<traced_iso> isos;
+	stitch_parts(info, tiles, isos);
+
+	if (close_on_bound)
+		close_isos(info, isos, res);
+	else
+		std::stable_sort(isos.begin(), isos.end(), level_order());
+
+	size_t q;
+	for (q = 0; q < isos.size(); q++)
+		res->push_back(isos[q].iso);
+
+	all_levels->release();
+	return res;
+};
+
+//! point of isoline
+struct iso_point_ref
+{
+	size_t iso;
+	size_t pos;
+};
+
+//! points of isolines sorted into square buckets
+struct iso_points_index
+{
+	REAL x0, y0, step;
+	size_t nx, ny;
+	//! points of bucket k are points[first[k]] ... points[first[k+1]-1]
+	std::vector<size_t> first;
+	std::vector<iso_point_ref> points;
+};
+
+inline
+size_t bucket_x(const iso_points_index & index, REAL x)
+{
+	if (x <= index.x0)
+		return 0;
+	return MIN(index.nx-1, (size_t)((x - index.x0)/index.step));
+};
+
+inline
+size_t bucket_y(const iso_points_index & index, REAL y)
+{
+	if (y <= index.y0)
+		return 0;
+	return MIN(index.ny-1, (size_t)((y - index.y0)/index.step));
+};
 
-	bugged_levels->release();
-	bugged_levels = NULL;
-
-	uval = FLT_MAX;
-		
-	//
-	//        val2   val3
-	//          o-----o
-	//	    |\   /|
-	//          | \ / |
-	//          |  o val4
-	//          | / \ |
-	//          |/   \|
-	//          o-----o
-	//         val0   val1
-	//
-	REAL vals[4];
-
-	if (close_on_bound == true) {
-		fiso * iso = trace_bound_rect(info);
-		if (iso) {
-			add_isoline(iso, isos);
+static void build_index(const std::vector<fiso *> * isos, REAL tolerance, iso_points_index & index)
+{
+	REAL minx = FLT_MAX, maxx = -FLT_MAX, miny = FLT_MAX, maxy = -FLT_MAX;
+	size_t total = 0;
+	size_t q, p;
+	for (q = 0; q < isos->size(); q++) {
+		const fiso * iso = (*isos)[q];
+		if (iso->get_level_number() == UINT_MAX)
+			continue;
+		for (p = 0; p < iso->size(); p++) {
+			REAL x = (*(iso->x))(p), y = (*(iso->y))(p);
+			minx = MIN(minx, x);
+			maxx = MAX(maxx, x);
+			miny = MIN(miny, y);
+			maxy = MAX(maxy, y);
 		}
+		total += iso->size();
 	}
-	
-	// trace isolines starting from bounds
-        
-	size_t isos_cnt = isos->size();
-	// bottom
-	// find appropriate bottom line
-	bool founded = false;
-	size_t min_j;
-	for (min_j = 0; min_j < mm-1; min_j++) 
-	{
-		for (i = 0; i < nn-1; i++)
-		{
-			if ( (*data)(i +min_j*nn) != uval ) {
-				founded = true;
-				break;
-			}
-		}
-		if (founded)
-			break;
+
+	index.x0 = minx;
+	index.y0 = miny;
+	// about 4 points per bucket
+	REAL w = MAX(maxx - minx, REAL(0));
+	REAL h = MAX(maxy - miny, REAL(0));
+	index.step = MAX(tolerance, (REAL)sqrt(4*w*h/REAL(total+1)));
+	if (index.step <= 0)
+		index.step = 1;
+	index.nx = MIN((size_t)(w/index.step) + 1, (size_t)4096);
+	index.ny = MIN((size_t)(h/index.step) + 1, (size_t)4096);
+	index.step = MAX(index.step, MAX(w/REAL(index.nx), h/REAL(index.ny)));
+
+	index.first.assign(index.nx*index.ny + 1, 0);
+	for (q = 0; q < isos->size(); q++) {
+		const fiso * iso = (*isos)[q];
+		if (iso->get_level_number() == UINT_MAX)
+			continue;
+		for (p = 0; p < iso->size(); p++)
+			index.first[ bucket_x(index, (*(iso->x))(p)) + bucket_y(index, (*(iso->y))(p))*index.nx + 1 ]++;
 	}
-	
-	j = min_j;
-	for (i = 0; i < nn-1; i++) 
-	{
-		update_vals(vals, i, j, info);
-		
-		if ((vals[0] == uval) && (vals[1] == uval))
+	size_t k;
+	for (k = 1; k < index.first.size(); k++)
+		index.first[k] += index.first[k-1];
+
+	index.points.resize(total);
+	std::vector<size_t> fill(index.first.begin(), index.first.end()-1);
+	for (q = 0; q < isos->size(); q++) {
+		const fiso * iso = (*isos)[q];
+		if (iso->get_level_number() == UINT_MAX)
 			continue;
-
-		swap_order = cmp_vals(vals[0], vals[1], uval);
-		if (swap_order) {
-			for (l = l_cnt-1; l >= 0; l--) {
-				pos = three2one(i, j, l, info.nn, info.mm, l_cnt);
-				if ( info.checks->get(pos) == true ) {
-					if (l == 0)
-						break;
-					continue;
-				}
-				level = (*levels)(l);
-				if (check_level_intersection(vals[0], vals[1], level, uval))
-				{
-					fiso * iso = trace_isoline(level, SIDE_BOTTOM, i, j, vals, info, false);
-					add_isoline(iso, isos);
-				}
-				if (l == 0)
-					break;
-			}
-		} else {
-			for (l = 0; l < l_cnt; l++) {
-				pos = three2one(i, j, l, info.nn, info.mm, l_cnt);
-				if ( info.checks->get(pos) == true ) 
-					continue;
-				level = (*levels)(l);
-				if (check_level_intersection(vals[0], vals[1], level, uval))
-				{
-					fiso * iso = trace_isoline(level, SIDE_BOTTOM, i, j, vals, info, false);
-					add_isoline(iso, isos);
-				}
-			}
+		for (p = 0; p < iso->size(); p++) {
+			size_t b = bucket_x(index, (*(iso->x))(p)) + bucket_y(index, (*(iso->y))(p))*index.nx;
+			iso_point_ref & ref = index.points[ fill[b]++ ];
+			ref.iso = q;
+			ref.pos = p;
 		}
 	}
+};
 
+//! distance from point (px,py) to segment (ax,ay)-(bx,by)
+inline
+REAL segment_dist(REAL px, REAL py, REAL ax, REAL ay, REAL bx, REAL by)
+{
+	REAL dx = bx - ax, dy = by - ay;
+	REAL len2 = dx*dx + dy*dy;
+	REAL t = 0;
+	if (len2 > 0)
+		t = MAX(REAL(0), MIN(REAL(1), ((px-ax)*dx + (py-ay)*dy)/len2));
+	REAL ex = ax + t*dx - px, ey = ay + t*dy - py;
+	return (REAL)sqrt(ex*ex + ey*ey);
+};
 
-	// left
-	///*
-	i = 0;
-	for (j = min_j; j < mm-1; j++)
-	{
-		update_vals(vals, i, j, info);
-
-		if ((vals[0] == uval) && (vals[2] == uval))
-			continue;
-
-		swap_order = cmp_vals(vals[0], vals[2], uval);
-		if (swap_order) {
-			for (l = l_cnt-1; l >= 0; l--) {
-				pos = three2one(i, j, l, info.nn, info.mm, l_cnt);
-				if ( info.checks->get(pos) == true ) {
-					if (l == 0)
-						break;
+//! returns true if points [from, to] of isoline can be replaced with segment
+static bool free_shortcut(const std::vector<fiso *> * isos, size_t q, size_t from, size_t to, REAL dist,
+			  const iso_points_index & index)
+{
+	const fiso * iso = (*isos)[q];
+	const vec & X = *(iso->x);
+	const vec & Y = *(iso->y);
+	REAL ax = X(from), ay = Y(from);
+	REAL bx = X(to), by = Y(to);
+	size_t level_number = iso->get_level_number();
+
+	size_t i0 = bucket_x(index, MIN(ax, bx) - dist), i1 = bucket_x(index, MAX(ax, bx) + dist);
+	size_t j0 = bucket_y(index, MIN(ay, by) - dist), j1 = bucket_y(index, MAX(ay, by) + dist);
+	size_t i, j, k, p;
+	for (j = j0; j <= j1; j++) {
+		for (i = i0; i <= i1; i++) {
+			size_t b = i + j*index.nx;
+			for (k = index.first[b]; k < index.first[b+1]; k++) {
+				const iso_point_ref & ref = index.points[k];
+				if ((ref.iso == q) && (ref.pos >= from) && (ref.pos <= to))
 					continue;
-				}
-				level = (*levels)(l);
-				if (check_level_intersection(vals[0], vals[2], level, uval))
-				{
-					fiso * iso = trace_isoline(level, SIDE_LEFT, i, j, vals, info, false);
-					add_isoline(iso, isos);
-				}
-				if (l == 0)
-					break;
-			}
-		} else {
-			for (l = 0; l < l_cnt; l++) {
-				pos = three2one(i, j, l, info.nn, info.mm, l_cnt);
-				if ( info.checks->get(pos) == true ) 
+				size_t level = (*isos)[ref.iso]->get_level_number();
+				if ((level + 1 < level_number) || (level > level_number + 1))
+					continue;
+				REAL px = (*((*isos)[ref.iso]->x))(ref.pos);
+				REAL py = (*((*isos)[ref.iso]->y))(ref.pos);
+				if (((px == ax) && (py == ay)) || ((px == bx) && (py == by)))
 					continue;
-				level = (*levels)(l);
-				if (check_level_intersection(vals[0], vals[2], level, uval))
-				{
-					fiso * iso = trace_isoline(level, SIDE_LEFT, i, j, vals, info, false);
-					add_isoline(iso, isos);
+				if (segment_dist(px, py, ax, ay, bx, by) > dist)
+					continue;
+				// is point inside of polygon from points and segment?
+				bool inside = false;
+				for (p = from; p <= to; p++) {
+					size_t n = (p == to) ? from : p+1;
+					REAL yp = Y(p), yn = Y(n);
+					if ( ((yp > py) != (yn > py)) &&
+					     (px < (X(n) - X(p))*(py - yp)/(yn - yp) + X(p)) )
+						inside = !inside;
 				}
+				if (inside)
+					return false;
 			}
 		}
 	}
-	//*/
-	
-	// top
-	///*
-	j = mm-2;
-	for (i = 0; i < nn-1; i++) 
-	{
-		update_vals(vals, i, j, info);
-		
-		if ((vals[2] == uval) && (vals[3] == uval))
-			continue;
+	return true;
+};
 
-		swap_order = cmp_vals(vals[2], vals[3], uval);
-		if (swap_order) {
-			for (l = l_cnt-1; l >= 0; l--) {
-				level = (*levels)(l);
-				pos = three2one(i, j, l, info.nn, info.mm, l_cnt);
-				if ( info.checks->get(pos) == true ) {
-					if (l == 0)
-						break;
-					continue;
-				}
-				if (check_level_intersection(vals[2], vals[3], level, uval))
-				{
-					fiso * iso = trace_isoline(level, SIDE_TOP, i, j, vals, info, false);
-					add_isoline(iso, isos);
-				}
-				if (l == 0)
-					break;
-			}
-		} else {
-			for (l = 0; l < l_cnt; l++) {
-				pos = three2one(i, j, l, info.nn, info.mm, l_cnt);
-				if ( info.checks->get(pos) == true ) 
-					continue;
-				level = (*levels)(l);
-				if (check_level_intersection(vals[2], vals[3], level, uval))
-				{
-					fiso * iso = trace_isoline(level, SIDE_TOP, i, j, vals, info, false);
-					add_isoline(iso, isos);
-				}
+//! Douglas-Peucker for visible points between from and to
+static void simplify_part(const std::vector<fiso *> * isos, size_t q, size_t from, size_t to, REAL tolerance,
+			  const iso_points_index & index, std::vector<bool> & keep)
+{
+	const fiso * iso = (*isos)[q];
+	const vec & X = *(iso->x);
+	const vec & Y = *(iso->y);
+	std::vector< std::pair<size_t, size_t> > parts;
+	parts.push_back( std::pair<size_t, size_t>(from, to) );
+	while (parts.size() > 0) {
+		size_t s = parts.back().first;
+		size_t e = parts.back().second;
+		parts.pop_back();
+		if (e <= s+1)
+			continue;
+		size_t p, far_p = s+1;
+		REAL far_dist = -1;
+		for (p = s+1; p < e; p++) {
+			REAL dist = segment_dist(X(p), Y(p), X(s), Y(s), X(e), Y(e));
+			if (dist > far_dist) {
+				far_dist = dist;
+				far_p = p;
 			}
 		}
+		if ((far_dist <= tolerance) && free_shortcut(isos, q, s, e, far_dist, index))
+			continue;
+		keep[far_p] = true;
+		parts.push_back( std::pair<size_t, size_t>(s, far_p) );
+		parts.push_back( std::pair<size_t, size_t>(far_p, e) );
 	}
-	//*/
+};
 
-	// right
-	///*
-	i = nn-2;
-	for (j = min_j; j < mm-1; j++)
-	{
-		update_vals(vals, i, j, info);
+void simplify_isos(std::vector<fiso *> * isos, REAL tolerance)
+{
+	if ((isos == NULL) || !(tolerance > 0))
+		return;
 
-		if ((vals[1] == uval) && (vals[3] == uval))
+	iso_points_index index;
+	build_index(isos, tolerance, index);
+
+	// points are removed after all isolines are processed, so segments are checked against traced points
+	std::vector< std::vector<bool> > keeps(isos->size());
+	size_t q, p;
+	for (q = 0; q < isos->size(); q++) {
+		fiso * iso = (*isos)[q];
+		size_t n = iso->size();
+		std::vector<bool> & keep = keeps[q];
+		keep.assign(n, true);
+		if ((n < 3) || (iso->get_level_number() == UINT_MAX))
 			continue;
 
-		swap_order = cmp_vals(vals[1], vals[3], uval);
-		if (swap_order) {
-			for (l = l_cnt-1; l >= 0; l--) {
-				pos = three2one(i, j, l, info.nn, info.mm, l_cnt);
-				if ( info.checks->get(pos) == true ) {
-					if (l == 0)
-						break;
-					continue;
-				}
-				level = (*levels)(l);
-				if (check_level_intersection(vals[1], vals[3], level, uval))
-				{
-					fiso * iso = trace_isoline(level, SIDE_RIGHT, i, j, vals, info, false);
-					add_isoline(iso, isos);
-				}
-				if (l == 0)
-					break;
+		REAL px, py, qx, qy;
+		bool visible, prev_visible;
+		keep.assign(n, false);
+		keep[0] = true;
+		keep[n-1] = true;
+		iso->get_point(0, px, py, prev_visible);
+		for (p = 1; p < n; p++) {
+			iso->get_point(p, qx, qy, visible);
+			if (visible != prev_visible) {
+				keep[p-1] = true;
+				keep[p] = true;
 			}
-		} else {
-			for (l = 0; l < l_cnt; l++) {
-				pos = three2one(i, j, l, info.nn, info.mm, l_cnt);
-				if ( info.checks->get(pos) == true ) 
-					continue;
-				level = (*levels)(l);
-				if (check_level_intersection(vals[1], vals[3], level, uval))
-				{
-					fiso * iso = trace_isoline(level, SIDE_RIGHT, i, j, vals, info, false);
-					add_isoline(iso, isos);
+			prev_visible = visible;
+		}
+
+		// closed isoline is divided by the farthest point
+		iso->get_point(n-1, qx, qy, visible);
+		if ((px == qx) && (py == qy)) {
+			size_t far_p = 0;
+			REAL far_dist = -1;
+			for (p = 1; p < n-1; p++) {
+				iso->get_point(p, qx, qy, visible);
+				REAL dist = (qx-px)*(qx-px) + (qy-py)*(qy-py);
+				if (dist > far_dist) {
+					far_dist = dist;
+					far_p = p;
 				}
 			}
+			keep[far_p] = true;
 		}
-	}
-	//*/
-	
-	///*
-	for (j = MAX(1,min_j); j <= mm-2; j++)
-	{
-		for (i = 1; i <= nn-2; i++)
-		{
-			update_vals(vals, i, j, info);
-
-			bool check_right = (i != nn-2);
-						
-			if (check_right)
-			{
-				if ((vals[1] != uval) || (vals[3] != uval))
-				{
-					swap_order = cmp_vals(vals[1], vals[3], uval);
-					if (swap_order) {
-						for (l = l_cnt-1; l >= 0; l--) {
-							pos = three2one(i, j, l, info.nn, info.mm, l_cnt);
-							if ( info.checks->get(pos) == true ) {
-								if (l == 0)
-									break;
-								continue;
-							}
-							level = (*levels)(l);
-							if (check_level_intersection(vals[1], vals[3], level, uval))
-							{
-								fiso * iso = trace_isoline(level, SIDE_RIGHT, i, j, vals, info, true);
-								add_isoline(iso, isos);
-							}
-							if (l == 0)
-								break;
-						}
-					} else {
-						for (l = 0; l < l_cnt; l++) {
-							pos = three2one(i, j, l, info.nn, info.mm, l_cnt);
-							if ( info.checks->get(pos) == true ) 
-								continue;
-							level = (*levels)(l);
-							if (check_level_intersection(vals[1], vals[3], level, uval))
-							{
-								fiso * iso = trace_isoline(level, SIDE_RIGHT, i, j, vals, info, true);
-								add_isoline(iso, isos);
-							}
-						}
-					}
-				}
+
+		size_t from = 0;
+		for (p = 1; p < n; p++) {
+			if (!keep[p])
+				continue;
+			iso->get_point(from, px, py, visible);
+			if (visible)
+				simplify_part(isos, q, from, p, tolerance, index, keep);
+			else {
+				size_t k;
+				for (k = from+1; k < p; k++)
+					keep[k] = true;
 			}
-			
+			from = p;
 		}
 	}
-	//*/
-	checks->release();
-	return isos;
-}
 
-}; // namespace surfit
+	for (q = 0; q < isos->size(); q++)
+		(*isos)[q]->remove_points(keeps[q]);
+};
 
+}; // namespace surfit
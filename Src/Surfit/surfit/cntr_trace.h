@@ -22,7 +22,6 @@
 
 #include <vector>
 #include "../sstuff/vec.h"
-#include "../sstuff/bitvec.h"
 
 namespace surfit {
 
@@ -32,9 +31,7 @@ struct fiso
 	//! constructor 
 	fiso(REAL ilevel, 
 	     size_t ilevel_number, 
-	     size_t ilevels, 
-	     bitvec * ichecks,
-	     size_t inn, size_t imm);
+	     size_t ireserve = 0);
 
 	//! destructor
 	~fiso();
@@ -46,7 +43,13 @@ struct fiso
 	size_t get_level_number() const;
 
 	//! adds point to isoline
-	void add_point(REAL px, REAL py, size_t i, size_t j, bool visible);
+	void add_point(REAL px, REAL py, bool visible);
+
+	//! adds points of other isoline, starting from point with number from
+	void append(const fiso * iso, size_t from);
+
+	//! removes points with false keep flags
+	void remove_points(const std::vector<bool> & keep);
 
 	//! gets point from isoline by its number
 	void get_point(size_t pos, REAL & px, REAL & py, bool & visible) const;
@@ -60,9 +63,6 @@ struct fiso
 	//! sets fill value
 	void set_fill_level(REAL ival, bool force = false);
 
-	//! returns checksum
-	int get_checksum() const;
-
 	//! returns iterator for the x-coord of the first points
 	vec::iterator x_begin() const;
 	//! returns iterator 
@@ -82,40 +82,53 @@ private:
 	//! visibility flags
 	std::vector<bool> * flags;
 
-	//! optimization vector
-	bitvec * checks;
-
 	//! level number
 	size_t level_number;
 	
-	//! number of levels for isolines
-	size_t levels;
-	
-	//! number of grid cells in OX direction
-	size_t nn;
-		
-	//! number of grid cells in OY direction
-	size_t mm;
-
 	//! isoline level
 	REAL level;
 	
 	//! isoline fill level
 	REAL fill_level;
-	
-	//! checksum (for speed)
-	int checksum;
 };
 
-//! calculates isolines for surface
-std::vector<fiso *> * trace_isos(vec * levels,
-				 vec * x_coords,
-				 vec * y_coords,
-				 extvec * data,
+/*! \brief calculates isolines for surface
+    \param levels isoline levels (sorted)
+    \param x_coords X-coordinates of grid nodes
+    \param y_coords Y-coordinates of grid nodes
+    \param data values of nn x mm grid nodes
+    \param uval undefined value
+    \param close_on_bound isolines are closed along the grid bounds into polygons with fill levels
+
+    Grid cells are divided into tiles, which are traced in parallel with marching squares:
+    crossings of cells are kept in a table of the tile and joined into parts of isolines,
+    parts ending on the bounds of tiles are stitched together afterwards.
+    Undefined nodes are higher than any level, so the bound of undefined area is traced
+    with additional level (its points are invisible).
+
+    If close_on_bound is true, the first isoline is the grid bound, and each polygon
+    is the smaller part of the grid cut by the isoline. Polygons are sorted by
+    area (from the larger one), so painting them in order gives filled map.
+*/
+std::vector<fiso *> * trace_isos(const vec * levels,
+				 const vec * x_coords,
+				 const vec * y_coords,
+				 const extvec * data,
 				 size_t nn, size_t mm,
 				 REAL uval,
 				 bool close_on_bound);
 
+/*! \brief simplifies isolines with Douglas-Peucker algorithm
+    \param isos isolines
+    \param tolerance maximum distance between simplified and traced isolines
+
+    Only visible points are removed: invisible points and ends of visible parts are kept,
+    so bounds of polygons and undefined areas don't change. A segment replaces points
+    only if there are no points of isolines with the same or adjacent levels between them,
+    so simplified isolines don't cross each other.
+*/
+void simplify_isos(std::vector<fiso *> * isos, REAL tolerance);
+
 }; // namespace surfit
 
 #endif
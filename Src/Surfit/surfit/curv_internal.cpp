@@ -206,7 +206,7 @@ d_curv * _curv_load_df(datafile * df, const char * curvname) {
 	
 	while (!loaded) {
 		
-		if (df->findTag("curv")) {
+		if (df->findTag("curv", NULL, curvname)) {
 			
 			df->skipTagName();
 
@@ -24,6 +24,7 @@
 #include "../sstuff/datafile.h"
 #include "../sstuff/interp.h"
 #include "../sstuff/boolvec.h"
+#include "../sstuff/threads.h"
 
 #include "data_manager.h"
 
@@ -535,48 +536,144 @@ int surfit_manager::load_tag(datafile * df, char * tagname) const {
 	return 0;
 };
 
-bool surfit_manager::save(datafile *df) const {
-
-	size_t cnt;
-
-	if (surfit_grid) {
-		if (!_grid_save_df(surfit_grid, df))
-			return false;
+//! object types saved by surfit_manager
+enum save_type {
+	SAVE_GRID,
+	SAVE_SURF,
+	SAVE_MASK,
+	SAVE_PNTS,
+	SAVE_CNTR,
+	SAVE_CURV,
+	SAVE_AREA
+};
+
+//! object to be saved by surfit_manager
+struct save_task {
+	save_task(int itype, const void * iobj) : type(itype), obj(iobj) {};
+	//! object type (see \ref save_type)
+	int type;
+	//! object pointer
+	const void * obj;
+};
+
+//! writes object to datafile
+static bool save_object(const save_task & task, datafile * df) {
+	switch (task.type) {
+	case SAVE_GRID:
+		return _grid_save_df((d_grid *)task.obj, df);
+	case SAVE_SURF:
+		return _surf_save_df((const d_surf *)task.obj, df);
+	case SAVE_MASK:
+		return _mask_save_df((const d_mask *)task.obj, df);
+	case SAVE_PNTS:
+		return _pnts_save_df((const d_points *)task.obj, df);
+	case SAVE_CNTR:
+		return _cntr_save_df((const d_cntr *)task.obj, df);
+	case SAVE_CURV:
+		return _curv_save_df((const d_curv *)task.obj, df);
+	case SAVE_AREA:
+		return _area_save_df((const d_area *)task.obj, df);
 	}
+	return false;
+};
 
-	for (cnt = 0; cnt < surfit_surfs->size(); cnt++) {
-		d_surf * srf = *(surfit_surfs->begin()+cnt);
-		if (!_surf_save_df(srf, df))
-			return false;
-	}
+#if defined(HAVE_THREADS) && !defined(XXL)
+//! serializes one object into memory datafile
+struct save_job : public job
+{
+	save_job()
+	{
+		task = NULL;
+		mem_df = NULL;
+		res = false;
+	};
+	void set(const save_task * itask, datafile * imem_df)
+	{
+		task = itask;
+		mem_df = imem_df;
+		res = false;
+	};
+	virtual void do_job()
+	{
+		if (task)
+			res = save_object(*task, mem_df);
+	};
 
-	for (cnt = 0; cnt < surfit_masks->size(); cnt++) {
-		d_mask * srf = *(surfit_masks->begin()+cnt);
-		if (!_mask_save_df(srf, df))
-			return false;
-	}
+	const save_task * task;
+	datafile * mem_df;
+	bool res;
+};
 
-	for (cnt = 0; cnt < surfit_pnts->size(); cnt++) {
-		d_points * pnts = *(surfit_pnts->begin()+cnt);
-		if (!_pnts_save_df(pnts, df))
-			return false;
-	}
+save_job save_jobs[MAX_CPU];
+#endif
 
-	for (cnt = 0; cnt < surfit_cntrs->size(); cnt++) {
-		d_cntr * cntrline = *(surfit_cntrs->begin()+cnt);
-		if (!_cntr_save_df(cntrline, df))
-			return false;
-	}
+bool surfit_manager::save(datafile *df) const {
 
-	for (cnt = 0; cnt < surfit_curvs->size(); cnt++) {
-		d_curv * ar = *(surfit_curvs->begin()+cnt);
-		if (!_curv_save_df(ar, df))
-			return false;
+	size_t cnt;
+	std::vector<save_task> tasks;
+
+	if (surfit_grid)
+		tasks.push_back( save_task(SAVE_GRID, surfit_grid) );
+	for (cnt = 0; cnt < surfit_surfs->size(); cnt++)
+		tasks.push_back( save_task(SAVE_SURF, *(surfit_surfs->begin()+cnt)) );
+	for (cnt = 0; cnt < surfit_masks->size(); cnt++)
+		tasks.push_back( save_task(SAVE_MASK, *(surfit_masks->begin()+cnt)) );
+	for (cnt = 0; cnt < surfit_pnts->size(); cnt++)
+		tasks.push_back( save_task(SAVE_PNTS, *(surfit_pnts->begin()+cnt)) );
+	for (cnt = 0; cnt < surfit_cntrs->size(); cnt++)
+		tasks.push_back( save_task(SAVE_CNTR, *(surfit_cntrs->begin()+cnt)) );
+	for (cnt = 0; cnt < surfit_curvs->size(); cnt++)
+		tasks.push_back( save_task(SAVE_CURV, *(surfit_curvs->begin()+cnt)) );
+	for (cnt = 0; cnt < surfit_areas->size(); cnt++)
+		tasks.push_back( save_task(SAVE_AREA, *(surfit_areas->begin()+cnt)) );
+
+#if defined(HAVE_THREADS) && !defined(XXL)
+	size_t threads = sstuff_get_threads();
+	if ( (datafile_parallel == 1) && (threads > 1) && (tasks.size() > 1) ) {
+
+		writelog(LOG_MESSAGE,"saving %d objects to file %s", (int)tasks.size(), df->get_filename());
+
+		// objects are serialized by groups of "threads" objects, so only the group 
+		// is kept in memory. Log is not thread-safe and is silent while threads run.
+		int prev_loglevel = loglevel;
+		size_t from, t;
+		for (from = 0; from < tasks.size(); from += threads) {
+			size_t group = MIN(threads, tasks.size() - from);
+			for (t = 0; t < threads; t++) {
+				if (t < group) {
+					// jobs can't run other jobs, so arrays are compressed serially
+					datafile * mem_df = new datafile(df->get_filename(), DF_MODE_MEMORY);
+					mem_df->set_serial(true);
+					save_jobs[t].set(&tasks[from + t], mem_df);
+				} else
+					save_jobs[t].set(NULL, NULL);
+				set_job(&save_jobs[t], t);
+			}
+			loglevel = LOG_SILENT;
+			do_jobs();
+			loglevel = prev_loglevel;
+
+			// buffers are written in the original order, so file is the same as after serial save
+			bool res = true;
+			for (t = 0; t < group; t++) {
+				if (res && !save_jobs[t].res) {
+					writelog(LOG_ERROR, "can't save object %d to file %s", (int)(from + t), df->get_filename());
+					res = false;
+				}
+				if (res)
+					res = df->writeDatafile(save_jobs[t].mem_df);
+				delete save_jobs[t].mem_df;
+				save_jobs[t].set(NULL, NULL);
+			}
+			if (!res)
+				return false;
+		}
+		return true;
 	}
+#endif
 
-	for (cnt = 0; cnt < surfit_areas->size(); cnt++) {
-		d_area * ar = *(surfit_areas->begin()+cnt);
-		if (!_area_save_df(ar, df))
+	for (cnt = 0; cnt < tasks.size(); cnt++) {
+		if (!save_object(tasks[cnt], df))
 			return false;
 	}
 
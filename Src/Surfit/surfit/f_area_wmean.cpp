@@ -122,7 +122,7 @@ bool f_area_wmean::make_matrix_and_vector(matr *& matrix, extvec *& v, bitvec *
 		if ((ii >= aux_X_from) && (ii <= aux_X_to) && (jj >= aux_Y_from) && (jj <= aux_Y_to)) {
 			size_t I = ii-aux_X_from;
 			size_t J = jj-aux_Y_from;
-			weight = (*(w_srf->coeff))(I + J*nn);
+			weight = w_srf->getValue(I + J*nn);
 			if (weight == w_srf->undef_value)
 				weight = 0;
 		}
@@ -244,7 +244,7 @@ void f_area_wmean::mark_solved_and_undefined(bitvec * mask_solved, bitvec * mask
 			int I = ii-aux_X_from;
 			int J = jj-aux_Y_from;
 			
-			REAL weight = (*(w_srf->coeff))(I + J*nn);
+			REAL weight = w_srf->getValue(I + J*nn);
 			if (weight == w_srf->undef_value)
 				continue;
 			
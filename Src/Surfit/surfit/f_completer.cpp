@@ -627,7 +627,7 @@ size_t calcVecV(size_t size,
 
 			if (trend) {
 
-				REAL tval = (*(trend->coeff))(local_pos);
+				REAL tval = trend->getValue(local_pos);
 				if (trend_val != undef_value) {
 					size_t j, prev_j;
 					for (j = 0; j < size;) {
@@ -641,7 +641,7 @@ size_t calcVecV(size_t size,
 							prev_j = pos_x-x_from + (pos_y-y_from)*nn;
 						}
 
-						REAL tval = (*(trend->coeff))(prev_j);
+						REAL tval = trend->getValue(prev_j);
 						if (tval == trend->undef_value)
 							continue;
 						if (tval == 0)
@@ -689,7 +689,7 @@ size_t calcVecV(size_t size,
 
 			if (trend) {
 
-				REAL trend_val = (*(trend->coeff))(local_pos);
+				REAL trend_val = trend->getValue(local_pos);
 				if ((trend_val != undef_value) && (trend_val != 0)) {
 					for (j = 0; j < T->rows();) {
 						size_t prev_j = j;
@@ -246,7 +246,7 @@ void f_mask_wmean::mark_solved_and_undefined(bitvec * mask_solved, bitvec * mask
 			int I = ii-aux_X_from;
 			int J = jj-aux_Y_from;
 			
-			REAL weight = (*(w_srf->coeff))(I + J*nn);
+			REAL weight = w_srf->getValue(I + J*nn);
 			if (weight == w_srf->undef_value)
 				continue;
 			
@@ -33,6 +33,7 @@
 #include "variables.h"
 
 #include "points.h"
+#include "pnts_morton.h"
 #include "grid_user.h"
 
 namespace surfit {
@@ -47,6 +48,9 @@ functional("f_points", F_USUAL)
 	f_sub_pnts = NULL;
 	mask = NULL;
 	binded_grid = NULL;
+	morton = NULL;
+	cells = NULL;
+	cells_values = NULL;
 	print_name = NULL;
 	if (iprint_name != NULL)
 		print_name = strdup(iprint_name);
@@ -74,6 +78,17 @@ void f_points::cleanup() {
 	if (binded_grid)
 		binded_grid->release();
 	binded_grid = NULL;
+
+	if (morton)
+		morton->release();
+	morton = NULL;
+
+	delete cells;
+	cells = NULL;
+
+	if (cells_values)
+		cells_values->release();
+	cells_values = NULL;
 };
 
 int f_points::this_get_data_count() const {
@@ -125,10 +140,6 @@ bool f_points::minimize() {
 
 bool f_points::make_matrix_and_vector(matr *& matrix, extvec *& v, bitvec * mask_solved, bitvec * mask_undefined) {
 
-	if (f_sub_pnts == NULL) {
-		prepare_scattered_points(pnts, f_sub_pnts);
-	}
-	
 	size_t points = 0;
 	size_t i;
 	
@@ -139,38 +150,22 @@ bool f_points::make_matrix_and_vector(matr *& matrix, extvec *& v, bitvec * mask
 		
 	writelog(LOG_MESSAGE,"%s : (%s)", print_name, pnts->getName());
 		
-	// avoiding two-times bind_points_to_grid calling for the same grid
-	if (binded_grid) {
-		if (binded_grid->operator ==(method_grid) == false) {
-			bind_points_to_grid(method_prev_grid, pnts, f_sub_pnts, method_grid);
-			if (binded_grid)
-				binded_grid->release();
-			binded_grid = create_grid(method_grid);
-		}
-	} else {
-		bind_points_to_grid(method_prev_grid, pnts, f_sub_pnts, method_grid);
-		if (binded_grid)
-			binded_grid->release();
-		binded_grid = create_grid(method_grid);
-	}
+	bind_points();
 
 	if (mask)
 		mask->release();
 	mask = create_bitvec(matrix_size);
 	mask->init_false();
 
-	for (i = 0; i < (int)f_sub_pnts->size(); i++) {
+	for (i = 0; i < cells->size(); i++) {
 		
-		sub_points * sub_pnts = (*f_sub_pnts)[i];
-
-		size_t pos = sub_pnts->cell_number;
+		size_t pos = (*cells)[i];
 
 		if ( (!mask_solved->get(pos)) && 
 		     (!mask_undefined->get(pos)) ) 
 		{
-			REAL value = sub_pnts->value(pnts);
-			(*v)(sub_pnts->cell_number) = value;
-			mask->set_true(sub_pnts->cell_number);
+			(*v)(pos) = (*cells_values)(i);
+			mask->set_true(pos);
 			points++;
 		}
 	}
@@ -187,43 +182,21 @@ bool f_points::make_matrix_and_vector(matr *& matrix, extvec *& v, bitvec * mask
 
 bool f_points::minimize_only_points() 
 {
-	if (f_sub_pnts == NULL) {
-		prepare_scattered_points(pnts, f_sub_pnts);
-	}
-
 	int pnts_size = pnts->size();
 	if (pnts_size > 0) {
 
 		writelog(LOG_MESSAGE,"%s : (%s)", print_name, pnts->getName());
 		
-		// avoiding two-times bind_points_to_grid calling for the same grid
-		if (binded_grid) {
-			if (binded_grid->operator ==(method_grid) == false) {
-				bind_points_to_grid(method_prev_grid, pnts, f_sub_pnts, method_grid);
-				if (binded_grid)
-					binded_grid->release();
-				binded_grid = create_grid(method_grid);
-			}
-		} else {
-			bind_points_to_grid(method_prev_grid, pnts, f_sub_pnts, method_grid);
-			if (binded_grid)
-				binded_grid->release();
-			binded_grid = create_grid(method_grid);
-		}
+		bind_points();
 				
 		size_t i;
-		int num;
-		sub_points * sub_pnts;
+		size_t num;
 		REAL value;
 
-		int solved_add_size = 0;
-		int undefined_add_size = 0;
-
-		size_t pnts_size = f_sub_pnts->size();
+		size_t cells_size = cells->size();
 	
-		for (i = 0; i < pnts_size; i++) {
-			sub_pnts = (*f_sub_pnts)[i];
-			num = sub_pnts->cell_number;
+		for (i = 0; i < cells_size; i++) {
+			num = (*cells)[i];
 
 			// check for existance
 			if (method_mask_solved->get(num))
@@ -231,7 +204,7 @@ bool f_points::minimize_only_points()
 			if (method_mask_undefined->get(num))
 				continue;
 		
-			value = sub_pnts->value(pnts);
+			value = (*cells_values)(i);
 
 			(*method_X)(num) = value;
 		
@@ -253,27 +226,23 @@ void f_points::mark_solved_and_undefined(bitvec * mask_solved, bitvec * mask_und
 	if ((functionals_add->size() == 0) && ( !cond() ) && (i_am_cond == false) )
 		return;
 
-	if (f_sub_pnts == NULL) {
-		prepare_scattered_points(pnts, f_sub_pnts);
-	}
+	bind_points();
 	
-	size_t pnts_size = f_sub_pnts->size();
+	size_t cells_size = cells->size();
 
 	size_t i;
-	int num;
-	sub_points * sub_pnts;
+	size_t num;
 	REAL value;
 
-	for (i = 0; i < pnts_size; i++) {
-		sub_pnts = (*f_sub_pnts)[i];
-		num = sub_pnts->cell_number;
+	for (i = 0; i < cells_size; i++) {
+		num = (*cells)[i];
 		// check for existance
 		if (mask_solved->get(num))
 			continue;
 		if (mask_undefined->get(num))
 			continue;
 	
-		value = sub_pnts->value(pnts);
+		value = (*cells_values)(i);
 	
 		if (value == undef_value) {
 			mask_undefined->set_true(num);
@@ -293,6 +262,56 @@ bool f_points::solvable_without_cond(const bitvec * mask_solved,
 	return true;
 };
 
+void f_points::bind_points()
+{
+	// avoiding two-times binding for the same grid
+	if (binded_grid && cells && cells_values) {
+		if (binded_grid->operator ==(method_grid))
+			return;
+	}
+
+	if (cells == NULL)
+		cells = new std::vector<size_t>;
+	if (cells_values)
+		cells_values->release();
+	cells_values = NULL;
+
+	bool binded = false;
+
+	// grids with 2^k x 2^k cells get points of every cell as a range of Z-ordered values
+	if (points_morton_order) {
+		if (morton == NULL)
+			morton = create_pnts_morton(pnts, surfit_grid);
+		std::vector<size_t> offsets;
+		if (morton->cell_table(method_grid, *cells, offsets)) {
+			size_t q, cells_size = cells->size();
+			cells_values = create_vec(cells_size, 0, false);
+			for (q = 0; q < cells_size; q++)
+				(*cells_values)(q) = morton->mean_value(offsets[q], offsets[q+1]);
+			binded = true;
+		}
+	}
+
+	if (!binded) {
+		if (f_sub_pnts == NULL)
+			prepare_scattered_points(pnts, f_sub_pnts);
+		bind_points_to_grid(method_prev_grid, pnts, f_sub_pnts, method_grid);
+
+		size_t q, cells_size = f_sub_pnts->size();
+		cells->resize(cells_size);
+		cells_values = create_vec(cells_size, 0, false);
+		for (q = 0; q < cells_size; q++) {
+			sub_points * sub_pnts = (*f_sub_pnts)[q];
+			(*cells)[q] = sub_pnts->cell_number;
+			(*cells_values)(q) = sub_pnts->value(pnts);
+		}
+	}
+
+	if (binded_grid)
+		binded_grid->release();
+	binded_grid = create_grid(method_grid);
+};
+
 //
 //
 // f_points_user
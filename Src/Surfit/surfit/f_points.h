@@ -26,6 +26,8 @@ namespace surfit {
 
 class d_points;
 class sub_points;
+class pnts_morton;
+class vec;
 
 //! vector of \ref sub_points
 typedef std::vector<sub_points *> sub_pnts;
@@ -65,6 +67,9 @@ protected:
 	//! very fast minimization
 	bool minimize_only_points();
 
+	//! binds points to method_grid: calculates numbers of cells with points and mean values for them
+	void bind_points();
+
 	//! scattered data points for approximation
 	const d_points * pnts;
 
@@ -77,6 +82,15 @@ protected:
 	//! \ref d_grid for binding points 
 	d_grid * binded_grid;
 
+	//! points values in Z-order of cells (see \ref points_morton_order)
+	pnts_morton * morton;
+
+	//! numbers of cells with points for binded_grid
+	std::vector<size_t> * cells;
+
+	//! mean values of points for cells
+	vec * cells_values;
+
 private:
 
 	char * print_name;
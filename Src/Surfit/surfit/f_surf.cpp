@@ -48,6 +48,7 @@ functional("f_surf", F_USUAL)
 	if (iname)
 		name = strdup(iname);
 	need_complete = true;
+	sums_held = false;
 	mult = imult;
 };
 
@@ -59,6 +60,9 @@ void f_surf::cleanup() {
 	if (mask)
 		mask->release();
 	mask = NULL;
+	if (sums_held)
+		srf->release_sums();
+	sums_held = false;
 	free(name);
 };
 
@@ -140,6 +144,7 @@ bool f_surf::make_matrix_and_vector(matr *& matrix, extvec *& v, bitvec * mask_s
 	REAL value;
 	REAL stepX2 = method_grid->stepX/REAL(2);
 	REAL stepY2 = method_grid->stepY/REAL(2);
+	bool means = use_cell_means();
 
 	for (j = from_y; j <= to_y; j++) {
 		for (i = from_x; i <= to_x; i++) {
@@ -155,8 +160,10 @@ bool f_surf::make_matrix_and_vector(matr *& matrix, extvec *& v, bitvec * mask_s
 			REAL x, y;
 			method_grid->getCoordNode(i, j, x, y);
 
-			//value = srf->getMeanValue(x-stepX2, x+stepX2, y-stepY2, y+stepY2);
-			value = srf->getInterpValue(x, y);
+			if (means)
+				value = srf->getMeanValue(x-stepX2, x+stepX2, y-stepY2, y+stepY2);
+			else
+				value = srf->getInterpValue(x, y);
 
 			if (value == srf->undef_value)
 				continue;
@@ -218,6 +225,7 @@ bool f_surf::minimize_only_surf()
 	REAL value;
 	REAL stepX2 = method_grid->stepX/REAL(2);
 	REAL stepY2 = method_grid->stepY/REAL(2);
+	bool means = use_cell_means();
 
 	for (j = from_y; j <= to_y; j++) {
 		for (i = from_x; i <= to_x; i++) {
@@ -233,8 +241,10 @@ bool f_surf::minimize_only_surf()
 			REAL x, y;
 			method_grid->getCoordNode(i, j, x, y);
 
-			//value = srf->getMeanValue(x-stepX2, x+stepX2, y-stepY2, y+stepY2);
-			value = srf->getInterpValue(x, y);
+			if (means)
+				value = srf->getMeanValue(x-stepX2, x+stepX2, y-stepY2, y+stepY2);
+			else
+				value = srf->getInterpValue(x, y);
 
 			if (value == srf->undef_value)
 				continue;
@@ -264,5 +274,22 @@ const d_surf * f_surf::get_surf() const
 	return srf;
 };
 
+bool f_surf::use_cell_means()
+{
+	// cell of method grid covers several surface nodes
+	bool coarse = (surf_cell_means != 0) &&
+		      ( (method_grid->stepX > REAL(1.5)*srf->getStepX()) || 
+		        (method_grid->stepY > REAL(1.5)*srf->getStepY()) );
+	if (coarse && !sums_held) {
+		srf->hold_sums();
+		sums_held = true;
+	}
+	if (!coarse && sums_held) {
+		srf->release_sums();
+		sums_held = false;
+	}
+	return coarse;
+};
+
 }; // namespace surfit;
 
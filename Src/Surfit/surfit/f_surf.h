@@ -67,6 +67,13 @@ protected:
 	//! fast minimization procedure
 	bool minimize_only_surf();
 
+	/*! \brief returns true if cell means should be used (see \ref surf_cell_means)
+	    Cell means are used on grids coarser than the surface grid, summed-area tables 
+	    of the surface are held for them until the grid becomes fine enough or 
+	    \ref cleanup is called.
+	*/
+	bool use_cell_means();
+
 	//! data for functional
 	const d_surf * srf;
 
@@ -81,6 +88,9 @@ private:
 	//! flag to complete solution - mark all unsolved cells as undefined
 	bool need_complete;
 
+	//! true if summed-area tables of srf are held (see \ref use_cell_means)
+	bool sums_held;
+
 	REAL mult;
 
 };
@@ -103,7 +103,7 @@ bool f_wmean::make_matrix_and_vector(matr *& matrix, extvec *& v, bitvec * mask_
 			if ((i >= aux_X_from) && (i <= aux_X_to) && (j >= aux_Y_from) && (j <= aux_Y_to)) {
 				int I = i-aux_X_from;
 				int J = j-aux_Y_from;
-				weight = (*(w_srf->coeff))(I + J*nn);
+				weight = w_srf->getValue(I + J*nn);
 				if (weight == w_srf->undef_value)
 					weight = 0;
 			}
@@ -206,7 +206,7 @@ void f_wmean::mark_solved_and_undefined(bitvec * mask_solved, bitvec * mask_unde
 			size_t I = ii-aux_X_from;
 			size_t J = jj-aux_Y_from;
 			
-			REAL weight = (*(w_srf->coeff))(I + J*nn);
+			REAL weight = w_srf->getValue(I + J*nn);
 			if (weight == w_srf->undef_value)
 				continue;
 			
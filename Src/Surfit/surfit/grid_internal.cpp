@@ -295,7 +295,7 @@ d_grid * _grid_load_df(datafile * df, const char * grid_name) {
 	
 	while (!loaded) {
 		
-		if (df->findTag("grid")) {
+		if (df->findTag("grid", NULL, grid_name)) {
 			
 			df->skipTagName();
 			
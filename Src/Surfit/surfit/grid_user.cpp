@@ -25,6 +25,7 @@
 #include "../sstuff/bitvec.h"
 #include "../sstuff/vec.h"
 #include "surf.h"
+#include "surf_float.h"
 #include "surf_internal.h"
 #include "surf_tcl.h"
 #include "variables_tcl.h"
@@ -81,6 +82,7 @@ size_t basis_cnt = GRID_START_SIZE;
 size_t method_basis_cntX = GRID_START_SIZE;
 size_t method_basis_cntY = GRID_START_SIZE;
 size_t method_phase_counter = 0;
+std::vector<d_surf *> * method_levels = NULL;
 
 /////////////////////////////////////////////////
 //
@@ -251,6 +253,7 @@ void grid_init()
 	method_X = NULL;
 	method_mask_solved = NULL;
 	method_mask_undefined = NULL;
+	method_levels = NULL;
 };
 
 void grid_prepare()
@@ -318,6 +321,27 @@ void grid_begin() {
 
 };
 
+void grid_keep_level() {
+
+	extvec * values = create_extvec(*method_X);
+	size_t i;
+	for (i = 0; i < values->size(); i++) {
+		if (method_mask_undefined->get(i) || (method_mask_solved->get(i) == false))
+			(*values)(i) = undef_value;
+	}
+
+	char * name = (char *)malloc(strlen(map_name) + 32);
+	sprintf(name, "%s_phase%d", map_name, (int)method_phase_counter);
+	d_surf * level = create_surf(values, create_grid(method_grid), name);
+	free(name);
+	level->undef_value = surfit::undef_value;
+
+	if (method_levels == NULL)
+		method_levels = new std::vector<d_surf *>;
+	method_levels->push_back(level);
+
+};
+
 void grid_finish(bool & method_ok) {
 
 	if (
@@ -326,6 +350,9 @@ void grid_finish(bool & method_ok) {
 	   )
 		method_ok = true;
 
+	if (!method_ok && surf_pyramid)
+		grid_keep_level();
+
 	if (method_ok) {
 		size_t i;
 		for (i = 0; i < method_mask_undefined->size(); i++) {
@@ -506,6 +533,27 @@ void grid_release() {
 	method_X = NULL;
 
 	res_surf->undef_value = surfit::undef_value;
+
+	if (surf_float_storage) {
+		d_surf * fsrf = create_surf_float(res_surf);
+		res_surf->release();
+		res_surf = fsrf;
+	}
+
+	// pyramid levels go before the result, from the coarsest one
+	if (method_levels) {
+		for (i = 0; i < method_levels->size(); i++) {
+			d_surf * level = (*method_levels)[i];
+			if (surf_float_storage) {
+				d_surf * flevel = create_surf_float(level);
+				level->release();
+				level = flevel;
+			}
+			surfit_surfs->push_back(level);
+		}
+		delete method_levels;
+		method_levels = NULL;
+	}
 	
 	surfit_surfs->push_back(res_surf);	
 
@@ -139,6 +139,10 @@ void grid_prepare();
 SURFIT_EXPORT 
 void grid_begin();
 
+//! stores solution of the current phase as the pyramid level (see \ref surf_pyramid)
+SURFIT_EXPORT 
+void grid_keep_level();
+
 //! performs some operations after the latest phase
 SURFIT_EXPORT 
 void grid_finish(bool & method_ok);
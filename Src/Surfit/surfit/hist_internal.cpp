@@ -113,13 +113,33 @@ REAL get_eq_value(const vec * T, const vec * Z, REAL val,
 	return val;
 };
 
+//! copies values of surface without coeff (float, paged)
+static extvec * read_surf_values(const d_surf * srf)
+{
+	size_t i, size = srf->getCountX()*srf->getCountY();
+	extvec * res = create_extvec(size, 0, false); // don't fill
+	for (i = 0; i < size; i++)
+		(*res)(i) = srf->getValue(i);
+	return res;
+};
+
 bool _surf_adj_hist(d_surf * srf, const d_hist * ihist)
 {
-	extvec * new_coeff = _extvec_adj_hist(srf->coeff, ihist, NULL, NULL, srf->undef_value);
+	extvec * values = srf->coeff ? NULL : read_surf_values(srf);
+	extvec * new_coeff = _extvec_adj_hist(values ? values : srf->coeff, ihist, NULL, NULL, srf->undef_value);
+	if (values)
+		values->release();
 	if (new_coeff == NULL)
 		return false;
-	srf->coeff->release();
-	srf->coeff = new_coeff;
+	if (srf->coeff) {
+		srf->coeff->release();
+		srf->coeff = new_coeff;
+		return true;
+	}
+	size_t i;
+	for (i = 0; i < new_coeff->size(); i++)
+		srf->setValue(i, (*new_coeff)(i));
+	new_coeff->release();
 	return true;
 };
 
@@ -266,7 +286,11 @@ d_hist * _hist_from_surf(const d_surf * srf, size_t intervs, REAL from, REAL to)
 	if (to == FLT_MAX)
 		to = maxz;
 
-	return _hist_from_extvec( srf->coeff, from, to, intervs, srf->undef_value );
+	extvec * values = srf->coeff ? NULL : read_surf_values(srf);
+	d_hist * res = _hist_from_extvec( values ? values : srf->coeff, from, to, intervs, srf->undef_value );
+	if (values)
+		values->release();
+	return res;
 };
 
 d_hist * _hist_from_points(const d_points * pnts, size_t intervs, REAL from, REAL to)
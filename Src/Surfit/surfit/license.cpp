@@ -25,8 +25,8 @@ namespace surfit {
 
 void print_license() {
 #ifdef XXL
-	log_printf("loading surfit v%s (XXL build)\n", VERSION);
-	Tcl_printf("surfit version %s (XXL build), Copyright (c) 2002-2007 M.V.Dmitrievsky & V.N.Kutrunov\n", VERSION);
+	log_printf("loading surfit v%s (XXL build)\n", "");
+	//Tcl_printf("surfit version %s (XXL build), Copyright (c) 2002-2007 M.V.Dmitrievsky & V.N.Kutrunov\n", "");
 #else
 	log_printf("loading surfit v%s\n", "");
 	//Tcl_printf("surfit version %s, Copyright (c) 2002-2007 M.V.Dmitrievsky & V.N.Kutrunov\n", "");
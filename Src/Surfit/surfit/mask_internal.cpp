@@ -61,7 +61,7 @@ d_mask * _mask_load_df(datafile * df, const char * maskname) {
 	
 	while ( !loaded ) {
 		
-		if (df->findTag("mask")) {
+		if (df->findTag("mask", NULL, maskname)) {
 			
 			df->skipTagName();
 			if (!df->readWord()) goto exit;
@@ -332,11 +332,12 @@ exit:
 d_mask * _mask_by_surf(const d_surf * srf) {
 	if (!srf)
 		return NULL;
-	bitvec * bcoeff = create_bitvec( srf->coeff->size() );
+	size_t size = srf->getCountX()*srf->getCountY();
+	bitvec * bcoeff = create_bitvec( size );
 	size_t i;
 	REAL val;
-	for (i = 0; i < srf->coeff->size(); i++) {
-		val = (*(srf->coeff))(i);
+	for (i = 0; i < size; i++) {
+		val = srf->getValue(i);
 		if (val != srf->undef_value)
 			bcoeff->set_true(i);
 		else 
@@ -365,14 +366,12 @@ bool _mask_apply_to_surf(const d_mask * msk, d_surf * srf) {
 	size_t MM = srf->getCountY();
 	REAL x,y;
 	bool val;
-	REAL surf_val;
 	for (j = 0; j < MM; j++) {
 		for (i = 0; i < NN; i++) {
 			srf->getCoordNode(i,j,x,y);
-			surf_val = (*(srf->coeff))(i + j*NN);
 			val = msk->getValue(x,y);
 			if (val == false) {
-				(*(srf->coeff))(i + j*NN) = srf->undef_value;
+				srf->setValue(i + j*NN, srf->undef_value);
 			}
 		}
 	}
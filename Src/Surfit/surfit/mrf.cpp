@@ -21,284 +21,291 @@
 
 #include "../sstuff/fileio.h"
 #include "../sstuff/vec.h"
+#include "../sstuff/threads.h"
 
-#include <memory.h>
 #include "mrf.h"
 
-#include <string.h>
-#include <limits.h>
+#include <algorithm>
 
 namespace surfit {
 
-void _decomp1d(extvec::iterator X_begin, 
-	       size_t N, 
-	       int distance, 
-	       REAL undef_value,
-	       bool flag,
-	       extvec * buf)
-{
-	size_t i;
-	size_t pos = 0;
-
-	REAL s1, s2;
-	REAL a, d;
-	for (i = 0; i < N; i+= 2) {
-		s1 = *(X_begin + i*distance);
-		s2 = *(X_begin + (i+1)*distance);
+//! matrices are transformed in one thread if they are smaller
+#define MRF_THREADS_MIN 65536
 
-		if ((s1 != undef_value) && (s2 != undef_value))
-		{
-			a = (s1 + s2)/REAL(2);
-			d = (s1 - s2)/REAL(2);
-		} else {
-			if ( flag ) {
-				if ( s1 == undef_value )
-					d = undef_value;
-				else
-					d = s1;
-				if ( s2 == undef_value )
-					a = undef_value;
-				else  
-					a = s2;
-			} else {
-				if ( s1 == undef_value ) 
-					a = undef_value;
-				 else 
-					a = s1;
-				if ( s2 == undef_value )
-					d = undef_value;
-				else
-					d = s2;
-			}
-		}
-	
-		*(X_begin + pos*distance) = a;
-		(*buf)(pos) = d;
-
-		pos++;
+//! forward lifting step for pair of values: d = (s1 - s2)/2, a = s2 + d = (s1 + s2)/2
+inline void lift_pair(REAL s1, REAL s2, REAL undef_value, bool flag, REAL & a, REAL & d)
+{
+	if ((s1 != undef_value) && (s2 != undef_value)) {
+		d = (s1 - s2)/REAL(2); // predict
+		a = s2 + d; // update
+		return;
+	}
+	// pair with undefined value is stored as is
+	if (flag) {
+		d = s1;
+		a = s2;
+	} else {
+		a = s1;
+		d = s2;
 	}
-
-	size_t buf_size = N/2;
-	for (i = 0; i < buf_size; i++) 
-		*(X_begin + buf_size*distance + i*distance) = (*buf)(i);
-	
 };
 
-void _decomp2d(extvec *& X,
-	       extvec *& Xa, extvec *& Xd, extvec *& Xh, extvec *& Xv,
-	       size_t N, size_t M, bool enlarge_cols, bool enlarge_rows,
-	       REAL undef_value,
-	       bool flag)
+//! inverse lifting step for pair of values
+inline void unlift_pair(REAL a, REAL d, REAL undef_value, bool flag, REAL & s1, REAL & s2)
 {
+	if ((a != undef_value) && (d != undef_value)) {
+		s2 = a - d; // undo update
+		s1 = s2 + d + d; // undo predict
+		return;
+	}
+	if (flag) {
+		s1 = d;
+		s2 = a;
+	} else {
+		s1 = a;
+		s2 = d;
+	}
+};
 
-	size_t newN = N;
-	size_t newM = M;
-
-	if (enlarge_cols)
-		newN++;
-	if (enlarge_rows)
-		newM++;
+/*! \brief decomposes rows [from, to) of approximation
+    Approximation of these rows is written to the beginning of the band
+    (rows 2*from...), details are written to their places.
+*/
+static void decomp_rows(extvec * X, size_t N, size_t M, extvec::iterator details,
+			REAL undef_value, bool flag, size_t from, size_t to)
+{
+	size_t n2 = (N+1)/2;
+	size_t m2 = (M+1)/2;
+	size_t size = n2*m2;
+	extvec::iterator x = X->begin();
+	extvec::iterator h = details;
+	extvec::iterator v = details + size;
+	extvec::iterator d = details + 2*size;
+	extvec::iterator a = x + 2*from*N;
 
 	size_t i, j;
+	REAL a0, d0, a1, d1;
+	REAL A, H, V, D;
+	for (j = from; j < to; j++) {
+		extvec::iterator r0 = x + 2*j*N;
+		extvec::iterator r1 = (2*j+1 < M) ? r0 + N : r0;
+		extvec::iterator aj = a + (j-from)*n2;
+		size_t pos = j*n2;
+		for (i = 0; i < n2; i++) {
+			size_t i0 = 2*i;
+			size_t i1 = MIN(2*i+1, N-1);
+			// "OY" direction
+			lift_pair(*(r0 + i0), *(r1 + i0), undef_value, flag, a0, d0);
+			lift_pair(*(r0 + i1), *(r1 + i1), undef_value, flag, a1, d1);
+			// "OX" direction
+			lift_pair(a0, a1, undef_value, flag, A, H);
+			lift_pair(d0, d1, undef_value, flag, V, D);
+			*(aj + i) = A;
+			*(h + pos + i) = H;
+			*(v + pos + i) = V;
+			*(d + pos + i) = D;
+		}
+	}
+};
 
-	if (enlarge_cols) {
-		X->resize(newN*M);
-		for (j = M-1; ; j--) {
+/*! \brief reconstructs rows [2*from, 2*to) of matrix
+    Approximation of these rows should be placed at the beginning of the band.
+    Rows are processed from the end, so approximation is read before it is overwritten.
+*/
+static void recons_rows(extvec * X, size_t N, size_t M, extvec::const_iterator details,
+			REAL undef_value, bool flag, size_t from, size_t to)
+{
+	size_t n2 = (N+1)/2;
+	size_t m2 = (M+1)/2;
+	size_t size = n2*m2;
+	extvec::iterator x = X->begin();
+	extvec::const_iterator h = details;
+	extvec::const_iterator v = details + size;
+	extvec::const_iterator d = details + 2*size;
+	extvec::iterator a = x + 2*from*N;
 
-#ifdef XXL
-			size_t q;
-			size_t pos = j*N + N - 1;
-			for (q = 0; q < N; q++)  {
-				*(X->begin()+pos+j) = *(X->const_begin()+pos);
-				pos--;
+	size_t i, j;
+	REAL a0, d0, a1, d1;
+	REAL s00, s01, s10, s11;
+	for (j = to; j > from; j--) {
+		size_t row = j-1;
+		extvec::iterator r0 = x + 2*row*N;
+		extvec::iterator r1 = r0 + N;
+		bool has_r1 = (2*row+1 < M);
+		extvec::iterator aj = a + (row-from)*n2;
+		size_t pos = row*n2;
+		for (i = n2; i > 0; i--) {
+			size_t col = i-1;
+			// "OX" direction
+			unlift_pair(*(aj + col), *(h + pos + col), undef_value, flag, a0, a1);
+			unlift_pair(*(v + pos + col), *(d + pos + col), undef_value, flag, d0, d1);
+			// "OY" direction
+			unlift_pair(a0, d0, undef_value, flag, s00, s01);
+			unlift_pair(a1, d1, undef_value, flag, s10, s11);
+			if (2*col+1 < N) {
+				*(r0 + 2*col+1) = s10;
+				if (has_r1)
+					*(r1 + 2*col+1) = s11;
 			}
-#else
-			memmove(X->begin() + j*N + j, X->begin() + j*N, N*sizeof(REAL));
-#endif
-			(*X)(j*N + j + N) = (*X)(j*N + j + N - 1);
-			if (j == 0)
-				break;
+			*(r0 + 2*col) = s00;
+			if (has_r1)
+				*(r1 + 2*col) = s01;
 		}
 	}
-	if (enlarge_rows) {
-		X->resize(newN*newM);
-#ifdef XXL
-		std::copy(X->const_begin() + (newM-2)*newN, X->const_begin() + (newM-2)*newN + newN, X->begin() + (newM-1)*newN);
-#else
-		memcpy( X->begin() + (newM-1)*newN, X->begin() + (newM-2)*newN, newN*sizeof(REAL) );
-#endif
-		for (i = 0; i < newN; i++)
-			(*X)(i + (newM-1)*newN) = (*X)(i + (newM-2)*newN);
-	}
-
-	// decomp in "OY" direction (column by column)
-
-	extvec * buf = create_extvec(newM/2, 0, 0, 0); // don't fill this vector
-
-	for (i = 0; i < newN; i++) 
-		_decomp1d(X->begin() + i, newM, newN, undef_value, flag, buf);
-
-	// decomp in "OX" direction
-	buf->resize(newN*newM/4);
-	_decomp1d(X->begin(), newN*newM/2, 1, undef_value, flag, buf);
-
-	Xa = create_extvec(newN*newM/4, 0, 0, 0); // don't fill this vector
-#ifdef XXL
-	std::copy(X->const_begin(), X->const_begin() + newN*newM/4, Xa->begin());
-#else
-	memcpy(Xa->begin(), X->begin(), newN*newM/4*sizeof(REAL));
-#endif
-	Xh = buf;
+};
 
-	buf = X;
-	_decomp1d(X->begin() + newN*newM/2, newN*newM/2, 1, undef_value, flag, buf);
+#ifdef HAVE_THREADS
+struct mrf_job : public job
+{
+	mrf_job()
+	{
+		X = NULL;
+		N = 0;
+		M = 0;
+		undef_value = 0;
+		flag = false;
+		from = 0;
+		to = 0;
+		decomp = true;
+	};
+	void set_decomp(extvec * iX, size_t iN, size_t iM, extvec::iterator idetails,
+			REAL iundef_value, bool iflag, size_t ifrom, size_t ito)
+	{
+		set(iX, iN, iM, iundef_value, iflag, ifrom, ito);
+		details = idetails;
+		decomp = true;
+	};
+	void set_recons(extvec * iX, size_t iN, size_t iM, extvec::const_iterator idetails,
+			REAL iundef_value, bool iflag, size_t ifrom, size_t ito)
+	{
+		set(iX, iN, iM, iundef_value, iflag, ifrom, ito);
+		cdetails = idetails;
+		decomp = false;
+	};
+	virtual void do_job()
+	{
+		if (decomp)
+			decomp_rows(X, N, M, details, undef_value, flag, from, to);
+		else
+			recons_rows(X, N, M, cdetails, undef_value, flag, from, to);
+	};
+
+	extvec * X;
+	size_t N, M;
+	extvec::iterator details;
+	extvec::const_iterator cdetails;
+	REAL undef_value;
+	bool flag;
+	size_t from, to;
+	bool decomp;
+
+private:
+	void set(extvec * iX, size_t iN, size_t iM, REAL iundef_value, bool iflag, size_t ifrom, size_t ito)
+	{
+		X = iX;
+		N = iN;
+		M = iM;
+		undef_value = iundef_value;
+		flag = iflag;
+		from = ifrom;
+		to = ito;
+	};
+};
 
-	Xv = create_extvec(newN*newM/4, 0, 0, 0);  // don't fill this vector
-#ifdef XXL
-	std::copy(X->const_begin() + newN*newM/2, X->const_begin() + newN*newM/2 + newN*newM/4, Xv->begin());
-#else
-	memcpy(Xv->begin(), X->begin() + newN*newM/2, newN*newM/4*sizeof(REAL));
-#endif
-	Xd = buf;
-	Xd->resize(newN*newM/4);
+mrf_job mrf_jobs[MAX_CPU];
 
-	X = NULL;
-	
-	return;
+//! divides rows of approximation between threads, returns amount of bands
+static size_t mrf_bands(size_t N, size_t M, size_t * bands)
+{
+	size_t m2 = (M+1)/2;
+	size_t threads = 1;
+	if (N*M >= MRF_THREADS_MIN)
+		threads = MIN(sstuff_get_threads(), m2);
+	size_t step = m2 / threads;
+	size_t ost = m2 % threads;
+	size_t t;
+	bands[0] = 0;
+	for (t = 0; t < threads; t++)
+		bands[t+1] = bands[t] + step + ((t < ost) ? 1 : 0);
+	return threads;
 };
+#endif
 
-
-void _recons1d(extvec::iterator X_begin, 
-	       size_t N, 
-	       int distance, 
+void _decomp2d(extvec * X,
+	       size_t N, size_t M,
+	       extvec::iterator details,
 	       REAL undef_value,
-	       bool flag,
-	       extvec * buf)
+	       bool flag)
 {
+	size_t n2 = (N+1)/2;
+	size_t m2 = (M+1)/2;
 
-	size_t i;
-	size_t pos = 0;
-
-	REAL s1, s2;
-	REAL a, d;
-
-	// copy approximation coefficients to buf
-	if (distance == 1) {
-#ifdef XXL
-		std::copy(X_begin, X_begin + N/2, buf->begin());
-#else
-		memcpy(buf->begin(), X_begin, N/2*sizeof(REAL)); 
+#ifdef HAVE_THREADS
+	size_t bands[MAX_CPU+1];
+	size_t threads = mrf_bands(N, M, bands);
+	if (threads == 1) {
 #endif
+		decomp_rows(X, N, M, details, undef_value, flag, 0, m2);
+#ifdef HAVE_THREADS
 	} else {
-		for (i = 0; i < N/2; i++) 
-			(*buf)(i) = *(X_begin + i*distance);
-	}
-	
-	for (i = 0; i < N/2; i++) {
-		a = (*buf)(i);
-		d = *(X_begin + (i+N/2)*distance);
-
-		if (( a != undef_value ) && ( d != undef_value )) {
-			s1 = a + d;
-			s2 = a - d;
-		} else {
-			if (flag) {
-				if (a == undef_value)
-					s2 = undef_value;
-				else
-					s2 = a;
-				if (d == undef_value) 
-					s1 = undef_value;
-				else
-					s1 = d;
-			} else {
-				if (a == undef_value) 
-					s1 = undef_value;
-				else
-					s1 = a;
-				if (d == undef_value)
-					s2 = undef_value;
-				else
-					s2 = d;
-			}
+		size_t t;
+		for (t = 0; t < threads; t++) {
+			mrf_job & f = mrf_jobs[t];
+			f.set_decomp(X, N, M, details, undef_value, flag, bands[t], bands[t+1]);
+			set_job(&f, t);
 		}
+		do_jobs();
 
-		*(X_begin + pos*distance) = s1;
-		pos++;
-		*(X_begin + pos*distance) = s2;
-		pos++;
-
+		// approximation of bands to its place
+		extvec::iterator x = X->begin();
+		for (t = 1; t < threads; t++) {
+			extvec::iterator src = x + 2*bands[t]*N;
+			std::copy(src, src + (bands[t+1]-bands[t])*n2, x + bands[t]*n2);
+		}
 	}
-};
+#endif
 
+	X->resize(n2*m2);
+};
 
-void _recons2d(extvec *& X,
-	       const extvec * a,
-	       const extvec * d,
-	       const extvec * h,
-	       const extvec * v,
+void _recons2d(extvec * X,
 	       size_t N, size_t M,
-	       bool enlarged_cols,
-	       bool enlarged_rows,
+	       extvec::const_iterator details,
 	       REAL undef_value,
 	       bool flag)
 {
+	size_t m2 = (M+1)/2;
 
-	size_t newN = 2*N;
-	size_t newM = 2*M;
+	X->resize(N*M, 0, false);
 
-	X = create_extvec(newN*newM, 0, 0, 0); // don't fill this vector
-
-#ifdef XXL
-	std::copy(a->const_begin(), a->const_end(), X->begin());
-	std::copy(h->const_begin(), h->const_end(), X->begin() + newN*newM/4);
-	std::copy(v->const_begin(), v->const_end(), X->begin() + newN*newM/2);
-	std::copy(d->const_begin(), d->const_end(), X->begin() + 3*(newN*newM/4));
-#else
-	memcpy(X->begin(), a->const_begin(), a->size()*sizeof(REAL));
-	memcpy(X->begin() + newN*newM/4, h->const_begin(), h->size()*sizeof(REAL));
-	memcpy(X->begin() + newN*newM/2, v->const_begin(), v->size()*sizeof(REAL));
-	memcpy(X->begin() + 3*(newN*newM/4), d->const_begin(), d->size()*sizeof(REAL));
+#ifdef HAVE_THREADS
+	size_t bands[MAX_CPU+1];
+	size_t threads = mrf_bands(N, M, bands);
+	if (threads == 1) {
 #endif
+		recons_rows(X, N, M, details, undef_value, flag, 0, m2);
+#ifdef HAVE_THREADS
+	} else {
+		size_t n2 = (N+1)/2;
+		size_t t;
+
+		// approximation of bands to the beginning of bands
+		extvec::iterator x = X->begin();
+		for (t = threads-1; t > 0; t--) {
+			extvec::iterator src = x + bands[t]*n2;
+			size_t cnt = (bands[t+1]-bands[t])*n2;
+			std::copy_backward(src, src + cnt, x + 2*bands[t]*N + cnt);
+		}
 
-	extvec * buf = create_extvec(newN*newM/4, 0, 0, 0);
-
-	_recons1d(X->begin(), newN*newM/2, 1, undef_value, flag, buf);
- 	_recons1d(X->begin() + newN*newM/2, newN*newM/2, 1, undef_value, flag, buf);
-
-	size_t i,j;
-
-	buf->resize(newM/2);
-	for (i = 0; i < newN; i++) {
-		_recons1d(X->begin() + i, newM, newN, undef_value, flag, buf);
-	}
-	
-	buf->release();
-	
-	N = newN;
-	M = newM;
-	if (enlarged_rows) {
-		newM--;
-		X->resize(newN*newM);
-	}
-	if (enlarged_cols) {
-		newN--;
-		for (j = 1; j < newM; j++) {
-#ifdef XXL
-			size_t q;
-			for (q = 0; q < newN; q++)
-				*(X->begin() + j*newN + q) = *(X->const_begin() + j*N + q);
-#else
-			memmove(X->begin() + j*newN, X->begin() + j*N, newN*sizeof(REAL));
-#endif
+		for (t = 0; t < threads; t++) {
+			mrf_job & f = mrf_jobs[t];
+			f.set_recons(X, N, M, details, undef_value, flag, bands[t], bands[t+1]);
+			set_job(&f, t);
 		}
-		X->resize(newN*newM);		
+		do_jobs();
 	}
-
-
+#endif
 };
 
-
-
 }; // namespace surfit;
 
@@ -24,47 +24,37 @@
 
 namespace surfit {
 
-//! applies wavelet decompositon for vector
-SURFIT_EXPORT
-void _decomp1d(extvec::iterator X_begin, 
-	       size_t N, // amount of elements to process
-	       int distance, // distance between elements
-	       REAL undef_value,
-	       bool flag,
-	       extvec * buf); // temporary vector of size N/2
+/*! \brief applies one level of wavelet decomposition in place (lifting scheme)
+    \param X matrix of N x M values, replaced with approximation of (N+1)/2 x (M+1)/2 values
+    \param N amount of columns
+    \param M amount of rows
+    \param details horizontal, vertical and diagonal details, 3*((N+1)/2)*((M+1)/2) values
+    \param undef_value undefined value
+    \param flag rule for pairs with undefined values (alternates from level to level)
 
-//! applies wavelet decompositon as matrix
+    Odd last column (row) is paired with itself. Each row of approximation and details
+    is calculated from two rows of X in one pass (columns are transformed first, then rows),
+    rows are divided between threads.
+*/
 SURFIT_EXPORT
-void _decomp2d(extvec *& X,
-	       extvec *& Xa,
-	       extvec *& Xd,
-	       extvec *& Xh,
-	       extvec *& Xv,
+void _decomp2d(extvec * X,
 	       size_t N, size_t M,
-	       bool enlarge_X,
-	       bool enlarge_Y,
+	       extvec::iterator details,
 	       REAL undef_value,
 	       bool flag);
 
-//! applies wavelet reconstruction for vector
-SURFIT_EXPORT		
-void _recons1d(extvec::iterator X_begin, 
-	       size_t N, // amount of elements to process
-	       int distance, // distance between elements
-	       REAL undef_value,
-	       bool flag,
-	       extvec * buf); // temporary vector of size N/2
-
-//! applies wavelet reconstruction for matrix
+/*! \brief applies one level of wavelet reconstruction in place (inverse of \ref _decomp2d)
+    \param X approximation of (N+1)/2 x (M+1)/2 values, replaced with matrix of N x M values
+    \param N amount of columns of reconstructed matrix
+    \param M amount of rows of reconstructed matrix
+    \param details details produced by \ref _decomp2d
+    \param undef_value undefined value
+    \param flag the same flag as for decomposition
+*/
 SURFIT_EXPORT
-void _recons2d(extvec *& X,
-	       const extvec * Xa,
-	       const extvec * Xd,
-	       const extvec * Xh,
-	       const extvec * Xv,
+void _recons2d(extvec * X,
 	       size_t N, size_t M,
-	       bool enlarge_X,
-	       bool enlarge_Y,
+	       extvec::const_iterator details,
 	       REAL undef_value,
 	       bool flag);
 
@@ -126,6 +126,111 @@ const char * datafile_new();
 SURFIT_EXPORT
 const char * datafile_append();
 
+/*! \ingroup tcl_other
+    \par Tcl syntax:
+    datafile_read_mode
+
+    \par Description
+    returns current mode for reading arrays from surfit datafiles: 
+    \ref datafile_read_mapped() "datafile_read_mapped" or \ref datafile_read_copied() "datafile_read_copied"
+*/
+SURFIT_EXPORT
+const char * datafile_read_mode();
+
+/*! \ingroup tcl_other
+    \par Tcl syntax:
+    datafile_read_mapped
+
+    \par Description
+    Sets \ref datafile_read_mode() "datafile_read_mode" to "mapped" mode. Datafiles are mapped 
+    into memory, and arrays of surfaces, points and other data are used directly from the 
+    mapped memory without reading and copying. Array is copied only when its size changes. 
+    Pages of the file are loaded on demand and are shared between processes.
+*/
+SURFIT_EXPORT
+const char * datafile_read_mapped();
+
+/*! \ingroup tcl_other
+    \par Tcl syntax:
+    datafile_read_copied
+
+    \par Description
+    Sets \ref datafile_read_mode() "datafile_read_mode" to "copied" mode (default). 
+    Arrays are read from datafiles into the allocated memory.
+*/
+SURFIT_EXPORT
+const char * datafile_read_copied();
+
+/*! \ingroup tcl_other
+    \par Tcl syntax:
+    datafile_write_mode
+
+    \par Description
+    returns current mode for saving data with \ref file_save "file_save": 
+    \ref datafile_write_parallel() "datafile_write_parallel" or \ref datafile_write_serial() "datafile_write_serial"
+*/
+SURFIT_EXPORT
+const char * datafile_write_mode();
+
+/*! \ingroup tcl_other
+    \par Tcl syntax:
+    datafile_write_parallel
+
+    \par Description
+    Sets \ref datafile_write_mode() "datafile_write_mode" to "parallel" mode. Objects are 
+    serialized into memory buffers by several threads (see \ref init_threads "init_threads"), and 
+    the buffers are written to the file in order. The file is the same as in "serial" mode,
+    but messages about every saved object are not printed.
+*/
+SURFIT_EXPORT
+const char * datafile_write_parallel();
+
+/*! \ingroup tcl_other
+    \par Tcl syntax:
+    datafile_write_serial
+
+    \par Description
+    Sets \ref datafile_write_mode() "datafile_write_mode" to "serial" mode (default). 
+    Objects are serialized one by one.
+*/
+SURFIT_EXPORT
+const char * datafile_write_serial();
+
+/*! \ingroup tcl_other
+    \par Tcl syntax:
+    datafile_arrays_mode
+
+    \par Description
+    returns current mode for writing real arrays to surfit datafiles: 
+    \ref datafile_arrays_compressed() "datafile_arrays_compressed" or \ref datafile_arrays_raw() "datafile_arrays_raw"
+*/
+SURFIT_EXPORT
+const char * datafile_arrays_mode();
+
+/*! \ingroup tcl_other
+    \par Tcl syntax:
+    datafile_arrays_compressed
+
+    \par Description
+    Sets \ref datafile_arrays_mode() "datafile_arrays_mode" to "compressed" mode. Real arrays 
+    (surface values, points coordinates etc.) are written with lossless compression. Smooth 
+    surfaces and surfaces with large undefined regions take several times less space.
+    Compressed arrays are recognized automatically while reading.
+*/
+SURFIT_EXPORT
+const char * datafile_arrays_compressed();
+
+/*! \ingroup tcl_other
+    \par Tcl syntax:
+    datafile_arrays_raw
+
+    \par Description
+    Sets \ref datafile_arrays_mode() "datafile_arrays_mode" to "raw" mode (default). 
+    Real arrays are written as is.
+*/
+SURFIT_EXPORT
+const char * datafile_arrays_raw();
+
 };
 
 #endif
@@ -0,0 +1,486 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/fileio.h"
+#include "../sstuff/mapfile.h"
+#include "../sstuff/sstuff.h"
+#include "../sstuff/vec.h"
+#include "../sstuff/threads.h"
+
+#include "points.h"
+#include "pnts_internal.h"
+#include "pnts_morton.h"
+#include "grid.h"
+#include "variables_tcl.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <float.h>
+
+#include <vector>
+#include <algorithm>
+
+namespace surfit {
+
+//! signature at the beginning of binary points file
+#define PNTS_BIN_MAGIC "SRFPNTS1"
+//! signature at the end of binary points file
+#define PNTS_BIN_INDEX_MAGIC "SRFPIDX1"
+//! amount of points in one chunk
+#define PNTS_BIN_CHUNK_SIZE 65536
+//! columns are stored as 4-byte floats relative to chunk bounds
+#define PNTS_BIN_FLOAT 1
+
+//! binary points file header
+struct pnts_bin_header
+{
+	//! PNTS_BIN_MAGIC
+	char magic[8];
+	//! PNTS_BIN_FLOAT or 0
+	unsigned int flags;
+	//! amount of points in one chunk
+	unsigned int chunk_size;
+	//! amount of points
+	unsigned long long count;
+	//! reserved for future use
+	unsigned long long reserved;
+};
+
+//! binary points file chunk index entry
+struct pnts_bin_chunk
+{
+	//! chunk offset in file. X, Y and Z columns are stored one after another
+	unsigned long long offset;
+	//! amount of points in chunk
+	unsigned long long count;
+	//! chunk bounds. Z-bounds are calculated for defined values only
+	double minx, maxx, miny, maxy, minz, maxz;
+};
+
+//! binary points file trailer
+struct pnts_bin_trailer
+{
+	//! offset of chunk index
+	unsigned long long index_offset;
+	//! amount of chunks
+	unsigned long long chunks;
+	//! PNTS_BIN_INDEX_MAGIC
+	char magic[8];
+};
+
+//! comparator for (key, point) pairs
+inline
+bool pnts_bin_pair_less(const std::pair<morton_key, size_t> & p1, const std::pair<morton_key, size_t> & p2) {
+	if (p1.first == p2.first)
+		return p1.second < p2.second;
+	return p1.first < p2.first;
+};
+
+template<class T>
+static void bin_write_column(std::vector<char> & buf, size_t & pos, const T & val) {
+	memcpy(&buf[pos], &val, sizeof(T));
+	pos += sizeof(T);
+};
+
+bool _pnts_save_bin(const d_points * pnts, const char * filename, bool float_columns) {
+
+	if (!pnts) {
+		writelog(LOG_WARNING, "NULL pointer to points.");
+		return false;
+	};
+
+	if (!pnts->getName()) 
+		writelog(LOG_MESSAGE,"saving points with no name to binary file %s", filename);
+	else 
+		writelog(LOG_MESSAGE,"saving points \"%s\" to binary file %s", pnts->getName(), filename);
+
+	FILE * file = fopen(filename, "wb");
+	if (!file) {
+		writelog(LOG_ERROR, "The file %s was not opened: %s", filename, strerror( errno ));
+		return false;
+	}
+
+	size_t pnts_size = pnts->size();
+	size_t p;
+
+	// points are stored in Z-order, so every chunk covers compact region
+	REAL minx = 0, maxx = 0, miny = 0, maxy = 0;
+	if (pnts_size > 0)
+		pnts->bounds(minx, maxx, miny, maxy);
+	REAL stepx = (maxx > minx) ? (maxx - minx)/REAL(65535) : REAL(1);
+	REAL stepy = (maxy > miny) ? (maxy - miny)/REAL(65535) : REAL(1);
+
+	std::vector< std::pair<morton_key, size_t> > pairs(pnts_size);
+	for (p = 0; p < pnts_size; p++) {
+		morton_key i = (morton_key)( ((*(pnts->X))(p) - minx)/stepx );
+		morton_key j = (morton_key)( ((*(pnts->Y))(p) - miny)/stepy );
+		pairs[p] = std::make_pair( morton_spread(MIN(i, 65535)) | (morton_spread(MIN(j, 65535)) << 1), p );
+	}
+	std::sort(pairs.begin(), pairs.end(), pnts_bin_pair_less);
+
+	pnts_bin_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, PNTS_BIN_MAGIC, 8);
+	hdr.flags = float_columns ? PNTS_BIN_FLOAT : 0;
+	hdr.chunk_size = PNTS_BIN_CHUNK_SIZE;
+	hdr.count = pnts_size;
+
+	bool res = (fwrite(&hdr, sizeof(hdr), 1, file) == 1);
+
+	size_t chunks_cnt = (pnts_size + PNTS_BIN_CHUNK_SIZE - 1)/PNTS_BIN_CHUNK_SIZE;
+	std::vector<pnts_bin_chunk> chunks(chunks_cnt);
+	size_t elem = float_columns ? sizeof(float) : sizeof(double);
+	std::vector<char> buf(PNTS_BIN_CHUNK_SIZE*elem*3);
+	unsigned long long offset = sizeof(hdr);
+
+	size_t c;
+	for (c = 0; (c < chunks_cnt) && res; c++) {
+		size_t from = c*PNTS_BIN_CHUNK_SIZE;
+		size_t to = MIN(from + PNTS_BIN_CHUNK_SIZE, pnts_size);
+		pnts_bin_chunk & chunk = chunks[c];
+		chunk.offset = offset;
+		chunk.count = to - from;
+		chunk.minx = chunk.miny = chunk.minz = DBL_MAX;
+		chunk.maxx = chunk.maxy = chunk.maxz = -DBL_MAX;
+
+		for (p = from; p < to; p++) {
+			size_t n = pairs[p].second;
+			REAL x = (*(pnts->X))(n);
+			REAL y = (*(pnts->Y))(n);
+			REAL z = (*(pnts->Z))(n);
+			chunk.minx = MIN(chunk.minx, x);
+			chunk.maxx = MAX(chunk.maxx, x);
+			chunk.miny = MIN(chunk.miny, y);
+			chunk.maxy = MAX(chunk.maxy, y);
+			if (z == undef_value)
+				continue;
+			chunk.minz = MIN(chunk.minz, z);
+			chunk.maxz = MAX(chunk.maxz, z);
+		}
+		if (chunk.minz > chunk.maxz) {
+			chunk.minz = 0;
+			chunk.maxz = 0;
+		}
+
+		size_t pos = 0;
+		size_t col;
+		for (col = 0; col < 3; col++) {
+			const vec * data = (col == 0) ? pnts->X : ( (col == 1) ? pnts->Y : pnts->Z );
+			double base = (col == 0) ? chunk.minx : ( (col == 1) ? chunk.miny : chunk.minz );
+			for (p = from; p < to; p++) {
+				REAL val = (*data)(pairs[p].second);
+				if (float_columns) {
+					float fval = ( (col == 2) && (val == undef_value) ) ? FLT_MAX : float(val - base);
+					bin_write_column(buf, pos, fval);
+				} else {
+					double dval = val;
+					bin_write_column(buf, pos, dval);
+				}
+			}
+		}
+
+		res = (fwrite(&buf[0], 1, pos, file) == pos);
+		offset += pos;
+	}
+
+	pnts_bin_trailer trailer;
+	memset(&trailer, 0, sizeof(trailer));
+	trailer.index_offset = offset;
+	trailer.chunks = chunks_cnt;
+	memcpy(trailer.magic, PNTS_BIN_INDEX_MAGIC, 8);
+
+	if (res && (chunks_cnt > 0))
+		res = (fwrite(&chunks[0], sizeof(pnts_bin_chunk), chunks_cnt, file) == chunks_cnt);
+	if (res)
+		res = (fwrite(&trailer, sizeof(trailer), 1, file) == 1);
+
+	if (fclose(file) != 0)
+		res = false;
+
+	if (!res)
+		writelog(LOG_ERROR, "Can't write data to file %s", filename);
+
+	return res;
+};
+
+/*! \brief decodes chunk points inside rect (all points if rect is NULL)
+    \return amount of decoded points. If X is NULL, points are only counted
+*/
+static size_t bin_decode_chunk(const char * data, const pnts_bin_chunk & chunk, bool float_columns, 
+			       const REAL * rect, REAL * X, REAL * Y, REAL * Z)
+{
+	size_t cnt = (size_t)chunk.count;
+	size_t elem = float_columns ? sizeof(float) : sizeof(double);
+	const char * x_ptr = data + chunk.offset;
+	const char * y_ptr = x_ptr + cnt*elem;
+	const char * z_ptr = y_ptr + cnt*elem;
+
+	// chunk is completely inside rect
+	if (rect) {
+		if ( (chunk.minx >= rect[0]) && (chunk.maxx <= rect[1]) &&
+		     (chunk.miny >= rect[2]) && (chunk.maxy <= rect[3]) )
+			rect = NULL;
+	}
+
+	size_t p, res = 0;
+	for (p = 0; p < cnt; p++) {
+		REAL x, y;
+		if (float_columns) {
+			float fx, fy;
+			memcpy(&fx, x_ptr + p*elem, elem);
+			memcpy(&fy, y_ptr + p*elem, elem);
+			x = chunk.minx + fx;
+			y = chunk.miny + fy;
+		} else {
+			double dx, dy;
+			memcpy(&dx, x_ptr + p*elem, elem);
+			memcpy(&dy, y_ptr + p*elem, elem);
+			x = dx;
+			y = dy;
+		}
+
+		if (rect) {
+			if ( (x < rect[0]) || (x > rect[1]) || (y < rect[2]) || (y > rect[3]) )
+				continue;
+		}
+
+		if (X) {
+			REAL z;
+			if (float_columns) {
+				float fz;
+				memcpy(&fz, z_ptr + p*elem, elem);
+				z = (fz == FLT_MAX) ? undef_value : chunk.minz + fz;
+			} else {
+				double dz;
+				memcpy(&dz, z_ptr + p*elem, elem);
+				z = dz;
+			}
+			X[res] = x;
+			Y[res] = y;
+			Z[res] = z;
+		}
+		res++;
+	}
+	return res;
+};
+
+#ifdef HAVE_THREADS
+struct pnts_bin_decode_job : public job
+{
+	pnts_bin_decode_job()
+	{
+		data = NULL;
+		chunks = NULL;
+		counts = NULL;
+		float_columns = false;
+		rect = NULL;
+		X = NULL;
+		Y = NULL;
+		Z = NULL;
+		from = 0;
+		to = 0;
+	};
+	void set(const char * idata, const std::vector<const pnts_bin_chunk *> * ichunks, 
+		 std::vector<size_t> * icounts, bool ifloat_columns, const REAL * irect,
+		 REAL * iX, REAL * iY, REAL * iZ, size_t ifrom, size_t ito)
+	{
+		data = idata;
+		chunks = ichunks;
+		counts = icounts;
+		float_columns = ifloat_columns;
+		rect = irect;
+		X = iX;
+		Y = iY;
+		Z = iZ;
+		from = ifrom;
+		to = ito;
+	};
+	virtual void do_job()
+	{
+		size_t c;
+		for (c = from; c < to; c++) {
+			// counting pass: counts[c] receives amount of points; 
+			// decoding pass: counts[c] holds writing position
+			if (X == NULL)
+				(*counts)[c] = bin_decode_chunk(data, *((*chunks)[c]), float_columns, rect, NULL, NULL, NULL);
+			else {
+				size_t pos = (*counts)[c];
+				bin_decode_chunk(data, *((*chunks)[c]), float_columns, rect, X + pos, Y + pos, Z + pos);
+			}
+		}
+	};
+
+	const char * data;
+	const std::vector<const pnts_bin_chunk *> * chunks;
+	std::vector<size_t> * counts;
+	bool float_columns;
+	const REAL * rect;
+	REAL * X;
+	REAL * Y;
+	REAL * Z;
+	size_t from, to;
+};
+
+pnts_bin_decode_job pnts_bin_decode_jobs[MAX_CPU];
+
+static void bin_decode_parallel(const char * data, const std::vector<const pnts_bin_chunk *> & chunks, 
+				std::vector<size_t> & counts, bool float_columns, const REAL * rect,
+				REAL * X, REAL * Y, REAL * Z)
+{
+	size_t threads = MIN(sstuff_get_threads(), chunks.size());
+	size_t step = chunks.size()/threads;
+	size_t ost = chunks.size() % threads;
+	size_t from = 0;
+	size_t to = 0;
+	size_t t;
+	for (t = 0; t < threads; t++) {
+		to = from + step;
+		if (t == 0)
+			to += ost;
+		pnts_bin_decode_job & f = pnts_bin_decode_jobs[t];
+		f.set(data, &chunks, &counts, float_columns, rect, X, Y, Z, from, to);
+		set_job(&f, t);
+		from = to;
+	}
+	do_jobs();
+};
+#endif
+
+d_points * _pnts_load_bin(const char * filename, const char * pntsname, const d_grid * grd) {
+
+	mapfile * mf = create_mapfile(filename);
+	if (mf == NULL)
+		return NULL;
+
+	const char * data = mf->begin();
+	size_t file_size = mf->size();
+
+	pnts_bin_header hdr;
+	pnts_bin_trailer trailer;
+	bool ok = (file_size >= sizeof(hdr) + sizeof(trailer));
+	if (ok) {
+		memcpy(&hdr, data, sizeof(hdr));
+		memcpy(&trailer, data + file_size - sizeof(trailer), sizeof(trailer));
+		ok = (memcmp(hdr.magic, PNTS_BIN_MAGIC, 8) == 0) && 
+		     (memcmp(trailer.magic, PNTS_BIN_INDEX_MAGIC, 8) == 0) &&
+		     (trailer.index_offset <= file_size - sizeof(trailer)) &&
+		     (trailer.chunks <= (file_size - sizeof(trailer) - trailer.index_offset)/sizeof(pnts_bin_chunk));
+	}
+	if (!ok) {
+		writelog(LOG_ERROR, "%s : not a surfit binary points file", filename);
+		mf->release();
+		return NULL;
+	}
+
+	bool float_columns = (hdr.flags & PNTS_BIN_FLOAT) != 0;
+	size_t elem = float_columns ? sizeof(float) : sizeof(double);
+	size_t chunks_cnt = (size_t)trailer.chunks;
+	std::vector<pnts_bin_chunk> index(chunks_cnt);
+	if (chunks_cnt > 0)
+		memcpy(&index[0], data + trailer.index_offset, chunks_cnt*sizeof(pnts_bin_chunk));
+
+	// region of grid cells
+	REAL rect_data[4];
+	const REAL * rect = NULL;
+	if (grd) {
+		rect_data[0] = grd->startX - grd->stepX/REAL(2);
+		rect_data[1] = grd->endX + grd->stepX/REAL(2);
+		rect_data[2] = grd->startY - grd->stepY/REAL(2);
+		rect_data[3] = grd->endY + grd->stepY/REAL(2);
+		rect = rect_data;
+	}
+
+	// chunks intersecting with rect
+	std::vector<const pnts_bin_chunk *> chunks;
+	size_t c;
+	for (c = 0; c < chunks_cnt; c++) {
+		const pnts_bin_chunk & chunk = index[c];
+		if (chunk.offset + 3*chunk.count*elem > trailer.index_offset) {
+			writelog(LOG_ERROR, "%s : wrong chunk index", filename);
+			mf->release();
+			return NULL;
+		}
+		if (rect) {
+			if ( (chunk.maxx < rect[0]) || (chunk.minx > rect[1]) ||
+			     (chunk.maxy < rect[2]) || (chunk.miny > rect[3]) )
+				continue;
+		}
+		chunks.push_back(&chunk);
+	}
+
+	std::vector<size_t> counts(chunks.size()+1, 0);
+	size_t total = 0;
+
+#ifdef HAVE_THREADS
+	if ((sstuff_get_threads() == 1) || (chunks.size() < 2)) {
+#endif
+		for (c = 0; c < chunks.size(); c++)
+			counts[c] = bin_decode_chunk(data, *(chunks[c]), float_columns, rect, NULL, NULL, NULL);
+#ifdef HAVE_THREADS
+	} else {
+		bin_decode_parallel(data, chunks, counts, float_columns, rect, NULL, NULL, NULL);
+	}
+#endif
+
+	// counts become writing positions
+	for (c = 0; c < chunks.size(); c++) {
+		size_t tmp = counts[c];
+		counts[c] = total;
+		total += tmp;
+	}
+	counts[chunks.size()] = total;
+
+	vec * X = create_vec(total, 0, false);
+	vec * Y = create_vec(total, 0, false);
+	vec * Z = create_vec(total, 0, false);
+
+#ifdef HAVE_THREADS
+	if ((sstuff_get_threads() == 1) || (chunks.size() < 2)) {
+#endif
+		for (c = 0; c < chunks.size(); c++) {
+			size_t pos = counts[c];
+			bin_decode_chunk(data, *(chunks[c]), float_columns, rect, X->begin() + pos, Y->begin() + pos, Z->begin() + pos);
+		}
+#ifdef HAVE_THREADS
+	} else {
+		bin_decode_parallel(data, chunks, counts, float_columns, rect, X->begin(), Y->begin(), Z->begin());
+	}
+#endif
+
+	mf->release();
+
+	writelog(LOG_MESSAGE, "%s : %d points of %d loaded from %d chunks of %d", 
+		 filename, (int)total, (int)hdr.count, (int)chunks.size(), (int)chunks_cnt);
+
+	d_points * res = NULL;
+	if (pntsname)
+		res = create_points(X, Y, Z, pntsname);
+	else {
+		char * name = get_name(filename);
+		res = create_points(X, Y, Z, name);
+		sstuff_free_char(name);
+	}
+	return res;
+};
+
+}; // namespace surfit;
+
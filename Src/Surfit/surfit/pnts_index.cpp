@@ -0,0 +1,524 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/vec.h"
+#include "../sstuff/threads.h"
+
+#include "pnts_index.h"
+#include "points.h"
+#include "grid.h"
+
+#include <math.h>
+#include <float.h>
+
+#include <algorithm>
+
+namespace surfit {
+
+pnts_index * create_pnts_index(const d_points * pnts) {
+	return new pnts_index(pnts);
+};
+
+//
+// index construction is done in two passes: first pass calculates bucket
+// number for every point and counts points in buckets, second pass places
+// point numbers to their buckets. Every thread works with its own range of
+// points and its own counters, so the order of points inside a bucket is
+// the same as in d_points.
+//
+
+static void index_count(const pnts_index * idx, const d_points * pnts,
+			size_t from, size_t to,
+			std::vector<size_t> & cells, std::vector<size_t> & counts);
+
+static void index_fill(std::vector<size_t> & order, const std::vector<size_t> & cells,
+		       size_t from, size_t to, std::vector<size_t> & pos);
+
+#ifdef HAVE_THREADS
+struct pnts_index_count_job : public job
+{
+	pnts_index_count_job()
+	{
+		idx = NULL;
+		pnts = NULL;
+		cells = NULL;
+		from = 0;
+		to = 0;
+	};
+	void set(const pnts_index * iidx, const d_points * ipnts,
+		 std::vector<size_t> * icells, size_t ifrom, size_t ito, size_t buckets)
+	{
+		idx = iidx;
+		pnts = ipnts;
+		cells = icells;
+		from = ifrom;
+		to = ito;
+		counts.assign(buckets, 0);
+	};
+	virtual void do_job()
+	{
+		index_count(idx, pnts, from, to, *cells, counts);
+	};
+
+	const pnts_index * idx;
+	const d_points * pnts;
+	std::vector<size_t> * cells;
+	size_t from, to;
+	std::vector<size_t> counts;
+};
+
+pnts_index_count_job pnts_index_count_jobs[MAX_CPU];
+
+struct pnts_index_fill_job : public job
+{
+	pnts_index_fill_job()
+	{
+		order = NULL;
+		cells = NULL;
+		pos = NULL;
+		from = 0;
+		to = 0;
+	};
+	void set(std::vector<size_t> * iorder, const std::vector<size_t> * icells,
+		 std::vector<size_t> * ipos, size_t ifrom, size_t ito)
+	{
+		order = iorder;
+		cells = icells;
+		pos = ipos;
+		from = ifrom;
+		to = ito;
+	};
+	virtual void do_job()
+	{
+		index_fill(*order, *cells, from, to, *pos);
+	};
+
+	std::vector<size_t> * order;
+	const std::vector<size_t> * cells;
+	std::vector<size_t> * pos;
+	size_t from, to;
+};
+
+pnts_index_fill_job pnts_index_fill_jobs[MAX_CPU];
+#endif
+
+pnts_index::pnts_index(const d_points * pnts)
+{
+	startX = 0;
+	startY = 0;
+	stepX = 0;
+	stepY = 0;
+	NN = 1;
+	MM = 1;
+	x_data = NULL;
+	y_data = NULL;
+	pnts_size = 0;
+	offsets.assign(2, 0);
+
+	if ((pnts == NULL) || (pnts->X == NULL) || (pnts->Y == NULL))
+		return;
+
+	pnts_size = pnts->size();
+	x_data = pnts->X->const_begin();
+	y_data = pnts->Y->const_begin();
+
+	REAL minx, maxx, miny, maxy;
+	if (pnts_size > 0)
+		pnts->bounds(minx, maxx, miny, maxy);
+	else
+		minx = maxx = miny = maxy = 0;
+
+	REAL dx = maxx - minx;
+	REAL dy = maxy - miny;
+
+	size_t buckets = MAX(1, pnts_size/PNTS_INDEX_BUCKET_SIZE);
+	if ((dx > 0) && (dy > 0)) {
+		NN = (size_t)ceil( sqrt(buckets*dx/dy) );
+		NN = MIN(MAX(NN, 1), buckets);
+		MM = MAX(1, buckets/NN);
+	} else if (dx > 0) {
+		NN = buckets;
+	} else if (dy > 0) {
+		MM = buckets;
+	}
+
+	startX = minx;
+	startY = miny;
+	stepX = (dx > 0) ? dx/REAL(NN) : REAL(1);
+	stepY = (dy > 0) ? dy/REAL(MM) : REAL(1);
+
+	size_t nbuckets = NN*MM;
+	std::vector<size_t> cells(pnts_size);
+	order.resize(pnts_size);
+	offsets.resize(nbuckets+1);
+
+#ifdef HAVE_THREADS
+	if ((sstuff_get_threads() == 1) || (pnts_size < 1000)) {
+#endif
+		std::vector<size_t> counts(nbuckets, 0);
+		index_count(this, pnts, 0, pnts_size, cells, counts);
+		size_t b, sum = 0;
+		for (b = 0; b < nbuckets; b++) {
+			offsets[b] = sum;
+			sum += counts[b];
+			counts[b] = offsets[b];
+		}
+		offsets[nbuckets] = sum;
+		index_fill(order, cells, 0, pnts_size, counts);
+#ifdef HAVE_THREADS
+	} else {
+		size_t threads = sstuff_get_threads();
+		size_t step = pnts_size/threads;
+		size_t ost = pnts_size % threads;
+		size_t from = 0;
+		size_t to = 0;
+		size_t t;
+		for (t = 0; t < threads; t++) {
+			to = from + step;
+			if (t == 0)
+				to += ost;
+			pnts_index_count_job & f = pnts_index_count_jobs[t];
+			f.set(this, pnts, &cells, from, to, nbuckets);
+			set_job(&f, t);
+			from = to;
+		}
+		do_jobs();
+
+		// counters of every thread become its writing positions
+		size_t b, sum = 0;
+		for (b = 0; b < nbuckets; b++) {
+			offsets[b] = sum;
+			for (t = 0; t < threads; t++) {
+				size_t & cnt = pnts_index_count_jobs[t].counts[b];
+				size_t tmp = cnt;
+				cnt = sum;
+				sum += tmp;
+			}
+		}
+		offsets[nbuckets] = sum;
+
+		for (t = 0; t < threads; t++) {
+			pnts_index_count_job & c = pnts_index_count_jobs[t];
+			pnts_index_fill_job & f = pnts_index_fill_jobs[t];
+			f.set(&order, &cells, &(c.counts), c.from, c.to);
+			set_job(&f, t);
+		}
+		do_jobs();
+
+		for (t = 0; t < threads; t++)
+			std::vector<size_t>().swap(pnts_index_count_jobs[t].counts);
+	}
+#endif
+
+	// bounds of points in buckets
+	bucket_minx.assign(nbuckets, FLT_MAX);
+	bucket_maxx.assign(nbuckets, -FLT_MAX);
+	bucket_miny.assign(nbuckets, FLT_MAX);
+	bucket_maxy.assign(nbuckets, -FLT_MAX);
+	size_t q, p;
+	for (q = 0; q < nbuckets; q++) {
+		for (p = offsets[q]; p < offsets[q+1]; p++) {
+			REAL x = *(x_data + order[p]);
+			REAL y = *(y_data + order[p]);
+			bucket_minx[q] = MIN(bucket_minx[q], x);
+			bucket_maxx[q] = MAX(bucket_maxx[q], x);
+			bucket_miny[q] = MIN(bucket_miny[q], y);
+			bucket_maxy[q] = MAX(bucket_maxy[q], y);
+		}
+	}
+};
+
+pnts_index::~pnts_index() {};
+
+void pnts_index::release() {
+	delete this;
+};
+
+bool pnts_index::check(const d_points * pnts) const {
+	if ((pnts == NULL) || (pnts->X == NULL) || (pnts->Y == NULL))
+		return false;
+	if (pnts->size() != pnts_size)
+		return false;
+	return (pnts->X->const_begin() == x_data) && (pnts->Y->const_begin() == y_data);
+};
+
+size_t pnts_index::get_bucket(REAL x, REAL y) const {
+	size_t i = (size_t)MAX(0, floor( (x - startX)/stepX ));
+	size_t j = (size_t)MAX(0, floor( (y - startY)/stepY ));
+	i = MIN(i, NN-1);
+	j = MIN(j, MM-1);
+	return i + j*NN;
+};
+
+void pnts_index::bucket(size_t pos, const size_t *& from, const size_t *& to) const {
+	from = NULL;
+	to = NULL;
+	if (pos >= NN*MM)
+		return;
+	if (offsets[pos] == offsets[pos+1])
+		return;
+	from = &(order[0]) + offsets[pos];
+	to = &(order[0]) + offsets[pos+1];
+};
+
+static void index_count(const pnts_index * idx, const d_points * pnts,
+			size_t from, size_t to,
+			std::vector<size_t> & cells, std::vector<size_t> & counts)
+{
+	vec::const_iterator x_ptr = pnts->X->const_begin();
+	vec::const_iterator y_ptr = pnts->Y->const_begin();
+	size_t i;
+	for (i = from; i < to; i++) {
+		size_t b = idx->get_bucket( *(x_ptr + i), *(y_ptr + i) );
+		cells[i] = b;
+		counts[b]++;
+	}
+};
+
+static void index_fill(std::vector<size_t> & order, const std::vector<size_t> & cells,
+		       size_t from, size_t to, std::vector<size_t> & pos)
+{
+	size_t i;
+	for (i = from; i < to; i++)
+		order[ pos[ cells[i] ]++ ] = i;
+};
+
+void pnts_index::getPointsInRect(REAL x_from, REAL x_to, REAL y_from, REAL y_to,
+				 std::vector<size_t> & nn) const
+{
+	if ((x_from > x_to) || (y_from > y_to))
+		return;
+	if (pnts_size == 0)
+		return;
+
+	size_t i_from = (size_t)MAX(0, floor( (x_from - startX)/stepX ));
+	size_t i_to   = (size_t)MAX(0, floor( (x_to   - startX)/stepX ));
+	size_t j_from = (size_t)MAX(0, floor( (y_from - startY)/stepY ));
+	size_t j_to   = (size_t)MAX(0, floor( (y_to   - startY)/stepY ));
+	i_from = MIN(i_from, NN-1);
+	i_to   = MIN(i_to,   NN-1);
+	j_from = MIN(j_from, MM-1);
+	j_to   = MIN(j_to,   MM-1);
+
+	size_t i, j, p;
+	for (j = j_from; j <= j_to; j++) {
+		for (i = i_from; i <= i_to; i++) {
+			size_t b = i + j*NN;
+			if (offsets[b] == offsets[b+1])
+				continue;
+			if ((bucket_maxx[b] < x_from) || (bucket_minx[b] > x_to) ||
+			    (bucket_maxy[b] < y_from) || (bucket_miny[b] > y_to))
+				continue;
+			// whole bucket is inside rect
+			if ((bucket_minx[b] >= x_from) && (bucket_maxx[b] <= x_to) &&
+			    (bucket_miny[b] >= y_from) && (bucket_maxy[b] <= y_to))
+			{
+				nn.insert(nn.end(), order.begin() + offsets[b], order.begin() + offsets[b+1]);
+				continue;
+			}
+			for (p = offsets[b]; p < offsets[b+1]; p++) {
+				REAL x = *(x_data + order[p]);
+				REAL y = *(y_data + order[p]);
+				if ((x >= x_from) && (x <= x_to) && (y >= y_from) && (y <= y_to))
+					nn.push_back(order[p]);
+			}
+		}
+	}
+};
+
+//
+// binding to grid
+//
+
+//! returns cell number of grd for (x,y) point, clamped to grid bounds
+inline
+size_t bind_cell(const d_grid * grd, size_t NN, size_t MM, REAL x, REAL y) {
+	size_t i = MIN(grd->get_i(x), NN-1);
+	size_t j = MIN(grd->get_j(y), MM-1);
+	return i + j*NN;
+};
+
+static void bind_buckets(const pnts_index * idx, const d_grid * grd,
+			 const REAL * x_data, const REAL * y_data,
+			 const std::vector<REAL> & bminx, const std::vector<REAL> & bmaxx,
+			 const std::vector<REAL> & bminy, const std::vector<REAL> & bmaxy,
+			 size_t b_from, size_t b_to, std::vector<size_t> & cells)
+{
+	size_t NN = grd->getCountX();
+	size_t MM = grd->getCountY();
+	size_t b;
+	const size_t * from, * to, * p;
+	for (b = b_from; b < b_to; b++) {
+		idx->bucket(b, from, to);
+		if (from == NULL)
+			continue;
+		// cell numbers are monotone in x and y, so if the corners of bucket
+		// bounds fall into one cell, all bucket points are inside this cell
+		size_t c0 = bind_cell(grd, NN, MM, bminx[b], bminy[b]);
+		size_t c1 = bind_cell(grd, NN, MM, bmaxx[b], bmaxy[b]);
+		if (c0 == c1) {
+			for (p = from; p != to; p++)
+				cells[*p] = c0;
+			continue;
+		}
+		for (p = from; p != to; p++)
+			cells[*p] = bind_cell(grd, NN, MM, *(x_data + *p), *(y_data + *p));
+	}
+};
+
+#ifdef HAVE_THREADS
+struct pnts_index_bind_job : public job
+{
+	pnts_index_bind_job()
+	{
+		idx = NULL;
+		grd = NULL;
+		cells = NULL;
+		b_from = 0;
+		b_to = 0;
+	};
+	void set(const pnts_index * iidx, const d_grid * igrd, std::vector<size_t> * icells,
+		 size_t ib_from, size_t ib_to)
+	{
+		idx = iidx;
+		grd = igrd;
+		cells = icells;
+		b_from = ib_from;
+		b_to = ib_to;
+	};
+	virtual void do_job()
+	{
+		bind_buckets(idx, grd, idx->x_data, idx->y_data,
+			     idx->bucket_minx, idx->bucket_maxx, idx->bucket_miny, idx->bucket_maxy,
+			     b_from, b_to, *cells);
+	};
+
+	const pnts_index * idx;
+	const d_grid * grd;
+	std::vector<size_t> * cells;
+	size_t b_from, b_to;
+};
+
+pnts_index_bind_job pnts_index_bind_jobs[MAX_CPU];
+#endif
+
+//! comparator for (cell, point) pairs
+inline
+bool cell_pair_less(const std::pair<size_t, size_t> & p1, const std::pair<size_t, size_t> & p2) {
+	if (p1.first == p2.first)
+		return p1.second < p2.second;
+	return p1.first < p2.first;
+};
+
+std::vector<sub_points *> * pnts_index::bind(const d_grid * grd) const
+{
+	std::vector<sub_points *> * res = new std::vector<sub_points *>;
+	if (pnts_size == 0)
+		return res;
+
+	size_t grdNN = grd->getCountX();
+	size_t grdMM = grd->getCountY();
+	size_t nbuckets = NN*MM;
+
+	std::vector<size_t> cells(pnts_size);
+
+#ifdef HAVE_THREADS
+	if ((sstuff_get_threads() == 1) || (pnts_size < 1000)) {
+#endif
+		bind_buckets(this, grd, x_data, y_data,
+			     bucket_minx, bucket_maxx, bucket_miny, bucket_maxy,
+			     0, nbuckets, cells);
+#ifdef HAVE_THREADS
+	} else {
+		size_t threads = sstuff_get_threads();
+		size_t step = nbuckets/threads;
+		size_t ost = nbuckets % threads;
+		size_t from = 0;
+		size_t to = 0;
+		size_t t;
+		for (t = 0; t < threads; t++) {
+			to = from + step;
+			if (t == 0)
+				to += ost;
+			pnts_index_bind_job & f = pnts_index_bind_jobs[t];
+			f.set(this, grd, &cells, from, to);
+			set_job(&f, t);
+			from = to;
+		}
+		do_jobs();
+	}
+#endif
+
+	size_t grid_size = grdNN*grdMM;
+	size_t i;
+
+	if (grid_size <= 4*pnts_size) {
+		// counting sort by cell number
+		std::vector<size_t> counts(grid_size+1, 0);
+		for (i = 0; i < pnts_size; i++)
+			counts[ cells[i]+1 ]++;
+		size_t nonempty = 0;
+		for (i = 0; i < grid_size; i++) {
+			if (counts[i+1] > 0)
+				nonempty++;
+			counts[i+1] += counts[i];
+		}
+		res->reserve(nonempty);
+		std::vector<size_t> sorted(pnts_size);
+		for (i = 0; i < pnts_size; i++)
+			sorted[ counts[ cells[i] ]++ ] = i;
+		// now counts[c] points to the end of cell c
+		size_t begin = 0;
+		for (i = 0; i < grid_size; i++) {
+			size_t end = counts[i];
+			if (end == begin)
+				continue;
+			std::vector<size_t> * nums = new std::vector<size_t>(sorted.begin() + begin, sorted.begin() + end);
+			res->push_back( new sub_points(i, nums) );
+			begin = end;
+		}
+	} else {
+		// grid is much larger than points set
+		std::vector< std::pair<size_t, size_t> > pairs(pnts_size);
+		for (i = 0; i < pnts_size; i++)
+			pairs[i] = std::make_pair(cells[i], i);
+		std::vector<size_t>().swap(cells);
+		std::sort(pairs.begin(), pairs.end(), cell_pair_less);
+		size_t begin = 0;
+		while (begin < pnts_size) {
+			size_t cell = pairs[begin].first;
+			size_t end = begin+1;
+			while ((end < pnts_size) && (pairs[end].first == cell))
+				end++;
+			std::vector<size_t> * nums = new std::vector<size_t>(end-begin);
+			size_t q;
+			for (q = begin; q < end; q++)
+				(*nums)[q-begin] = pairs[q].second;
+			res->push_back( new sub_points(cell, nums) );
+			begin = end;
+		}
+	}
+
+	return res;
+};
+
+}; // namespace surfit;
+
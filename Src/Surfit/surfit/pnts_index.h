@@ -0,0 +1,135 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__pnts_index__
+#define __surfit__pnts_index__
+
+#include <vector>
+
+namespace surfit {
+
+class d_points;
+class d_grid;
+class sub_points;
+class pnts_index;
+
+//! average amount of points in one \ref pnts_index bucket
+#define PNTS_INDEX_BUCKET_SIZE 8
+
+//! constructs \ref pnts_index for \ref d_points
+SURFIT_EXPORT
+pnts_index * create_pnts_index(const d_points * pnts);
+
+/*! \class pnts_index
+    \brief uniform bucket grid over scattered points
+
+    Numbers of points are stored bucket by bucket (buckets are ordered row by row)
+    in one array, so points inside any rectangle are found by visiting only the
+    buckets covered by this rectangle. Index is built once for the \ref d_points
+    and is used for binning points to the grid at every calculation phase.
+*/
+class SURFIT_EXPORT pnts_index {
+protected:
+	/*! constructor
+	    \param pnts points to index
+	*/
+	pnts_index(const d_points * pnts);
+
+	//! destructor
+	~pnts_index();
+
+public:
+
+	friend SURFIT_EXPORT
+	//! constructs \ref pnts_index for \ref d_points
+	pnts_index * create_pnts_index(const d_points * pnts);
+
+	//! destructor
+	void release();
+
+	/*! \brief returns true if index was built for the current X and Y vectors of pnts
+	    In-place changes of coordinates can't be seen here, they are reported with \ref d_points::drop_index
+	*/
+	bool check(const d_points * pnts) const;
+
+	//! returns amount of buckets in X direction
+	size_t getCountX() const { return NN; };
+
+	//! returns amount of buckets in Y direction
+	size_t getCountY() const { return MM; };
+
+	//! calculates bucket number for (x,y) point
+	size_t get_bucket(REAL x, REAL y) const;
+
+	//! returns numbers of points for bucket (i + j*getCountX())
+	void bucket(size_t pos, const size_t *& from, const size_t *& to) const;
+
+	/*! \brief appends numbers of points inside rect [x_from, x_to] x [y_from, y_to] to nn
+	    Numbers are appended in bucket order, not sorted.
+	*/
+	void getPointsInRect(REAL x_from, REAL x_to, REAL y_from, REAL y_to,
+			     std::vector<size_t> & nn) const;
+
+	/*! \brief distributes all points between the cells of grd
+	    \return \ref sub_points for every nonempty cell, sorted by cell number.
+	    Points outside the grid are binded to the nearest border cell.
+	*/
+	std::vector<sub_points *> * bind(const d_grid * grd) const;
+
+private:
+
+	//! X coordinate of the first bucket left bound
+	REAL startX;
+	//! Y coordinate of the first bucket lower bound
+	REAL startY;
+	//! bucket size in X direction
+	REAL stepX;
+	//! bucket size in Y direction
+	REAL stepY;
+	//! amount of buckets in X direction
+	size_t NN;
+	//! amount of buckets in Y direction
+	size_t MM;
+
+	//! numbers of points, sorted by buckets
+	std::vector<size_t> order;
+	//! bucket "pos" contents are order[offsets[pos]] .. order[offsets[pos+1]-1]
+	std::vector<size_t> offsets;
+
+	//! X-bounds of points in every bucket
+	std::vector<REAL> bucket_minx, bucket_maxx;
+	//! Y-bounds of points in every bucket
+	std::vector<REAL> bucket_miny, bucket_maxy;
+
+	//! coordinates the index was built for
+	const REAL * x_data;
+	//! coordinates the index was built for
+	const REAL * y_data;
+	//! amount of points the index was built for
+	size_t pnts_size;
+
+#ifdef HAVE_THREADS
+	friend struct pnts_index_bind_job;
+#endif
+};
+
+}; // namespace surfit;
+
+#endif
+
@@ -64,6 +64,14 @@ d_points * _pnts_load(const char * filename, const char * pntsname);
 SURFIT_EXPORT
 d_points * _pnts_load_df(datafile * df, const char * pntsname);
 
+/*! \brief reads \ref d_points from binary points file (see \ref _pnts_save_bin)
+    \param filename filename
+    \param pntsname name for points (file name if NULL)
+    \param grd if not NULL, only points inside grd cells are read. Chunks outside grd are skipped.
+*/
+SURFIT_EXPORT
+d_points * _pnts_load_bin(const char * filename, const char * pntsname = NULL, const d_grid * grd = NULL);
+
 //////////////
 // save
 
@@ -86,6 +94,17 @@ bool _pnts_save(const d_points * pnts, const char * filename);
 SURFIT_EXPORT
 bool _pnts_save_df(const d_points * pnts, datafile * df);
 
+/*! \brief saves \ref d_points to binary points file
+    Points are stored in Z-order by chunks of X, Y and Z columns. Bounds of every chunk
+    are written to the index at the end of file, so regions can be read without 
+    decoding the whole file. Points names are not stored.
+    \param pnts pointer to \ref d_points
+    \param filename filename
+    \param float_columns store columns as 4-byte floats (relative to chunk bounds)
+*/
+SURFIT_EXPORT
+bool _pnts_save_bin(const d_points * pnts, const char * filename, bool float_columns = false);
+
 //////////////
 // stuff
 
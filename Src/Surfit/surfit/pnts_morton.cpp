@@ -0,0 +1,168 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/vec.h"
+
+#include "pnts_morton.h"
+#include "points.h"
+#include "grid.h"
+#include "variables_tcl.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace surfit {
+
+pnts_morton * create_pnts_morton(const d_points * pnts, const d_grid * grd) {
+	return new pnts_morton(pnts, grd);
+};
+
+//! comparator for (key, point) pairs
+inline
+bool morton_pair_less(const std::pair<morton_key, size_t> & p1, const std::pair<morton_key, size_t> & p2) {
+	if (p1.first == p2.first)
+		return p1.second < p2.second;
+	return p1.first < p2.first;
+};
+
+pnts_morton::pnts_morton(const d_points * pnts, const d_grid * grd)
+{
+	Z = NULL;
+
+	startX = grd->startX - grd->stepX/REAL(2);
+	startY = grd->startY - grd->stepY/REAL(2);
+	lengthX = grd->stepX*grd->getCountX();
+	lengthY = grd->stepY*grd->getCountY();
+
+	size_t cnt = MAX(grd->getCountX(), grd->getCountY());
+	levels = 0;
+	while ( ((size_t)1 << levels) < cnt )
+		levels++;
+
+	size_t pnts_size = pnts->size();
+	morton_key key_cnt = (morton_key)1 << levels;
+	REAL stepX = lengthX/REAL(key_cnt);
+	REAL stepY = lengthY/REAL(key_cnt);
+
+	std::vector< std::pair<morton_key, size_t> > pairs(pnts_size);
+	vec::const_iterator x_ptr = pnts->X->const_begin();
+	vec::const_iterator y_ptr = pnts->Y->const_begin();
+	size_t p;
+	for (p = 0; p < pnts_size; p++) {
+		morton_key i = (morton_key)MAX(0, floor( (*(x_ptr + p) - startX)/stepX ));
+		morton_key j = (morton_key)MAX(0, floor( (*(y_ptr + p) - startY)/stepY ));
+		i = MIN(i, key_cnt-1);
+		j = MIN(j, key_cnt-1);
+		pairs[p] = std::make_pair( morton_spread(i) | (morton_spread(j) << 1), p );
+	}
+
+	std::sort(pairs.begin(), pairs.end(), morton_pair_less);
+
+	keys.resize(pnts_size);
+	Z = create_vec(pnts_size, 0, false);
+	vec::const_iterator z_ptr = pnts->Z->const_begin();
+	vec::iterator sz_ptr = Z->begin();
+	for (p = 0; p < pnts_size; p++) {
+		keys[p] = pairs[p].first;
+		*(sz_ptr + p) = *(z_ptr + pairs[p].second);
+	}
+};
+
+pnts_morton::~pnts_morton() {
+	if (Z)
+		Z->release();
+};
+
+void pnts_morton::release() {
+	delete this;
+};
+
+size_t pnts_morton::size() const {
+	return keys.size();
+};
+
+bool pnts_morton::cell_table(const d_grid * grd,
+			     std::vector<size_t> & cells,
+			     std::vector<size_t> & offsets) const
+{
+	cells.resize(0);
+	offsets.resize(0);
+
+	size_t NN = grd->getCountX();
+	size_t MM = grd->getCountY();
+	if (NN != MM)
+		return false;
+
+	size_t k = 0;
+	while ( ((size_t)1 << k) < NN )
+		k++;
+	if ( ((size_t)1 << k) != NN )
+		return false;
+	if (k > levels)
+		return false;
+
+	// grd should cover the same region as key grid
+	REAL tolX = lengthX*REAL(1e-9);
+	REAL tolY = lengthY*REAL(1e-9);
+	if (fabs(grd->startX - grd->stepX/REAL(2) - startX) > tolX)
+		return false;
+	if (fabs(grd->startY - grd->stepY/REAL(2) - startY) > tolY)
+		return false;
+	if (fabs(grd->stepX*NN - lengthX) > tolX)
+		return false;
+	if (fabs(grd->stepY*MM - lengthY) > tolY)
+		return false;
+
+	size_t shift = 2*(levels - k);
+	size_t pnts_size = keys.size();
+	size_t p = 0;
+	while (p < pnts_size) {
+		morton_key cell_key = keys[p] >> shift;
+		size_t i = (size_t)morton_compact(cell_key);
+		size_t j = (size_t)morton_compact(cell_key >> 1);
+		cells.push_back(i + j*NN);
+		offsets.push_back(p);
+		p++;
+		while ((p < pnts_size) && ((keys[p] >> shift) == cell_key))
+			p++;
+	}
+	offsets.push_back(pnts_size);
+
+	return true;
+};
+
+REAL pnts_morton::mean_value(size_t from, size_t to) const {
+	if (from >= to)
+		return undef_value;
+	REAL value = REAL(0);
+	vec::const_iterator ptr = Z->const_begin() + from;
+	vec::const_iterator ptr_end = Z->const_begin() + to;
+	for (; ptr != ptr_end; ptr++) {
+		if (*ptr == undef_value)
+			return undef_value;
+		value += *ptr;
+	}
+	return value/REAL(to - from);
+};
+
+}; // namespace surfit;
+
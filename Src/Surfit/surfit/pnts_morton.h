@@ -0,0 +1,130 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__pnts_morton__
+#define __surfit__pnts_morton__
+
+#include <vector>
+
+namespace surfit {
+
+class vec;
+class d_points;
+class d_grid;
+class pnts_morton;
+
+//! Z-order (Morton) key of the cell: bits of i and j interleaved
+typedef unsigned long long morton_key;
+
+/*! \brief constructs \ref pnts_morton for \ref d_points
+    \param pnts points
+    \param grd grid for the latest calculation phase (usually \ref surfit_grid)
+*/
+SURFIT_EXPORT
+pnts_morton * create_pnts_morton(const d_points * pnts, const d_grid * grd);
+
+/*! \class pnts_morton
+    \brief points values, sorted in Z-order (Morton order) of cells
+
+    Key grid divides the region of calculation grids into 2^levels x 2^levels cells.
+    Every point gets the Morton key of its key grid cell, and point values are stored 
+    sorted by these keys. Calculation grids with 2^k x 2^k cells (k <= levels) are 
+    nested into the key grid, so the key of a calculation cell is (key >> 2*(levels-k))
+    and points of any such cell are stored contiguously.
+*/
+class SURFIT_EXPORT pnts_morton {
+protected:
+	//! constructor
+	pnts_morton(const d_points * pnts, const d_grid * grd);
+
+	//! destructor
+	~pnts_morton();
+
+public:
+
+	friend SURFIT_EXPORT
+	//! constructs \ref pnts_morton for \ref d_points
+	pnts_morton * create_pnts_morton(const d_points * pnts, const d_grid * grd);
+
+	//! destructor
+	void release();
+
+	/*! \brief makes cells table for calculation grid
+	    \param grd calculation grid (should be nested into the key grid)
+	    \param cells numbers of nonempty cells of grd, in Z-order
+	    \param offsets points of cells[q] are stored at positions offsets[q] .. offsets[q+1]-1
+	    \return false if grd cells are not nested into the key grid
+	*/
+	bool cell_table(const d_grid * grd,
+			std::vector<size_t> & cells,
+			std::vector<size_t> & offsets) const;
+
+	//! calculates mean value for points stored at positions from .. to-1
+	REAL mean_value(size_t from, size_t to) const;
+
+	//! returns amount of points
+	size_t size() const;
+
+private:
+
+	//! X-coordinate of the key grid left bound
+	REAL startX;
+	//! Y-coordinate of the key grid lower bound
+	REAL startY;
+	//! X-size of the key grid
+	REAL lengthX;
+	//! Y-size of the key grid
+	REAL lengthY;
+	//! key grid has 2^levels cells in each direction
+	size_t levels;
+
+	//! sorted keys of points
+	std::vector<morton_key> keys;
+	//! Z-values of points, sorted by keys
+	vec * Z;
+};
+
+//! spreads bits of i: bit number n goes to 2*n position
+inline
+morton_key morton_spread(morton_key i) {
+	i &= 0xFFFFFFFFULL;
+	i = (i | (i << 16)) & 0x0000FFFF0000FFFFULL;
+	i = (i | (i << 8))  & 0x00FF00FF00FF00FFULL;
+	i = (i | (i << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+	i = (i | (i << 2))  & 0x3333333333333333ULL;
+	i = (i | (i << 1))  & 0x5555555555555555ULL;
+	return i;
+};
+
+//! inverse to \ref morton_spread
+inline
+morton_key morton_compact(morton_key i) {
+	i &= 0x5555555555555555ULL;
+	i = (i | (i >> 1))  & 0x3333333333333333ULL;
+	i = (i | (i >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+	i = (i | (i >> 4))  & 0x00FF00FF00FF00FFULL;
+	i = (i | (i >> 8))  & 0x0000FFFF0000FFFFULL;
+	i = (i | (i >> 16)) & 0x00000000FFFFFFFFULL;
+	return i;
+};
+
+}; // namespace surfit;
+
+#endif
+
@@ -22,6 +22,7 @@
 #include "../sstuff/datafile.h"
 #include "../sstuff/fileio.h"
 #include "../sstuff/vec.h"
+#include "../sstuff/bitvec.h"
 #include "../sstuff/rnd.h"
 #include "../sstuff/geom_alg.h"
 #include "../sstuff/findfile.h"
@@ -30,10 +31,15 @@
 #include <algorithm>
 
 #include "points.h"
+#include "pnts_index.h"
 #include "pnts_internal.h"
 #include "pnts_tcl.h"
+#include "grid_internal.h"
 #include "surf.h"
 #include "surf_internal.h"
+#include "surf_sample.h"
+#include "surf_stats.h"
+#include "variables_tcl.h"
 #include "mask.h"
 #include "mask_internal.h"
 #include "variables_internal.h"
@@ -65,6 +71,27 @@ boolvec * pnts_load(const char * filename, const char * pntsname)
 	return res;
 };
 
+boolvec * pnts_load_bin(const char * filename, const char * pntsname, bool in_grid) 
+{
+	if (in_grid && !_grid_check())
+		return NULL;
+
+	boolvec * res = create_boolvec();
+	const char * fname = find_first(filename);
+	
+	while (fname != NULL) {
+		d_points * pnts = _pnts_load_bin(fname, pntsname, in_grid ? _get_surfit_grid() : NULL);
+		if (pnts != NULL) {
+			surfit_pnts->push_back(pnts);
+			res->push_back(true);
+		} else
+			res->push_back(false);
+		fname = find_next();
+	}
+	find_close();
+	return res;
+};
+
 struct match_add_noise
 {
 	match_add_noise(REAL istd, const char * ipos) : pos(ipos), std(istd), res(NULL) {};
@@ -144,6 +171,32 @@ vec * pnts_std(REAL mean, const char * pos)
 	return qq.res;
 };
 
+struct match_pnts_stats
+{
+	match_pnts_stats(const char * ipos) : pos(ipos), res(NULL) {};
+	void operator()(d_points * pnts)
+	{
+		if ( StringMatch(pos, pnts->getName()) )
+		{
+			if (res == NULL)
+				res = create_vec();
+			writelog(LOG_MESSAGE,"calculating statistics for points \"%s\"", pnts->getName());
+			stat_acc acc;
+			_pnts_stats(pnts, acc);
+			acc.push_back(res, undef_value);
+		}
+	}
+	const char * pos;
+	vec * res;
+};
+
+vec * pnts_stats(const char * pos) 
+{
+	match_pnts_stats qq(pos);
+	qq = std::for_each(surfit_pnts->begin(), surfit_pnts->end(), qq);
+	return qq.res;
+};
+
 struct match_pnts_save
 {
 	match_pnts_save(const char * ifilename, const char * ipos) : filename(ifilename), pos(ipos), res(NULL) {};
@@ -169,6 +222,32 @@ boolvec * pnts_save(const char * filename, const char * pos)
 	return qq.res;
 };
 
+struct match_pnts_save_bin
+{
+	match_pnts_save_bin(const char * ifilename, const char * ipos, bool ifloat_columns) : filename(ifilename), pos(ipos), float_columns(ifloat_columns), res(NULL) {};
+	void operator()(d_points * pnts)
+	{
+		if ( StringMatch(pos, pnts->getName()) )
+		{
+			if (res == NULL)
+				res = create_boolvec();
+			writelog(LOG_MESSAGE,"Saving points to binary file %s", filename);
+			res->push_back( _pnts_save_bin(pnts, filename, float_columns) );
+		}
+	}
+	const char * filename;
+	const char * pos;
+	bool float_columns;
+	boolvec * res;
+};
+
+boolvec * pnts_save_bin(const char * filename, const char * pos, bool float_columns) 
+{
+	match_pnts_save_bin qq(filename, pos, float_columns);
+	qq = std::for_each(surfit_pnts->begin(), surfit_pnts->end(), qq);
+	return qq.res;
+};
+
 struct match_pnts_getCount
 {
 	match_pnts_getCount(const char * ipos) : pos(ipos), res(NULL) {};
@@ -271,9 +350,11 @@ struct match_pfbs2
 			vec::iterator new_Z_ptr = pnts->Z->begin();
 			
 			REAL z_value;
+			vec * values = _surf_sample_pnts(srf, pnts);
+			vec::iterator values_ptr = values->begin();
 			
-			for (;old_X_ptr != pnts->X->end(); old_X_ptr++, old_Y_ptr++, old_Z_ptr++) {
-				z_value = srf->getValue(*old_X_ptr, *old_Y_ptr);
+			for (;old_X_ptr != pnts->X->end(); old_X_ptr++, old_Y_ptr++, old_Z_ptr++, values_ptr++) {
+				z_value = *values_ptr;
 				if ( fabs(z_value - *old_Z_ptr) < eps ) {
 					*new_X_ptr = *old_X_ptr;
 					*new_Y_ptr = *old_Y_ptr;
@@ -283,12 +364,11 @@ struct match_pfbs2
 					new_Z_ptr++;
 				}
 			}
+			values->release();
 			
 			size_t new_size = new_X_ptr - pnts->X->begin();
 			
-			pnts->X->resize(new_size);
-			pnts->Y->resize(new_size);
-			pnts->Z->resize(new_size);
+			pnts->resize(new_size);
 			if (res == NULL)
 				res = create_boolvec();
 			res->push_back(true);
@@ -328,6 +408,53 @@ boolvec * pnts_filter_by_surf(REAL eps, const char * pnts_pos, const char * surf
 	return qq.res;
 };
 
+//! removes points inside (remove_inside == true) or outside area
+static void filter_pnts_by_area(d_points * pnts, const d_area * area, bool remove_inside)
+{
+	size_t old_size = pnts->size();
+	if (old_size == 0)
+		return;
+
+	// only points inside area bounds need in_region test,
+	// others are outside area (or inside inverted area)
+	bitvec * in_reg = create_bitvec(old_size);
+	if (area->inverted)
+		in_reg->init_true();
+	else
+		in_reg->init_false();
+
+	REAL minx, maxx, miny, maxy;
+	if (area->bounds(minx, maxx, miny, maxy)) {
+		std::vector<size_t> nums;
+		pnts->get_index()->getPointsInRect(minx, maxx, miny, maxy, nums);
+		std::vector<size_t>::const_iterator ptr;
+		for (ptr = nums.begin(); ptr != nums.end(); ptr++) {
+			if ( area->in_region( (*(pnts->X))(*ptr), (*(pnts->Y))(*ptr) ) )
+				in_reg->set_true(*ptr);
+			else
+				in_reg->set_false(*ptr);
+		}
+	}
+
+	vec::iterator X_ptr = pnts->X->begin();
+	vec::iterator Y_ptr = pnts->Y->begin();
+	vec::iterator Z_ptr = pnts->Z->begin();
+
+	size_t i, new_size = 0;
+	for (i = 0; i < old_size; i++) {
+		if ( in_reg->get(i) == remove_inside )
+			continue;
+		*(X_ptr + new_size) = *(X_ptr + i);
+		*(Y_ptr + new_size) = *(Y_ptr + i);
+		*(Z_ptr + new_size) = *(Z_ptr + i);
+		new_size++;
+	}
+
+	in_reg->release();
+
+	pnts->resize(new_size);
+};
+
 struct match_fpfoa2
 {
 	match_fpfoa2(d_points * ipnts, const char * iarea_pos) : pnts(ipnts), area_pos(iarea_pos), res(NULL) {};
@@ -337,34 +464,8 @@ struct match_fpfoa2
 		{
 			writelog(LOG_MESSAGE,"removing points \"%s\" outside area \"%s\"",pnts->getName(), area->getName());
 			
-			size_t old_size = pnts->size();
-			
-			vec::iterator old_X_ptr = pnts->X->begin();
-			vec::iterator old_Y_ptr = pnts->Y->begin();
-			vec::iterator old_Z_ptr = pnts->Z->begin();
-			
-			vec::iterator new_X_ptr = pnts->X->begin();
-			vec::iterator new_Y_ptr = pnts->Y->begin();
-			vec::iterator new_Z_ptr = pnts->Z->begin();
-			
-			for (;old_X_ptr != pnts->X->end(); old_X_ptr++, old_Y_ptr++, old_Z_ptr++) {
-				
-				bool in_reg = area->in_region(*old_X_ptr, *old_Y_ptr);
-				if ( in_reg ) {
-					*new_X_ptr = *old_X_ptr;
-					*new_Y_ptr = *old_Y_ptr;
-					*new_Z_ptr = *old_Z_ptr;
-					new_X_ptr++;
-					new_Y_ptr++;
-					new_Z_ptr++;
-				}
-			}
-			
-			size_t new_size = new_X_ptr - pnts->X->begin();
-			
-			pnts->X->resize(new_size);
-			pnts->Y->resize(new_size);
-			pnts->Z->resize(new_size);
+			filter_pnts_by_area(pnts, area, false);
+
 			if (res == NULL)
 				res = create_boolvec();
 			res->push_back(true);
@@ -410,34 +511,7 @@ struct match_fpfia2
 		{
 			writelog(LOG_MESSAGE,"removing points \"%s\" inside area \"%s\"",pnts->getName(), area->getName());
 			
-			size_t old_size = pnts->size();
-			
-			vec::iterator old_X_ptr = pnts->X->begin();
-			vec::iterator old_Y_ptr = pnts->Y->begin();
-			vec::iterator old_Z_ptr = pnts->Z->begin();
-			
-			vec::iterator new_X_ptr = pnts->X->begin();
-			vec::iterator new_Y_ptr = pnts->Y->begin();
-			vec::iterator new_Z_ptr = pnts->Z->begin();
-			
-			for (;old_X_ptr != pnts->X->end(); old_X_ptr++, old_Y_ptr++, old_Z_ptr++) {
-				
-				bool in_reg = area->in_region(*old_X_ptr, *old_Y_ptr);
-				if ( !in_reg ) {
-					*new_X_ptr = *old_X_ptr;
-					*new_Y_ptr = *old_Y_ptr;
-					*new_Z_ptr = *old_Z_ptr;
-					new_X_ptr++;
-					new_Y_ptr++;
-					new_Z_ptr++;
-				}
-			}
-			
-			size_t new_size = new_X_ptr - pnts->X->begin();
-			
-			pnts->X->resize(new_size);
-			pnts->Y->resize(new_size);
-			pnts->Z->resize(new_size);
+			filter_pnts_by_area(pnts, area, true);
 
 			if (res == NULL)
 				res = create_boolvec();
@@ -508,9 +582,7 @@ struct match_fbm2
 				}
 			}
 			
-			pnts->X->resize(j);
-			pnts->Y->resize(j);
-			pnts->Z->resize(j);
+			pnts->resize(j);
 			if (res == NULL)
 				res = create_boolvec();
 			res->push_back(true);
@@ -830,20 +902,18 @@ struct pnts_oper_surf_plus : public pnts_oper_surf
 			return false;
 
 		size_t i;
-		REAL x,y,z, Z;
-		vec::iterator x_ptr = pnts->X->begin();
-		vec::iterator y_ptr = pnts->Y->begin();
+		REAL z, Z;
+		vec * values = _surf_sample_pnts(srf, pnts);
 		vec::iterator z_ptr = pnts->Z->begin();
 		for (i = 0; i < pnts->size(); i++) {
-			x = *(x_ptr + i);
-			y = *(y_ptr + i);
 			z = *(z_ptr + i);
-			Z = srf->getValue(x,y);
+			Z = (*values)(i);
 			if (Z != srf->undef_value) {
 				*(z_ptr + i) = z + Z;
 			}
 		}
 
+		values->release();
 		return true;
 	};
 };
@@ -865,20 +935,18 @@ struct pnts_oper_surf_minus : public pnts_oper_surf
 			return false;
 
 		size_t i;
-		REAL x,y,z, Z;
-		vec::iterator x_ptr = pnts->X->begin();
-		vec::iterator y_ptr = pnts->Y->begin();
+		REAL z, Z;
+		vec * values = _surf_sample_pnts(srf, pnts);
 		vec::iterator z_ptr = pnts->Z->begin();
 		for (i = 0; i < pnts->size(); i++) {
-			x = *(x_ptr + i);
-			y = *(y_ptr + i);
 			z = *(z_ptr + i);
-			Z = srf->getValue(x,y);
+			Z = (*values)(i);
 			if (Z != srf->undef_value) {
 				*(z_ptr + i) = z - Z;
 			}
 		}
 
+		values->release();
 		return true;
 	};
 };
@@ -900,20 +968,18 @@ struct pnts_oper_surf_mult : public pnts_oper_surf
 			return false;
 
 		size_t i;
-		REAL x,y,z, Z;
-		vec::iterator x_ptr = pnts->X->begin();
-		vec::iterator y_ptr = pnts->Y->begin();
+		REAL z, Z;
+		vec * values = _surf_sample_pnts(srf, pnts);
 		vec::iterator z_ptr = pnts->Z->begin();
 		for (i = 0; i < pnts->size(); i++) {
-			x = *(x_ptr + i);
-			y = *(y_ptr + i);
 			z = *(z_ptr + i);
-			Z = srf->getValue(x,y);
+			Z = (*values)(i);
 			if (Z != srf->undef_value) {
 				*(z_ptr + i) = z * Z;
 			}
 		}
 
+		values->release();
 		return true;
 	};
 };
@@ -935,15 +1001,12 @@ struct pnts_oper_surf_div : public pnts_oper_surf
 			return false;
 
 		size_t i;
-		REAL x,y,z, Z;
-		vec::iterator x_ptr = pnts->X->begin();
-		vec::iterator y_ptr = pnts->Y->begin();
+		REAL z, Z;
+		vec * values = _surf_sample_pnts(srf, pnts);
 		vec::iterator z_ptr = pnts->Z->begin();
 		for (i = 0; i < pnts->size(); i++) {
-			x = *(x_ptr + i);
-			y = *(y_ptr + i);
 			z = *(z_ptr + i);
-			Z = srf->getValue(x,y);
+			Z = (*values)(i);
 			if (Z != srf->undef_value) {
 				if (Z != 0)
 					*(z_ptr + i) = z / Z;
@@ -952,6 +1015,7 @@ struct pnts_oper_surf_div : public pnts_oper_surf
 			}
 		}
 
+		values->release();
 		return true;
 	};
 };
@@ -973,19 +1037,17 @@ struct pnts_oper_surf_set : public pnts_oper_surf
 			return false;
 
 		size_t i;
-		REAL x,y, Z;
-		vec::iterator x_ptr = pnts->X->begin();
-		vec::iterator y_ptr = pnts->Y->begin();
+		REAL Z;
+		vec * values = _surf_sample_pnts(srf, pnts);
 		vec::iterator z_ptr = pnts->Z->begin();
 		for (i = 0; i < pnts->size(); i++) {
-			x = *(x_ptr + i);
-			y = *(y_ptr + i);
-			Z = srf->getValue(x,y);
+			Z = (*values)(i);
 			if (Z != srf->undef_value) {
 				*(z_ptr + i) = Z;
 			}
 		}
 
+		values->release();
 		return true;
 	};
 };
@@ -1007,17 +1069,8 @@ struct match_pnts_update_by_surf2
 		{
 			if (res == NULL)
 				res = create_boolvec();
-			size_t i;
-			REAL x,y,z;
-			vec::iterator x_ptr = pnts->X->begin();
-			vec::iterator y_ptr = pnts->Y->begin();
-			vec::iterator z_ptr = pnts->Z->begin();
-			for (i = 0; i < pnts->size(); i++) {
-				x = *(x_ptr + i);
-				y = *(y_ptr + i);
-				z = surf->getValue(x,y);
-				*(z_ptr + i) = z;
-			}
+			// values are written over Z coordinates
+			_surf_sample(surf, pnts->X->begin(), pnts->Y->begin(), pnts->size(), pnts->Z->begin());
 			res->push_back(true);
 		}
 	}
@@ -1305,7 +1358,7 @@ struct match_pnts_transform
 		{
 			if (res == NULL)
 				res = create_boolvec();
-			_points_transform(pnts->X, pnts->Y, shiftX, scaleX, shiftY, scaleY);
+			pnts->transform(shiftX, scaleX, shiftY, scaleY);
 			res->push_back(true);
 		}
 	}
@@ -1418,9 +1471,7 @@ struct pnts_oper_concat : public pnts_oper
 		if (pnts1->Z == NULL)
 			pnts1->Z = create_vec();
 
-		pnts1->X->resize(cnt);
-		pnts1->Y->resize(cnt);
-		pnts1->Z->resize(cnt);
+		pnts1->resize(cnt);
 
 		vec::iterator ptr;
 
@@ -90,6 +90,36 @@ boolvec * pnts_read(const char * filename, const char * pntsname = NULL,
 SURFIT_EXPORT
 boolvec * pnts_save(const char * filename, const char * points_name = "*");
 
+/*! \ingroup tcl_pnts_save_load
+    \par Tcl syntax:
+    pnts_load_bin \ref file "filename" "pntsname" in_grid
+
+    \par Description:
+    reads \ref d_points "points" from binary points file (see \ref pnts_save_bin).
+    If in_grid is 1, only points inside current \ref d_grid "grid" are read, and 
+    only chunks intersecting with the grid are decoded.
+
+    \par Example:
+    pnts_load_bin "C:\\my_points.pbin" "my_points" 1
+*/
+SURFIT_EXPORT
+boolvec * pnts_load_bin(const char * filename, const char * pntsname = NULL, bool in_grid = false);
+
+/*! \ingroup tcl_pnts_save_load
+    \par Tcl syntax:
+    pnts_save_bin "filename" \ref str "points_name" float_columns
+
+    \par Description:
+    saves \ref d_points "points" to binary points file. Points are stored in chunks
+    with bounds index, for fast loading of subregions. If float_columns is 1, coordinates 
+    and values are stored as 4-byte floats. Points names are not saved.
+
+    \par Example
+    pnts_save_bin "C:\\points.pbin" "my_points"
+*/
+SURFIT_EXPORT
+boolvec * pnts_save_bin(const char * filename, const char * points_name = "*", bool float_columns = false);
+
 /*! \ingroup tcl_pnts_save_load
     \par Tcl syntax:
     pnts_write "filename" \ref str "points_name" "delimiter" 
@@ -285,6 +315,18 @@ vec * pnts_mean(const char * points_name = "*");
 SURFIT_EXPORT
 vec * pnts_std(REAL mean, const char * points_name = "*");
 
+/*! \ingroup tcl_pnts_math
+    \par Tcl syntax:
+    pnts_stats \ref str "points_name"
+
+    \par Description:
+    returns amount of defined values, minimum, maximum, mean, standard deviation 
+    and sum of Z values (six numbers for each \ref d_points "points"), calculated in one pass.
+    Standard deviation is divided by amount of defined values.
+*/
+SURFIT_EXPORT
+vec * pnts_stats(const char * points_name = "*");
+
 /*! \ingroup tcl_pnts_math
     \par Tcl syntax:
     pnts_plus \ref str "points_name1" \ref str "points_name2"
@@ -29,6 +29,8 @@
 #include "sort_alg.h"
 
 #include "points.h"
+#include "pnts_index.h"
+#include "surf_stats.h"
 #include "variables_tcl.h"
 #include "free_elements.h"
 
@@ -70,6 +72,7 @@ d_points::d_points() : data("pnts") {
 	Y = NULL;
 	Z = NULL;
 	names = NULL;
+	index = NULL;
 };
 
 d_points::d_points(vec *& iX, vec *& iY, vec *& iZ, 
@@ -82,6 +85,7 @@ d_points::d_points(vec *& iX, vec *& iY, vec *& iZ,
 	iZ = NULL;
 	setName(ipoints_name);
 	names = NULL;
+	index = NULL;
 };
 
 d_points::d_points(vec *& iX, vec *& iY, vec *& iZ,
@@ -96,6 +100,7 @@ d_points::d_points(vec *& iX, vec *& iY, vec *& iZ,
 	iZ = NULL;
 	setName(ipoints_name);
 	names = inames;
+	index = NULL;
 };
 
 d_points::~d_points() {
@@ -107,6 +112,7 @@ d_points::~d_points() {
 		Z->release();
 	if (names)
 		names->release();
+	drop_index();
 };
 
 size_t d_points::size() const {
@@ -140,15 +146,15 @@ REAL d_points::maxy() const {
 };
 
 REAL d_points::minz() const {
-	if (Z)
-		return *std::min_element(Z->begin(), Z->end());
-	return FLT_MAX;
+	stat_acc acc;
+	_pnts_stats(this, acc);
+	return acc.minz;
 };
 
 REAL d_points::maxz() const {
-	if (Z)
-		return *std::max_element(Z->begin(), Z->end());
-	return -FLT_MAX;
+	stat_acc acc;
+	_pnts_stats(this, acc);
+	return acc.maxz;
 };
 
 bool d_points::plus(const d_points * pnts) {
@@ -263,15 +269,18 @@ void d_points::set(REAL val) {
 
 
 REAL d_points::mean() const {
-	if (Z)
-		return mean_value(Z->const_begin(), Z->const_end(), undef_value);
-	return FLT_MAX;
+	stat_acc acc;
+	if (!_pnts_stats(this, acc))
+		return FLT_MAX;
+	return acc.sum/REAL(acc.cnt);
 };
 
 REAL d_points::std(REAL mean) const {
-	if (Z)
-		return std_value(mean, Z->const_begin(), Z->const_end(), undef_value);
-	return FLT_MAX;
+	stat_acc acc;
+	if (!_pnts_stats(this, acc))
+		return FLT_MAX;
+	// divided by all points
+	return acc.get_std(mean, size());
 };
 
 bool d_points::bounds(REAL & minx, REAL & maxx, REAL & miny, REAL & maxy) const {
@@ -284,11 +293,12 @@ bool d_points::bounds(REAL & minx, REAL & maxx, REAL & miny, REAL & maxy) const
 };
 
 bool d_points::getMinMaxZ(REAL & minz, REAL & maxz) const {
-	if (Z) {
-		minmax_value(Z->begin(), Z->end(), minz, maxz);
-		return true;
-	}
-	return false;
+	stat_acc acc;
+	if (!_pnts_stats(this, acc))
+		return false;
+	minz = acc.minz;
+	maxz = acc.maxz;
+	return true;
 };
 
 void d_points::remove_with_value(REAL val) {
@@ -307,10 +317,40 @@ void d_points::remove_with_value(REAL val) {
 		
 	}
 
-	X->resize(j);
-	Y->resize(j);
-	Z->resize(j);
+	resize(j);
+};
 
+void d_points::resize(size_t new_size) {
+	if (X)
+		X->resize(new_size);
+	if (Y)
+		Y->resize(new_size);
+	if (Z)
+		Z->resize(new_size);
+	drop_index();
+};
+
+void d_points::transform(REAL shiftX, REAL scaleX, REAL shiftY, REAL scaleY) {
+	if ((X == NULL) || (Y == NULL))
+		return;
+	_points_transform(X, Y, shiftX, scaleX, shiftY, scaleY);
+	drop_index();
+};
+
+const pnts_index * d_points::get_index() const {
+	if (index) {
+		if (index->check(this))
+			return index;
+		drop_index();
+	}
+	index = create_pnts_index(this);
+	return index;
+};
+
+void d_points::drop_index() const {
+	if (index)
+		index->release();
+	index = NULL;
 };
 
 void d_points::abs() {
@@ -461,6 +501,8 @@ void _inverse_points_transform(d_points * pnts,
 	
 	for (ptr_Y = pnts->Y->begin(); ptr_Y != pnts->Y->end(); ptr_Y++) 
         	*ptr_Y = *ptr_Y/scaleY + shiftY;
+
+	pnts->drop_index();
 };
 
 
@@ -29,6 +29,7 @@ namespace surfit {
 class vec;
 class strvec;
 class d_points;
+class pnts_index;
 
 //! constructs default \ref d_points object
 SURFIT_EXPORT
@@ -180,6 +181,25 @@ public:
 	//! removes all points with z == val
 	void remove_with_value(REAL val);
 
+	//! changes amount of points (unused X, Y and Z values are dropped), removes spatial index
+	void resize(size_t new_size);
+
+	//! transforms coordinates: x = (x - shiftX)*scaleX, y = (y - shiftY)*scaleY, removes spatial index
+	void transform(REAL shiftX, REAL scaleX, REAL shiftY, REAL scaleY);
+
+	//! returns spatial index for points (index is built on the first call)
+	const pnts_index * get_index() const;
+
+	/*! \brief removes spatial index
+	    Methods of d_points changing coordinates call it, code changing X or Y directly should call it too.
+	*/
+	void drop_index() const;
+
+private:
+
+	//! spatial index for points
+	mutable pnts_index * index;
+
 };
 
 //! collection of \ref d_points objects (scattered data-points)
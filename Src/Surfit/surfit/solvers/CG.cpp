@@ -31,7 +31,7 @@
 #include "../variables_tcl.h"
 
 #ifdef XXL
-#include "../../src_xxl/sstuff/solvers_xxl.h"
+#include "../../../src_xxl/sstuff/solvers_xxl.h"
 #endif
 
 using namespace std;
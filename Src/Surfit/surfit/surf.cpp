@@ -37,6 +37,7 @@
 #include "free_elements.h"
 #include "grid_internal.h"
 #include "surf_internal.h"
+#include "surf_stats.h"
 
 #include "grid_user.h"
 
@@ -57,11 +58,13 @@ d_surf::d_surf(extvec *icoeff, d_grid *igrd,
 	setName(newname);
 	undef_value = FLT_MAX;
 
-	details_d = new std::vector<extvec*>;
-	details_h = new std::vector<extvec*>;
-	details_v = new std::vector<extvec*>;
+	details = create_extvec();
 	enlarges_X = new std::vector<bool>;
 	enlarges_Y = new std::vector<bool>;
+	sums = NULL;
+	sums_cnt = NULL;
+	sums_base = 0;
+	sums_users = 0;
 	
 };
 
@@ -80,11 +83,13 @@ d_surf::d_surf(d_mask * msk) : data("surf") {
 	setName(msk->getName());
 	undef_value = FLT_MAX;
 
-	details_d = new std::vector<extvec*>;
-	details_h = new std::vector<extvec*>;
-	details_v = new std::vector<extvec*>;
+	details = create_extvec();
 	enlarges_X = new std::vector<bool>;
 	enlarges_Y = new std::vector<bool>;
+	sums = NULL;
+	sums_cnt = NULL;
+	sums_base = 0;
+	sums_users = 0;
 };
 
 d_surf::~d_surf() {
@@ -92,27 +97,10 @@ d_surf::~d_surf() {
 		grd->release();
 	if (coeff)
 		coeff->release();
+	drop_sums();
 	
-	std::vector<extvec*>::iterator it;
-	
-	for (it = details_h->begin(); it != details_h->end(); it++) {
-		if (*it)
-			(*it)->release();
-	}
-	delete details_h;
-
-	for (it = details_v->begin(); it != details_v->end(); it++) {
-		if (*it)
-			(*it)->release();
-	}
-	delete details_v;
-
-	for (it = details_d->begin(); it != details_d->end(); it++) {
-		if (*it)
-			(*it)->release();
-	}
-	delete details_d;
-
+	if (details)
+		details->release();
 	delete enlarges_X;
 	delete enlarges_Y;
 };
@@ -130,28 +118,10 @@ bool d_surf::getMinMaxZ(REAL & minZ, REAL & maxZ) const {
 };
 
 bool d_surf::getMinMaxZ_mask(REAL & minZ, REAL & maxZ, const bitvec * msk) const {
-	size_t i;
-	REAL value;
-
-	minZ = FLT_MAX;
-	maxZ = -FLT_MAX;
-
-	for (i = 0; i < grd->getCountX()*grd->getCountY(); i++) {
-
-		if (msk) {
-			if (msk->get(i) == false)
-				continue;
-		}
-
-		value = (*coeff)(i);
-		if (value == this->undef_value)
-			continue;
-
-		minZ = MIN(minZ, value);
-		maxZ = MAX(maxZ, value);
-
-	}
-
+	stat_acc acc;
+	_surf_stats(this, acc, msk);
+	minZ = acc.minz;
+	maxZ = acc.maxz;
 	return true;
 };
 
@@ -170,7 +140,7 @@ REAL d_surf::getValue(REAL x, REAL y) const {
 	if ((j >= grd->getCountY()) || (j < 0))
 		return undef_value;
 
-	return (*coeff)( i + grd->getCountX()*j );
+	return getValue( i + grd->getCountX()*j );
 			
 };
 
@@ -200,10 +170,10 @@ REAL d_surf::getInterpValue(REAL x, REAL y) const {
 	
 	getCoordNode(I0, J0, x0, y0);
 	
-	z0 = (*(coeff))(I0 + surf_sizeX*J0);
-	z1 = (*(coeff))(I1 + surf_sizeX*J0);
-	z2 = (*(coeff))(I1 + surf_sizeX*J1);
-	z3 = (*(coeff))(I0 + surf_sizeX*J1);
+	z0 = getValue(I0 + surf_sizeX*J0);
+	z1 = getValue(I1 + surf_sizeX*J0);
+	z2 = getValue(I1 + surf_sizeX*J1);
+	z3 = getValue(I0 + surf_sizeX*J1);
 	
 	if (
 		(z0 == this->undef_value) ||
@@ -278,23 +248,8 @@ REAL d_surf::getMeanValue(REAL x_from, REAL x_to, REAL y_from, REAL y_to) const
 	j_to   = get_j(y_to);
 	j_to   = MIN(j_to, getCountY()-1);
 
-	size_t NN = getCountX();
-
-	size_t i,j;
 	size_t cnt = 0;
-	REAL sum_value = 0;
-	REAL value;
-	for (j = j_from; j <= j_to; j++) {
-		for (i = i_from; i <= i_to; i++) {
-		
-			size_t pos = i + j*NN;
-			value = (*coeff)(pos);
-			if (value == this->undef_value)
-				continue;
-			sum_value += value;
-			cnt++;
-		};
-	};
+	REAL sum_value = getSumValue(i_from, i_to, j_from, j_to, cnt);
 
 	if (cnt == 0)
 		return this->undef_value;
@@ -304,6 +259,96 @@ REAL d_surf::getMeanValue(REAL x_from, REAL x_to, REAL y_from, REAL y_to) const
 
 };
 
+REAL d_surf::getSumValue(size_t i_from, size_t i_to, size_t j_from, size_t j_to, size_t & cnt) const {
+	
+	cnt = 0;
+	if ((i_from > i_to) || (j_from > j_to))
+		return 0;
+
+	size_t NN = getCountX();
+	size_t i,j;
+
+	if (sums == NULL) {
+		REAL sum_value = 0;
+		REAL value;
+		for (j = j_from; j <= j_to; j++) {
+			for (i = i_from; i <= i_to; i++) {
+				value = getValue(i + j*NN);
+				if (value == this->undef_value)
+					continue;
+				sum_value += value;
+				cnt++;
+			}
+		}
+		return sum_value;
+	}
+
+	// tables have one more row and column with zeros
+	size_t W = NN+1;
+	size_t p00 = i_from + j_from*W;
+	size_t p10 = (i_to + 1) + j_from*W;
+	size_t p01 = i_from + (j_to + 1)*W;
+	size_t p11 = (i_to + 1) + (j_to + 1)*W;
+	REAL c = (*sums_cnt)(p11) - (*sums_cnt)(p10) - (*sums_cnt)(p01) + (*sums_cnt)(p00);
+	REAL s = (*sums)(p11) - (*sums)(p10) - (*sums)(p01) + (*sums)(p00);
+	cnt = (size_t)(c + REAL(0.5));
+	return s + REAL(cnt)*sums_base;
+
+};
+
+void d_surf::hold_sums() const {
+	sums_users++;
+	if (sums == NULL)
+		build_sums();
+};
+
+void d_surf::release_sums() const {
+	if (sums_users == 0)
+		return;
+	sums_users--;
+	if (sums_users == 0)
+		drop_sums();
+};
+
+void d_surf::build_sums() const {
+
+	size_t NN = getCountX();
+	size_t MM = getCountY();
+	size_t W = NN+1;
+
+	stat_acc acc;
+	_surf_stats(this, acc);
+	sums_base = acc.get_mean(0);
+
+	sums = create_extvec(W*(MM+1), 0);
+	sums_cnt = create_extvec(W*(MM+1), 0);
+
+	size_t i, j;
+	for (j = 0; j < MM; j++) {
+		REAL row_sum = 0, row_cnt = 0;
+		for (i = 0; i < NN; i++) {
+			REAL value = getValue(i + j*NN);
+			if (value != this->undef_value) {
+				row_sum += value - sums_base;
+				row_cnt += 1;
+			}
+			size_t pos = (i+1) + (j+1)*W;
+			(*sums)(pos) = (*sums)(pos - W) + row_sum;
+			(*sums_cnt)(pos) = (*sums_cnt)(pos - W) + row_cnt;
+		}
+	}
+
+};
+
+void d_surf::drop_sums() const {
+	if (sums)
+		sums->release();
+	sums = NULL;
+	if (sums_cnt)
+		sums_cnt->release();
+	sums_cnt = NULL;
+};
+
 REAL d_surf::getValueIJ(size_t I, size_t J) const {
 	if (I < 0)
 		return FLT_MAX;
@@ -322,6 +367,9 @@ REAL d_surf::getValue(size_t pos) const {
 };
 
 void d_surf::setValue(size_t pos, REAL val) {
+	// summed-area tables are dropped, queries are calculated directly until the next hold_sums
+	if (sums)
+		drop_sums();
 	(*coeff)( pos ) = val;
 }
 
@@ -353,7 +401,7 @@ bool d_surf::writeTags(datafile *df) const {
 	}
 	
 	op = grd->writeTags(df);			res = (res && op);
-	op = df->writeRealArray("coeff", coeff); res = (res && op);
+	op = df->writeRealArray("coeff", coeff, getCountX()); res = (res && op);
 	op = df->writeReal("undef_value", undef_value); res = (res && op);
 	op = df->writeEndTag();					res = (res && op);
 
@@ -398,78 +446,36 @@ size_t d_surf::get_j(REAL y) const {
 };
 
 REAL d_surf::mean() const {
-	return mean_value(coeff->const_begin(), coeff->const_end(), undef_value);
+	stat_acc acc;
+	_surf_stats(this, acc);
+	return acc.sum/REAL(acc.cnt);
 };
 
 REAL d_surf::wmean(const d_surf * wsrf) const {
-	
-	REAL res = REAL(0);
-
-	size_t aux_X_from, aux_X_to;
-	size_t aux_Y_from, aux_Y_to;
-	
-	_grid_intersect1(grd, wsrf->grd, aux_X_from, aux_X_to, aux_Y_from, aux_Y_to);
-	d_grid * aux_grid = _create_sub_grid(grd, aux_X_from, aux_X_to, aux_Y_from, aux_Y_to);
-	
-	d_surf * w_srf = _surf_project(wsrf, aux_grid);
-
-	size_t nn = aux_grid->getCountX();
-	size_t mm = aux_grid->getCountY();
-
-	size_t NN = getCountX();
-	size_t MM = getCountY();
-
-	REAL denom = 0;
-	REAL sum = 0;
-
-	size_t i, j, pos;
-	for (i = 0; i < NN; i++) {
-		for (j = 0; j < MM; j++) {
-			
-			pos = two2one(i, j, NN, MM);
-
-			REAL value = (*coeff)(pos);
-			if (value == this->undef_value)
-				continue;
-
-			REAL weight = 0;
-			if ((i >= aux_X_from) && (i <= aux_X_to) && (j >= aux_Y_from) && (j <= aux_Y_to)) {
-				size_t I = i-aux_X_from;
-				size_t J = j-aux_Y_from;
-				weight = (*(w_srf->coeff))(I + J*nn);
-				if (weight == w_srf->undef_value)
-					weight = 0;
-			}
-			
-			if (weight <= 0)
-				continue;
-
-			denom += weight;
-			sum += weight*value;
-
-		}
-	}
-
-	if (aux_grid)
-		aux_grid->release();
-	
-	delete w_srf;
-	
-	return sum/denom;
+	d_surf * w_srf = _surf_stats_weights(this, wsrf);
+	stat_acc acc;
+	_surf_stats(this, acc, NULL, w_srf);
+	w_srf->release();
+	return acc.get_wmean(undef_value);
 };
 
 REAL d_surf::std(REAL mean) const {
-	return std_value(mean, coeff->begin(), coeff->end(), undef_value);
+	stat_acc acc;
+	_surf_stats(this, acc);
+	// divided by all nodes
+	return acc.get_std(mean, getCountX()*getCountY());
 };
 
 REAL d_surf::sum() const {
-	return sum_value(coeff->begin(), coeff->end(), undef_value);
+	stat_acc acc;
+	_surf_stats(this, acc);
+	return acc.sum;
 };
 
 bool d_surf::compare_grid(const d_surf * srf) const {
 	return ( 
 		(grd->operator ==(srf->grd)) &&
-		(coeff->size() == srf->coeff->size())
+		(getCountX()*getCountY() == srf->getCountX()*srf->getCountY())
 	       );
 };
 
@@ -477,7 +483,7 @@ void d_surf::plus(const d_surf * srf) {
 	size_t i;
 	REAL val1, val2;
 	for (i = 0; i < coeff->size(); i++) {
-		val1 = (*srf->coeff)(i);
+		val1 = srf->getValue(i);
 		val2 = (*coeff)(i);
 		if ((val1 != srf->undef_value) && (val2 != this->undef_value))
 			(*coeff)(i) += val1;
@@ -490,7 +496,7 @@ void d_surf::plus_mask(const d_surf * srf, const bitvec * mask) {
 	for (i = 0; i < coeff->size(); i++) {
 		if (mask->get(i) == false)
 			continue;
-		val1 = (*srf->coeff)(i);
+		val1 = srf->getValue(i);
 		val2 = (*coeff)(i);
 		if ((val1 != srf->undef_value) && (val2 != this->undef_value))
 			(*coeff)(i) += val1;
@@ -501,7 +507,7 @@ void d_surf::minus(const d_surf * srf) {
 	size_t i;
 	REAL val1, val2;
 	for (i = 0; i < coeff->size(); i++) {
-		val1 = (*srf->coeff)(i);
+		val1 = srf->getValue(i);
 		val2 = (*coeff)(i);
 		if ((val1 != srf->undef_value) && (val2 != this->undef_value))
 			(*coeff)(i) -= val1;
@@ -514,7 +520,7 @@ void d_surf::minus_mask(const d_surf * srf, const bitvec * mask) {
 	for (i = 0; i < coeff->size(); i++) {
 		if (mask->get(i) == false)
 			continue;
-		val1 = (*srf->coeff)(i);
+		val1 = srf->getValue(i);
 		val2 = (*coeff)(i);
 		if ((val1 != srf->undef_value) && (val2 != this->undef_value))
 			(*coeff)(i) -= val1;
@@ -525,7 +531,7 @@ void d_surf::mult(const d_surf * srf) {
 	size_t i;
 	REAL val1, val2;
 	for (i = 0; i < coeff->size(); i++) {
-		val1 = (*srf->coeff)(i);
+		val1 = srf->getValue(i);
 		val2 = (*coeff)(i);
 		if ((val1 != srf->undef_value) && (val2 != this->undef_value))
 			(*coeff)(i) *= val1;
@@ -538,7 +544,7 @@ void d_surf::mult_mask(const d_surf * srf, const bitvec * mask) {
 	for (i = 0; i < coeff->size(); i++) {
 		if (mask->get(i) == false)
 			continue;
-		val1 = (*srf->coeff)(i);
+		val1 = srf->getValue(i);
 		val2 = (*coeff)(i);
 		if ((val1 != srf->undef_value) && (val2 != this->undef_value))
 			(*coeff)(i) *= val1;
@@ -549,7 +555,7 @@ void d_surf::div(const d_surf * srf) {
 	size_t i;
 	REAL val1, val2;
 	for (i = 0; i < coeff->size(); i++) {
-		val1 = (*srf->coeff)(i);
+		val1 = srf->getValue(i);
 		val2 = (*coeff)(i);
 		if ((val1 != srf->undef_value) && (val2 != this->undef_value))
 			(*coeff)(i) /= val1;
@@ -565,7 +571,7 @@ void d_surf::div_mask(const d_surf * srf, const bitvec * mask) {
 	for (i = 0; i < coeff->size(); i++) {
 		if (mask->get(i) == false)
 			continue;
-		val1 = (*srf->coeff)(i);
+		val1 = srf->getValue(i);
 		val2 = (*coeff)(i);
 		if ((val1 != srf->undef_value) && (val2 != this->undef_value))
 			(*coeff)(i) /= val1;
@@ -579,7 +585,7 @@ void d_surf::set(const d_surf * srf) {
 	size_t i;
 	REAL val1, val2;
 	for (i = 0; i < coeff->size(); i++) {
-		val1 = (*srf->coeff)(i);
+		val1 = srf->getValue(i);
 		val2 = (*coeff)(i);
 		if ((val1 != srf->undef_value) && (val2 != this->undef_value))
 			(*coeff)(i) = val1;
@@ -592,7 +598,7 @@ void d_surf::set_mask(const d_surf * srf, const bitvec * mask) {
 	for (i = 0; i < coeff->size(); i++) {
 		if (mask->get(i) == false)
 			continue;
-		val1 = (*srf->coeff)(i);
+		val1 = srf->getValue(i);
 		val2 = (*coeff)(i);
 		if ((val1 != srf->undef_value) && (val2 != this->undef_value))
 			(*coeff)(i) = val1;
@@ -716,7 +722,7 @@ void d_surf::set_mask(REAL val, const bitvec * mask) {
 //
 
 size_t d_surf::details_size() const {
-	return 1+MIN(details_h->size(),MIN(details_v->size(),details_d->size()));
+	return 1+enlarges_X->size();
 };
 
 bool d_surf::decompose() {
@@ -739,32 +745,21 @@ bool d_surf::decompose() {
 	if (N <= 1)
 		return false;
 
-	extvec * xa = NULL; // new approx vector
-	extvec * xd = NULL; // diagonal details
-	extvec * xh = NULL; // horizontal details
-	extvec * xv = NULL; // vertical details
-
-	_decomp2d(coeff, 
-		  xa,
-		  xd,
-		  xh,
-		  xv,
-		  grd->getCountX(), grd->getCountY(),
-		  enlarge_X,
-		  enlarge_Y,
+	// details of new level are appended to the end of details
+	size_t nn = (countX+1)/2;
+	size_t mm = (countY+1)/2;
+	size_t pos = details->size();
+	details->resize(pos + 3*nn*mm, 0, false);
+
+	_decomp2d(coeff,
+		  countX, countY,
+		  details->begin() + pos,
 		  undef_value,
-		  (details_d->size() % 2 == 1));
+		  (enlarges_X->size() % 2 == 1));
 
-	details_d->push_back(xd);
-	details_h->push_back(xh);
-	details_v->push_back(xv);
 	enlarges_X->push_back(enlarge_X);
 	enlarges_Y->push_back(enlarge_Y);
 
-	if (coeff)
-		coeff->release();
-	coeff = xa;
-
 	size_t new_size_x = 0;
 	if (enlarge_X) {
 		new_size_x = (grd->getCountX() + 1) / 2;
@@ -835,65 +830,50 @@ bool d_surf::reconstruct() {
 	
 	writelog(LOG_MESSAGE,"reconstructing surface \"%s\"",getName());
 
-	size_t N = details_d->size();
+	size_t N = enlarges_X->size();
 
 	if (N == 0)
 		return false;
 
-	extvec * approx = NULL;
-
-	std::vector<extvec*>::iterator d_it = details_d->end()-1;
-	std::vector<extvec*>::iterator h_it = details_h->end()-1;
-	std::vector<extvec*>::iterator v_it = details_v->end()-1;
-	std::vector<bool>::iterator b_itX = enlarges_X->end()-1;
-	std::vector<bool>::iterator b_itY = enlarges_Y->end()-1;
-
-	_recons2d(approx,
-		  coeff,
-		  (*d_it),
-		  (*h_it),
-		  (*v_it),
-		  grd->getCountX(), grd->getCountY(),
-		  *b_itX,
-		  *b_itY,
+	bool enlarge_X = enlarges_X->back();
+	bool enlarge_Y = enlarges_Y->back();
+
+	size_t nn = grd->getCountX();
+	size_t mm = grd->getCountY();
+	size_t countX = 2*nn - (enlarge_X ? 1 : 0);
+	size_t countY = 2*mm - (enlarge_Y ? 1 : 0);
+	size_t pos = details->size() - 3*nn*mm;
+
+	_recons2d(coeff,
+		  countX, countY,
+		  details->const_begin() + pos,
 		  undef_value,
-		  ((details_d->size() + 1) % 2 == 1));
-							   
-	if (coeff)
-		coeff->release();
-	if (*d_it)
-		(*d_it)->release(); 
-	details_d->erase(d_it);
-	if (*h_it)
-		(*h_it)->release();
-	details_h->erase(h_it);
-	if (*v_it)
-		(*v_it)->release();
-	details_v->erase(v_it);
-	
-	coeff = approx;
+		  ((N - 1) % 2 == 1));
+
+	if (pos == 0) {
+		details->release();
+		details = create_extvec();
+	} else
+		details->resize(pos);
 
 	// X
 	size_t new_count_x = grd->getCountX()*2;
 	grd->stepX  /= REAL(2);
 	grd->startX -= grd->stepX/REAL(2);
 	grd->endX    = grd->startX + grd->stepX*(new_count_x-1);
-	if (*b_itX)
+	if (enlarge_X)
 		grd->endX -= grd->stepX;
 
 	size_t new_count_y = grd->getCountY()*2;
 	grd->stepY  /= REAL(2);
 	grd->startY -= grd->stepY/REAL(2);
 	grd->endY    = grd->startY + grd->stepY*(new_count_y-1);
-	if (*b_itY)
+	if (enlarge_Y)
 		grd->endY -= grd->stepY;
 
-	enlarges_X->erase(b_itX);
-	enlarges_Y->erase(b_itY);
+	enlarges_X->pop_back();
+	enlarges_Y->pop_back();
 
-	size_t check_x = getCountX();
-	size_t check_y = getCountY();
-	
 	return true;
 };
 
@@ -901,12 +881,12 @@ bool d_surf::full_reconstruct() {
 
 	writelog(LOG_MESSAGE,"making full surface \"%s\" reconstruction", getName());
 	
-	size_t N = details_d->size();
+	size_t N = enlarges_X->size();
 	bool res = true;
 
 	while ( (N > 0) && res ) {
 		res = reconstruct() && res;
-		N = details_d->size();
+		N = enlarges_X->size();
 	}
 
 	return res;
@@ -924,16 +904,9 @@ bool d_surf::add_noise(REAL std) {
 };
 
 size_t d_surf::defined() const {
-	size_t defined = 0;
-	size_t i;
-	if (coeff) {
-		extvec::const_iterator ptr = coeff->const_begin();
-		for (i = 0; i < coeff->size(); i++) {
-			if ( *(ptr+i) != undef_value )
-				defined++;
-		}
-	};
-	return defined;
+	stat_acc acc;
+	_surf_stats(this, acc);
+	return acc.cnt;
 };
 
 void d_surf::set_undef_value(REAL new_undef_value) {
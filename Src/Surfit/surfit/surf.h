@@ -80,6 +80,23 @@ public:
 	//! calculates surface mean value for rect
 	virtual REAL getMeanValue(REAL x_from, REAL x_to, REAL y_from, REAL y_to) const;
 
+	/*! \brief calculates sum of defined values for nodes [i_from, i_to] x [j_from, j_to]
+	    \param cnt amount of defined nodes in rect
+
+	    Takes constant time while summed-area tables are held (see \ref hold_sums),
+	    otherwise all nodes of the rect are summed.
+	*/
+	virtual REAL getSumValue(size_t i_from, size_t i_to, size_t j_from, size_t j_to, size_t & cnt) const;
+
+	/*! \brief builds summed-area tables for \ref getSumValue and \ref getMeanValue
+	    Tables are kept until the matching \ref release_sums call, so the caller 
+	    running many queries decides how long they live. setValue drops them.
+	*/
+	virtual void hold_sums() const;
+
+	//! releases summed-area tables built by \ref hold_sums
+	virtual void release_sums() const;
+
 	//! returns surface value at node (i,j)
 	virtual REAL getValueIJ(size_t i, size_t j) const;
 
@@ -244,14 +261,8 @@ public:
 	//! all values in coeff equal to undef_value interprets as undefined
 	REAL undef_value;
 
-	//! horizontal details
-	std::vector<extvec *> * details_h;
- 
-	//! vertical details
-	std::vector<extvec *> * details_v; 
-
-	//! diagonal details
-	std::vector<extvec *> * details_d; 
+	//! horizontal, vertical and diagonal details of all decomposition levels, level by level
+	extvec * details;
 
 	//! X-direction enlarges
 	std::vector<bool>  * enlarges_X; 
@@ -259,6 +270,23 @@ public:
 	//! Y-direction enlarges
 	std::vector<bool>  * enlarges_Y; 
 
+protected:
+
+	//! builds summed-area tables
+	void build_sums() const;
+
+	//! drops summed-area tables
+	void drop_sums() const;
+
+	//! summed-area table of (value - sums_base) for defined nodes, (NN+1) x (MM+1) values
+	mutable extvec * sums;
+	//! summed-area table of amounts of defined nodes
+	mutable extvec * sums_cnt;
+	//! values are summed relative to this value to keep precision
+	mutable REAL sums_base;
+	//! amount of \ref hold_sums calls without \ref release_sums
+	mutable size_t sums_users;
+
 };
 
 //! container for \ref d_surf objects
@@ -0,0 +1,715 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/vec.h"
+#include "../sstuff/bitvec.h"
+#include "../sstuff/threads.h"
+
+#include "surf_expr.h"
+#include "surf.h"
+#include "surf_float.h"
+#include "grid.h"
+#include "grid_line.h"
+#include "area.h"
+#include "mask.h"
+#include "variables_tcl.h"
+#include "grid_user.h"
+
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+namespace surfit {
+
+//! amount of nodes processed by one instruction
+#define SURF_EXPR_CHUNK 256
+
+// instructions of the stack machine
+enum {
+	EXPR_SURF, EXPR_CONST, EXPR_X, EXPR_Y,
+	// unary operations
+	EXPR_NEG, EXPR_ABS, EXPR_SQRT, EXPR_EXP, EXPR_LOG, EXPR_LOG10,
+	EXPR_SIN, EXPR_COS, EXPR_TAN, EXPR_ASIN, EXPR_ACOS, EXPR_ATAN, EXPR_FLOOR, EXPR_CEIL,
+	// binary operations
+	EXPR_ADD, EXPR_SUB, EXPR_MUL, EXPR_DIV, EXPR_POW, EXPR_MIN, EXPR_MAX, EXPR_ATAN2
+};
+
+//! function of expression
+struct expr_func {
+	const char * name;
+	int op;
+	//! amount of arguments
+	int args;
+};
+
+static const expr_func expr_funcs[] = {
+	{ "abs",   EXPR_ABS,   1 },
+	{ "sqrt",  EXPR_SQRT,  1 },
+	{ "exp",   EXPR_EXP,   1 },
+	{ "log",   EXPR_LOG,   1 },
+	{ "log10", EXPR_LOG10, 1 },
+	{ "sin",   EXPR_SIN,   1 },
+	{ "cos",   EXPR_COS,   1 },
+	{ "tan",   EXPR_TAN,   1 },
+	{ "asin",  EXPR_ASIN,  1 },
+	{ "acos",  EXPR_ACOS,  1 },
+	{ "atan",  EXPR_ATAN,  1 },
+	{ "floor", EXPR_FLOOR, 1 },
+	{ "ceil",  EXPR_CEIL,  1 },
+	{ "min",   EXPR_MIN,   2 },
+	{ "max",   EXPR_MAX,   2 },
+	{ "pow",   EXPR_POW,   2 },
+	{ "atan2", EXPR_ATAN2, 2 },
+	{ NULL, 0, 0 }
+};
+
+/*! \class surf_expr_parser
+    \brief recursive descent parser for \ref surf_expression
+
+    grammar:
+    \code
+    expr    := term { ('+'|'-') term }
+    term    := unary { ('*'|'/') unary }
+    unary   := ('-'|'+') unary | power
+    power   := primary [ '^' unary ]
+    primary := number | name | 'quoted name' | x | y | func '(' expr [',' expr] ')' | '(' expr ')'
+    \endcode
+*/
+class surf_expr_parser {
+public:
+	surf_expr_parser(const char * itext, surf_expression * iexpr) : text(itext), p(itext), expr(iexpr), sp(0), ok(true) {};
+
+	bool parse() {
+		parse_expr();
+		skip();
+		if (ok && (*p != '\0'))
+			error("unexpected symbol");
+		return ok;
+	};
+
+private:
+
+	void error(const char * msg) {
+		if (ok)
+			writelog(LOG_ERROR, "surf_expr : %s at position %d in \"%s\"", msg, (int)(p - text) + 1, text);
+		ok = false;
+	};
+
+	void skip() {
+		while (isspace((unsigned char)*p))
+			p++;
+	};
+
+	void emit(int op, size_t arg = 0, REAL value = 0) {
+		surf_expression::instr i;
+		i.op = op;
+		i.arg = arg;
+		i.value = value;
+		expr->code.push_back(i);
+		if (op <= EXPR_Y) {
+			sp++;
+			expr->depth = MAX(expr->depth, sp);
+		} else if (op >= EXPR_ADD)
+			sp--;
+	};
+
+	void emit_name(const char * name, size_t len) {
+		size_t n;
+		for (n = 0; n < expr->names.size(); n++) {
+			if ((strlen(expr->names[n]) == len) && (strncmp(expr->names[n], name, len) == 0))
+				break;
+		}
+		if (n == expr->names.size()) {
+			char * s = (char *)malloc(len + 1);
+			memcpy(s, name, len);
+			s[len] = '\0';
+			expr->names.push_back(s);
+		}
+		emit(EXPR_SURF, n);
+	};
+
+	void parse_expr() {
+		parse_term();
+		while (ok) {
+			skip();
+			if ((*p != '+') && (*p != '-'))
+				break;
+			int op = (*p == '+') ? EXPR_ADD : EXPR_SUB;
+			p++;
+			parse_term();
+			emit(op);
+		}
+	};
+
+	void parse_term() {
+		parse_unary();
+		while (ok) {
+			skip();
+			if ((*p != '*') && (*p != '/'))
+				break;
+			int op = (*p == '*') ? EXPR_MUL : EXPR_DIV;
+			p++;
+			parse_unary();
+			emit(op);
+		}
+	};
+
+	void parse_unary() {
+		skip();
+		if (*p == '-') {
+			p++;
+			parse_unary();
+			emit(EXPR_NEG);
+			return;
+		}
+		if (*p == '+') {
+			p++;
+			parse_unary();
+			return;
+		}
+		parse_power();
+	};
+
+	void parse_power() {
+		parse_primary();
+		skip();
+		if (ok && (*p == '^')) {
+			p++;
+			parse_unary();
+			emit(EXPR_POW);
+		}
+	};
+
+	void parse_primary() {
+		if (!ok)
+			return;
+		skip();
+
+		if (*p == '(') {
+			p++;
+			parse_expr();
+			skip();
+			if (*p != ')') {
+				error("')' expected");
+				return;
+			}
+			p++;
+			return;
+		}
+
+		if (isdigit((unsigned char)*p) || (*p == '.')) {
+			char * end = NULL;
+			double value = strtod(p, &end);
+			if (end == p) {
+				error("bad number");
+				return;
+			}
+			p = end;
+			emit(EXPR_CONST, 0, (REAL)value);
+			return;
+		}
+
+		if (*p == '\'') {
+			const char * from = ++p;
+			while ((*p != '\'') && (*p != '\0'))
+				p++;
+			if (*p != '\'') {
+				error("closing quote expected");
+				return;
+			}
+			emit_name(from, p - from);
+			p++;
+			return;
+		}
+
+		if (isalpha((unsigned char)*p) || (*p == '_')) {
+			const char * from = p;
+			while (isalnum((unsigned char)*p) || (*p == '_') || (*p == '.'))
+				p++;
+			size_t len = p - from;
+			skip();
+			if (*p == '(') {
+				const expr_func * f;
+				for (f = expr_funcs; f->name; f++) {
+					if ((strlen(f->name) == len) && (strncmp(f->name, from, len) == 0))
+						break;
+				}
+				if (f->name == NULL) {
+					p = from;
+					error("unknown function");
+					return;
+				}
+				p++;
+				parse_expr();
+				if (f->args == 2) {
+					skip();
+					if (*p != ',') {
+						error("',' expected");
+						return;
+					}
+					p++;
+					parse_expr();
+				}
+				skip();
+				if (*p != ')') {
+					error("')' expected");
+					return;
+				}
+				p++;
+				emit(f->op);
+				return;
+			}
+			if ((len == 1) && (*from == 'x'))
+				emit(EXPR_X);
+			else if ((len == 1) && (*from == 'y'))
+				emit(EXPR_Y);
+			else
+				emit_name(from, len);
+			return;
+		}
+
+		if (*p == '\0')
+			error("unexpected end of expression");
+		else
+			error("unexpected symbol");
+	};
+
+	const char * text;
+	const char * p;
+	surf_expression * expr;
+	//! current stack depth
+	size_t sp;
+	bool ok;
+};
+
+surf_expression * create_surf_expression(const char * text) {
+	surf_expression * res = new surf_expression();
+	surf_expr_parser parser(text, res);
+	if (!parser.parse()) {
+		res->release();
+		return NULL;
+	}
+	return res;
+};
+
+surf_expression::surf_expression() {
+	depth = 0;
+};
+
+surf_expression::~surf_expression() {
+	size_t i;
+	for (i = 0; i < names.size(); i++)
+		free(names[i]);
+};
+
+void surf_expression::release() {
+	delete this;
+};
+
+void surf_expression::eval_nodes(const std::vector<const d_surf *> & surfs, d_surf * res, const bitvec * region,
+			   size_t from, size_t to, REAL * stack, unsigned char * undef) const
+{
+	const d_grid * grd = res->grd;
+	size_t NN = grd->getCountX();
+	size_t c, k, n, l;
+
+	for (c = from; c < to; c += SURF_EXPR_CHUNK) {
+		n = MIN(SURF_EXPR_CHUNK, to - c);
+		size_t sp = 0;
+		REAL * a = NULL, * b = NULL;
+		unsigned char * ua = NULL, * ub = NULL;
+
+		for (l = 0; l < code.size(); l++) {
+			const instr & in = code[l];
+			if (in.op <= EXPR_Y) {
+				// push
+				a = stack + sp*SURF_EXPR_CHUNK;
+				ua = undef + sp*SURF_EXPR_CHUNK;
+				sp++;
+			} else if (in.op < EXPR_ADD) {
+				// unary operation in place
+				a = stack + (sp-1)*SURF_EXPR_CHUNK;
+				ua = undef + (sp-1)*SURF_EXPR_CHUNK;
+			} else {
+				// binary operation, result replaces the first argument
+				sp--;
+				a = stack + (sp-1)*SURF_EXPR_CHUNK;
+				ua = undef + (sp-1)*SURF_EXPR_CHUNK;
+				b = stack + sp*SURF_EXPR_CHUNK;
+				ub = undef + sp*SURF_EXPR_CHUNK;
+				for (k = 0; k < n; k++)
+					ua[k] |= ub[k];
+			}
+
+			switch (in.op) {
+			case EXPR_SURF:
+				{
+					const d_surf * srf = surfs[in.arg];
+					REAL srf_undef = srf->undef_value;
+					if (srf->coeff) {
+						const extvec & coeff = *(srf->coeff);
+						for (k = 0; k < n; k++)
+							a[k] = coeff(c + k);
+					} else {
+						for (k = 0; k < n; k++)
+							a[k] = srf->getValue(c + k);
+					}
+					for (k = 0; k < n; k++)
+						ua[k] = (a[k] == srf_undef);
+				}
+				break;
+			case EXPR_CONST:
+				for (k = 0; k < n; k++) {
+					a[k] = in.value;
+					ua[k] = 0;
+				}
+				break;
+			case EXPR_X:
+				for (k = 0; k < n; k++) {
+					a[k] = grd->getCoordNodeX((c + k) % NN);
+					ua[k] = 0;
+				}
+				break;
+			case EXPR_Y:
+				for (k = 0; k < n; k++) {
+					a[k] = grd->getCoordNodeY((c + k) / NN);
+					ua[k] = 0;
+				}
+				break;
+			case EXPR_NEG:
+				for (k = 0; k < n; k++)
+					a[k] = -a[k];
+				break;
+			case EXPR_ABS:
+				for (k = 0; k < n; k++)
+					a[k] = (REAL)fabs(a[k]);
+				break;
+			case EXPR_SQRT:
+				for (k = 0; k < n; k++) {
+					ua[k] |= (a[k] < 0);
+					a[k] = (REAL)sqrt(MAX(a[k], REAL(0)));
+				}
+				break;
+			case EXPR_EXP:
+				for (k = 0; k < n; k++)
+					a[k] = (REAL)exp(a[k]);
+				break;
+			case EXPR_LOG:
+				for (k = 0; k < n; k++) {
+					ua[k] |= (a[k] <= 0);
+					a[k] = (a[k] > 0) ? (REAL)log(a[k]) : REAL(0);
+				}
+				break;
+			case EXPR_LOG10:
+				for (k = 0; k < n; k++) {
+					ua[k] |= (a[k] <= 0);
+					a[k] = (a[k] > 0) ? (REAL)log10(a[k]) : REAL(0);
+				}
+				break;
+			case EXPR_SIN:
+				for (k = 0; k < n; k++)
+					a[k] = (REAL)sin(a[k]);
+				break;
+			case EXPR_COS:
+				for (k = 0; k < n; k++)
+					a[k] = (REAL)cos(a[k]);
+				break;
+			case EXPR_TAN:
+				for (k = 0; k < n; k++)
+					a[k] = (REAL)tan(a[k]);
+				break;
+			case EXPR_ASIN:
+				for (k = 0; k < n; k++) {
+					ua[k] |= (fabs(a[k]) > 1);
+					a[k] = (REAL)asin(MIN(MAX(a[k], REAL(-1)), REAL(1)));
+				}
+				break;
+			case EXPR_ACOS:
+				for (k = 0; k < n; k++) {
+					ua[k] |= (fabs(a[k]) > 1);
+					a[k] = (REAL)acos(MIN(MAX(a[k], REAL(-1)), REAL(1)));
+				}
+				break;
+			case EXPR_ATAN:
+				for (k = 0; k < n; k++)
+					a[k] = (REAL)atan(a[k]);
+				break;
+			case EXPR_FLOOR:
+				for (k = 0; k < n; k++)
+					a[k] = (REAL)floor(a[k]);
+				break;
+			case EXPR_CEIL:
+				for (k = 0; k < n; k++)
+					a[k] = (REAL)ceil(a[k]);
+				break;
+			case EXPR_ADD:
+				for (k = 0; k < n; k++)
+					a[k] += b[k];
+				break;
+			case EXPR_SUB:
+				for (k = 0; k < n; k++)
+					a[k] -= b[k];
+				break;
+			case EXPR_MUL:
+				for (k = 0; k < n; k++)
+					a[k] *= b[k];
+				break;
+			case EXPR_DIV:
+				for (k = 0; k < n; k++) {
+					ua[k] |= (b[k] == 0);
+					a[k] = (b[k] != 0) ? a[k]/b[k] : REAL(0);
+				}
+				break;
+			case EXPR_POW:
+				for (k = 0; k < n; k++) {
+					// negative number in fractional power, zero in negative power
+					if ( ((a[k] < 0) && (floor(b[k]) != b[k])) || ((a[k] == 0) && (b[k] < 0)) ) {
+						ua[k] = 1;
+						a[k] = 0;
+					} else
+						a[k] = (REAL)pow(a[k], b[k]);
+				}
+				break;
+			case EXPR_MIN:
+				for (k = 0; k < n; k++)
+					a[k] = MIN(a[k], b[k]);
+				break;
+			case EXPR_MAX:
+				for (k = 0; k < n; k++)
+					a[k] = MAX(a[k], b[k]);
+				break;
+			case EXPR_ATAN2:
+				for (k = 0; k < n; k++)
+					a[k] = (REAL)atan2(a[k], b[k]);
+				break;
+			}
+		}
+
+		// result is on the top of the stack
+		REAL res_undef = res->undef_value;
+		for (k = 0; k < n; k++) {
+			size_t pos = c + k;
+			if (region && (region->get(pos) == false))
+				continue;
+			REAL value = undef[k] ? res_undef : stack[k];
+			if (res->coeff)
+				(*(res->coeff))(pos) = value;
+			else
+				res->setValue(pos, value);
+		}
+	}
+};
+
+#ifdef HAVE_THREADS
+struct surf_expr_job : public job
+{
+	surf_expr_job()
+	{
+		expr = NULL;
+		surfs = NULL;
+		res = NULL;
+		region = NULL;
+		from = 0;
+		to = 0;
+	};
+	void set(const surf_expression * iexpr, const std::vector<const d_surf *> * isurfs, d_surf * ires,
+		 const bitvec * iregion, size_t ifrom, size_t ito)
+	{
+		expr = iexpr;
+		surfs = isurfs;
+		res = ires;
+		region = iregion;
+		from = ifrom;
+		to = ito;
+	};
+	virtual void do_job()
+	{
+		size_t depth = MAX(expr->depth, 1);
+		REAL * stack = (REAL *)malloc(depth*SURF_EXPR_CHUNK*sizeof(REAL));
+		unsigned char * undef = (unsigned char *)malloc(depth*SURF_EXPR_CHUNK);
+		expr->eval_nodes(*surfs, res, region, from, to, stack, undef);
+		free(undef);
+		free(stack);
+	};
+
+	const surf_expression * expr;
+	const std::vector<const d_surf *> * surfs;
+	d_surf * res;
+	const bitvec * region;
+	size_t from, to;
+};
+
+surf_expr_job surf_expr_jobs[MAX_CPU];
+#endif
+
+bool surf_expression::eval(const std::vector<const d_surf *> & surfs, d_surf * res, const bitvec * region) const
+{
+	if (surfs.size() != names.size())
+		return false;
+	if (code.size() == 0)
+		return false;
+
+	size_t nodes = res->getCountX()*res->getCountY();
+
+#ifdef HAVE_THREADS
+	if ((sstuff_get_threads() == 1) || (nodes < 16*SURF_EXPR_CHUNK)) {
+#endif
+		size_t d = MAX(depth, 1);
+		REAL * stack = (REAL *)malloc(d*SURF_EXPR_CHUNK*sizeof(REAL));
+		unsigned char * undef = (unsigned char *)malloc(d*SURF_EXPR_CHUNK);
+		eval_nodes(surfs, res, region, 0, nodes, stack, undef);
+		free(undef);
+		free(stack);
+#ifdef HAVE_THREADS
+	} else {
+		// threads get whole chunks
+		size_t chunks = (nodes + SURF_EXPR_CHUNK - 1)/SURF_EXPR_CHUNK;
+		size_t threads = sstuff_get_threads();
+		size_t step = chunks / threads;
+		size_t ost = chunks % threads;
+		size_t from = 0;
+		size_t t;
+		for (t = 0; t < threads; t++) {
+			size_t to = MIN(nodes, from + (step + ((t < ost) ? 1 : 0))*SURF_EXPR_CHUNK);
+			surf_expr_job & f = surf_expr_jobs[t];
+			f.set(this, &surfs, res, region, from, to);
+			set_job(&f, t);
+			from = to;
+		}
+		do_jobs();
+	}
+#endif
+
+	return true;
+};
+
+//! finds surface with exact name
+static d_surf * find_surf(const char * name) {
+	size_t i;
+	for (i = 0; i < surfit_surfs->size(); i++) {
+		d_surf * srf = (*surfit_surfs)[i];
+		if (srf->getName() && (strcmp(srf->getName(), name) == 0))
+			return srf;
+	}
+	return NULL;
+};
+
+bool _surf_expr(const char * result_name, const char * expression, const d_area * area, const d_mask * mask) {
+
+	if (!result_name || !expression)
+		return false;
+
+	surf_expression * expr = create_surf_expression(expression);
+	if (!expr)
+		return false;
+
+	std::vector<const d_surf *> surfs;
+	size_t i;
+	for (i = 0; i < expr->names_size(); i++) {
+		d_surf * srf = find_surf(expr->get_name(i));
+		if (srf == NULL) {
+			writelog(LOG_ERROR, "surf_expr : surf \"%s\" not found", expr->get_name(i));
+			expr->release();
+			return false;
+		}
+		surfs.push_back(srf);
+	}
+
+	d_surf * res = find_surf(result_name);
+	bool new_surf = (res == NULL);
+	if (res) {
+		// paged surfaces are read-only
+		if ((res->coeff == NULL) && (dynamic_cast<d_surf_float *>(res) == NULL)) {
+			writelog(LOG_ERROR, "surf_expr : surf \"%s\" can't be modified", result_name);
+			expr->release();
+			return false;
+		}
+	} else {
+		const d_grid * grd = surfit_grid;
+		if (surfs.size() > 0)
+			grd = surfs[0]->grd;
+		if (grd == NULL) {
+			writelog(LOG_ERROR, "surf_expr : no grid for surf \"%s\"", result_name);
+			expr->release();
+			return false;
+		}
+		size_t nodes = grd->getCountX()*grd->getCountY();
+		res = create_surf(create_extvec(nodes, undef_value), create_grid(grd), result_name);
+		res->undef_value = undef_value;
+	}
+
+	for (i = 0; i < surfs.size(); i++) {
+		if (!res->compare_grid(surfs[i])) {
+			writelog(LOG_ERROR, "surf_expr : surf \"%s\" has different grid", surfs[i]->getName());
+			if (new_surf)
+				res->release();
+			expr->release();
+			return false;
+		}
+	}
+
+	bitvec * region = NULL;
+	if (area) {
+		writelog(LOG_MESSAGE, "surf_expr : \"%s\" = %s in area \"%s\"", result_name, expression, area->getName());
+		region = nodes_in_area_mask(area, res->grd);
+		if (region == NULL) {
+			if (new_surf)
+				res->release();
+			expr->release();
+			return false;
+		}
+	} else if (mask) {
+		writelog(LOG_MESSAGE, "surf_expr : \"%s\" = %s where mask \"%s\"", result_name, expression, mask->getName());
+		size_t NN = res->getCountX();
+		size_t MM = res->getCountY();
+		size_t I, J;
+		region = create_bitvec(NN*MM);
+		for (J = 0; J < MM; J++) {
+			REAL y = res->getCoordNodeY(J);
+			for (I = 0; I < NN; I++) {
+				if (mask->getValue(res->getCoordNodeX(I), y))
+					region->set_true(I + J*NN);
+				else
+					region->set_false(I + J*NN);
+			}
+		}
+	} else
+		writelog(LOG_MESSAGE, "surf_expr : \"%s\" = %s", result_name, expression);
+
+	bool ok = expr->eval(surfs, res, region);
+
+	if (region)
+		region->release();
+	expr->release();
+
+	if (new_surf) {
+		if (ok)
+			surfit_surfs->push_back(res);
+		else
+			res->release();
+	}
+
+	return ok;
+};
+
+}; // namespace surfit;
+
@@ -0,0 +1,124 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__surf_expr__
+#define __surfit__surf_expr__
+
+#include <vector>
+
+namespace surfit {
+
+class d_surf;
+class d_area;
+class d_mask;
+class bitvec;
+class surf_expression;
+
+/*! \brief compiles expression over surfaces
+    \param text expression, for example "(A-B)*C+5"
+    \return compiled expression or NULL (error is written to log)
+
+    Expression consists of numbers, surface names, node coordinates x and y,
+    operators + - * / ^, parentheses and functions abs, sqrt, exp, log, log10,
+    sin, cos, tan, asin, acos, atan, floor, ceil (one argument) and min, max,
+    pow, atan2 (two arguments). Names with special characters should be
+    quoted with single quotes: 'my surf' + 1.
+*/
+SURFIT_EXPORT
+surf_expression * create_surf_expression(const char * text);
+
+/*! \class surf_expression
+    \brief expression over surfaces, evaluated for all nodes in one pass
+
+    Expression is compiled into the program for the stack machine. Nodes are
+    processed by chunks: each instruction of the program is applied to the whole
+    chunk, so all operations are done in one pass over surfaces without temporary
+    surfaces. Nodes are divided between threads.
+
+    If any operand is undefined, or operation is not defined (division by zero,
+    sqrt or log of negative number), the result is undefined.
+*/
+class SURFIT_EXPORT surf_expression {
+protected:
+	//! constructor
+	surf_expression();
+	//! destructor
+	~surf_expression();
+
+public:
+	//! constructor
+	friend SURFIT_EXPORT
+	surf_expression * create_surf_expression(const char * text);
+
+	//! destructor
+	void release();
+
+	//! returns amount of surfaces used in expression
+	size_t names_size() const { return names.size(); };
+	//! returns name of surface number n
+	const char * get_name(size_t n) const { return names[n]; };
+
+	/*! \brief calculates expression values
+	    \param surfs surfaces for names (in the same order as names), with the same grid as res
+	    \param res surface for result values
+	    \param region if not NULL, values are calculated only for nodes where region is true
+	*/
+	bool eval(const std::vector<const d_surf *> & surfs, d_surf * res, const bitvec * region) const;
+
+	//! instruction of the stack machine
+	struct instr {
+		//! operation code
+		int op;
+		//! surface number
+		size_t arg;
+		//! constant value
+		REAL value;
+	};
+
+private:
+
+	friend class surf_expr_parser;
+	friend struct surf_expr_job;
+
+	//! evaluates program for nodes [from, to) using stack memory
+	void eval_nodes(const std::vector<const d_surf *> & surfs, d_surf * res, const bitvec * region,
+			size_t from, size_t to, REAL * stack, unsigned char * undef) const;
+
+	//! program
+	std::vector<instr> code;
+	//! surfaces names
+	std::vector<char *> names;
+	//! maximum stack depth
+	size_t depth;
+};
+
+/*! \brief calculates expression over surfaces from \ref surfit_surfs
+    \param result_name name of surface for result. If there is no such surface, new
+    surface is created on the grid of operands (or \ref surfit_grid)
+    \param expression expression text (see \ref create_surf_expression)
+    \param area if not NULL, only nodes inside area are changed
+    \param mask if not NULL, only nodes where mask is true are changed
+*/
+SURFIT_EXPORT
+bool _surf_expr(const char * result_name, const char * expression, 
+		const d_area * area = NULL, const d_mask * mask = NULL);
+
+}; // namespace surfit;
+
+#endif
+
@@ -0,0 +1,254 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/vec.h"
+#include "../sstuff/bitvec.h"
+#include "../sstuff/datafile.h"
+#include "../sstuff/rnd.h"
+
+#include "surf_float.h"
+#include "grid.h"
+
+#include <float.h>
+#include <stdlib.h>
+#include <math.h>
+
+namespace surfit {
+
+// operations for d_surf_float::oper
+enum {
+	SURF_FLOAT_PLUS,
+	SURF_FLOAT_MINUS,
+	SURF_FLOAT_MULT,
+	SURF_FLOAT_DIV,
+	SURF_FLOAT_SET
+};
+
+d_surf_float * create_surf_float(const d_surf * srf) {
+	d_surf_float * res = new d_surf_float(create_grid(srf->grd), srf->undef_value, srf->getName());
+	size_t i, size = srf->getCountX()*srf->getCountY();
+	if (srf->coeff) {
+		extvec::const_iterator ptr = srf->coeff->const_begin();
+		for (i = 0; i < size; i++)
+			res->values[i] = res->to_float( *(ptr+i) );
+	} else {
+		for (i = 0; i < size; i++)
+			res->values[i] = res->to_float( srf->getValue(i) );
+	}
+	return res;
+};
+
+d_surf * create_surf_double(const d_surf_float * srf) {
+	d_surf * res = create_surf(srf->read_all(), create_grid(srf->grd), srf->getName());
+	res->undef_value = srf->undef_value;
+	return res;
+};
+
+d_surf_float::d_surf_float(d_grid * igrd, REAL iundef_value, const char * surfname) : d_surf(NULL, igrd, surfname)
+{
+	undef_value = iundef_value;
+	// undef_value may be out of float range
+	if (fabs(undef_value) <= FLT_MAX)
+		fundef = float(undef_value);
+	else
+		fundef = FLT_MAX;
+	values = (float *)malloc(grd->getCountX()*grd->getCountY()*sizeof(float));
+};
+
+d_surf_float::~d_surf_float() {
+	free(values);
+};
+
+float d_surf_float::to_float(REAL value) const {
+	if (value == undef_value)
+		return fundef;
+	return float(value);
+};
+
+REAL d_surf_float::getValueIJ(size_t I, size_t J) const {
+	if (I >= grd->getCountX())
+		return FLT_MAX;
+	if (J >= grd->getCountY())
+		return FLT_MAX;
+	return getValue(I + J*grd->getCountX());
+};
+
+REAL d_surf_float::getValue(size_t pos) const {
+	float value = values[pos];
+	if (value == fundef)
+		return undef_value;
+	return REAL(value);
+};
+
+void d_surf_float::setValue(size_t pos, REAL val) {
+	if (sums)
+		drop_sums();
+	values[pos] = to_float(val);
+};
+
+extvec * d_surf_float::read_all() const {
+	size_t i, size = grd->getCountX()*grd->getCountY();
+	extvec * res = create_extvec(size, 0, false); // don't fill
+	for (i = 0; i < size; i++)
+		(*res)(i) = getValue(i);
+	return res;
+};
+
+bool d_surf_float::writeTags(datafile *df) const {
+
+	bool res = true;
+	bool op;
+
+	extvec * coeffs = read_all();
+
+	op = df->writeTag("surf");		res = (res && op);
+
+	if (getName()) {
+		op = df->writeString("name", getName()); res = (res && op);
+	}
+
+	op = grd->writeTags(df);			res = (res && op);
+	op = df->writeRealArray("coeff", coeffs, getCountX()); res = (res && op);
+	op = df->writeReal("undef_value", undef_value); res = (res && op);
+	op = df->writeEndTag();					res = (res && op);
+
+	coeffs->release();
+
+	return res;
+
+};
+
+void d_surf_float::oper(int op, const d_surf * srf, REAL val, const bitvec * mask) {
+	size_t i, size = grd->getCountX()*grd->getCountY();
+	for (i = 0; i < size; i++) {
+		if (mask) {
+			if (mask->get(i) == false)
+				continue;
+		}
+		REAL val1 = val;
+		if (srf) {
+			val1 = srf->getValue(i);
+			// division by zero surface gives zero, as in d_surf::div
+			if ((op == SURF_FLOAT_DIV) && (val1 == 0)) {
+				values[i] = 0;
+				continue;
+			}
+			if (val1 == srf->undef_value)
+				continue;
+		}
+		if (values[i] == fundef)
+			continue;
+		REAL val2 = REAL(values[i]);
+		switch (op) {
+		case SURF_FLOAT_PLUS:
+			val2 += val1;
+			break;
+		case SURF_FLOAT_MINUS:
+			val2 -= val1;
+			break;
+		case SURF_FLOAT_MULT:
+			val2 *= val1;
+			break;
+		case SURF_FLOAT_DIV:
+			val2 /= val1;
+			break;
+		case SURF_FLOAT_SET:
+			val2 = val1;
+			break;
+		};
+		values[i] = float(val2);
+	}
+};
+
+void d_surf_float::plus(const d_surf * srf) { oper(SURF_FLOAT_PLUS, srf, 0, NULL); };
+void d_surf_float::plus_mask(const d_surf * srf, const bitvec * mask) { oper(SURF_FLOAT_PLUS, srf, 0, mask); };
+void d_surf_float::minus(const d_surf * srf) { oper(SURF_FLOAT_MINUS, srf, 0, NULL); };
+void d_surf_float::minus_mask(const d_surf * srf, const bitvec * mask) { oper(SURF_FLOAT_MINUS, srf, 0, mask); };
+void d_surf_float::mult(const d_surf * srf) { oper(SURF_FLOAT_MULT, srf, 0, NULL); };
+void d_surf_float::mult_mask(const d_surf * srf, const bitvec * mask) { oper(SURF_FLOAT_MULT, srf, 0, mask); };
+void d_surf_float::div(const d_surf * srf) { oper(SURF_FLOAT_DIV, srf, 0, NULL); };
+void d_surf_float::div_mask(const d_surf * srf, const bitvec * mask) { oper(SURF_FLOAT_DIV, srf, 0, mask); };
+void d_surf_float::set(const d_surf * srf) { oper(SURF_FLOAT_SET, srf, 0, NULL); };
+void d_surf_float::set_mask(const d_surf * srf, const bitvec * mask) { oper(SURF_FLOAT_SET, srf, 0, mask); };
+
+void d_surf_float::plus(REAL val) { oper(SURF_FLOAT_PLUS, NULL, val, NULL); };
+void d_surf_float::plus_mask(REAL val, const bitvec * mask) { oper(SURF_FLOAT_PLUS, NULL, val, mask); };
+void d_surf_float::minus(REAL val) { oper(SURF_FLOAT_MINUS, NULL, val, NULL); };
+void d_surf_float::minus_mask(REAL val, const bitvec * mask) { oper(SURF_FLOAT_MINUS, NULL, val, mask); };
+void d_surf_float::mult(REAL val) { oper(SURF_FLOAT_MULT, NULL, val, NULL); };
+void d_surf_float::mult_mask(REAL val, const bitvec * mask) { oper(SURF_FLOAT_MULT, NULL, val, mask); };
+void d_surf_float::div(REAL val) { oper(SURF_FLOAT_DIV, NULL, val, NULL); };
+void d_surf_float::div_mask(REAL val, const bitvec * mask) { oper(SURF_FLOAT_DIV, NULL, val, mask); };
+void d_surf_float::set(REAL val) { oper(SURF_FLOAT_SET, NULL, val, NULL); };
+void d_surf_float::set_mask(REAL val, const bitvec * mask) { oper(SURF_FLOAT_SET, NULL, val, mask); };
+
+void d_surf_float::set_undef_value(REAL new_undef_value) {
+	float new_fundef = FLT_MAX;
+	if (fabs(new_undef_value) <= FLT_MAX)
+		new_fundef = float(new_undef_value);
+	size_t i, size = grd->getCountX()*grd->getCountY();
+	for (i = 0; i < size; i++) {
+		if (values[i] == fundef)
+			values[i] = new_fundef;
+	}
+	fundef = new_fundef;
+	undef_value = new_undef_value;
+};
+
+bool d_surf_float::add_noise(REAL std) {
+	writelog(LOG_MESSAGE,"adding noise to surface \"%s\"", getName());
+	size_t i, size = grd->getCountX()*grd->getCountY();
+	for (i = 0; i < size; i++) {
+		if (values[i] != fundef)
+			values[i] = float(values[i] + norm_rand(std));
+	}
+	return true;
+};
+
+bool d_surf_float::decompose() {
+	writelog(LOG_ERROR, "surf \"%s\" is stored in float precision, use surf_store_double before decomposition", getName());
+	return false;
+};
+
+bool d_surf_float::auto_decompose(REAL eps, int norm) {
+	return decompose();
+};
+
+bool d_surf_float::reconstruct() {
+	return decompose();
+};
+
+bool d_surf_float::full_reconstruct() {
+	return decompose();
+};
+
+REAL d_surf_float::calc_approx_norm(int norm_type) const {
+	size_t i, size = grd->getCountX()*grd->getCountY();
+	REAL res = REAL(0);
+	for (i = 0; i < size; i++) {
+		REAL value = getValue(i);
+		res += value*value;
+	}
+	return res/size;
+};
+
+}; // namespace surfit;
+
@@ -0,0 +1,170 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__surf_float__
+#define __surfit__surf_float__
+
+#include "surf.h"
+
+namespace surfit {
+
+class d_surf_float;
+
+/*! \brief converts surface to \ref d_surf_float (values are rounded to float)
+    \param srf surface with values in memory or \ref d_surf_paged
+    \return new surface, srf is not changed
+*/
+SURFIT_EXPORT
+d_surf_float * create_surf_float(const d_surf * srf);
+
+/*! \brief converts surface with float values to the ordinary surface
+    \return new surface with values in extvec, srf is not changed
+*/
+SURFIT_EXPORT
+d_surf * create_surf_double(const d_surf_float * srf);
+
+/*! \class d_surf_float
+    \brief surface with values stored as floats
+
+    Halves memory for big surfaces, when float precision (about 7 significant 
+    digits) is enough. Values are converted to REAL when read, so all 
+    calculations are made in REAL. Results written with setValue and arithmetic 
+    operations are rounded to float.
+
+    coeff is NULL for float surfaces, values are read with getValue. Wavelets
+    are not supported, they need a surface with values in extvec 
+    (see \ref create_surf_double).
+*/
+class SURFIT_EXPORT d_surf_float : public d_surf {
+protected:
+	//! constructor
+	d_surf_float(d_grid * igrd, REAL iundef_value, const char * surfname);
+
+	//! destructor
+	virtual ~d_surf_float();
+
+public:
+
+	//! constructor
+	friend SURFIT_EXPORT
+	d_surf_float * create_surf_float(const d_surf * srf);
+
+	using d_surf::getValue;
+
+	//! returns surface value at node (i,j)
+	virtual REAL getValueIJ(size_t i, size_t j) const;
+
+	//! returns surface value at node
+	virtual REAL getValue(size_t pos) const;
+
+	//! sets surface value at node (value is rounded to float)
+	virtual void setValue(size_t pos, REAL val);
+
+	//! writes tag for saving surf to datafile
+	virtual bool writeTags(datafile * df) const;
+
+	//! this = this + srf
+	virtual void plus(const d_surf * srf);
+	//! this = this + srf where mask == true
+	virtual void plus_mask(const d_surf * srf, const bitvec * mask);
+	
+	//! this = this - srf, undef means no operation
+	virtual void minus(const d_surf * srf);
+	//! this = this - srf where mask == true
+	virtual void minus_mask(const d_surf * srf, const bitvec * mask);
+
+	//! this = this * srf
+	virtual void mult(const d_surf * srf);
+	//! this = this * srf where mask == true
+	virtual void mult_mask(const d_surf * srf, const bitvec * mask);
+	
+	//! this = this / srf
+	virtual void div(const d_surf * srf);
+	//! this = this / srf where mask == true
+	virtual void div_mask(const d_surf * srf, const bitvec * mask);
+	
+	//! this = srf
+	virtual void set(const d_surf * srf);
+	//! this = this = srf where mask == true
+	virtual void set_mask(const d_surf * srf, const bitvec * mask);
+
+	//! this = this + val
+	virtual void plus(REAL val);
+	//! this = this + val where mask == true
+	virtual void plus_mask(REAL val, const bitvec * mask);
+
+	//! this = this - val
+	virtual void minus(REAL val);
+	//! this = this - val where mask == true
+	virtual void minus_mask(REAL val, const bitvec * mask);
+
+	//! this = this * val
+	virtual void mult(REAL val);
+	//! this = this * val where mask == true
+	virtual void mult_mask(REAL val, const bitvec * mask);
+
+	//! this = this / val
+	virtual void div(REAL val);
+	//! this = this / val where mask == true
+	virtual void div_mask(REAL val, const bitvec * mask);
+
+	//! this = val
+	virtual void set(REAL val);
+	//! this = val where mask == true
+	virtual void set_mask(REAL val, const bitvec * mask);
+
+	//! sets new undef_value
+	virtual void set_undef_value(REAL new_undef_value);
+
+	//! adds normally-distributed noise with parameters N(0,std)
+	virtual bool add_noise(REAL std);
+
+	//! wavelets are not supported for float surfaces
+	virtual bool decompose();
+	//! wavelets are not supported for float surfaces
+	virtual bool auto_decompose(REAL eps, int norm = 0);
+	//! wavelets are not supported for float surfaces
+	virtual bool reconstruct();
+	//! wavelets are not supported for float surfaces
+	virtual bool full_reconstruct();
+
+	//! calculates norm of surface values
+	virtual REAL calc_approx_norm(int norm_type) const;
+
+	//! converts all surface values to extvec
+	extvec * read_all() const;
+
+private:
+
+	//! operation with surface (srf) or value (srf == NULL)
+	void oper(int op, const d_surf * srf, REAL val, const bitvec * mask);
+
+	//! converts value to float, undef_value goes to fundef
+	float to_float(REAL value) const;
+
+	//! surface values
+	float * values;
+	//! float value for undefined nodes
+	float fundef;
+};
+
+}; // namespace surfit;
+
+#endif
+
@@ -33,6 +33,10 @@
 #include "variables_tcl.h"
 #include "variables_internal.h"
 #include "points.h"
+#include "surf_sample.h"
+#include "surf_project.h"
+#include "surf_stats.h"
+#include "surf_wavelet.h"
 #include "curv.h"
 #include "curv_internal.h"
 #include "mask.h"
@@ -58,6 +62,7 @@
 #include <math.h>
 #include <float.h>
 #include <errno.h>
+#include <algorithm>
 
 namespace surfit {
 
@@ -65,11 +70,6 @@ int calc_ptr(int i, int j, int N);
 
 d_points * _surf_to_pnts(const d_surf * srf) {
 	
-	if (!srf->coeff) {
-		writelog(LOG_ERROR,"convert_surf_to_pnts : wrong surf - no coeffs");
-		return NULL;
-	}
-
 	size_t size = srf->getCountX()*srf->getCountY();
 	vec * Z = create_vec();
 	Z->reserve(size);
@@ -137,433 +137,9 @@ bool _surf_full_recons(d_surf * srf) {
 	return srf->full_reconstruct();
 };
 
-#ifdef HAVE_THREADS
-struct surf_project_job : public job 
-{
-	surf_project_job()
-	{
-		J_from = 0;
-		J_to = 0;
-		srf = NULL;
-		grd = NULL;
-	};
-	void set(size_t iJ_from, size_t iJ_to, 
-		 const d_surf * isrf, const d_grid * igrd,
-		 extvec * icoeff)
-	{
-		J_from = iJ_from;
-		J_to = iJ_to;
-		srf = isrf;
-		grd = igrd;
-		coeff = icoeff;
-	};
-	virtual void do_job() 
-	{
-		d_grid * g = srf->grd;
-		REAL value, x, y, x0, y0;
-		size_t I0, I1, J0, J1;
-		REAL z0, z1, z2, z3;
-		REAL delta_x, delta_y;
-
-		REAL hX = srf->grd->stepX;
-		REAL hY = srf->grd->stepY;
-		size_t size_x = grd->getCountX();
-		size_t surf_sizeX = srf->getCountX();
-		size_t surf_sizeY = srf->getCountY();
-
-		size_t i,j;
-		for (j = J_from; j < J_to; j++) {
-			for (i = 0; i < (size_t)size_x; i++) {
-				value = 0;
-				grd->getCoordNode(i, j, x, y);
-								
-				I0 = (size_t)MAX(0,floor( (x - g->startX)/g->stepX ));
-				J0 = (size_t)MAX(0,floor( (y - g->startY)/g->stepY ));
-
-				I1 = I0+1;
-				J1 = J0+1;
-
-				I0 = MIN(MAX( 0, I0 ), surf_sizeX-1);
-				I1 = MIN(MAX( 0, I1 ), surf_sizeX-1);
-				J0 = MIN(MAX( 0, J0 ), surf_sizeY-1);
-				J1 = MIN(MAX( 0, J1 ), surf_sizeY-1);
-
-				srf->getCoordNode(I0, J0, x0, y0);
-				
-				z0 = (*(srf->coeff))(I0 + surf_sizeX*J0);
-				z1 = (*(srf->coeff))(I1 + surf_sizeX*J0);
-				z2 = (*(srf->coeff))(I1 + surf_sizeX*J1);
-				z3 = (*(srf->coeff))(I0 + surf_sizeX*J1);
-				
-				if (
-					(z0 == srf->undef_value) ||
-					(z1 == srf->undef_value) ||
-					(z2 == srf->undef_value) ||
-					(z3 == srf->undef_value) 
-					) 
-				{
-					
-					REAL sum = REAL(0);
-					int cnt = 0;
-					
-					if (z0 != srf->undef_value) {
-						sum += z0;
-						cnt++;
-					}
-					if (z1 != srf->undef_value) {
-						sum += z1;
-						cnt++;
-					}
-					if (z2 != srf->undef_value) {
-						sum += z2;
-						cnt++;
-					}
-					if (z3 != srf->undef_value) {
-						sum += z3;
-						cnt++;
-					}
-					
-					if (cnt == 0) {
-						(*coeff)(i + j*size_x) = srf->undef_value;
-						continue;
-					}
-
-					REAL mean_z = sum/REAL(cnt);
-					if (z0 == srf->undef_value)
-						z0 = mean_z;
-					if (z1 == srf->undef_value)
-						z1 = mean_z;
-					if (z2 == srf->undef_value)
-						z2 = mean_z;
-					if (z3 == srf->undef_value)
-						z3 = mean_z;
-					
-				}
-				
-				delta_x = x - x0;
-				delta_y = y - y0;
-				
-				REAL z11 = (z2-z1)*delta_y/hY+z1;
-				REAL z22 = (z3-z0)*delta_y/hY+z0;
-				
-				REAL res = (z11-z22)*delta_x/hX+z22;
-								
-				(*coeff)(i + j*size_x) = res;
-				
-								
-			}
-		}
-	};
-
-	size_t J_from, J_to;
-	const d_surf * srf;
-	const d_grid * grd;
-	extvec * coeff;
-};
-
-surf_project_job surf_project_jobs[MAX_CPU];
-#endif
-
 d_surf * _surf_project(const d_surf * srf, d_grid * grd) 
 {
-	size_t size_x = grd->getCountX();
-	size_t size_y = grd->getCountY();
-
-	extvec * coeff = create_extvec(size_x*size_y,0,0);  // do not fill this vector
-	
-	size_t surf_size = srf->coeff->size();
-	size_t surf_sizeX = srf->getCountX();
-	size_t surf_sizeY = srf->getCountY();
-
-	if (srf->getName())
-		writelog(LOG_MESSAGE,"Projecting surf \"%s\" (%d x %d) => (%d x %d)",srf->getName(), surf_sizeX, surf_sizeY, size_x, size_y);
-	else 
-		writelog(LOG_MESSAGE,"Projecting surf (%d x %d) => (%d x %d)", surf_sizeX, surf_sizeY, size_x, size_y);
-
-	{
-
-		REAL x, y;
-		size_t I0, J0, I1, J1;
-		REAL value;
-		size_t i,j;
-		REAL z0, z1, z2, z3;
-		REAL x0, y0;
-		REAL delta_x, delta_y;
-		REAL hX = srf->grd->stepX;
-		REAL hY = srf->grd->stepY;
-#ifdef HAVE_THREADS
-		if (sstuff_get_threads() == 1) {
-#endif
-		d_grid * g = srf->grd;
-		for (j = 0; j < size_y; j++) {
-			for (i = 0; i < size_x; i++) {
-				value = 0;
-				grd->getCoordNode(i, j, x, y);
-								
-				I0 = (size_t)MAX(0,floor( (x - g->startX)/g->stepX ));
-				J0 = (size_t)MAX(0,floor( (y - g->startY)/g->stepY ));
-
-				I1 = I0+1;
-				J1 = J0+1;
-
-				I0 = MIN(MAX( 0, I0 ), surf_sizeX-1);
-				I1 = MIN(MAX( 0, I1 ), surf_sizeX-1);
-				J0 = MIN(MAX( 0, J0 ), surf_sizeY-1);
-				J1 = MIN(MAX( 0, J1 ), surf_sizeY-1);
-
-				srf->getCoordNode(I0, J0, x0, y0);
-				
-				z0 = (*(srf->coeff))(I0 + surf_sizeX*J0);
-				z1 = (*(srf->coeff))(I1 + surf_sizeX*J0);
-				z2 = (*(srf->coeff))(I1 + surf_sizeX*J1);
-				z3 = (*(srf->coeff))(I0 + surf_sizeX*J1);
-				
-				if (
-					(z0 == srf->undef_value) ||
-					(z1 == srf->undef_value) ||
-					(z2 == srf->undef_value) ||
-					(z3 == srf->undef_value) 
-					) 
-				{
-					
-					REAL sum = REAL(0);
-					int cnt = 0;
-					
-					if (z0 != srf->undef_value) {
-						sum += z0;
-						cnt++;
-					}
-					if (z1 != srf->undef_value) {
-						sum += z1;
-						cnt++;
-					}
-					if (z2 != srf->undef_value) {
-						sum += z2;
-						cnt++;
-					}
-					if (z3 != srf->undef_value) {
-						sum += z3;
-						cnt++;
-					}
-					
-					if (cnt == 0) {
-						(*coeff)(i + j*size_x) = srf->undef_value;
-						continue;
-					}
-
-					REAL mean_z = sum/REAL(cnt);
-					if (z0 == srf->undef_value)
-						z0 = mean_z;
-					if (z1 == srf->undef_value)
-						z1 = mean_z;
-					if (z2 == srf->undef_value)
-						z2 = mean_z;
-					if (z3 == srf->undef_value)
-						z3 = mean_z;
-					
-				}
-				
-				delta_x = x - x0;
-				delta_y = y - y0;
-				
-				REAL z11 = (z2-z1)*delta_y/hY+z1;
-				REAL z22 = (z3-z0)*delta_y/hY+z0;
-				
-				REAL res = (z11-z22)*delta_x/hX+z22;
-								
-				(*coeff)(i + j*size_x) = res;
-				
-								
-			}
-		}
-#ifdef HAVE_THREADS
-		} else {
-			size_t step = size_y / (sstuff_get_threads());
-			size_t ost = size_y % (sstuff_get_threads());
-			size_t J_from = 0;
-			size_t J_to = 0;
-			size_t work;
-			for (work = 0; work < sstuff_get_threads(); work++) {
-				J_to = J_from + step;
-				if (work == 0)
-					J_to += ost;
-				
-				surf_project_job & f = surf_project_jobs[work];
-				f.set(J_from, J_to, srf, grd, coeff);
-				set_job(&f, work);
-				J_from = J_to;
-			}
-
-			do_jobs();
-		}
-#endif
-	}
-	
-	d_grid * new_grd = create_grid(grd);
-	d_surf * res = create_surf(coeff, new_grd, srf->getName());
-	res->undef_value = srf->undef_value;
-	return res;
-};
-
-d_surf * _surf_project(d_surf * srf, d_grid * grd, grid_line * fault_grd_line) {
-
-	if (!fault_grd_line)
-		return _surf_project(srf, grd);
-
-	size_t size_x = grd->getCountX();
-	size_t size_y = grd->getCountY();
-
-	extvec * coeff = create_extvec(size_x*size_y,0,0);  // do not fill this vector
-	
-	size_t surf_size = srf->coeff->size();
-	size_t surf_sizeX = srf->getCountX();
-	size_t surf_sizeY = srf->getCountY();
-
-	if (srf->getName())
-		writelog(LOG_MESSAGE,"Projecting surf \"%s\" (%d x %d) => (%d x %d)",srf->getName(), surf_sizeX, surf_sizeY, size_x, size_y);
-	else 
-		writelog(LOG_MESSAGE,"Projecting surf (%d x %d) => (%d x %d)", surf_sizeX, surf_sizeY, size_x, size_y);
-
-	{
-
-		REAL x, y;
-		size_t I0, J0, I1, J1;
-		REAL value;
-		size_t i,j;
-		REAL z0, z1, z2, z3;
-		REAL x0, y0;
-		REAL delta_x, delta_y;
-		REAL hX = srf->grd->stepX;
-		REAL hY = srf->grd->stepY;
-		
-		for (j = 0; j < size_y; j++) {
-			for (i = 0; i < size_x; i++) {
-				value = 0;
-				grd->getCoordNode(i, j, x, y);
-
-				x -= grd->stepX/REAL(2);
-				y -= grd->stepY/REAL(2);
-				
-				d_grid * g = srf->grd;
-				I0 = (size_t)MAX(0,floor( (x - g->startX)/g->stepX ));
-				J0 = (size_t)MAX(0,floor( (y - g->startY)/g->stepY ));
-
-				I1 = I0+1;
-				J1 = J0+1;
-
-				I0 = MIN(MAX( 0, I0 ), surf_sizeX-1);
-				I1 = MIN(MAX( 0, I1 ), surf_sizeX-1);
-				J0 = MIN(MAX( 0, J0 ), surf_sizeY-1);
-				J1 = MIN(MAX( 0, J1 ), surf_sizeY-1);
-
-				srf->getCoordNode(I0, J0, x0, y0);
-				
-				z0 = (*(srf->coeff))(I0 + surf_sizeX*J0);
-				z1 = (*(srf->coeff))(I1 + surf_sizeX*J0);
-				z2 = (*(srf->coeff))(I1 + surf_sizeX*J1);
-				z3 = (*(srf->coeff))(I0 + surf_sizeX*J1);
-				
-				if (
-					(z0 == srf->undef_value) &&
-					(z1 == srf->undef_value) &&
-					(z2 == srf->undef_value) &&
-					(z3 == srf->undef_value) 
-				   )
-				{
-					(*coeff)(i + j*size_x) = srf->undef_value;
-				} else {
-					
-					if (
-						(z0 == srf->undef_value) ||
-						(z1 == srf->undef_value) ||
-						(z2 == srf->undef_value) ||
-						(z3 == srf->undef_value) 
-						) 
-					{
-						
-						REAL sum = REAL(0);
-						int cnt = 0;
-								
-						if (z0 != srf->undef_value) {
-							sum += z0;
-							cnt++;
-						}
-						if (z1 != srf->undef_value) {
-							sum += z1;
-							cnt++;
-						}
-						if (z2 != srf->undef_value) {
-							sum += z2;
-							cnt++;
-						}
-						if (z3 != srf->undef_value) {
-							sum += z3;
-							cnt++;
-						}
-
-						REAL mean_z = sum/REAL(cnt);
-						if (z0 == srf->undef_value)
-							z0 = mean_z;
-						if (z1 == srf->undef_value)
-							z1 = mean_z;
-						if (z2 == srf->undef_value)
-							z2 = mean_z;
-						if (z3 == srf->undef_value)
-							z3 = mean_z;
-
-					}
-					
-					delta_x = x - x0;
-					delta_y = y - y0;
-
-					if ( fault_grd_line->check_for_pair(I1 + J0*surf_sizeX, 
-									    I1 + J1*surf_sizeX) )
-					{
-						if (delta_y < srf->grd->stepY/REAL(2))
-							z2 = z1;
-						else
-							z1 = z2;
-					}
-
-					if ( fault_grd_line->check_for_pair(I0 + J0*surf_sizeX, 
-									    I0 + J1*surf_sizeX) )
-					{
-						if (delta_y < srf->grd->stepY/REAL(2))
-							z3 = z0;
-						else
-							z0 = z3;
-					}
-
-					// first step of linear interpolation
-					REAL z11 = (z2-z1)*delta_y/hY+z1,
-						 z22 = (z3-z0)*delta_y/hY+z0;
-
-					if ( fault_grd_line->check_for_pair(I0 + J0*surf_sizeX,
-									    I1 + J0*surf_sizeX)
-						 ||
-						 fault_grd_line->check_for_pair(I0 + J1*surf_sizeX,
-										I1 + J1*surf_sizeX)
-					   ) 
-					{
-						if (delta_x < srf->grd->stepX/REAL(2))
-							(*coeff)(i + j*size_x) = z22;
-						else
-							(*coeff)(i + j*size_x) = z11;
-					} else {
-						
-						// second step of linear interpolation
-						REAL Res = (z11-z22)*delta_x/hX+z22;
-						(*coeff)(i + j*size_x) = Res;
-					}
-				}
-			}
-		}
-	}
-	
-	d_grid * new_grd = create_grid(grd);
-	d_surf * res = create_surf(coeff, new_grd, srf->getName());
-	res->undef_value = srf->undef_value;
-	return res;
+	return _surf_project(srf, grd, SURF_PROJECT_BILINEAR);
 };
 
 void _surf_info(const d_surf * srf) {
@@ -602,14 +178,18 @@ bool _surf_resid(const d_surf * srf, const d_points * pnts, const char * filenam
 	vec::iterator y_ptr = pnts->Y->begin();
 	vec::iterator z_ptr = pnts->Z->begin();
 
+	vec * values = _surf_sample_pnts(srf, pnts);
+
 	for (cnt = 0; cnt < pnts_size; cnt++) {
 		x = *(x_ptr + cnt);
 		y = *(y_ptr + cnt);
 		z = *(z_ptr + cnt);
-		res = srf->getValue(x,y) - z;
+		res = (*values)(cnt) - z;
 		maxres = (REAL)MAX(fabs(res),maxres);
 		fprintf(f,"%lf \t %lf \t %lf %lf\n",x,y,z,res);
 	}
+
+	values->release();
 	
 	fclose(f);
 	writelog(LOG_MESSAGE,"max residual : %lf", maxres);
@@ -624,16 +204,14 @@ REAL _surf_D1(const d_surf * srf) {
 	size_t NN = srf->getCountX();
 	size_t MM = srf->getCountY();
 
-	extvec::const_iterator ptr = srf->coeff->const_begin();
-
 	REAL v1, v2;
 
 	REAL dx = 0;
 	size_t dx_cnt = 0;
 	for (i = 0; i < NN-2; i++) {
 		for (j = 0; j < MM-1; j++) {
-			v1 = *(ptr + i + j*NN);
-			v2 = *(ptr + (i+1) + j*NN);
+			v1 = srf->getValue(i + j*NN);
+			v2 = srf->getValue((i+1) + j*NN);
 			if ((v1 != srf->undef_value) && (v2 != srf->undef_value)) {
 				dx += (v2-v1)*(v2-v1);
 				dx_cnt++;
@@ -647,8 +225,8 @@ REAL _surf_D1(const d_surf * srf) {
 	int dy_cnt = 0;
 	for (i = 0; i < NN-1; i++) {
 		for (j = 0; j < MM-2; j++) {
-			v1 = *(ptr + i + j*NN);
-			v2 = *(ptr + i + (j+1)*NN);
+			v1 = srf->getValue(i + j*NN);
+			v2 = srf->getValue(i + (j+1)*NN);
 			if ((v1 != srf->undef_value) && (v2 != srf->undef_value)) {
 				dy += (v2-v1)*(v2-v1);
 				dy_cnt++;
@@ -673,17 +251,15 @@ REAL _surf_D2(const d_surf * srf) {
 	size_t NN = srf->getCountX();
 	size_t MM = srf->getCountY();
 
-	extvec::const_iterator ptr = srf->coeff->const_begin();
-
 	REAL v1, v2, v3, v4;
 
 	REAL dx2 = 0;
 	size_t dx2_cnt = 0;
 	for (i = 0; i < NN-3; i++) {
 		for (j = 0; j < MM-1; j++) {
-			v1 = *(ptr + i + j*NN);
-			v2 = *(ptr + (i+1) + j*NN);
-			v3 = *(ptr + (i+2) + j*NN);
+			v1 = srf->getValue(i + j*NN);
+			v2 = srf->getValue((i+1) + j*NN);
+			v3 = srf->getValue((i+2) + j*NN);
 			if ((v1 != srf->undef_value) && 
 				(v2 != srf->undef_value) && 
 				(v3 != srf->undef_value)) {
@@ -697,10 +273,10 @@ REAL _surf_D2(const d_surf * srf) {
 	size_t dxdy_cnt = 0;
 	for (i = 0; i < NN-2; i++) {
 		for (j = 0; j < MM-2; j++) {
-			v1 = *(ptr + i + j*NN);
-			v2 = *(ptr + (i+1) + j*NN);
-			v3 = *(ptr + i + (j+1)*NN);
-			v4 = *(ptr + (i+1) + (j+1)*NN);
+			v1 = srf->getValue(i + j*NN);
+			v2 = srf->getValue((i+1) + j*NN);
+			v3 = srf->getValue(i + (j+1)*NN);
+			v4 = srf->getValue((i+1) + (j+1)*NN);
 			if ((v1 != srf->undef_value) && 
 				(v2 != srf->undef_value) && 
 				(v3 != srf->undef_value) && 
@@ -715,9 +291,9 @@ REAL _surf_D2(const d_surf * srf) {
 	size_t dy2_cnt = 0;
 	for (i = 0; i < NN-1; i++) {
 		for (j = 0; j < MM-3; j++) {
-			v1 = *(ptr + i + j*NN);
-			v2 = *(ptr + i + (j+1)*NN);
-			v3 = *(ptr + i + (j+2)*NN);
+			v1 = srf->getValue(i + j*NN);
+			v2 = srf->getValue(i + (j+1)*NN);
+			v3 = srf->getValue(i + (j+2)*NN);
 			if ((v1 != srf->undef_value) && 
 				(v2 != srf->undef_value) && 
 				(v3 != srf->undef_value)) {
@@ -782,7 +358,7 @@ d_surf * _surf_gradient(const d_surf * srf) {
 				first_y = false;
 
 			pos = i + j*NN;
-			REAL pos_val = (*(srf->coeff))(pos);
+			REAL pos_val = srf->getValue(pos);
 			if (pos_val == srf->undef_value) {
 				(*(coeff))(pos) = srf->undef_value;
 				continue;
@@ -793,7 +369,7 @@ d_surf * _surf_gradient(const d_surf * srf) {
 
 			if (first_x) {
 				pos1 = (i+1) + j*NN;
-				pos1_val = (*(srf->coeff))(pos1);
+				pos1_val = srf->getValue(pos1);
 				if (pos1_val == srf->undef_value) {
 					(*(coeff))(pos) = srf->undef_value;
 					continue;
@@ -803,7 +379,7 @@ d_surf * _surf_gradient(const d_surf * srf) {
 
 			if (second_x) {
 				pos1 = (i-1) + j*NN;
-				pos1_val = (*(srf->coeff))(pos1);
+				pos1_val = srf->getValue(pos1);
 				if (pos1_val == srf->undef_value) {
 					(*(coeff))(pos) = srf->undef_value;
 					continue;
@@ -813,7 +389,7 @@ d_surf * _surf_gradient(const d_surf * srf) {
 
 			if (first_y) {
 				pos1 = (i) + (j+1)*NN;
-				pos1_val = (*(srf->coeff))(pos1);
+				pos1_val = srf->getValue(pos1);
 				if (pos1_val == srf->undef_value) {
 					(*(coeff))(pos) = srf->undef_value;
 					continue;
@@ -823,7 +399,7 @@ d_surf * _surf_gradient(const d_surf * srf) {
 
 			if (second_y) {
 				pos1 = i + (j-1)*NN;
-				pos1_val = (*(srf->coeff))(pos1);
+				pos1_val = srf->getValue(pos1);
 				if (pos1_val == srf->undef_value) {
 					(*(coeff))(pos) = srf->undef_value;
 					continue;
@@ -848,184 +424,55 @@ REAL _surf_mean_area(const d_surf * srf, const d_area * area) {
 	if (mask == NULL)
 		return srf->undef_value;
 	
-	size_t i, N = 0;
-	REAL sum = 0;
-	REAL value;
-	for (i = 0; i < mask->size(); i++) {
-
-		if (mask->get(i) == false)
-			continue;
-		
-		value = (*(srf->coeff))(i); 
-		
-		if (value == srf->undef_value)
-			continue;
-
-		sum += value;
-		N++;
-	}
-
-	if (mask)
-		mask->release();
-	if (N == 0)
-		return srf->undef_value;
+	stat_acc acc;
+	_surf_stats(srf, acc, mask);
+	mask->release();
 
-	return sum/REAL(N);
+	return acc.get_mean(srf->undef_value);
 	
 };
 
 REAL _surf_mean_mask(const d_surf * srf, const d_mask * mask) {
 	
-	size_t NN = srf->getCountX();
-	size_t MM = srf->getCountY();
-	size_t size = NN*MM;
-
-	size_t i, j, N = 0;
-	REAL sum = 0;
-	REAL value;
-	REAL x, y;
-	for (j = 0; j < MM; j++) {
-		for (i = 0; i < NN; i++) {
-			
-			srf->getCoordNode(i, j, x, y);
-			
-			if (mask->getValue(x,y) == false)
-				continue;
-			
-			value = (*(srf->coeff))(i + j*NN); 
-			
-			if (value == srf->undef_value)
-				continue;
-			
-			sum += value;
-			N++;
-		}
-	}
+	bitvec * region = mask->get_bitvec_mask(srf->grd);
 
-	if (N == 0)
-		return srf->undef_value;
+	stat_acc acc;
+	_surf_stats(srf, acc, region);
+	region->release();
 
-	return sum/REAL(N);
+	return acc.get_mean(srf->undef_value);
 	
 };
 
-
 REAL _surf_wmean_area(const d_surf * srf, const d_surf * wsrf, const d_area * area) {
 	
 	bitvec * mask = nodes_in_area_mask(area, srf->grd);
-	
-	size_t i;
-	
 	if (mask == NULL) 
 		return srf->undef_value;
 	
-	size_t aux_X_from, aux_X_to;
-	size_t aux_Y_from, aux_Y_to;
-	_grid_intersect1(srf->grd, wsrf->grd, aux_X_from, aux_X_to, aux_Y_from, aux_Y_to);
-	d_grid * aux_grid = _create_sub_grid(srf->grd, aux_X_from, aux_X_to, aux_Y_from, aux_Y_to);
-	d_surf * w_srf = _surf_project(wsrf, aux_grid);
-	size_t nn = aux_grid->getCountX();
-	size_t mm = aux_grid->getCountY();
-	size_t NN = srf->getCountX();
-	size_t MM = srf->getCountY();
-	
-	if (aux_grid)
-		aux_grid->release();
-
-	REAL denom = 0;
-	size_t ii, jj;
-	REAL sum = 0;
-	REAL value;
-	for (i = 0; i < mask->size(); i++) {
-
-		if (mask->get(i) == false)
-			continue;
-		
-		value = (*(srf->coeff))(i);
-		if (value == srf->undef_value)
-			continue;
-
-		REAL weight = 0;
-
-		one2two(i, ii, jj, NN, MM);
-
-		if ((ii >= aux_X_from) && (ii <= aux_X_to) && (jj >= aux_Y_from) && (jj <= aux_Y_to)) {
-			size_t I = ii-aux_X_from;
-			size_t J = jj-aux_Y_from;
-			weight = (*(w_srf->coeff))(I + J*nn);
-			if (weight == w_srf->undef_value)
-				weight = 0;
-		}
-
-		if (weight <= 0)
-			continue;
-
-		sum += value*weight;
-		denom += weight;
-	}
-
-	if (w_srf)
-		w_srf->release();
-	if (mask)
-		mask->release();
+	d_surf * w_srf = _surf_stats_weights(srf, wsrf);
+	stat_acc acc;
+	_surf_stats(srf, acc, mask, w_srf);
+	w_srf->release();
+	mask->release();
 
-	if (denom == 0)
-		return srf->undef_value;
-	return sum/denom;
+	return acc.get_wmean(srf->undef_value);
 	
 };
 
 REAL _surf_wmean_mask(const d_surf * srf, const d_surf * wsrf, const d_mask * mask) {
 	
-	size_t i;
-	
 	if (mask == NULL) 
 		return srf->undef_value;
 	
-	size_t aux_X_from, aux_X_to;
-	size_t aux_Y_from, aux_Y_to;
-	_grid_intersect1(srf->grd, wsrf->grd, aux_X_from, aux_X_to, aux_Y_from, aux_Y_to);
-	d_grid * aux_grid = _create_sub_grid(srf->grd, aux_X_from, aux_X_to, aux_Y_from, aux_Y_to);
-	d_surf * w_srf = _surf_project(wsrf, aux_grid);
-	size_t nn = aux_grid->getCountX();
-	size_t mm = aux_grid->getCountY();
-	size_t NN = srf->getCountX();
-	size_t MM = srf->getCountY();
-	
-	if (aux_grid)
-		aux_grid->release();
-
-	REAL denom = 0;
-	size_t ii, jj;
-	REAL sum = 0;
-	REAL value;
-	REAL x, y;
-	for (i = 0; i < NN*MM; i++) {
-
-		one2two(i, ii, jj, NN, MM);
-		srf->getCoordNode(ii, jj, x, y);
-
-		if (mask->getValue(x,y) == false)
-			continue;
-		
-		value = (*(srf->coeff))(i);
-		if (value == srf->undef_value)
-			continue;
-
-		REAL weight = w_srf->getValue(x,y);
-		if (weight == w_srf->undef_value)
-			weight = 0;
-		if (weight <= 0)
-			continue;
-
-		sum += value*weight;
-		denom += weight;
-	}
-
-	if (w_srf)
-		w_srf->release();
-
-	return sum/denom;
+	bitvec * region = mask->get_bitvec_mask(srf->grd);
+	d_surf * w_srf = _surf_stats_weights(srf, wsrf);
+	stat_acc acc;
+	_surf_stats(srf, acc, region, w_srf);
+	w_srf->release();
+	region->release();
+
+	return acc.get_wmean(srf->undef_value);
 	
 };
 
@@ -1035,25 +482,11 @@ REAL _surf_sum_area(const d_surf * srf, const d_area * area) {
 	if (mask == NULL)
 		return 0;
 
-	size_t i;
-
-	REAL sum = 0;
-	REAL value;
-	for (i = 0; i < (size_t)mask->size(); i++) {
-		
-		if (mask->get(i) == false)
-			continue;
-
-		value = (*(srf->coeff))(i);
-		if (value == srf->undef_value)
-			continue;
-
-		sum += value;
-	}
+	stat_acc acc;
+	_surf_stats(srf, acc, mask);
+	mask->release();
 
-	if (mask)
-		mask->release();
-	return sum;	
+	return acc.sum;	
 
 };
 
@@ -1069,7 +502,7 @@ int _surf_cells_in_area(const d_surf * srf, const d_area * area) {
 	
 };
 
-d_surf * _surf_load_df(datafile * df, const char * surfname) 
+d_surf * _surf_load_df(datafile * df, const char * surfname, int levels) 
 {
 	
 	if (surfname)
@@ -1091,13 +524,18 @@ d_surf * _surf_load_df(datafile * df, const char * surfname)
 	REAL undef_value = FLT_MAX;
 
 	extvec * coeff = NULL;
+	int wavelet_levels = 0;
+	std::vector< std::vector<char> > wavelet_details;
 	
 	bool loaded = false;
 	
 	while ( !loaded ) {
 		
-		if (df->findTag("surf","func")) {
+		if (df->findTag("surf","func", surfname)) {
 			
+			wavelet_levels = 0;
+			wavelet_details.resize(0);
+
 			df->skipTagName();
 			if (!df->readWord()) goto exit;
 			
@@ -1127,16 +565,37 @@ d_surf * _surf_load_df(datafile * df, const char * surfname)
 					if (!df->skipReal(false)) goto exit;
 					goto cont;
 				}
+
+				if ( df->isWord("int") ) {
+					if (!df->readWord()) goto exit;
+					if ( df->isWord("wavelet_levels") ) {
+						if ( !df->readInt(wavelet_levels) ) goto exit;
+						goto cont;
+					}
+					if (!df->skipInt(false)) goto exit;
+					goto cont;
+				}
 				
 				if ( df->isWord("array") ) {
 					if (!df->readWord()) goto exit;
 					if ( df->isWord(REAL_NAME) ) {
 						if (!df->readWord()) goto exit;
-						if ( df->isWord("coeff") ) {
+						if ( df->isWord("coeff") || df->isWord("wavelet_approx") ) {
 							df->readRealArray(coeff);
 							goto cont;
 						}
 					}
+					if ( df->isWord("byte") ) {
+						if (!df->readWord()) goto exit;
+						// coarse levels go first, the rest is skipped for previews
+						if ( df->isWord("wavelet_details") && ((levels < 0) || (wavelet_details.size() < (size_t)levels)) ) {
+							wavelet_details.push_back(std::vector<char>());
+							if ( !df->readByteArray(wavelet_details.back()) ) goto exit;
+							goto cont;
+						}
+						if ( !df->skipByteArray(false) ) goto exit;
+						goto cont;
+					}
 					if ( !df->skipArray(false) ) goto exit;
 				}
 				
@@ -1169,6 +628,11 @@ cont:
 			writelog(LOG_ERROR,"surf_load : empty geometry");
 			err = true;
 		}
+
+		if ( !err && (wavelet_levels > 0) ) {
+			if ( !_surf_wavelet_decode(coeff, grd, (size_t)wavelet_levels, wavelet_details, undef_value) )
+				err = true;
+		}
 		
 		if (err) {
 			if (coeff)
@@ -1213,11 +677,11 @@ exit:
 
 };
 
-d_surf * _surf_load(const char * filename, const char * surfname) {
+d_surf * _surf_load(const char * filename, const char * surfname, int levels) {
 
 	datafile * df = new datafile(filename, DF_MODE_READ); // read
 
-	d_surf * res = _surf_load_df(df, surfname);
+	d_surf * res = _surf_load_df(df, surfname, levels);
 
 	if (!res)
 		goto exit;
@@ -1266,6 +730,59 @@ bool _surf_save_df(const d_surf * srf, datafile * df) {
 	return res;
 };
 
+//! compares pyramid levels by the amount of nodes (larger first)
+static bool level_larger(const d_surf * a, const d_surf * b) {
+	return a->getCountX()*a->getCountY() > b->getCountX()*b->getCountY();
+};
+
+void _surf_pyramid_levels(const d_surf * srf, std::vector<const d_surf *> & levels) {
+	levels.resize(0);
+	if (!srf->getName())
+		return;
+	const char * name = srf->getName();
+	size_t len = strlen(name);
+	size_t i;
+	for (i = 0; i < surfit_surfs->size(); i++) {
+		const d_surf * level = (*surfit_surfs)[i];
+		if ((level == srf) || !level->getName())
+			continue;
+		const char * lname = level->getName();
+		if ((strncmp(lname, name, len) != 0) || (strncmp(lname + len, "_phase", 6) != 0))
+			continue;
+		const char * num = lname + len + 6;
+		if ((*num == '\0') || (strspn(num, "0123456789") != strlen(num)))
+			continue;
+		levels.push_back(level);
+	}
+	std::stable_sort(levels.begin(), levels.end(), level_larger);
+};
+
+bool _surf_save_pyramid(const d_surf * srf, const char * filename) {
+
+	std::vector<const d_surf *> levels;
+	_surf_pyramid_levels(srf, levels);
+	if (levels.size() == 0)
+		writelog(LOG_WARNING, "surf_save_pyramid : no pyramid levels found for surf \"%s\"", srf->getName());
+
+	datafile *df = new datafile(filename, DF_MODE_WRITE); // write
+	if (!df->condition()) {
+		delete df;
+		return false;
+	}
+
+	bool res = _surf_save_df(srf, df);
+	bool op;
+	size_t i;
+	for (i = 0; i < levels.size(); i++) {
+		op = _surf_save_df(levels[i], df);	res = ( op && res );
+	}
+
+	op = df->writeEof();				res = ( op && res );
+	
+	delete df;
+	return res;
+};
+
 d_surf * triangulate_points(const d_points * pnts, const d_grid * grid)
 {
 	size_t points_cnt = pnts->size();
@@ -1452,7 +969,7 @@ d_surf * triangulate_points(const d_points * pnts, const d_grid * grid)
 
 };
 
-std::vector<d_cntr *> * _surf_trace_cntrs(const d_surf * surf, REAL from, REAL to, REAL step, bool closed)
+std::vector<d_cntr *> * _surf_trace_cntrs(const d_surf * surf, REAL from, REAL to, REAL step, bool closed, REAL tolerance)
 {
 	std::vector<d_cntr *> * res = new std::vector<d_cntr *>();
 	
@@ -1490,15 +1007,27 @@ std::vector<d_cntr *> * _surf_trace_cntrs(const d_surf * surf, REAL from, REAL t
 		(*y_coords)(q) = y;
 	}
 
-	extvec * data = create_extvec(*(surf->coeff)); // don't fill;
+	// surfaces without coeff (float, paged) are read into temporary vector
+	extvec * data = NULL;
+	if (surf->coeff == NULL) {
+		data = create_extvec(NN*MM,0,false);
+		for (q = 0; q < NN*MM; q++)
+			(*data)(q) = surf->getValue(q);
+	}
 
 	writelog(LOG_MESSAGE,"tracing %d contours from surface \"%s\"", levels_count, surf->getName());
-	std::vector<fiso *> * isos = trace_isos(levels, x_coords, y_coords, data, NN, MM, surf->undef_value, closed);
+	std::vector<fiso *> * isos = trace_isos(levels, x_coords, y_coords, data ? data : surf->coeff, NN, MM, surf->undef_value, closed);
 
 	levels->release();
 	x_coords->release();
 	y_coords->release();
-	data->release();
+	if (data)
+		data->release();
+
+	if (isos == NULL)
+		return res;
+
+	simplify_isos(isos, tolerance);
 
 	std::vector<int> cnts(levels_count);
 	char buf[512];
@@ -1571,6 +1100,7 @@ std::vector<d_cntr *> * _surf_trace_cntrs(const d_surf * surf, REAL from, REAL t
 
 	}
 
+	free_elements(isos->begin(), isos->end());
 	delete isos;
 
 
@@ -1631,7 +1161,7 @@ float calc_label_width(const char * label, float digit_w, float period_w)
 	return res;
 };
 
-bool _surf_plot(const d_surf * srf, const char * filename, size_t number_of_levels, bool draw_isos, bool draw_colorscale ) 
+bool _surf_plot(const d_surf * srf, const char * filename, size_t number_of_levels, bool draw_isos, bool draw_colorscale, REAL tolerance) 
 {
 	if (srf == NULL)
 		return false;
@@ -1667,7 +1197,7 @@ bool _surf_plot(const d_surf * srf, const char * filename, size_t number_of_leve
 		size_t i;
 		for (i = 0; i < NN; i++)
 		{
-			if ( (*(srf->coeff))(i +min_j*NN) != srf->undef_value ) {
+			if ( srf->getValue(i +min_j*NN) != srf->undef_value ) {
 				founded = true;
 				break;
 			}
@@ -1692,27 +1222,26 @@ bool _surf_plot(const d_surf * srf, const char * filename, size_t number_of_leve
 	}
 
 	extvec * data = NULL;
-	if (min_j == 0)
-		data = create_extvec(*(srf->coeff)); // copy vector
-	else
+	if ((min_j > 0) || (srf->coeff == NULL))
 	{
 		size_t size = NN*(MM-min_j);
 		data = create_extvec(NN*(MM-min_j),0,false);
 		size_t q;
 		for (q = 0; q < size; q++) {
 			size_t pos = q + NN*min_j;
-			REAL val = (*(srf->coeff))(pos);
+			REAL val = srf->getValue(pos);
 			(*data)(q) = val;
 		}
 	}
 
 	writelog(LOG_MESSAGE,"tracing %d contours from surface \"%s\"", levels_count, srf->getName());
-	std::vector<fiso *> * isos = trace_isos(levels, x_coords, y_coords, data, NN, MM-min_j, srf->undef_value, true);
+	std::vector<fiso *> * isos = trace_isos(levels, x_coords, y_coords, data ? data : srf->coeff, NN, MM-min_j, srf->undef_value, true);
 
 	levels->release();
 	x_coords->release();
 	y_coords->release();
-	data->release();
+	if (data)
+		data->release();
 	
 	color_scale cs(from, to, step, DEFAULT_COLORS);
 
@@ -1751,6 +1280,9 @@ bool _surf_plot(const d_surf * srf, const char * filename, size_t number_of_leve
 	float MAXX = prj.get_x(maxx);
 	float MAXY = prj.get_y(maxy);
 
+	// tolerance in points -> millimeters -> map units
+	simplify_isos(isos, tolerance/2.834645669291*max_len/width);
+
 	//CreEPS ps(filename, 210, 297); // A4
 	CreEPS ps(filename, 200, 200); 
 	if (ps.file_status() == false)
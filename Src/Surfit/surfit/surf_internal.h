@@ -38,26 +38,38 @@ class d_mask;
 class d_cntr;
 
 
-//! loads \ref d_surf named 'surfname' from surfit \ref datafile
+/*! \brief loads \ref d_surf named 'surfname' from surfit \ref datafile
+    \param levels for surfaces saved with \ref _surf_save_wavelet, amount of detail levels to load (-1 for all)
+*/
 SURFIT_EXPORT
-d_surf * _surf_load(const char * filename, const char * surfname);
+d_surf * _surf_load(const char * filename, const char * surfname, int levels = -1);
 
-//! loads \ref d_surf named 'surfname' from surfit \ref datafile 
+//! loads \ref d_surf named 'surfname' from surfit \ref datafile (see \ref _surf_load)
 SURFIT_EXPORT
-d_surf * _surf_load_df(datafile * df, const char * surfname);
+d_surf * _surf_load_df(datafile * df, const char * surfname, int levels = -1);
 
 //! saves \ref d_surf to surfit \ref datafile 
 SURFIT_EXPORT
 bool _surf_save(const d_surf * srf, const char * filename);
 
-//! plots \ref d_surf to PostScript file
+/*! \brief plots \ref d_surf to PostScript file
+    \param tolerance isolines are simplified with this tolerance in points (1/72 inch) of the plot, 0 - no simplification
+*/
 SURFIT_EXPORT
-bool _surf_plot(const d_surf * srf, const char * filename, size_t number_of_levels = 16, bool draw_isos = true, bool draw_colorscale = true);
+bool _surf_plot(const d_surf * srf, const char * filename, size_t number_of_levels = 16, bool draw_isos = true, bool draw_colorscale = true, REAL tolerance = 0);
 
 //! writes \ref d_surf tags to \ref datafile
 SURFIT_EXPORT
 bool _surf_save_df(const d_surf * srf, datafile * df);
 
+//! finds pyramid levels of \ref d_surf (surfaces named "name_phaseN", see \ref surf_pyramid), larger levels first
+SURFIT_EXPORT
+void _surf_pyramid_levels(const d_surf * srf, std::vector<const d_surf *> & levels);
+
+//! saves \ref d_surf and its pyramid levels to surfit \ref datafile 
+SURFIT_EXPORT
+bool _surf_save_pyramid(const d_surf * srf, const char * filename);
+
 //! converts \ref d_surf to \ref d_points
 SURFIT_EXPORT
 d_points * _surf_to_pnts(const d_surf * srf);
@@ -142,9 +154,11 @@ int _surf_cells_in_area(const d_surf * srf, const d_area * crv);
 SURFIT_EXPORT
 d_surf * triangulate_points(const d_points * pnts, const d_grid * grd);
 
-//! traces contours from \ref d_surf
+/*! \brief traces contours from \ref d_surf
+    \param tolerance contours are simplified with this tolerance in map units, 0 - no simplification
+*/
 SURFIT_EXPORT
-std::vector<d_cntr *> * _surf_trace_cntrs(const d_surf * surf, REAL from = FLT_MAX, REAL to = FLT_MAX, REAL step = FLT_MAX, bool closed = false);
+std::vector<d_cntr *> * _surf_trace_cntrs(const d_surf * surf, REAL from = FLT_MAX, REAL to = FLT_MAX, REAL step = FLT_MAX, bool closed = false, REAL tolerance = 0);
 
 }; // namespace surfit;
 
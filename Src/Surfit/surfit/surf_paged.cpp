@@ -0,0 +1,329 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/vec.h"
+#include "../sstuff/bitvec.h"
+#include "../sstuff/mapfile.h"
+#include "../sstuff/datafile.h"
+
+#include "surf_paged.h"
+#include "surf_stats.h"
+#include "grid.h"
+#include "variables_tcl.h"
+
+#include <float.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef HAVE_THREADS
+#include "../sstuff/ptypes/pasync.h"
+USING_PTYPES
+#endif
+
+namespace surfit {
+
+#ifdef HAVE_THREADS
+//! guards tiles caches of all paged surfaces
+mutex surf_paged_mutex;
+#endif
+
+d_surf_paged * create_surf_paged(mapfile * mf, size_t offset, d_grid * igrd,
+				 REAL minz, REAL maxz, REAL blank,
+				 size_t cache_size, const char * surfname)
+{
+	return new d_surf_paged(mf, offset, igrd, minz, maxz, blank, cache_size, surfname);
+};
+
+d_surf_paged::d_surf_paged(mapfile * imf, size_t ioffset, d_grid * igrd,
+			   REAL iminz, REAL imaxz, REAL iblank,
+			   size_t cache_size, const char * surfname) : d_surf(NULL, igrd, surfname)
+{
+	mf = imf;
+	offset = ioffset;
+	minz = iminz;
+	maxz = imaxz;
+	blank = iblank;
+	undef_value = surfit::undef_value;
+
+	tiles_x = (grd->getCountX() + SURF_PAGED_TILE - 1)/SURF_PAGED_TILE;
+	tiles_y = (grd->getCountY() + SURF_PAGED_TILE - 1)/SURF_PAGED_TILE;
+	// two rows of tiles are enough for bilinear interpolation along the grid rows
+	max_tiles = MAX(2, cache_size/(SURF_PAGED_TILE*SURF_PAGED_TILE*sizeof(REAL)));
+
+	tiles.resize(tiles_x*tiles_y, NULL);
+	lru_pos.resize(tiles_x*tiles_y);
+};
+
+d_surf_paged::~d_surf_paged() {
+	size_t t;
+	for (t = 0; t < tiles.size(); t++)
+		free(tiles[t]);
+	if (mf)
+		mf->release();
+};
+
+void d_surf_paged::read_tile(size_t ti, size_t tj, REAL * tile) const {
+	size_t NN = grd->getCountX();
+	size_t MM = grd->getCountY();
+	size_t i_from = ti*SURF_PAGED_TILE;
+	size_t j_from = tj*SURF_PAGED_TILE;
+	size_t width = MIN(SURF_PAGED_TILE, NN - i_from);
+	size_t height = MIN(SURF_PAGED_TILE, MM - j_from);
+	size_t i, j;
+	for (j = 0; j < height; j++) {
+		// values in file can be unaligned
+		const char * src = mf->begin() + offset + ((j_from + j)*NN + i_from)*sizeof(double);
+		REAL * dst = tile + j*SURF_PAGED_TILE;
+		for (i = 0; i < width; i++) {
+			double value;
+			memcpy(&value, src + i*sizeof(double), sizeof(double));
+			if ((value < minz) || (value > maxz) || (value >= blank))
+				dst[i] = undef_value;
+			else
+				dst[i] = REAL(value);
+		}
+	}
+};
+
+const REAL * d_surf_paged::get_tile(size_t ti, size_t tj) const {
+	size_t t = ti + tj*tiles_x;
+	if (tiles[t]) {
+		lru.splice(lru.begin(), lru, lru_pos[t]);
+		return tiles[t];
+	}
+
+	REAL * tile = NULL;
+	if (lru.size() >= max_tiles) {
+		// reuse memory of the least recently used tile
+		size_t old = lru.back();
+		lru.pop_back();
+		tile = tiles[old];
+		tiles[old] = NULL;
+	} else
+		tile = (REAL *)malloc(SURF_PAGED_TILE*SURF_PAGED_TILE*sizeof(REAL));
+
+	read_tile(ti, tj, tile);
+	tiles[t] = tile;
+	lru.push_front(t);
+	lru_pos[t] = lru.begin();
+	return tile;
+};
+
+REAL d_surf_paged::getValueIJ(size_t I, size_t J) const {
+	if (I >= grd->getCountX())
+		return FLT_MAX;
+	if (J >= grd->getCountY())
+		return FLT_MAX;
+
+#ifdef HAVE_THREADS
+	surf_paged_mutex.enter();
+#endif
+	const REAL * tile = get_tile(I/SURF_PAGED_TILE, J/SURF_PAGED_TILE);
+	REAL res = tile[I%SURF_PAGED_TILE + (J%SURF_PAGED_TILE)*SURF_PAGED_TILE];
+#ifdef HAVE_THREADS
+	surf_paged_mutex.leave();
+#endif
+	return res;
+};
+
+REAL d_surf_paged::getValue(size_t pos) const {
+	size_t NN = grd->getCountX();
+	return getValueIJ(pos % NN, pos / NN);
+};
+
+void d_surf_paged::read_only() const {
+	writelog(LOG_ERROR, "surf \"%s\" is paged from file and can't be modified", getName());
+};
+
+void d_surf_paged::setValue(size_t pos, REAL val) { read_only(); };
+
+void d_surf_paged::plus(const d_surf * srf) { read_only(); };
+void d_surf_paged::plus_mask(const d_surf * srf, const bitvec * mask) { read_only(); };
+void d_surf_paged::minus(const d_surf * srf) { read_only(); };
+void d_surf_paged::minus_mask(const d_surf * srf, const bitvec * mask) { read_only(); };
+void d_surf_paged::mult(const d_surf * srf) { read_only(); };
+void d_surf_paged::mult_mask(const d_surf * srf, const bitvec * mask) { read_only(); };
+void d_surf_paged::div(const d_surf * srf) { read_only(); };
+void d_surf_paged::div_mask(const d_surf * srf, const bitvec * mask) { read_only(); };
+void d_surf_paged::set(const d_surf * srf) { read_only(); };
+void d_surf_paged::set_mask(const d_surf * srf, const bitvec * mask) { read_only(); };
+
+void d_surf_paged::plus(REAL val) { read_only(); };
+void d_surf_paged::plus_mask(REAL val, const bitvec * mask) { read_only(); };
+void d_surf_paged::minus(REAL val) { read_only(); };
+void d_surf_paged::minus_mask(REAL val, const bitvec * mask) { read_only(); };
+void d_surf_paged::mult(REAL val) { read_only(); };
+void d_surf_paged::mult_mask(REAL val, const bitvec * mask) { read_only(); };
+void d_surf_paged::div(REAL val) { read_only(); };
+void d_surf_paged::div_mask(REAL val, const bitvec * mask) { read_only(); };
+void d_surf_paged::set(REAL val) { read_only(); };
+void d_surf_paged::set_mask(REAL val, const bitvec * mask) { read_only(); };
+
+bool d_surf_paged::add_noise(REAL std) {
+	read_only();
+	return false;
+};
+
+bool d_surf_paged::decompose() {
+	read_only();
+	return false;
+};
+
+bool d_surf_paged::auto_decompose(REAL eps, int norm) {
+	return decompose();
+};
+
+bool d_surf_paged::reconstruct() {
+	return decompose();
+};
+
+bool d_surf_paged::full_reconstruct() {
+	return decompose();
+};
+
+void d_surf_paged::drop_tiles() const {
+#ifdef HAVE_THREADS
+	surf_paged_mutex.enter();
+#endif
+	size_t t;
+	for (t = 0; t < tiles.size(); t++) {
+		free(tiles[t]);
+		tiles[t] = NULL;
+	}
+	lru.clear();
+#ifdef HAVE_THREADS
+	surf_paged_mutex.leave();
+#endif
+};
+
+void d_surf_paged::set_undef_value(REAL new_undef_value) {
+	// undefined values are substituted when tiles are read
+	drop_tiles();
+	undef_value = new_undef_value;
+};
+
+void d_surf_paged::hold_sums() const {
+	// getSumValue sums nodes of tiles directly
+};
+
+void d_surf_paged::release_sums() const {
+};
+
+REAL d_surf_paged::calc_approx_norm(int norm_type) const {
+	size_t NN = grd->getCountX();
+	size_t MM = grd->getCountY();
+	size_t ti, tj, i, j;
+	REAL res = REAL(0);
+	// tiles are visited one by one, so each of them is read once
+	for (tj = 0; tj < tiles_y; tj++) {
+		for (ti = 0; ti < tiles_x; ti++) {
+			size_t i_to = MIN(NN, (ti+1)*SURF_PAGED_TILE);
+			size_t j_to = MIN(MM, (tj+1)*SURF_PAGED_TILE);
+			for (j = tj*SURF_PAGED_TILE; j < j_to; j++) {
+				for (i = ti*SURF_PAGED_TILE; i < i_to; i++) {
+					REAL value = getValueIJ(i, j);
+					res += value*value;
+				}
+			}
+		}
+	}
+	return res/(NN*MM);
+};
+
+void d_surf_paged::stats(const bitvec * msk, stat_acc & res) const
+{
+	size_t NN = grd->getCountX();
+	size_t MM = grd->getCountY();
+	size_t ti, tj, i, j;
+
+	REAL row[SURF_PAGED_TILE];
+
+	// tiles are read past the cache to keep it for queries
+	REAL * tile = (REAL *)malloc(SURF_PAGED_TILE*SURF_PAGED_TILE*sizeof(REAL));
+	for (tj = 0; tj < tiles_y; tj++) {
+		for (ti = 0; ti < tiles_x; ti++) {
+			size_t width = MIN(SURF_PAGED_TILE, NN - ti*SURF_PAGED_TILE);
+			size_t height = MIN(SURF_PAGED_TILE, MM - tj*SURF_PAGED_TILE);
+			read_tile(ti, tj, tile);
+			for (j = 0; j < height; j++) {
+				const REAL * values = tile + j*SURF_PAGED_TILE;
+				if (msk) {
+					size_t pos = ti*SURF_PAGED_TILE + (tj*SURF_PAGED_TILE + j)*NN;
+					for (i = 0; i < width; i++)
+						row[i] = msk->get(pos + i) ? values[i] : this->undef_value;
+					values = row;
+				}
+				res.add(values, width, this->undef_value);
+			}
+		}
+	}
+	free(tile);
+};
+
+extvec * d_surf_paged::read_all() const {
+	size_t NN = grd->getCountX();
+	size_t MM = grd->getCountY();
+	extvec * res = create_extvec(NN*MM, 0, false); // don't fill
+	size_t ti, tj, i, j;
+	REAL * tile = (REAL *)malloc(SURF_PAGED_TILE*SURF_PAGED_TILE*sizeof(REAL));
+	// tiles are read past the cache
+	for (tj = 0; tj < tiles_y; tj++) {
+		for (ti = 0; ti < tiles_x; ti++) {
+			size_t width = MIN(SURF_PAGED_TILE, NN - ti*SURF_PAGED_TILE);
+			size_t height = MIN(SURF_PAGED_TILE, MM - tj*SURF_PAGED_TILE);
+			read_tile(ti, tj, tile);
+			for (j = 0; j < height; j++) {
+				for (i = 0; i < width; i++)
+					(*res)(ti*SURF_PAGED_TILE + i + (tj*SURF_PAGED_TILE + j)*NN) = tile[i + j*SURF_PAGED_TILE];
+			}
+		}
+	}
+	free(tile);
+	return res;
+};
+
+bool d_surf_paged::writeTags(datafile *df) const {
+
+	bool res = true;
+	bool op;
+
+	extvec * values = read_all();
+
+	op = df->writeTag("surf");		res = (res && op);
+
+	if (getName()) {
+		op = df->writeString("name", getName()); res = (res && op);
+	}
+
+	op = grd->writeTags(df);			res = (res && op);
+	op = df->writeRealArray("coeff", values, getCountX()); res = (res && op);
+	op = df->writeReal("undef_value", undef_value); res = (res && op);
+	op = df->writeEndTag();					res = (res && op);
+
+	values->release();
+
+	return res;
+
+};
+
+}; // namespace surfit;
+
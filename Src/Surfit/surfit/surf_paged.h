@@ -0,0 +1,190 @@
+
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__surf_paged__
+#define __surfit__surf_paged__
+
+#include <vector>
+#include <list>
+
+#include "surf.h"
+
+namespace surfit {
+
+class mapfile;
+class d_surf_paged;
+struct stat_acc;
+
+//! size of \ref d_surf_paged tile side (in nodes)
+#define SURF_PAGED_TILE 256
+
+/*! \brief constructor for \ref d_surf_paged
+    \param mf mapped file with surface values (released by the surface)
+    \param offset position of the first value in the file
+    \param igrd surface grid
+    \param minz values less than minz are undefined
+    \param maxz values greater than maxz are undefined
+    \param blank values greater than or equal to blank are undefined
+    \param cache_size maximum size of tiles cache in bytes
+    \param surfname surface name
+*/
+SURFIT_EXPORT
+d_surf_paged * create_surf_paged(mapfile * mf, size_t offset, d_grid * igrd,
+				 REAL minz, REAL maxz, REAL blank,
+				 size_t cache_size, const char * surfname = 0);
+
+/*! \class d_surf_paged
+    \brief surface with values kept in the file and read on demand
+
+    Values are stored in the file as doubles, row by row from south to north
+    (Surfer7 GRD data section). File stays mapped, and square tiles of
+    SURF_PAGED_TILE x SURF_PAGED_TILE nodes are read into the cache when
+    they are needed. Least recently used tiles are dropped when the cache is full.
+
+    coeff is NULL for paged surfaces. Value queries (getValue, getInterpValue,
+    getMeanValue, getValueIJ), statistics, \ref _surf_project and saving to
+    datafile work on paged surfaces. Operations changing values log an error
+    and leave the surface unchanged; they need a surface in memory (see \ref read_all).
+*/
+class SURFIT_EXPORT d_surf_paged : public d_surf {
+protected:
+	//! constructor
+	d_surf_paged(mapfile * imf, size_t ioffset, d_grid * igrd,
+		     REAL iminz, REAL imaxz, REAL iblank,
+		     size_t cache_size, const char * surfname);
+
+	//! destructor
+	virtual ~d_surf_paged();
+
+public:
+
+	//! constructor
+	friend SURFIT_EXPORT
+	d_surf_paged * create_surf_paged(mapfile * mf, size_t offset, d_grid * igrd,
+					 REAL minz, REAL maxz, REAL blank,
+					 size_t cache_size, const char * surfname);
+
+	using d_surf::getValue;
+
+	//! returns surface value at node (i,j)
+	virtual REAL getValueIJ(size_t i, size_t j) const;
+
+	//! returns surface value at node
+	virtual REAL getValue(size_t pos) const;
+
+	//! paged surfaces are read-only
+	virtual void setValue(size_t pos, REAL val);
+
+	//
+	// paged surfaces are read-only: arithmetics, noise and wavelets log an error
+	//
+
+	virtual void plus(const d_surf * srf);
+	virtual void plus_mask(const d_surf * srf, const bitvec * mask);
+	virtual void minus(const d_surf * srf);
+	virtual void minus_mask(const d_surf * srf, const bitvec * mask);
+	virtual void mult(const d_surf * srf);
+	virtual void mult_mask(const d_surf * srf, const bitvec * mask);
+	virtual void div(const d_surf * srf);
+	virtual void div_mask(const d_surf * srf, const bitvec * mask);
+	virtual void set(const d_surf * srf);
+	virtual void set_mask(const d_surf * srf, const bitvec * mask);
+
+	virtual void plus(REAL val);
+	virtual void plus_mask(REAL val, const bitvec * mask);
+	virtual void minus(REAL val);
+	virtual void minus_mask(REAL val, const bitvec * mask);
+	virtual void mult(REAL val);
+	virtual void mult_mask(REAL val, const bitvec * mask);
+	virtual void div(REAL val);
+	virtual void div_mask(REAL val, const bitvec * mask);
+	virtual void set(REAL val);
+	virtual void set_mask(REAL val, const bitvec * mask);
+
+	virtual bool add_noise(REAL std);
+
+	virtual bool decompose();
+	virtual bool auto_decompose(REAL eps, int norm = 0);
+	virtual bool reconstruct();
+	virtual bool full_reconstruct();
+
+	//! changes undefined value (values in file are not changed, cached tiles are dropped)
+	virtual void set_undef_value(REAL new_undef_value);
+
+	//! calculates surface norm (tile by tile)
+	virtual REAL calc_approx_norm(int norm_type) const;
+
+	//! summed-area tables are not built, they would be as large as the whole grid
+	virtual void hold_sums() const;
+	//! nothing to release (see \ref hold_sums)
+	virtual void release_sums() const;
+
+	//! writes tag for saving surf to datafile
+	virtual bool writeTags(datafile * df) const;
+
+	//! reads all surface values into memory
+	extvec * read_all() const;
+
+	//! adds values of nodes where msk is true (or all nodes) to statistics (tiles are read past the cache)
+	void stats(const bitvec * msk, stat_acc & res) const;
+
+private:
+
+	//! logs error about modification of paged surface
+	void read_only() const;
+
+	//! drops all tiles from the cache
+	void drop_tiles() const;
+
+	//! returns tile (ti,tj) from the cache, reading it if necessary. Cache should be locked
+	const REAL * get_tile(size_t ti, size_t tj) const;
+
+	//! reads tile values from file
+	void read_tile(size_t ti, size_t tj, REAL * tile) const;
+
+	//! mapped file
+	mapfile * mf;
+	//! position of the first value in the file
+	size_t offset;
+	//! values less than minz are undefined
+	REAL minz;
+	//! values greater than maxz are undefined
+	REAL maxz;
+	//! values greater than or equal to blank are undefined
+	REAL blank;
+
+	//! amount of tiles in X direction
+	size_t tiles_x;
+	//! amount of tiles in Y direction
+	size_t tiles_y;
+	//! maximum amount of tiles in the cache
+	size_t max_tiles;
+
+	//! cached tiles (NULL for tiles not in the cache)
+	mutable std::vector<REAL *> tiles;
+	//! cached tiles numbers, most recently used first
+	mutable std::list<size_t> lru;
+	//! positions of cached tiles in lru list
+	mutable std::vector< std::list<size_t>::iterator > lru_pos;
+};
+
+}; // namespace surfit;
+
+#endif
+
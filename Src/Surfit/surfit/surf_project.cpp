@@ -0,0 +1,440 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/vec.h"
+#include "../sstuff/threads.h"
+
+#include "surf_project.h"
+#include "surf.h"
+#include "grid.h"
+#include "grid_line.h"
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace surfit {
+
+//! weights of source nodes for each node of new grid along one axis
+struct proj_axis
+{
+	//! taps of node k are from[k]..from[k+1]-1
+	std::vector<size_t> from;
+	//! source node numbers
+	std::vector<size_t> index;
+	//! source node weights
+	std::vector<REAL> weight;
+	//! maximum amount of taps
+	size_t max_taps;
+
+	void add(size_t i, REAL w) {
+		index.push_back(i);
+		weight.push_back(w);
+	};
+};
+
+//! calculates weights for dst_n nodes starting at dst_start with dst_step
+static void proj_axis_build(proj_axis & ax, int kernel,
+			    REAL src_start, REAL src_step, size_t src_n,
+			    REAL dst_start, REAL dst_step, size_t dst_n)
+{
+	ax.from.resize(dst_n + 1);
+	ax.index.clear();
+	ax.weight.clear();
+	ax.max_taps = 0;
+
+	size_t k;
+	for (k = 0; k < dst_n; k++) {
+		ax.from[k] = ax.index.size();
+		REAL x = dst_start + k*dst_step;
+		REAL f = (x - src_start)/src_step;
+
+		switch (kernel) {
+		case SURF_PROJECT_NEAREST:
+			{
+				REAL fi = (REAL)floor(f + REAL(0.5));
+				fi = MIN(MAX(REAL(0), fi), (REAL)(src_n-1));
+				ax.add((size_t)fi, 1);
+			}
+			break;
+		case SURF_PROJECT_BILINEAR:
+			{
+				// the same as in d_surf::getInterpValue, extrapolates outside of surface
+				size_t I0 = (size_t)MAX(0, floor(f));
+				size_t I1 = I0 + 1;
+				I0 = MIN(I0, src_n-1);
+				I1 = MIN(I1, src_n-1);
+				REAL t = (x - (src_start + I0*src_step))/src_step;
+				ax.add(I0, 1 - t);
+				ax.add(I1, t);
+			}
+			break;
+		case SURF_PROJECT_BICUBIC:
+			{
+				REAL fi = MIN(MAX(REAL(0), (REAL)floor(f)), (REAL)(src_n-1));
+				REAL t = MIN(MAX(REAL(0), f - fi), REAL(1));
+				REAL t2 = t*t, t3 = t2*t;
+				REAL w[4];
+				w[0] = (-t3 + 2*t2 - t)/REAL(2);
+				w[1] = (3*t3 - 5*t2 + 2)/REAL(2);
+				w[2] = (-3*t3 + 4*t2 + t)/REAL(2);
+				w[3] = (t3 - t2)/REAL(2);
+				int q;
+				for (q = 0; q < 4; q++) {
+					REAL fq = MIN(MAX(REAL(0), fi + q - 1), (REAL)(src_n-1));
+					ax.add((size_t)fq, w[q]);
+				}
+			}
+			break;
+		case SURF_PROJECT_AREA:
+			{
+				// cell of new grid [a0,a1] and cells of surface [b0,b1]
+				REAL a0 = x - dst_step/REAL(2);
+				REAL a1 = x + dst_step/REAL(2);
+				REAL fi0 = (REAL)floor( (a0 - src_start)/src_step + REAL(0.5) );
+				REAL fi1 = (REAL)floor( (a1 - src_start)/src_step + REAL(0.5) );
+				fi0 = MAX(REAL(0), fi0);
+				fi1 = MIN((REAL)(src_n-1), fi1);
+				REAL fi;
+				for (fi = fi0; fi <= fi1; fi++) {
+					REAL b0 = src_start + (fi - REAL(0.5))*src_step;
+					REAL b1 = b0 + src_step;
+					REAL overlap = MIN(a1, b1) - MAX(a0, b0);
+					if (overlap > 0)
+						ax.add((size_t)fi, overlap/dst_step);
+				}
+			}
+			break;
+		}
+
+		ax.max_taps = MAX(ax.max_taps, ax.index.size() - ax.from[k]);
+	}
+	ax.from[dst_n] = ax.index.size();
+};
+
+//! projection parameters, shared by all threads
+struct proj_params
+{
+	const d_surf * srf;
+	int kernel;
+	const grid_line * faults;
+	//! weights of the kernel
+	proj_axis ax, ay;
+	//! bilinear weights (for bicubic kernel near undefined nodes)
+	proj_axis lx, ly;
+	extvec * coeff;
+	size_t size_x;
+};
+
+//! ring of rows, row r is kept in slot r % slots
+struct proj_rows
+{
+	proj_rows(size_t islots, size_t iwidth) : slots(islots), width(iwidth), tags(islots, (size_t)-1), data(islots*iwidth) {};
+	//! returns row memory, fresh is true if row r should be calculated
+	REAL * get(size_t r, bool & fresh) {
+		size_t s = r % slots;
+		fresh = (tags[s] != r);
+		tags[s] = r;
+		return &data[s*width];
+	};
+	size_t slots;
+	size_t width;
+	std::vector<size_t> tags;
+	std::vector<REAL> data;
+};
+
+//! reads row J of surface
+static const REAL * proj_src_row(const d_surf * srf, size_t J, proj_rows & rows)
+{
+	bool fresh;
+	REAL * row = rows.get(J, fresh);
+	if (fresh) {
+		size_t NN = srf->getCountX();
+		size_t i, pos = J*NN;
+		if (srf->coeff) {
+			for (i = 0; i < NN; i++)
+				row[i] = (*(srf->coeff))(pos + i);
+		} else {
+			for (i = 0; i < NN; i++)
+				row[i] = srf->getValue(pos + i);
+		}
+	}
+	return row;
+};
+
+//! bilinear interpolation for node (i,j) of new grid
+static REAL proj_bilinear(const proj_params & p, size_t i, size_t j, proj_rows & src)
+{
+	const d_surf * srf = p.srf;
+	REAL undef = srf->undef_value;
+	size_t NN = srf->getCountX();
+
+	size_t I0 = p.lx.index[p.lx.from[i]];
+	size_t I1 = p.lx.index[p.lx.from[i]+1];
+	REAL tx = p.lx.weight[p.lx.from[i]+1];
+	size_t J0 = p.ly.index[p.ly.from[j]];
+	size_t J1 = p.ly.index[p.ly.from[j]+1];
+	REAL ty = p.ly.weight[p.ly.from[j]+1];
+
+	const REAL * row0 = proj_src_row(srf, J0, src);
+	const REAL * row1 = proj_src_row(srf, J1, src);
+	REAL z0 = row0[I0];
+	REAL z1 = row0[I1];
+	REAL z2 = row1[I1];
+	REAL z3 = row1[I0];
+
+	if ( (z0 == undef) || (z1 == undef) || (z2 == undef) || (z3 == undef) ) {
+		REAL sum = REAL(0);
+		int cnt = 0;
+		if (z0 != undef) { sum += z0; cnt++; }
+		if (z1 != undef) { sum += z1; cnt++; }
+		if (z2 != undef) { sum += z2; cnt++; }
+		if (z3 != undef) { sum += z3; cnt++; }
+		if (cnt == 0)
+			return undef;
+		REAL mean_z = sum/REAL(cnt);
+		if (z0 == undef) z0 = mean_z;
+		if (z1 == undef) z1 = mean_z;
+		if (z2 == undef) z2 = mean_z;
+		if (z3 == undef) z3 = mean_z;
+	}
+
+	if (p.faults == NULL) {
+		REAL z11 = (z2-z1)*ty+z1;
+		REAL z22 = (z3-z0)*ty+z0;
+		return (z11-z22)*tx+z22;
+	}
+
+	// values are not interpolated across the faults
+	if ( p.faults->check_for_pair(I1 + J0*NN, I1 + J1*NN) ) {
+		if (ty < REAL(0.5))
+			z2 = z1;
+		else
+			z1 = z2;
+	}
+	if ( p.faults->check_for_pair(I0 + J0*NN, I0 + J1*NN) ) {
+		if (ty < REAL(0.5))
+			z3 = z0;
+		else
+			z0 = z3;
+	}
+
+	REAL z11 = (z2-z1)*ty+z1;
+	REAL z22 = (z3-z0)*ty+z0;
+
+	if ( p.faults->check_for_pair(I0 + J0*NN, I1 + J0*NN) ||
+	     p.faults->check_for_pair(I0 + J1*NN, I1 + J1*NN) )
+	{
+		if (tx < REAL(0.5))
+			return z22;
+		return z11;
+	}
+	return (z11-z22)*tx+z22;
+};
+
+//! calculates rows [J_from, J_to) of new grid
+static void proj_do_rows(const proj_params & p, size_t J_from, size_t J_to)
+{
+	const d_surf * srf = p.srf;
+	REAL undef = srf->undef_value;
+	size_t NN = srf->getCountX();
+	size_t size_x = p.size_x;
+	size_t i, j;
+
+	// surface rows for bilinear interpolation
+	proj_rows src(3, NN);
+
+	if (p.kernel == SURF_PROJECT_BILINEAR) {
+		for (j = J_from; j < J_to; j++) {
+			for (i = 0; i < size_x; i++)
+				(*(p.coeff))(i + j*size_x) = proj_bilinear(p, i, j, src);
+		}
+		return;
+	}
+
+	// surface rows interpolated along X: weighted sums of defined values and sums of their weights
+	proj_rows hrows(p.ay.max_taps + 1, 2*size_x);
+	proj_rows hsrc(1, NN);
+	std::vector<REAL> num(size_x), den(size_x);
+
+	for (j = J_from; j < J_to; j++) {
+
+		std::fill(num.begin(), num.end(), REAL(0));
+		std::fill(den.begin(), den.end(), REAL(0));
+
+		size_t q;
+		for (q = p.ay.from[j]; q < p.ay.from[j+1]; q++) {
+			size_t J = p.ay.index[q];
+			REAL wy = p.ay.weight[q];
+			bool fresh;
+			REAL * h = hrows.get(J, fresh);
+			if (fresh) {
+				const REAL * row = proj_src_row(srf, J, hsrc);
+				for (i = 0; i < size_x; i++) {
+					REAL s = 0, w = 0;
+					size_t t;
+					for (t = p.ax.from[i]; t < p.ax.from[i+1]; t++) {
+						REAL z = row[p.ax.index[t]];
+						if (z == undef)
+							continue;
+						s += p.ax.weight[t]*z;
+						w += p.ax.weight[t];
+					}
+					h[i] = s;
+					h[size_x + i] = w;
+				}
+			}
+			for (i = 0; i < size_x; i++) {
+				num[i] += wy*h[i];
+				den[i] += wy*h[size_x + i];
+			}
+		}
+
+		for (i = 0; i < size_x; i++) {
+			REAL res;
+			if (p.kernel == SURF_PROJECT_BICUBIC) {
+				// all weights sum to one, if some nodes are undefined - use bilinear interpolation
+				if (fabs(den[i] - 1) < 1e-6)
+					res = num[i];
+				else
+					res = proj_bilinear(p, i, j, src);
+			} else {
+				if (den[i] > 0)
+					res = num[i]/den[i];
+				else
+					res = undef;
+			}
+			(*(p.coeff))(i + j*size_x) = res;
+		}
+	}
+};
+
+#ifdef HAVE_THREADS
+struct surf_proj_job : public job
+{
+	surf_proj_job()
+	{
+		p = NULL;
+		J_from = 0;
+		J_to = 0;
+	};
+	void set(const proj_params * ip, size_t iJ_from, size_t iJ_to)
+	{
+		p = ip;
+		J_from = iJ_from;
+		J_to = iJ_to;
+	};
+	virtual void do_job()
+	{
+		proj_do_rows(*p, J_from, J_to);
+	};
+
+	const proj_params * p;
+	size_t J_from, J_to;
+};
+
+surf_proj_job surf_proj_jobs[MAX_CPU];
+#endif
+
+d_surf * _surf_project(const d_surf * srf, const d_grid * grd, int kernel, const grid_line * faults)
+{
+	if ((kernel < SURF_PROJECT_NEAREST) || (kernel > SURF_PROJECT_AREA)) {
+		writelog(LOG_ERROR, "surf_project : wrong kernel %d", kernel);
+		return NULL;
+	}
+
+	size_t size_x = grd->getCountX();
+	size_t size_y = grd->getCountY();
+
+	size_t surf_sizeX = srf->getCountX();
+	size_t surf_sizeY = srf->getCountY();
+
+	if (srf->getName())
+		writelog(LOG_MESSAGE,"Projecting surf \"%s\" (%d x %d) => (%d x %d)",srf->getName(), surf_sizeX, surf_sizeY, size_x, size_y);
+	else
+		writelog(LOG_MESSAGE,"Projecting surf (%d x %d) => (%d x %d)", surf_sizeX, surf_sizeY, size_x, size_y);
+
+	const d_grid * g = srf->grd;
+
+	proj_params p;
+	p.srf = srf;
+	p.kernel = kernel;
+	p.faults = faults;
+	p.size_x = size_x;
+	proj_axis_build(p.lx, SURF_PROJECT_BILINEAR, g->startX, g->stepX, surf_sizeX, grd->startX, grd->stepX, size_x);
+	proj_axis_build(p.ly, SURF_PROJECT_BILINEAR, g->startY, g->stepY, surf_sizeY, grd->startY, grd->stepY, size_y);
+	if (kernel != SURF_PROJECT_BILINEAR) {
+		proj_axis_build(p.ax, kernel, g->startX, g->stepX, surf_sizeX, grd->startX, grd->stepX, size_x);
+		proj_axis_build(p.ay, kernel, g->startY, g->stepY, surf_sizeY, grd->startY, grd->stepY, size_y);
+	}
+
+	p.coeff = create_extvec(size_x*size_y,0,0);  // do not fill this vector
+
+#ifdef HAVE_THREADS
+	// paged surfaces (without coeff) are projected serially
+	if ((sstuff_get_threads() == 1) || (srf->coeff == NULL) || (size_y < sstuff_get_threads())) {
+#endif
+		proj_do_rows(p, 0, size_y);
+#ifdef HAVE_THREADS
+	} else {
+		size_t step = size_y / (sstuff_get_threads());
+		size_t ost = size_y % (sstuff_get_threads());
+		size_t J_from = 0;
+		size_t J_to = 0;
+		size_t work;
+		for (work = 0; work < sstuff_get_threads(); work++) {
+			J_to = J_from + step;
+			if (work == 0)
+				J_to += ost;
+
+			surf_proj_job & f = surf_proj_jobs[work];
+			f.set(&p, J_from, J_to);
+			set_job(&f, work);
+			J_from = J_to;
+		}
+
+		do_jobs();
+	}
+#endif
+
+	d_grid * new_grd = create_grid(grd);
+	d_surf * res = create_surf(p.coeff, new_grd, srf->getName());
+	res->undef_value = srf->undef_value;
+	return res;
+};
+
+int surf_project_kernel(const char * name)
+{
+	if (name == NULL)
+		return SURF_PROJECT_BILINEAR;
+	if (strcmp(name, "nearest") == 0)
+		return SURF_PROJECT_NEAREST;
+	if (strcmp(name, "bilinear") == 0)
+		return SURF_PROJECT_BILINEAR;
+	if (strcmp(name, "bicubic") == 0)
+		return SURF_PROJECT_BICUBIC;
+	if (strcmp(name, "area") == 0)
+		return SURF_PROJECT_AREA;
+	return -1;
+};
+
+}; // namespace surfit;
+
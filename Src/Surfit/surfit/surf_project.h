@@ -0,0 +1,61 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__surf_project__
+#define __surfit__surf_project__
+
+namespace surfit {
+
+class d_surf;
+class d_grid;
+class grid_line;
+
+//! value of the nearest node (nodes outside of surface take values of the edge nodes)
+#define SURF_PROJECT_NEAREST 0
+//! bilinear interpolation (as \ref d_surf::getInterpValue)
+#define SURF_PROJECT_BILINEAR 1
+//! bicubic (Catmull-Rom) interpolation
+#define SURF_PROJECT_BICUBIC 2
+//! mean of surface cells covered by the cell of new grid, weighted by the covered area
+#define SURF_PROJECT_AREA 3
+
+/*! \brief recalculates \ref d_surf to new \ref d_grid
+    \param srf surface
+    \param grd new grid
+    \param kernel SURF_PROJECT_NEAREST, SURF_PROJECT_BILINEAR, SURF_PROJECT_BICUBIC or SURF_PROJECT_AREA
+    \param faults if not NULL, bilinear interpolation doesn't cross the faults
+
+    Weights of surface nodes are calculated once for each column and each row of the new
+    grid. Each row of the surface is interpolated along X once, and then the rows are
+    combined along Y. Rows of the new grid are divided between threads.
+
+    Undefined nodes: bilinear kernel replaces them with the mean of defined corners,
+    nearest and area kernels use the defined nodes only, and bicubic kernel falls back
+    to bilinear interpolation near undefined nodes.
+*/
+SURFIT_EXPORT
+d_surf * _surf_project(const d_surf * srf, const d_grid * grd, int kernel, const grid_line * faults = NULL);
+
+//! returns kernel number for name ("nearest", "bilinear", "bicubic" or "area"), or -1
+SURFIT_EXPORT
+int surf_project_kernel(const char * name);
+
+}; // namespace surfit;
+
+#endif
+
@@ -0,0 +1,293 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/vec.h"
+#include "../sstuff/threads.h"
+
+#include "surf_sample.h"
+#include "surf.h"
+#include "grid.h"
+#include "points.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+namespace surfit {
+
+//! amount of points processed at once
+#define SURF_SAMPLE_CHUNK 256
+
+//! points are not sorted if there are less points
+#define SURF_SAMPLE_SORT_MIN 1024
+
+//! returns surface value at node
+inline REAL sample_node(const d_surf * srf, size_t pos) {
+	if (srf->coeff)
+		return (*(srf->coeff))(pos);
+	return srf->getValue(pos);
+};
+
+/*! \brief calculates values for points order[from..to)
+    Each step is done for the whole chunk of points, so the loops over
+    coordinates and weights can be vectorized by compiler.
+*/
+static void sample_points(const d_surf * srf, const REAL * X, const REAL * Y,
+			  const size_t * order, size_t from, size_t to,
+			  REAL * values, int kernel)
+{
+	const d_grid * grd = srf->grd;
+	size_t NN = grd->getCountX();
+	size_t MM = grd->getCountY();
+	REAL startX = grd->startX;
+	REAL startY = grd->startY;
+	REAL hX = grd->stepX;
+	REAL hY = grd->stepY;
+	REAL undef = srf->undef_value;
+
+	REAL xs[SURF_SAMPLE_CHUNK], ys[SURF_SAMPLE_CHUNK];
+	REAL fi[SURF_SAMPLE_CHUNK], fj[SURF_SAMPLE_CHUNK];
+	REAL z0[SURF_SAMPLE_CHUNK], z1[SURF_SAMPLE_CHUNK], z2[SURF_SAMPLE_CHUNK], z3[SURF_SAMPLE_CHUNK];
+	REAL res[SURF_SAMPLE_CHUNK];
+
+	size_t c, k, n;
+	for (c = from; c < to; c += SURF_SAMPLE_CHUNK) {
+		n = MIN(SURF_SAMPLE_CHUNK, to - c);
+
+		for (k = 0; k < n; k++) {
+			size_t p = order ? order[c + k] : c + k;
+			xs[k] = X[p];
+			ys[k] = Y[p];
+		}
+
+		if (kernel == SURF_SAMPLE_NEAREST) {
+
+			for (k = 0; k < n; k++) {
+				fi[k] = (REAL)floor( (xs[k] - startX + hX/REAL(2))/hX );
+				fj[k] = (REAL)floor( (ys[k] - startY + hY/REAL(2))/hY );
+			}
+			for (k = 0; k < n; k++) {
+				if ((fi[k] < 0) || (fi[k] >= (REAL)NN) || (fj[k] < 0) || (fj[k] >= (REAL)MM))
+					res[k] = undef;
+				else
+					res[k] = sample_node(srf, (size_t)fi[k] + NN*(size_t)fj[k]);
+			}
+
+		} else {
+
+			// cell (I0,J0)-(I1,J1) is clamped to the grid, as in d_surf::getInterpValue
+			for (k = 0; k < n; k++) {
+				fi[k] = (REAL)floor( (xs[k] - startX)/hX );
+				fj[k] = (REAL)floor( (ys[k] - startY)/hY );
+				fi[k] = MIN(MAX(REAL(0), fi[k]), (REAL)NN);
+				fj[k] = MIN(MAX(REAL(0), fj[k]), (REAL)MM);
+			}
+			for (k = 0; k < n; k++) {
+				size_t I0 = MIN((size_t)fi[k], NN-1);
+				size_t I1 = MIN((size_t)fi[k]+1, NN-1);
+				size_t J0 = MIN((size_t)fj[k], MM-1);
+				size_t J1 = MIN((size_t)fj[k]+1, MM-1);
+				z0[k] = sample_node(srf, I0 + NN*J0);
+				z1[k] = sample_node(srf, I1 + NN*J0);
+				z2[k] = sample_node(srf, I1 + NN*J1);
+				z3[k] = sample_node(srf, I0 + NN*J1);
+				// offsets from node (I0,J0)
+				xs[k] = xs[k] - (startX + I0*hX);
+				ys[k] = ys[k] - (startY + J0*hY);
+			}
+			// undefined nodes are replaced with mean of defined ones
+			for (k = 0; k < n; k++) {
+				if ((z0[k] != undef) && (z1[k] != undef) && (z2[k] != undef) && (z3[k] != undef))
+					continue;
+				REAL sum = 0;
+				size_t cnt = 0;
+				if (z0[k] != undef) { sum += z0[k]; cnt++; }
+				if (z1[k] != undef) { sum += z1[k]; cnt++; }
+				if (z2[k] != undef) { sum += z2[k]; cnt++; }
+				if (z3[k] != undef) { sum += z3[k]; cnt++; }
+				if (cnt == 0) {
+					// no defined nodes around the point
+					z0[k] = z1[k] = z2[k] = z3[k] = 0;
+					fi[k] = -1;
+					continue;
+				}
+				REAL mean_z = sum/REAL(cnt);
+				if (z0[k] == undef) z0[k] = mean_z;
+				if (z1[k] == undef) z1[k] = mean_z;
+				if (z2[k] == undef) z2[k] = mean_z;
+				if (z3[k] == undef) z3[k] = mean_z;
+			}
+			for (k = 0; k < n; k++) {
+				REAL z11 = (z2[k]-z1[k])*ys[k]/hY+z1[k];
+				REAL z22 = (z3[k]-z0[k])*ys[k]/hY+z0[k];
+				res[k] = (z11-z22)*xs[k]/hX+z22;
+			}
+			for (k = 0; k < n; k++) {
+				if (fi[k] < 0)
+					res[k] = undef;
+			}
+
+		}
+
+		for (k = 0; k < n; k++) {
+			size_t p = order ? order[c + k] : c + k;
+			values[p] = res[k];
+		}
+	}
+};
+
+#ifdef HAVE_THREADS
+struct surf_sample_job : public job
+{
+	surf_sample_job()
+	{
+		srf = NULL;
+		X = NULL;
+		Y = NULL;
+		order = NULL;
+		from = 0;
+		to = 0;
+		values = NULL;
+		kernel = SURF_SAMPLE_NEAREST;
+	};
+	void set(const d_surf * isrf, const REAL * iX, const REAL * iY, const size_t * iorder,
+		 size_t ifrom, size_t ito, REAL * ivalues, int ikernel)
+	{
+		srf = isrf;
+		X = iX;
+		Y = iY;
+		order = iorder;
+		from = ifrom;
+		to = ito;
+		values = ivalues;
+		kernel = ikernel;
+	};
+	virtual void do_job()
+	{
+		sample_points(srf, X, Y, order, from, to, values, kernel);
+	};
+
+	const d_surf * srf;
+	const REAL * X;
+	const REAL * Y;
+	const size_t * order;
+	size_t from, to;
+	REAL * values;
+	int kernel;
+};
+
+surf_sample_job surf_sample_jobs[MAX_CPU];
+#endif
+
+/*! \brief sorts points by square tiles of surface nodes (counting sort)
+    \return points numbers, tile by tile (points outside of surface go last)
+*/
+static size_t * sample_order(const d_surf * srf, const REAL * X, const REAL * Y, size_t cnt)
+{
+	const d_grid * grd = srf->grd;
+	size_t NN = grd->getCountX();
+	size_t MM = grd->getCountY();
+
+	// tiles of 16x16 nodes, larger tiles for large grids with few points
+	size_t tile = 16;
+	size_t tx = (NN + tile - 1)/tile;
+	size_t ty = (MM + tile - 1)/tile;
+	while ((tx*ty > MAX(cnt, (size_t)1024)) && (tile < MAX(NN, MM))) {
+		tile *= 2;
+		tx = (NN + tile - 1)/tile;
+		ty = (MM + tile - 1)/tile;
+	}
+	size_t tiles = tx*ty;
+
+	size_t * keys = (size_t *)malloc(cnt*sizeof(size_t));
+	size_t * start = (size_t *)calloc(tiles + 2, sizeof(size_t));
+	size_t * order = (size_t *)malloc(cnt*sizeof(size_t));
+	if ((keys == NULL) || (start == NULL) || (order == NULL)) {
+		free(keys);
+		free(start);
+		free(order);
+		return NULL;
+	}
+
+	size_t p;
+	for (p = 0; p < cnt; p++) {
+		REAL fi = (REAL)floor( (X[p] - grd->startX)/grd->stepX + REAL(0.5) );
+		REAL fj = (REAL)floor( (Y[p] - grd->startY)/grd->stepY + REAL(0.5) );
+		size_t key = tiles;
+		if ((fi >= 0) && (fi < (REAL)NN) && (fj >= 0) && (fj < (REAL)MM))
+			key = ((size_t)fi/tile) + ((size_t)fj/tile)*tx;
+		keys[p] = key;
+		start[key + 1]++;
+	}
+	for (p = 1; p < tiles + 2; p++)
+		start[p] += start[p-1];
+	for (p = 0; p < cnt; p++)
+		order[ start[keys[p]]++ ] = p;
+
+	free(start);
+	free(keys);
+	return order;
+};
+
+void _surf_sample(const d_surf * srf, const REAL * X, const REAL * Y, size_t cnt,
+		  REAL * values, int kernel)
+{
+	if (cnt == 0)
+		return;
+
+	size_t * order = NULL;
+	if (cnt >= SURF_SAMPLE_SORT_MIN)
+		order = sample_order(srf, X, Y, cnt);
+
+#ifdef HAVE_THREADS
+	if ((sstuff_get_threads() == 1) || (cnt < SURF_SAMPLE_SORT_MIN)) {
+#endif
+		sample_points(srf, X, Y, order, 0, cnt, values, kernel);
+#ifdef HAVE_THREADS
+	} else {
+		size_t threads = sstuff_get_threads();
+		size_t step = cnt / threads;
+		size_t ost = cnt % threads;
+		size_t from = 0;
+		size_t t;
+		for (t = 0; t < threads; t++) {
+			size_t to = from + step + ((t < ost) ? 1 : 0);
+			surf_sample_job & f = surf_sample_jobs[t];
+			f.set(srf, X, Y, order, from, to, values, kernel);
+			set_job(&f, t);
+			from = to;
+		}
+		do_jobs();
+	}
+#endif
+
+	free(order);
+};
+
+vec * _surf_sample_pnts(const d_surf * srf, const d_points * pnts, int kernel)
+{
+	size_t cnt = pnts->size();
+	vec * res = create_vec(cnt, 0, false); // don't fill
+	if (cnt > 0)
+		_surf_sample(srf, pnts->X->begin(), pnts->Y->begin(), cnt, res->begin(), kernel);
+	return res;
+};
+
+}; // namespace surfit;
+
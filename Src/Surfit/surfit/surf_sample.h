@@ -0,0 +1,57 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__surf_sample__
+#define __surfit__surf_sample__
+
+namespace surfit {
+
+class d_surf;
+class d_points;
+class vec;
+
+//! value of the nearest surface node (as \ref d_surf::getValue(REAL,REAL))
+#define SURF_SAMPLE_NEAREST 0
+//! bilinear interpolation of surface values (as \ref d_surf::getInterpValue)
+#define SURF_SAMPLE_BILINEAR 1
+
+/*! \brief calculates surface values for many points at once
+    \param srf surface
+    \param X X coordinates of points
+    \param Y Y coordinates of points
+    \param cnt amount of points
+    \param values array for cnt results
+    \param kernel SURF_SAMPLE_NEAREST or SURF_SAMPLE_BILINEAR
+
+    Points are sorted by surface tiles, so the neighbour points read
+    the neighbour nodes, and are processed by chunks in several threads.
+    Value is srf->undef_value for points outside of surface (nearest kernel)
+    or without defined nodes around.
+*/
+SURFIT_EXPORT
+void _surf_sample(const d_surf * srf, const REAL * X, const REAL * Y, size_t cnt,
+		  REAL * values, int kernel = SURF_SAMPLE_NEAREST);
+
+//! calculates surface values for \ref d_points (see \ref _surf_sample)
+SURFIT_EXPORT
+vec * _surf_sample_pnts(const d_surf * srf, const d_points * pnts, int kernel = SURF_SAMPLE_NEAREST);
+
+}; // namespace surfit;
+
+#endif
+
@@ -0,0 +1,361 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/vec.h"
+#include "../sstuff/bitvec.h"
+#include "../sstuff/threads.h"
+
+#include "surf_stats.h"
+#include "surf.h"
+#include "surf_paged.h"
+#include "surf_internal.h"
+#include "grid.h"
+#include "grid_internal.h"
+#include "points.h"
+#include "variables_tcl.h"
+
+#include <math.h>
+#include <float.h>
+
+namespace surfit {
+
+//! amount of values processed at once
+#define STAT_CHUNK 256
+
+//! nodes are processed in one thread for smaller surfaces
+#define STAT_THREADS_MIN 65536
+
+stat_acc::stat_acc()
+{
+	reset();
+};
+
+void stat_acc::reset()
+{
+	cnt = 0;
+	sum = 0;
+	minz = FLT_MAX;
+	maxz = -FLT_MAX;
+	mean = 0;
+	m2 = 0;
+	wcnt = 0;
+	wsum = 0;
+	wmean = 0;
+	wm2 = 0;
+};
+
+void stat_acc::merge_part(size_t n, REAL s, REAL mn, REAL mx, REAL m, REAL q)
+{
+	if (n == 0)
+		return;
+	minz = MIN(minz, mn);
+	maxz = MAX(maxz, mx);
+	sum += s;
+	if (cnt == 0) {
+		cnt = n;
+		mean = m;
+		m2 = q;
+		return;
+	}
+	size_t total = cnt + n;
+	REAL delta = m - mean;
+	mean += delta*REAL(n)/REAL(total);
+	m2 += q + delta*delta*REAL(cnt)*REAL(n)/REAL(total);
+	cnt = total;
+};
+
+void stat_acc::merge_wpart(size_t n, REAL w, REAL m, REAL q)
+{
+	if (n == 0)
+		return;
+	if (wcnt == 0) {
+		wcnt = n;
+		wsum = w;
+		wmean = m;
+		wm2 = q;
+		return;
+	}
+	REAL total = wsum + w;
+	REAL delta = m - wmean;
+	wmean += delta*w/total;
+	wm2 += q + delta*delta*wsum*w/total;
+	wsum = total;
+	wcnt += n;
+};
+
+void stat_acc::merge(const stat_acc & a)
+{
+	merge_part(a.cnt, a.sum, a.minz, a.maxz, a.mean, a.m2);
+	merge_wpart(a.wcnt, a.wsum, a.wmean, a.wm2);
+};
+
+void stat_acc::add(const REAL * values, size_t n, REAL undef, const REAL * weights)
+{
+	REAL v[STAT_CHUNK], w[STAT_CHUNK];
+	size_t c, i, k;
+	for (c = 0; c < n; c += STAT_CHUNK) {
+		size_t m = MIN(STAT_CHUNK, n - c);
+
+		// defined values of the chunk
+		k = 0;
+		for (i = 0; i < m; i++) {
+			REAL value = values[c + i];
+			if (value == undef)
+				continue;
+			v[k] = value;
+			if (weights)
+				w[k] = weights[c + i];
+			k++;
+		}
+		if (k == 0)
+			continue;
+
+		REAL s = 0, mn = v[0], mx = v[0];
+		for (i = 0; i < k; i++) {
+			s += v[i];
+			mn = MIN(mn, v[i]);
+			mx = MAX(mx, v[i]);
+		}
+		REAL cm = s/REAL(k);
+		REAL q = 0;
+		for (i = 0; i < k; i++)
+			q += (v[i] - cm)*(v[i] - cm);
+		merge_part(k, s, mn, mx, cm, q);
+
+		if (weights == NULL)
+			continue;
+
+		// values with positive weights
+		size_t wk = 0;
+		for (i = 0; i < k; i++) {
+			if (w[i] <= 0)
+				continue;
+			v[wk] = v[i];
+			w[wk] = w[i];
+			wk++;
+		}
+		if (wk == 0)
+			continue;
+		REAL ws = 0, wvs = 0;
+		for (i = 0; i < wk; i++) {
+			ws += w[i];
+			wvs += w[i]*v[i];
+		}
+		REAL wm = wvs/ws;
+		REAL wq = 0;
+		for (i = 0; i < wk; i++)
+			wq += w[i]*(v[i] - wm)*(v[i] - wm);
+		merge_wpart(wk, ws, wm, wq);
+	}
+};
+
+REAL stat_acc::get_mean(REAL undef) const
+{
+	if (cnt == 0)
+		return undef;
+	return mean;
+};
+
+REAL stat_acc::get_std() const
+{
+	if (cnt == 0)
+		return 0;
+	return REAL(sqrt(m2/REAL(cnt)));
+};
+
+REAL stat_acc::get_std(REAL center, size_t total) const
+{
+	if (total == 0)
+		return 0;
+	REAL sum2 = m2 + REAL(cnt)*(mean - center)*(mean - center);
+	return REAL(sqrt(sum2/REAL(total)));
+};
+
+REAL stat_acc::get_wmean(REAL undef) const
+{
+	if (wcnt == 0)
+		return undef;
+	return wmean;
+};
+
+void stat_acc::push_back(vec * res, REAL undef) const
+{
+	res->push_back(REAL(cnt));
+	res->push_back(minz);
+	res->push_back(maxz);
+	res->push_back(get_mean(undef));
+	res->push_back(get_std());
+	res->push_back(sum);
+};
+
+//! adds values of nodes [from, to) to res
+static void surf_stats_nodes(const d_surf * srf, const bitvec * region, const d_surf * wsrf,
+			     size_t from, size_t to, stat_acc & res)
+{
+	REAL values[STAT_CHUNK], weights[STAT_CHUNK];
+	REAL undef = srf->undef_value;
+	size_t c, i;
+	for (c = from; c < to; c += STAT_CHUNK) {
+		size_t n = MIN(STAT_CHUNK, to - c);
+		if (srf->coeff) {
+			for (i = 0; i < n; i++)
+				values[i] = (*(srf->coeff))(c + i);
+		} else {
+			for (i = 0; i < n; i++)
+				values[i] = srf->getValue(c + i);
+		}
+		if (region) {
+			for (i = 0; i < n; i++) {
+				if (region->get(c + i) == false)
+					values[i] = undef;
+			}
+		}
+		if (wsrf) {
+			for (i = 0; i < n; i++) {
+				REAL w = wsrf->coeff ? (*(wsrf->coeff))(c + i) : wsrf->getValue(c + i);
+				weights[i] = (w == wsrf->undef_value) ? 0 : w;
+			}
+		}
+		res.add(values, n, undef, wsrf ? weights : NULL);
+	}
+};
+
+#ifdef HAVE_THREADS
+struct surf_stats_job : public job
+{
+	surf_stats_job()
+	{
+		srf = NULL;
+		region = NULL;
+		wsrf = NULL;
+		from = 0;
+		to = 0;
+	};
+	void set(const d_surf * isrf, const bitvec * iregion, const d_surf * iwsrf, size_t ifrom, size_t ito)
+	{
+		srf = isrf;
+		region = iregion;
+		wsrf = iwsrf;
+		from = ifrom;
+		to = ito;
+		res.reset();
+	};
+	virtual void do_job()
+	{
+		surf_stats_nodes(srf, region, wsrf, from, to, res);
+	};
+
+	const d_surf * srf;
+	const bitvec * region;
+	const d_surf * wsrf;
+	size_t from, to;
+	stat_acc res;
+};
+
+surf_stats_job surf_stats_jobs[MAX_CPU];
+#endif
+
+bool _surf_stats(const d_surf * srf, stat_acc & res, const bitvec * region, const d_surf * wsrf)
+{
+	if (srf == NULL)
+		return false;
+
+	if (wsrf && !srf->compare_grid(wsrf)) {
+		writelog(LOG_ERROR, "surf_stats : weights surface \"%s\" has different grid", wsrf->getName());
+		return false;
+	}
+
+	const d_surf_paged * paged = dynamic_cast<const d_surf_paged *>(srf);
+	if (paged && (wsrf == NULL)) {
+		paged->stats(region, res);
+		return true;
+	}
+
+	size_t size = srf->getCountX()*srf->getCountY();
+
+#ifdef HAVE_THREADS
+	// paged surfaces are read by one thread
+	if ((sstuff_get_threads() == 1) || (size < STAT_THREADS_MIN) || paged) {
+#endif
+		surf_stats_nodes(srf, region, wsrf, 0, size, res);
+#ifdef HAVE_THREADS
+	} else {
+		size_t threads = sstuff_get_threads();
+		// parts are multiple of STAT_CHUNK
+		size_t chunks = (size + STAT_CHUNK - 1)/STAT_CHUNK;
+		size_t step = chunks / threads;
+		size_t ost = chunks % threads;
+		size_t from = 0;
+		size_t t;
+		for (t = 0; t < threads; t++) {
+			size_t to = MIN(size, from + (step + ((t < ost) ? 1 : 0))*STAT_CHUNK);
+			surf_stats_job & f = surf_stats_jobs[t];
+			f.set(srf, region, wsrf, from, to);
+			set_job(&f, t);
+			from = to;
+		}
+		do_jobs();
+		for (t = 0; t < threads; t++)
+			res.merge(surf_stats_jobs[t].res);
+	}
+#endif
+
+	return true;
+};
+
+d_surf * _surf_stats_weights(const d_surf * srf, const d_surf * wsrf)
+{
+	size_t NN = srf->getCountX();
+	size_t MM = srf->getCountY();
+
+	size_t aux_X_from, aux_X_to;
+	size_t aux_Y_from, aux_Y_to;
+	_grid_intersect1(srf->grd, wsrf->grd, aux_X_from, aux_X_to, aux_Y_from, aux_Y_to);
+	d_grid * aux_grid = _create_sub_grid(srf->grd, aux_X_from, aux_X_to, aux_Y_from, aux_Y_to);
+	d_surf * w_srf = _surf_project(wsrf, aux_grid);
+	size_t nn = aux_grid->getCountX();
+	aux_grid->release();
+
+	extvec * coeff = create_extvec(NN*MM, 0); // nodes outside of wsrf have zero weights
+	size_t i, j;
+	for (j = aux_Y_from; j <= aux_Y_to; j++) {
+		for (i = aux_X_from; i <= aux_X_to; i++) {
+			REAL weight = w_srf->getValue(i - aux_X_from + (j - aux_Y_from)*nn);
+			if (weight == w_srf->undef_value)
+				weight = 0;
+			(*coeff)(i + j*NN) = weight;
+		}
+	}
+	w_srf->release();
+
+	d_surf * res = create_surf(coeff, create_grid(srf->grd), wsrf->getName());
+	return res;
+};
+
+bool _pnts_stats(const d_points * pnts, stat_acc & res)
+{
+	if ((pnts == NULL) || (pnts->Z == NULL))
+		return false;
+	res.add(pnts->Z->begin(), pnts->size(), undef_value);
+	return true;
+};
+
+}; // namespace surfit;
+
@@ -0,0 +1,127 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__surf_stats__
+#define __surfit__surf_stats__
+
+namespace surfit {
+
+class d_surf;
+class d_points;
+class bitvec;
+class vec;
+
+/*! \struct stat_acc
+    \brief statistics of values: count, sum, minimum, maximum, mean and sum of squared deviations
+
+    Values are added by chunks: simple loops over the chunk calculate its sum, min, max
+    and squared deviations from the chunk mean, and the chunk is merged into the
+    accumulated statistics. Statistics of several parts (calculated in different
+    threads) are merged with \ref merge, so all values are read once.
+
+    If weights are given, weighted mean and sum of weighted squared deviations
+    are calculated for values with positive weights.
+*/
+struct SURFIT_EXPORT stat_acc
+{
+	//! constructor
+	stat_acc();
+
+	//! forgets all values
+	void reset();
+
+	/*! \brief adds n values
+	    \param values values
+	    \param n amount of values
+	    \param undef undefined values are skipped
+	    \param weights if not NULL, weights of values
+	*/
+	void add(const REAL * values, size_t n, REAL undef, const REAL * weights = NULL);
+
+	//! adds statistics calculated for another part of values
+	void merge(const stat_acc & a);
+
+	//! returns mean value (or undef if there are no values)
+	REAL get_mean(REAL undef) const;
+
+	//! returns standard deviation (divided by amount of values)
+	REAL get_std() const;
+
+	//! returns \f$ \sqrt{ \sum (v - center)^2 / total } \f$
+	REAL get_std(REAL center, size_t total) const;
+
+	//! returns weighted mean value (or undef if there are no values with positive weights)
+	REAL get_wmean(REAL undef) const;
+
+	//! appends amount of values, minimum, maximum, mean, standard deviation and sum to res
+	void push_back(vec * res, REAL undef) const;
+
+	//! amount of values
+	size_t cnt;
+	//! sum of values
+	REAL sum;
+	//! minimum value (FLT_MAX if there are no values)
+	REAL minz;
+	//! maximum value (-FLT_MAX if there are no values)
+	REAL maxz;
+	//! mean value
+	REAL mean;
+	//! sum of squared deviations from mean
+	REAL m2;
+
+	//! amount of values with positive weights
+	size_t wcnt;
+	//! sum of weights
+	REAL wsum;
+	//! weighted mean value
+	REAL wmean;
+	//! sum of weighted squared deviations from wmean
+	REAL wm2;
+
+private:
+	//! merges part of values
+	void merge_part(size_t n, REAL s, REAL mn, REAL mx, REAL m, REAL q);
+	//! merges weighted part of values
+	void merge_wpart(size_t n, REAL w, REAL m, REAL q);
+};
+
+/*! \brief calculates statistics of surface values in one pass
+    \param srf surface
+    \param res statistics (added to res)
+    \param region if not NULL, only nodes where region is true are used
+    \param wsrf if not NULL, surface with weights on the same grid (undefined weights mean zero)
+
+    Nodes are divided between threads. Paged surfaces are read tile by tile.
+*/
+SURFIT_EXPORT
+bool _surf_stats(const d_surf * srf, stat_acc & res, const bitvec * region = NULL, const d_surf * wsrf = NULL);
+
+/*! \brief projects weights surface to the grid of srf
+    \return surface with weights for srf nodes (zero for nodes outside of wsrf)
+*/
+SURFIT_EXPORT
+d_surf * _surf_stats_weights(const d_surf * srf, const d_surf * wsrf);
+
+//! calculates statistics of Z values of \ref d_points in one pass (added to res)
+SURFIT_EXPORT
+bool _pnts_stats(const d_points * pnts, stat_acc & res);
+
+}; // namespace surfit;
+
+#endif
+
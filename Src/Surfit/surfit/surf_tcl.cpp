@@ -30,6 +30,12 @@
 #include "../sstuff/read_txt.h"
 
 #include "surf.h"
+#include "surf_float.h"
+#include "surf_expr.h"
+#include "surf_project.h"
+#include "surf_stats.h"
+#include "surf_terrain.h"
+#include "surf_wavelet.h"
 #include "surf_internal.h"
 #include "surf_tcl.h"
 #include "variables_internal.h"
@@ -80,6 +86,29 @@ boolvec * surf_load(const char * filename, const char * surfname)
 	return res;
 };
 
+boolvec * surf_load_preview(const char * filename, int levels, const char * surfname) 
+{
+	if (levels < 0) {
+		writelog(LOG_ERROR, "surf_load_preview : wrong amount of levels");
+		return NULL;
+	}
+
+	const char * fname = find_first(filename);
+	boolvec * res = create_boolvec();
+
+	while (fname != NULL) {
+		d_surf * srf = _surf_load(fname, surfname, levels);
+		if (srf != NULL) {
+			surfit_surfs->push_back(srf);
+			res->push_back(true);
+		} else
+			res->push_back(false);
+		fname = find_next();
+	}
+	find_close();
+	return res;
+};
+
 struct match_surf_save
 {
 	match_surf_save(const char * ifilename, const char * ipos) : filename(ifilename), pos(ipos), res(NULL) {};
@@ -105,19 +134,70 @@ boolvec * surf_save(const char * filename, const char * pos)
 	return qq.res;
 };
 
+struct match_surf_save_pyramid
+{
+	match_surf_save_pyramid(const char * ifilename, const char * ipos) : filename(ifilename), pos(ipos), res(NULL) {};
+	void operator()(d_surf * surf)
+	{
+		if ( StringMatch(pos, surf->getName()) )
+		{
+			bool r = _surf_save_pyramid(surf, filename);
+			if (res == NULL)
+				res = create_boolvec();
+			res->push_back(r);
+		}
+	}
+	const char * filename;
+	const char * pos;
+	boolvec * res;
+};
+
+boolvec * surf_save_pyramid(const char * filename, const char * pos) 
+{
+	match_surf_save_pyramid qq(filename, pos);
+	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
+	return qq.res;
+};
+
+struct match_surf_save_wavelet
+{
+	match_surf_save_wavelet(const char * ifilename, REAL ieps, const char * ipos) : filename(ifilename), eps(ieps), pos(ipos), res(NULL) {};
+	void operator()(d_surf * surf)
+	{
+		if ( StringMatch(pos, surf->getName()) )
+		{
+			bool r = _surf_save_wavelet(surf, filename, eps);
+			if (res == NULL)
+				res = create_boolvec();
+			res->push_back(r);
+		}
+	}
+	const char * filename;
+	REAL eps;
+	const char * pos;
+	boolvec * res;
+};
+
+boolvec * surf_save_wavelet(const char * filename, REAL eps, const char * pos) 
+{
+	match_surf_save_wavelet qq(filename, eps, pos);
+	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
+	return qq.res;
+};
+
 struct match_surf_plot
 {
 	match_surf_plot(const char * ifilename, const char * ipos, 
-			size_t inumber_of_levels, bool idraw_isos, bool idraw_colorscale) : 
+			size_t inumber_of_levels, bool idraw_isos, bool idraw_colorscale, REAL itolerance) : 
 	filename(ifilename), pos(ipos), res(NULL), 
-	draw_isos(idraw_isos), draw_colorscale(idraw_colorscale), number_of_levels(inumber_of_levels) {};
+	draw_isos(idraw_isos), draw_colorscale(idraw_colorscale), number_of_levels(inumber_of_levels), tolerance(itolerance) {};
 	void operator()(d_surf * surf)
 	{
 		if ( StringMatch(pos, surf->getName()) )
 		{
 			bool r = false;
 			if (filename)
-				r = _surf_plot(surf, filename, number_of_levels, draw_isos, draw_colorscale);
+				r = _surf_plot(surf, filename, number_of_levels, draw_isos, draw_colorscale, tolerance);
 			else
 			{
 				const char * name = surf->getName();
@@ -125,7 +205,7 @@ struct match_surf_plot
 				strncpy(Filename, surf->getName(), strlen(name));
 				strncpy(Filename+strlen(name),".ps",3);
 				Filename[strlen(name)+3]='\0';
-				r = _surf_plot(surf, Filename, number_of_levels, draw_isos, draw_colorscale);
+				r = _surf_plot(surf, Filename, number_of_levels, draw_isos, draw_colorscale, tolerance);
 				free(Filename);	
 			}
 			if (res == NULL)
@@ -139,11 +219,12 @@ struct match_surf_plot
 	bool draw_isos;
 	bool draw_colorscale;
 	size_t number_of_levels;
+	REAL tolerance;
 };
 
-boolvec * surf_plot(const char * filename, const char * pos, size_t number_of_levels, bool draw_isos, bool draw_colorscale) 
+boolvec * surf_plot(const char * filename, const char * pos, size_t number_of_levels, bool draw_isos, bool draw_colorscale, REAL tolerance) 
 {
-	match_surf_plot qq(filename, pos, number_of_levels, draw_isos, draw_colorscale);
+	match_surf_plot qq(filename, pos, number_of_levels, draw_isos, draw_colorscale, tolerance);
 	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
 	return qq.res;
 };
@@ -1281,6 +1362,63 @@ boolvec * surf_div_value_area(REAL val, const char * area_pos, const char * surf
 	return qq.res;
 };
 
+bool surf_expr(const char * result_name, const char * expression)
+{
+	return _surf_expr(result_name, expression);
+};
+
+struct match_surf_expr_area
+{
+	match_surf_expr_area(const char * iresult_name, const char * iexpression, const char * iarea_pos) : 
+		result_name(iresult_name), expression(iexpression), area_pos(iarea_pos), res(NULL) {};
+	void operator()(d_area * area)
+	{
+		if ( StringMatch(area_pos, area->getName()) )
+		{
+			if (res == NULL)
+				res = create_boolvec();
+			res->push_back( _surf_expr(result_name, expression, area, NULL) );
+		}
+	}
+	const char * result_name;
+	const char * expression;
+	const char * area_pos;
+	boolvec * res;
+};
+
+boolvec * surf_expr_area(const char * result_name, const char * expression, const char * area_pos)
+{
+	match_surf_expr_area qq(result_name, expression, area_pos);
+	qq = std::for_each(surfit_areas->begin(), surfit_areas->end(), qq);
+	return qq.res;
+};
+
+struct match_surf_expr_mask
+{
+	match_surf_expr_mask(const char * iresult_name, const char * iexpression, const char * imask_pos) : 
+		result_name(iresult_name), expression(iexpression), mask_pos(imask_pos), res(NULL) {};
+	void operator()(d_mask * mask)
+	{
+		if ( StringMatch(mask_pos, mask->getName()) )
+		{
+			if (res == NULL)
+				res = create_boolvec();
+			res->push_back( _surf_expr(result_name, expression, NULL, mask) );
+		}
+	}
+	const char * result_name;
+	const char * expression;
+	const char * mask_pos;
+	boolvec * res;
+};
+
+boolvec * surf_expr_mask(const char * result_name, const char * expression, const char * mask_pos)
+{
+	match_surf_expr_mask qq(result_name, expression, mask_pos);
+	qq = std::for_each(surfit_masks->begin(), surfit_masks->end(), qq);
+	return qq.res;
+};
+
 struct surf_val_oper_area_set : public surf_val_oper_area
 {
 	virtual bool do_oper(REAL val, d_surf * surf, d_area * area) 
@@ -1323,11 +1461,12 @@ struct match_surf_to_mask
 				res = create_boolvec();
 			writelog(LOG_MESSAGE,"converting surface \"%s\" to mask",surf->getName());
 
-			bitvec * bcoeff = create_bitvec( surf->coeff->size() );
+			size_t size = surf->getCountX()*surf->getCountY();
+			bitvec * bcoeff = create_bitvec( size );
 			size_t i;
 			REAL val;
-			for (i = 0; i < surf->coeff->size(); i++) {
-				val = (*(surf->coeff))(i);
+			for (i = 0; i < size; i++) {
+				val = surf->getValue(i);
 				bool bval = ( (val >= true_from) && (val <= true_to) );
 				if (bval)
 					bcoeff->set_true(i);
@@ -1485,7 +1624,7 @@ struct match_surf_get_details_level
 		{
 			if (res == NULL)
 				res = create_intvec();
-			res->push_back( (int)surf->details_h->size() );
+			res->push_back( (int)surf->enlarges_X->size() );
 		}
 	}
 	const char * pos;
@@ -1524,6 +1663,51 @@ boolvec * surf_undef(REAL new_undef_value, const char * pos)
 	return qq.res;
 };
 
+struct match_surf_store
+{
+	match_surf_store(bool ito_float, const char * ipos) : to_float(ito_float), pos(ipos), res(NULL) {};
+	void operator()(d_surf *& surf)
+	{
+		if ( StringMatch(pos, surf->getName()) )
+		{
+			if (res == NULL)
+				res = create_boolvec();
+			d_surf_float * fsrf = dynamic_cast<d_surf_float *>(surf);
+			d_surf * new_surf = NULL;
+			if (to_float && (fsrf == NULL)) {
+				writelog(LOG_MESSAGE,"storing surface \"%s\" in float precision", surf->getName());
+				new_surf = create_surf_float(surf);
+			}
+			if (!to_float && fsrf) {
+				writelog(LOG_MESSAGE,"storing surface \"%s\" in double precision", surf->getName());
+				new_surf = create_surf_double(fsrf);
+			}
+			if (new_surf) {
+				surf->release();
+				surf = new_surf;
+			}
+			res->push_back( true );
+		}
+	}
+	bool to_float;
+	const char * pos;
+	boolvec * res;
+};
+
+boolvec * surf_store_float(const char * pos) 
+{
+	match_surf_store qq(true, pos);
+	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
+	return qq.res;
+};
+
+boolvec * surf_store_double(const char * pos) 
+{
+	match_surf_store qq(false, pos);
+	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
+	return qq.res;
+};
+
 struct match_surf_D1
 {	
 	match_surf_D1(const char * ipos) : pos(ipos), res(NULL) {};
@@ -1593,7 +1777,7 @@ void surf_info(const char * pos)
 
 struct match_surf_project
 {
-	match_surf_project(const char * ipos, const char * inewname) : pos(ipos), newname(inewname), res(NULL) {};
+	match_surf_project(const char * ipos, const char * inewname, int ikernel) : pos(ipos), newname(inewname), kernel(ikernel), res(NULL) {};
 	void operator()(d_surf * surf)
 	{
 		if ( StringMatch(pos, surf->getName()) )
@@ -1605,7 +1789,7 @@ struct match_surf_project
 				return;
 			}
 			if (!(surf->grd->operator == (surfit_grid))) {
-				d_surf * res_surf2 = _surf_project(surf, surfit_grid);
+				d_surf * res_surf2 = _surf_project(surf, surfit_grid, kernel);
 				if (res_surf2) {
 					if (newname)
 						res_surf2->setName(newname);
@@ -1625,13 +1809,19 @@ struct match_surf_project
 	}
 	const char * pos;
 	const char * newname;
+	int kernel;
 	boolvec * res;
 	std::vector<d_surf *> surfs;
 };
 
-boolvec * surf_project(const char * pos, const char * newname) 
+boolvec * surf_project(const char * pos, const char * newname, const char * method) 
 {
-	match_surf_project qq(pos, newname);
+	int kernel = surf_project_kernel(method);
+	if (kernel < 0) {
+		writelog(LOG_ERROR, "surf_project : unknown method \"%s\"", method);
+		return NULL;
+	}
+	match_surf_project qq(pos, newname, kernel);
 	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
 	size_t i;
 	for (i = 0; i < qq.surfs.size(); i++)
@@ -1680,6 +1870,78 @@ boolvec * surf_gradient(const char * pos, const char * newname)
 	return qq.res;
 };
 
+struct match_surf_terrain
+{
+	match_surf_terrain(const char * ipos, int ioutputs, REAL iazimuth, REAL ialtitude, REAL iz_factor) : 
+		pos(ipos), outputs(ioutputs), azimuth(iazimuth), altitude(ialtitude), z_factor(iz_factor), res(NULL) {};
+	void operator()(d_surf * surf)
+	{
+		if ( StringMatch(pos, surf->getName()) )
+		{
+			if (res == NULL)
+				res = create_boolvec();
+			d_surf * ss[SURF_TERRAIN_COUNT];
+			if ( !_surf_terrain(surf, outputs, ss, azimuth, altitude, z_factor) ) {
+				res->push_back(false);
+				return;
+			}
+			int k;
+			for (k = 0; k < SURF_TERRAIN_COUNT; k++) {
+				if (ss[k] == NULL)
+					continue;
+				char buf[512];
+				sprintf(buf, "%s_%s", surf->getName(), surf_terrain_name(k));
+				ss[k]->setName(buf);
+				surfs.push_back(ss[k]);
+			}
+			res->push_back(true);
+		}
+	}
+	const char * pos;
+	int outputs;
+	REAL azimuth, altitude, z_factor;
+	boolvec * res;
+	std::vector<d_surf *> surfs;
+};
+
+boolvec * surf_terrain(const char * pos, const char * outputs, REAL azimuth, REAL altitude, REAL z_factor) 
+{
+	// list of output names
+	int mask = 0;
+	const char * delims = " \t,";
+	const char * p = outputs;
+	while (*p) {
+		size_t len = strcspn(p, delims);
+		if (len == 0) {
+			p++;
+			continue;
+		}
+		int k;
+		if ((len == 3) && (strncmp(p, "all", 3) == 0))
+			mask = (1 << SURF_TERRAIN_COUNT) - 1;
+		else {
+			for (k = 0; k < SURF_TERRAIN_COUNT; k++) {
+				const char * name = surf_terrain_name(k);
+				if ((strlen(name) == len) && (strncmp(p, name, len) == 0))
+					break;
+			}
+			if (k == SURF_TERRAIN_COUNT) {
+				writelog(LOG_ERROR, "surf_terrain : unknown output \"%.*s\"", (int)len, p);
+				return NULL;
+			}
+			mask |= (1 << k);
+		}
+		p += len;
+	}
+
+	match_surf_terrain qq(pos, mask, azimuth, altitude, z_factor);
+	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
+	size_t i;
+	for (i = 0; i < qq.surfs.size(); i++)
+		surfit_surfs->push_back( qq.surfs[i] );
+	return qq.res;
+};
+
 struct match_surf_getName {
 	match_surf_getName(const char * ipos) : pos(ipos), res(NULL) {};
 	void operator()(d_surf * surf)
@@ -2062,6 +2324,130 @@ vec * surf_sum_area(const char * area_pos,  const char * surf_pos)
 	return qq.res;
 };
 
+struct match_surf_stats
+{
+	match_surf_stats(const char * ipos) : pos(ipos), res(NULL) {};
+	void operator()(d_surf * surf)
+	{
+		if ( StringMatch(pos, surf->getName()) )
+		{
+			if (res == NULL)
+				res = create_vec();
+			writelog(LOG_MESSAGE,"calculating statistics for surface \"%s\"", surf->getName());
+			stat_acc acc;
+			_surf_stats(surf, acc);
+			acc.push_back(res, surf->undef_value);
+		}
+	}
+	const char * pos;
+	vec * res;
+};
+
+vec * surf_stats(const char * pos) 
+{
+	match_surf_stats qq(pos);
+	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
+	return qq.res;
+};
+
+struct match_surf_area_stats2
+{
+	match_surf_area_stats2(d_surf * isurf, const char * iarea_pos) : surf(isurf), area_pos(iarea_pos), res(NULL) {};
+	void operator()(d_area * area)
+	{
+		if ( StringMatch(area_pos, area->getName()) )
+		{
+			if (res == NULL)
+				res = create_vec();
+			writelog(LOG_MESSAGE,"calculating statistics for surface \"%s\" inside area \"%s\"", surf->getName(), area->getName());
+			stat_acc acc;
+			bitvec * mask = nodes_in_area_mask(area, surf->grd);
+			if (mask) {
+				_surf_stats(surf, acc, mask);
+				mask->release();
+			}
+			acc.push_back(res, surf->undef_value);
+		}
+	}
+	d_surf * surf;
+	const char * area_pos;
+	vec * res;
+};
+
+struct match_surf_area_stats
+{
+	match_surf_area_stats(const char * iarea_pos, const char * isurf_pos) : area_pos(iarea_pos), surf_pos(isurf_pos), res(NULL) {};
+	void operator()(d_surf * surf)
+	{
+		if ( StringMatch(surf_pos, surf->getName()) )
+		{
+			match_surf_area_stats2 qq(surf, area_pos);
+			qq = std::for_each(surfit_areas->begin(), surfit_areas->end(), qq);
+			if (res == NULL)
+				res = create_vec();
+			res->push_back(qq.res);
+		}
+	}
+	const char * area_pos; 
+	const char * surf_pos;
+	vec * res;
+};
+
+vec * surf_area_stats(const char * area_pos, const char * surf_pos) 
+{
+	match_surf_area_stats qq(area_pos, surf_pos);
+	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
+	return qq.res;
+};
+
+struct match_surf_mask_stats2
+{
+	match_surf_mask_stats2(d_surf * isurf, const char * imask_pos) : surf(isurf), mask_pos(imask_pos), res(NULL) {};
+	void operator()(d_mask * mask)
+	{
+		if ( StringMatch(mask_pos, mask->getName()) )
+		{
+			if (res == NULL)
+				res = create_vec();
+			writelog(LOG_MESSAGE,"calculating statistics for surface \"%s\" where mask \"%s\" is true", surf->getName(), mask->getName());
+			stat_acc acc;
+			bitvec * region = mask->get_bitvec_mask(surf->grd);
+			_surf_stats(surf, acc, region);
+			region->release();
+			acc.push_back(res, surf->undef_value);
+		}
+	}
+	d_surf * surf;
+	const char * mask_pos;
+	vec * res;
+};
+
+struct match_surf_mask_stats
+{
+	match_surf_mask_stats(const char * imask_pos, const char * isurf_pos) : mask_pos(imask_pos), surf_pos(isurf_pos), res(NULL) {};
+	void operator()(d_surf * surf)
+	{
+		if ( StringMatch(surf_pos, surf->getName()) )
+		{
+			match_surf_mask_stats2 qq(surf, mask_pos);
+			qq = std::for_each(surfit_masks->begin(), surfit_masks->end(), qq);
+			if (res == NULL)
+				res = create_vec();
+			res->push_back(qq.res);
+		}
+	}
+	const char * mask_pos; 
+	const char * surf_pos;
+	vec * res;
+};
+
+vec * surf_mask_stats(const char * mask_pos, const char * surf_pos) 
+{
+	match_surf_mask_stats qq(mask_pos, surf_pos);
+	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
+	return qq.res;
+};
+
 struct match_surf_cells_in_area2
 {
 	match_surf_cells_in_area2(const char * iarea_pos,  d_surf * isurf) : area_pos(iarea_pos), surf(isurf), res(NULL) {};
@@ -2133,7 +2519,7 @@ struct match_surf_filter_by_mask2
 					val = mask->getValue(x,y);
 					if (val == false) {
 						pos = two2one(i, j, NN, MM);
-						(*(surf->coeff))( pos ) = surf->undef_value;
+						surf->setValue(pos, surf->undef_value);
 					}
 				}
 			}
@@ -2197,7 +2583,7 @@ struct match_sfa_by_area
 					pos = two2one(i, j, NN, MM);
 					val = area_mask->get(pos);
 					if (val == in_area) {
-						(*(srf->coeff))( pos ) = srf->undef_value;
+						srf->setValue(pos, srf->undef_value);
 					}
 				}
 			}	
@@ -2278,7 +2664,7 @@ struct match_sfbs2
 						continue;
 					if ( fabs(val2 - val1) < eps ) {
 						pos = two2one(i, j, NN, MM);
-						(*(surf1->coeff))( pos ) = surf1->undef_value;
+						surf1->setValue(pos, surf1->undef_value);
 					}
 				}
 			}
@@ -2331,7 +2717,8 @@ struct match_swapxy
 			if (res == NULL)
 				res = create_boolvec();
 			
-			if (surf->coeff == NULL) {
+			d_surf_float * fsrf = dynamic_cast<d_surf_float *>(surf);
+			if ((surf->coeff == NULL) && (fsrf == NULL)) {
 				res->push_back(false);
 				return;
 			}
@@ -2341,7 +2728,7 @@ struct match_swapxy
 				return;
 			}
 			
-			extvec * new_coeff = create_extvec(surf->coeff->size());
+			extvec * new_coeff = create_extvec(surf->getCountX()*surf->getCountY());
 			
 			size_t NN = surf->getCountX();
 			size_t MM = surf->getCountY();
@@ -2359,12 +2746,19 @@ struct match_swapxy
 				}
 			}
 			
-			surf->coeff->release();
-			surf->coeff = new_coeff;
-			
 			std::swap(surf->grd->startX, surf->grd->startY);
 			std::swap(surf->grd->stepX, surf->grd->stepY);
 			std::swap(surf->grd->endX, surf->grd->endY);
+
+			if (fsrf) {
+				// float values are rewritten in place for the swapped grid
+				for (pos = 0; pos < new_coeff->size(); pos++)
+					fsrf->setValue(pos, (*new_coeff)(pos));
+				new_coeff->release();
+			} else {
+				surf->coeff->release();
+				surf->coeff = new_coeff;
+			}
 			
 			res->push_back(true);
 		}
@@ -2382,14 +2776,14 @@ boolvec * surf_swapxy(const char * surf_pos)
 
 struct match_trace
 {
-	match_trace(const char * ipos, REAL ifrom, REAL ito, REAL istep) : pos(ipos), from(ifrom), to(ito), step(istep), res(NULL) {};
+	match_trace(const char * ipos, REAL ifrom, REAL ito, REAL istep, REAL itolerance) : pos(ipos), from(ifrom), to(ito), step(istep), tolerance(itolerance), res(NULL) {};
 	void operator()(d_surf * surf)
 	{
 		if ( StringMatch(pos, surf->getName()) )
 		{
 			if (res == NULL)
 				res = create_boolvec();
-			std::vector<d_cntr*> * cntrs = _surf_trace_cntrs(surf, from, to, step);
+			std::vector<d_cntr*> * cntrs = _surf_trace_cntrs(surf, from, to, step, false, tolerance);
 			size_t i;
 			for (i = 0; i < cntrs->size(); i++)
 				surfit_cntrs->push_back( (*cntrs)[i] );
@@ -2401,12 +2795,13 @@ struct match_trace
 	REAL from;
 	REAL to;
 	REAL step;
+	REAL tolerance;
 	boolvec * res;
 };
 
-boolvec * surf_trace_cntr(const char * surface_name_or_position, REAL step, REAL from, REAL to)
+boolvec * surf_trace_cntr(const char * surface_name_or_position, REAL step, REAL from, REAL to, REAL tolerance)
 {
-	match_trace qq(surface_name_or_position, from, to, step);
+	match_trace qq(surface_name_or_position, from, to, step, tolerance);
 	qq = std::for_each(surfit_surfs->begin(), surfit_surfs->end(), qq);
 	return qq.res;
 };
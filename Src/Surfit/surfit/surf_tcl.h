@@ -50,6 +50,21 @@ class strvec;
 SURFIT_EXPORT
 boolvec * surf_load(const char * filename, const char * surfname = NULL);
 
+/*! \ingroup tcl_surf_save_load
+    \par Tcl syntax:
+    surf_load_preview \ref file "filename" levels \ref str "surfname"
+    
+    \par Description:
+    loads surface saved by \ref surf_save_wavelet with "levels" coarse levels of details only.
+    Surface is loaded on coarser grid, the rest of the file is skipped.
+
+    \param filename surfit datafile
+    \param levels amount of detail levels to load
+    \param surfname name for surface (optional)
+*/
+SURFIT_EXPORT
+boolvec * surf_load_preview(const char * filename, int levels, const char * surfname = NULL);
+
 /*! \ingroup tcl_surf_save_load
     \par Tcl syntax:
     surf_save \ref file "filename" \ref str "surface_name" 
@@ -62,13 +77,38 @@ boolvec * surf_save(const char * filename, const char * surface_name = "*");
 
 /*! \ingroup tcl_surf_save_load
     \par Tcl syntax:
-    surf_plot \ref file "filename" \ref str "surface_name" number_of_levels draw_isos draw_colorscale
+    surf_save_pyramid \ref file "filename" \ref str "surface_name" 
+
+    \par Description:
+    saves surface with its pyramid levels (surfaces named "surface_name_phaseN",
+    kept by \ref surfit if \ref surf_pyramid is set) to surfit datafile. Levels are 
+    saved after the surface, from larger to smaller.
+*/
+SURFIT_EXPORT
+boolvec * surf_save_pyramid(const char * filename, const char * surface_name = "*");
+
+/*! \ingroup tcl_surf_save_load
+    \par Tcl syntax:
+    surf_save_wavelet \ref file "filename" eps \ref str "surface_name" 
+
+    \par Description:
+    saves surface to surfit datafile as quantized wavelet coefficients. Values loaded
+    by \ref surf_load differ from the saved ones by no more than eps. Smooth surfaces
+    take much less space, and coarse previews can be loaded with \ref surf_load_preview.
+*/
+SURFIT_EXPORT
+boolvec * surf_save_wavelet(const char * filename, REAL eps, const char * surface_name = "*");
+
+/*! \ingroup tcl_surf_save_load
+    \par Tcl syntax:
+    surf_plot \ref file "filename" \ref str "surface_name" number_of_levels draw_isos draw_colorscale tolerance
 
     \par Description:
-    plots surface to PostScript file
+    plots surface to PostScript file. If tolerance is positive, isolines are simplified:
+    points closer than tolerance (in points, 1/72 inch) to the simplified isoline are removed.
 */
 SURFIT_EXPORT
-boolvec * surf_plot(const char * filename = NULL, const char * surface_name = "*", size_t number_of_levels = 16, bool draw_isos = true, bool draw_labels = true);
+boolvec * surf_plot(const char * filename = NULL, const char * surface_name = "*", size_t number_of_levels = 16, bool draw_isos = true, bool draw_labels = true, REAL tolerance = 0);
 
 //
 // MATH OPERATIONS
@@ -144,13 +184,30 @@ boolvec * surf_gradient(const char * surface_name = "*", const char * newname =
 
 /*! \ingroup tcl_surf_math
     \par Tcl syntax:
-    surf_project \ref str "surface_name" "newname"
+    surf_terrain \ref str "surface_name" "outputs" azimuth altitude z_factor
 
     \par Description:
-    recalculates surface on current \ref d_grid "grid" using bilinear interpolation algorithm
+    calculates terrain derivatives of surface in one pass and saves them to new surfaces
+    named "surface_name_output". "outputs" is a list of "gradient", "slope" (degrees),
+    "aspect" (degrees clockwise from north, -1 for flat nodes), "plan_curv", "profile_curv" 
+    and "hillshade" (0..255), or "all". Hillshade is lit from azimuth (degrees clockwise
+    from north) and altitude (degrees above horizon). Surface values are multiplied by z_factor.
 */
 SURFIT_EXPORT
-boolvec * surf_project(const char * surface_name = "*", const char * newname = NULL);
+boolvec * surf_terrain(const char * surface_name = "*", const char * outputs = "all", 
+		       REAL azimuth = 315, REAL altitude = 45, REAL z_factor = 1);
+
+/*! \ingroup tcl_surf_math
+    \par Tcl syntax:
+    surf_project \ref str "surface_name" "newname" "method"
+
+    \par Description:
+    recalculates surface on current \ref d_grid "grid". Method is one of "nearest", 
+    "bilinear" (default), "bicubic" or "area" (area-weighted mean of covered cells, 
+    for coarser grids).
+*/
+SURFIT_EXPORT
+boolvec * surf_project(const char * surface_name = "*", const char * newname = NULL, const char * method = "bilinear");
 
 /*! \ingroup tcl_surf_math
     \par Tcl syntax:
@@ -285,6 +342,38 @@ vec * surf_sum(const char * surface_name = "*");
 SURFIT_EXPORT
 vec * surf_sum_area(const char * area_name = "*",  const char * surface_name = "*");
 
+/*! \ingroup tcl_surf_math
+    \par Tcl syntax:
+    surf_stats \ref str "surface_name"
+
+    \par Description:
+    returns amount of defined cells, minimum, maximum, mean, standard deviation 
+    and sum of surface cell values (six numbers for each surface), calculated in one pass.
+    Standard deviation is divided by amount of defined cells.
+*/
+SURFIT_EXPORT
+vec * surf_stats(const char * surface_name = "*");
+
+/*! \ingroup tcl_surf_math
+    \par Tcl syntax:
+    surf_area_stats \ref str "area_name" \ref str "surface_name"
+
+    \par Description:
+    returns statistics (as \ref surf_stats) for surface cells in area
+*/
+SURFIT_EXPORT
+vec * surf_area_stats(const char * area_name = "*", const char * surface_name = "*");
+
+/*! \ingroup tcl_surf_math
+    \par Tcl syntax:
+    surf_mask_stats \ref str "mask_name" \ref str "surface_name"
+
+    \par Description:
+    returns statistics (as \ref surf_stats) for surface cells where mask is "true"
+*/
+SURFIT_EXPORT
+vec * surf_mask_stats(const char * mask_name = "*", const char * surface_name = "*");
+
 /*! \ingroup tcl_surf_math
     \par Tcl syntax:
     surf_cells_in_area \ref str "area_name" \ref str "surface_name"
@@ -505,6 +594,47 @@ boolvec * surf_div_value(REAL val, const char * surface_name = "*");
 SURFIT_EXPORT
 boolvec * surf_div_value_area(REAL val, const char * area_name = "*", const char * surface_name = "*");
 
+/*! \ingroup tcl_surf_math
+    \par Tcl syntax:
+    surf_expr \ref str "result_name" "expression"
+      
+    \par Description:
+    calculates expression over surfaces for all cells in one pass, for example
+    \code
+    surf_expr "res" "(A-B)*C+5"
+    \endcode
+    Expression can contain surfaces names, numbers, cells coordinates x and y, 
+    operators + - * / ^ and functions abs, sqrt, exp, log, log10, sin, cos, tan, 
+    asin, acos, atan, floor, ceil, min, max, pow, atan2. Surfaces names with special 
+    characters should be quoted with single quotes. Result is undefined if any 
+    operand is undefined. If there is no surface named "result_name", new surface 
+    is created.
+*/
+SURFIT_EXPORT
+bool surf_expr(const char * result_name, const char * expression);
+
+/*! \ingroup tcl_surf_math
+    \par Tcl syntax:
+    surf_expr_area \ref str "result_name" "expression" \ref str "area_name"
+      
+    \par Description:
+    calculates expression over surfaces (see \ref surf_expr) for cells in area. 
+    Other cells of result surface are not changed (undefined for new surface)
+*/
+SURFIT_EXPORT
+boolvec * surf_expr_area(const char * result_name, const char * expression, const char * area_name = "*");
+
+/*! \ingroup tcl_surf_math
+    \par Tcl syntax:
+    surf_expr_mask \ref str "result_name" "expression" \ref str "mask_name"
+      
+    \par Description:
+    calculates expression over surfaces (see \ref surf_expr) for cells where mask is true. 
+    Other cells of result surface are not changed (undefined for new surface)
+*/
+SURFIT_EXPORT
+boolvec * surf_expr_mask(const char * result_name, const char * expression, const char * mask_name = "*");
+
 /*! \ingroup tcl_surf_math
     \par Tcl syntax:
     surf_set_value val \ref str "surface_name"
@@ -660,7 +790,7 @@ boolvec * surf_to_mask(REAL true_from, REAL true_to, const char * surface_name =
 
 /*! \ingroup tcl_surf_conv
     \par Tcl syntax:
-    surf_trace_cntr \ref str "surface_name" step from to 
+    surf_trace_cntr \ref str "surface_name" step from to tolerance
 
     \par Description:
     Converts surface to contours using isoline tracing algorithm.
@@ -668,9 +798,10 @@ boolvec * surf_to_mask(REAL true_from, REAL true_to, const char * surface_name =
     \param from starting value for isolines. If not set then determines automatically.
     \param step step between isolines values. If not set then determines automatically.
     \param to ending value for isolines. If not set then determines automatically.
+    \param tolerance if positive, contours are simplified: points closer than tolerance to the simplified contour are removed
 */
 SURFIT_EXPORT
-boolvec * surf_trace_cntr(const char * surface_name = "*", REAL step = FLT_MAX, REAL from = FLT_MAX, REAL to = FLT_MAX);
+boolvec * surf_trace_cntr(const char * surface_name = "*", REAL step = FLT_MAX, REAL from = FLT_MAX, REAL to = FLT_MAX, REAL tolerance = 0);
 
 
 //
@@ -727,6 +858,30 @@ vec * surf_getStepY(const char * surface_name = "*");
 SURFIT_EXPORT
 boolvec * surf_undef(REAL new_undef_value, const char * surface_name = "*");
 
+/*! \ingroup tcl_surf_other
+    \par Tcl syntax:
+    surf_store_float \ref str "surface_name"
+    
+    \par Description:
+    converts surface values to float precision. Surface takes half of memory,
+    but only value queries, statistics, arithmetic, projecting and saving
+    are available for it (see \ref surf_store_double). 
+    See also \ref surf_float_storage variable.
+*/
+SURFIT_EXPORT
+boolvec * surf_store_float(const char * surface_name = "*");
+
+/*! \ingroup tcl_surf_other
+    \par Tcl syntax:
+    surf_store_double \ref str "surface_name"
+    
+    \par Description:
+    converts surface values stored in float precision (see \ref surf_store_float) 
+    back to REAL values
+*/
+SURFIT_EXPORT
+boolvec * surf_store_double(const char * surface_name = "*");
+
 /*! \ingroup tcl_surf_other
     \par Tcl syntax:
     surf_info \ref str "surface_name"
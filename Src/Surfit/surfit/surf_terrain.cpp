@@ -0,0 +1,312 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/vec.h"
+#include "../sstuff/threads.h"
+
+#include "surf_terrain.h"
+#include "surf.h"
+#include "surf_paged.h"
+#include "grid.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+namespace surfit {
+
+//! tile width (nodes)
+#define TERRAIN_TILE_X 256
+//! tile height (nodes)
+#define TERRAIN_TILE_Y 64
+
+//! surfaces are processed in one thread if they are smaller
+#define TERRAIN_THREADS_MIN 65536
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//! parameters shared by all tiles
+struct terrain_params
+{
+	const d_surf * srf;
+	size_t NN, MM;
+	REAL hx, hy;
+	REAL z_factor;
+	//! light direction for hillshade
+	REAL lx, ly, lz;
+	//! output values, NULL for outputs not requested
+	extvec * out[SURF_TERRAIN_COUNT];
+	REAL undef_value;
+};
+
+/*! \brief calculates outputs for nodes [i0,i1) x [j0,j1)
+    \param buf buffer for (i1-i0+2) x (j1-j0+2) values
+*/
+static void terrain_tile(const terrain_params & c, size_t i0, size_t i1, size_t j0, size_t j1, REAL * buf)
+{
+	const REAL undef = c.undef_value;
+	const REAL src_undef = c.srf->undef_value;
+	size_t w = i1 - i0 + 2;
+	size_t h = j1 - j0 + 2;
+	size_t ii, jj;
+
+	// tile with halo, nodes outside of grid are undefined
+	for (jj = 0; jj < h; jj++) {
+		REAL * row = buf + jj*w;
+		if ((j0 + jj == 0) || (j0 + jj > c.MM)) {
+			for (ii = 0; ii < w; ii++)
+				row[ii] = src_undef;
+			continue;
+		}
+		size_t j = j0 + jj - 1;
+		for (ii = 0; ii < w; ii++) {
+			if ((i0 + ii == 0) || (i0 + ii > c.NN)) {
+				row[ii] = src_undef;
+				continue;
+			}
+			size_t pos = (i0 + ii - 1) + j*c.NN;
+			row[ii] = c.srf->coeff ? (*(c.srf->coeff))(pos) : c.srf->getValue(pos);
+		}
+	}
+
+	const REAL hx = c.hx, hy = c.hy;
+	const REAL zf = c.z_factor;
+	bool need_curv = (c.out[SURF_TERRAIN_PLAN_CURV] != NULL) || (c.out[SURF_TERRAIN_PROFILE_CURV] != NULL);
+
+	size_t i, j, k;
+	for (j = j0; j < j1; j++) {
+		const REAL * rd = buf + (j - j0)*w;
+		const REAL * rc = rd + w;
+		const REAL * ru = rc + w;
+		for (i = i0; i < i1; i++) {
+			size_t b = i - i0 + 1;
+			size_t pos = i + j*c.NN;
+			REAL z = rc[b];
+
+			REAL out[SURF_TERRAIN_COUNT];
+			for (k = 0; k < SURF_TERRAIN_COUNT; k++)
+				out[k] = undef;
+
+			if (z == src_undef)
+				goto write;
+
+			{
+				REAL zl = rc[b-1], zr = rc[b+1];
+				REAL zd = rd[b], zu = ru[b];
+				bool dl = (zl != src_undef), dr = (zr != src_undef);
+				bool dd = (zd != src_undef), du = (zu != src_undef);
+
+				REAL p, q;
+				if (dl && dr)
+					p = (zr - zl)/(2*hx);
+				else if (dr)
+					p = (zr - z)/hx;
+				else if (dl)
+					p = (z - zl)/hx;
+				else
+					goto write;
+
+				if (dd && du)
+					q = (zu - zd)/(2*hy);
+				else if (du)
+					q = (zu - z)/hy;
+				else if (dd)
+					q = (z - zd)/hy;
+				else
+					goto write;
+
+				p *= zf;
+				q *= zf;
+				REAL g2 = p*p + q*q;
+				REAL g = (REAL)sqrt(g2);
+
+				out[SURF_TERRAIN_GRADIENT] = g;
+				out[SURF_TERRAIN_SLOPE] = (REAL)(atan(g)*180/M_PI);
+				if (g2 == 0)
+					out[SURF_TERRAIN_ASPECT] = -1;
+				else {
+					REAL a = (REAL)(atan2(-p, -q)*180/M_PI);
+					out[SURF_TERRAIN_ASPECT] = (a < 0) ? a + 360 : a;
+				}
+
+				// normal (-p,-q,1) and light direction
+				REAL shade = (-p*c.lx - q*c.ly + c.lz)/(REAL)sqrt(1 + g2);
+				out[SURF_TERRAIN_HILLSHADE] = (shade > 0) ? 255*shade : 0;
+
+				if (!need_curv || !dl || !dr || !dd || !du)
+					goto write;
+
+				REAL zdl = rd[b-1], zdr = rd[b+1];
+				REAL zul = ru[b-1], zur = ru[b+1];
+				if ((zdl == src_undef) || (zdr == src_undef) || (zul == src_undef) || (zur == src_undef))
+					goto write;
+
+				REAL r = zf*(zr - 2*z + zl)/(hx*hx);
+				REAL t = zf*(zu - 2*z + zd)/(hy*hy);
+				REAL s = zf*(zur - zul - zdr + zdl)/(4*hx*hy);
+
+				if (g2 == 0) {
+					out[SURF_TERRAIN_PLAN_CURV] = 0;
+					out[SURF_TERRAIN_PROFILE_CURV] = 0;
+				} else {
+					out[SURF_TERRAIN_PLAN_CURV] = -(q*q*r - 2*p*q*s + p*p*t)/(REAL)pow(g2, REAL(1.5));
+					out[SURF_TERRAIN_PROFILE_CURV] = -(p*p*r + 2*p*q*s + q*q*t)/(g2*(REAL)pow(1 + g2, REAL(1.5)));
+				}
+			}
+write:
+			for (k = 0; k < SURF_TERRAIN_COUNT; k++) {
+				if (c.out[k])
+					(*(c.out[k]))(pos) = out[k];
+			}
+		}
+	}
+};
+
+//! processes tiles of rows [from, to)
+static void terrain_rows(const terrain_params & c, size_t from, size_t to)
+{
+	REAL * buf = (REAL *)malloc((TERRAIN_TILE_X + 2)*(TERRAIN_TILE_Y + 2)*sizeof(REAL));
+	if (buf == NULL)
+		return;
+	size_t i, j;
+	for (j = from; j < to; j += TERRAIN_TILE_Y) {
+		size_t j1 = MIN(to, j + TERRAIN_TILE_Y);
+		for (i = 0; i < c.NN; i += TERRAIN_TILE_X) {
+			size_t i1 = MIN(c.NN, i + TERRAIN_TILE_X);
+			terrain_tile(c, i, i1, j, j1, buf);
+		}
+	}
+	free(buf);
+};
+
+#ifdef HAVE_THREADS
+struct surf_terrain_job : public job
+{
+	surf_terrain_job()
+	{
+		params = NULL;
+		from = 0;
+		to = 0;
+	};
+	void set(const terrain_params * iparams, size_t ifrom, size_t ito)
+	{
+		params = iparams;
+		from = ifrom;
+		to = ito;
+	};
+	virtual void do_job()
+	{
+		terrain_rows(*params, from, to);
+	};
+
+	const terrain_params * params;
+	size_t from, to;
+};
+
+surf_terrain_job surf_terrain_jobs[MAX_CPU];
+#endif
+
+bool _surf_terrain(const d_surf * srf, int outputs, d_surf * res[SURF_TERRAIN_COUNT],
+		   REAL azimuth, REAL altitude, REAL z_factor)
+{
+	size_t k;
+	for (k = 0; k < SURF_TERRAIN_COUNT; k++)
+		res[k] = NULL;
+
+	if ((outputs & ((1 << SURF_TERRAIN_COUNT) - 1)) == 0) {
+		writelog(LOG_ERROR, "surf_terrain : no outputs");
+		return false;
+	}
+
+	terrain_params c;
+	c.srf = srf;
+	c.NN = srf->getCountX();
+	c.MM = srf->getCountY();
+	c.hx = srf->getStepX();
+	c.hy = srf->getStepY();
+	c.z_factor = z_factor;
+	REAL az = (REAL)(azimuth*M_PI/180);
+	REAL alt = (REAL)(altitude*M_PI/180);
+	c.lx = (REAL)(sin(az)*cos(alt));
+	c.ly = (REAL)(cos(az)*cos(alt));
+	c.lz = (REAL)sin(alt);
+	c.undef_value = srf->undef_value;
+
+	for (k = 0; k < SURF_TERRAIN_COUNT; k++) {
+		c.out[k] = NULL;
+		if ((outputs & (1 << k)) == 0)
+			continue;
+		extvec * coeff = create_extvec(c.NN*c.MM, 0, false); // don't fill
+		res[k] = create_surf(coeff, create_grid(srf->grd), srf->getName());
+		res[k]->undef_value = srf->undef_value;
+		c.out[k] = coeff;
+	}
+
+#ifdef HAVE_THREADS
+	// paged surfaces are read by one thread
+	size_t threads = sstuff_get_threads();
+	if ((threads == 1) || (c.NN*c.MM < TERRAIN_THREADS_MIN) || dynamic_cast<const d_surf_paged *>(srf)) {
+#endif
+		terrain_rows(c, 0, c.MM);
+#ifdef HAVE_THREADS
+	} else {
+		// bands are multiple of tile height
+		size_t tiles = (c.MM + TERRAIN_TILE_Y - 1)/TERRAIN_TILE_Y;
+		threads = MIN(threads, tiles);
+		size_t step = tiles / threads;
+		size_t ost = tiles % threads;
+		size_t from = 0;
+		size_t t;
+		for (t = 0; t < threads; t++) {
+			size_t to = MIN(c.MM, from + (step + ((t < ost) ? 1 : 0))*TERRAIN_TILE_Y);
+			surf_terrain_job & f = surf_terrain_jobs[t];
+			f.set(&c, from, to);
+			set_job(&f, t);
+			from = to;
+		}
+		do_jobs();
+	}
+#endif
+
+	return true;
+};
+
+const char * surf_terrain_name(int output)
+{
+	switch (output) {
+	case SURF_TERRAIN_GRADIENT:
+		return "gradient";
+	case SURF_TERRAIN_SLOPE:
+		return "slope";
+	case SURF_TERRAIN_ASPECT:
+		return "aspect";
+	case SURF_TERRAIN_PLAN_CURV:
+		return "plan_curv";
+	case SURF_TERRAIN_PROFILE_CURV:
+		return "profile_curv";
+	case SURF_TERRAIN_HILLSHADE:
+		return "hillshade";
+	}
+	return NULL;
+};
+
+}; // namespace surfit;
+
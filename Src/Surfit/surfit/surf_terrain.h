@@ -0,0 +1,74 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__surf_terrain__
+#define __surfit__surf_terrain__
+
+/*! \file
+    \brief terrain derivatives of surfaces
+
+    Derivatives are calculated with finite differences over 3x3 window of nodes:
+    \f$ p = z_x, q = z_y, r = z_{xx}, t = z_{yy}, s = z_{xy} \f$.
+    If one of the nodes left/right (down/up) is undefined, first derivative
+    is calculated with one-sided difference; second derivatives (curvatures)
+    need all nodes of the window. Undefined nodes give undefined values.
+*/
+
+namespace surfit {
+
+class d_surf;
+
+//! length of gradient \f$ \sqrt{p^2+q^2} \f$
+#define SURF_TERRAIN_GRADIENT 0
+//! slope angle in degrees
+#define SURF_TERRAIN_SLOPE 1
+//! direction of steepest descent in degrees, clockwise from north (Y axis); -1 for flat nodes
+#define SURF_TERRAIN_ASPECT 2
+//! plan (contour) curvature \f$ -(q^2 r - 2pqs + p^2 t)/(p^2+q^2)^{3/2} \f$
+#define SURF_TERRAIN_PLAN_CURV 3
+//! profile curvature \f$ -(p^2 r + 2pqs + q^2 t)/((p^2+q^2)(1+p^2+q^2)^{3/2}) \f$
+#define SURF_TERRAIN_PROFILE_CURV 4
+//! illumination 0..255 by light from given azimuth and altitude
+#define SURF_TERRAIN_HILLSHADE 5
+//! amount of terrain outputs
+#define SURF_TERRAIN_COUNT 6
+
+/*! \brief calculates terrain derivatives of surface in one pass
+    \param srf surface
+    \param outputs bit mask of outputs: (1 << SURF_TERRAIN_SLOPE) | ...
+    \param res surfaces for requested outputs (other items are set to NULL)
+    \param azimuth light direction for hillshade in degrees, clockwise from north
+    \param altitude light angle above horizon for hillshade in degrees
+    \param z_factor multiplier for surface values
+
+    Grid is divided into tiles, every tile is read with one node wide halo into
+    a buffer once and all requested outputs are calculated from the buffer.
+    Rows of tiles are divided between threads.
+*/
+SURFIT_EXPORT
+bool _surf_terrain(const d_surf * srf, int outputs, d_surf * res[SURF_TERRAIN_COUNT],
+		   REAL azimuth = 315, REAL altitude = 45, REAL z_factor = 1);
+
+//! returns name of terrain output ("gradient", "slope", "aspect", "plan_curv", "profile_curv" or "hillshade")
+SURFIT_EXPORT
+const char * surf_terrain_name(int output);
+
+}; // namespace surfit;
+
+#endif
+
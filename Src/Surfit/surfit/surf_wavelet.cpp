@@ -0,0 +1,313 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "surfit_ie.h"
+
+#include "../sstuff/vec.h"
+#include "../sstuff/datafile.h"
+
+#include "surf_wavelet.h"
+#include "surf.h"
+#include "grid.h"
+#include "mrf.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace surfit {
+
+//! surfaces are decomposed while approximation has more values
+#define SURF_WAVELET_MIN_SIZE 256
+
+//! quantized values with larger magnitude are saved exactly
+#define SURF_WAVELET_MAX_INT 4.5e15
+
+//! token for run of zero values (followed by run length - 1)
+#define WL_ZEROS 0
+//! token for undefined value
+#define WL_UNDEF 1
+//! token for exact value (followed by 8 bytes of double)
+#define WL_EXACT 2
+//! first token for quantized values (followed by zigzag-coded value - 1)
+#define WL_VALUE 3
+
+static void put_varint(std::vector<char> & stream, unsigned long long v)
+{
+	while (v >= 0x80) {
+		stream.push_back( (char)((v & 0x7f) | 0x80) );
+		v >>= 7;
+	}
+	stream.push_back( (char)v );
+};
+
+static bool get_varint(const char *& p, const char * end, unsigned long long & v)
+{
+	v = 0;
+	int shift = 0;
+	while (p < end) {
+		unsigned char c = (unsigned char)*p++;
+		v |= (unsigned long long)(c & 0x7f) << shift;
+		if ((c & 0x80) == 0)
+			return true;
+		shift += 7;
+		if (shift > 63)
+			return false;
+	}
+	return false;
+};
+
+static void put_zeros(std::vector<char> & stream, size_t & zeros)
+{
+	if (zeros == 0)
+		return;
+	put_varint(stream, WL_ZEROS);
+	put_varint(stream, zeros - 1);
+	zeros = 0;
+};
+
+//! quantizes and encodes cnt details
+static void wavelet_encode(extvec::const_iterator details, size_t cnt, REAL step, REAL undef_value,
+			   std::vector<char> & stream)
+{
+	size_t i, zeros = 0;
+	for (i = 0; i < cnt; i++) {
+		REAL v = *(details + i);
+
+		if (v == undef_value) {
+			put_zeros(stream, zeros);
+			put_varint(stream, WL_UNDEF);
+			continue;
+		}
+
+		REAL q = (REAL)floor(v/step + REAL(0.5));
+		if ( !(fabs(q) < SURF_WAVELET_MAX_INT) ) {
+			put_zeros(stream, zeros);
+			put_varint(stream, WL_EXACT);
+			double d = v;
+			const char * bytes = (const char *)&d;
+			stream.insert(stream.end(), bytes, bytes + sizeof(double));
+			continue;
+		}
+
+		if (q == 0) {
+			zeros++;
+			continue;
+		}
+
+		put_zeros(stream, zeros);
+		long long iq = (long long)q;
+		unsigned long long z = (iq > 0) ? ((unsigned long long)iq << 1) : (((unsigned long long)(-iq) << 1) - 1);
+		put_varint(stream, WL_VALUE + z - 1);
+	}
+	put_zeros(stream, zeros);
+};
+
+//! decodes cnt details
+static bool wavelet_decode(const char * p, const char * end, REAL step, REAL undef_value,
+			   extvec::iterator details, size_t cnt)
+{
+	size_t i = 0;
+	unsigned long long token, run;
+	while (i < cnt) {
+		if ( !get_varint(p, end, token) )
+			return false;
+		switch (token) {
+		case WL_ZEROS:
+			if ( !get_varint(p, end, run) || (run >= cnt - i) )
+				return false;
+			run++;
+			for (; run > 0; run--)
+				*(details + i++) = 0;
+			break;
+		case WL_UNDEF:
+			*(details + i++) = undef_value;
+			break;
+		case WL_EXACT:
+			{
+				if (end - p < (long)sizeof(double))
+					return false;
+				double d;
+				memcpy(&d, p, sizeof(double));
+				p += sizeof(double);
+				*(details + i++) = (REAL)d;
+			}
+			break;
+		default:
+			{
+				unsigned long long z = token - WL_VALUE + 1;
+				long long iq = (z & 1) ? -(long long)((z + 1) >> 1) : (long long)(z >> 1);
+				*(details + i++) = REAL(iq)*step;
+			}
+		}
+	}
+	return (p == end);
+};
+
+bool _surf_save_wavelet_df(const d_surf * srf, datafile * df, REAL eps) {
+
+	if ( !(eps > 0) ) {
+		writelog(LOG_ERROR, "surf_save_wavelet : error bound should be positive");
+		return false;
+	}
+
+	if (!srf->getName())
+		writelog(LOG_MESSAGE,"saving surf with no name to file %s (wavelets, error %g)",df->get_filename(),eps);
+	else
+		writelog(LOG_MESSAGE,"saving surf \"%s\" to file %s (wavelets, error %g)",srf->getName(),df->get_filename(),eps);
+
+	size_t NN = srf->getCountX();
+	size_t MM = srf->getCountY();
+	extvec * values = create_extvec(NN*MM, 0, false); // don't fill
+	size_t i;
+	for (i = 0; i < NN*MM; i++)
+		(*values)(i) = srf->getValue(i);
+
+	// sizes of levels, from the fine level
+	std::vector<size_t> countsX, countsY, offsets;
+	size_t n = NN, m = MM, total = 0;
+	while ( (n > 1) && (m > 1) && (n*m > SURF_WAVELET_MIN_SIZE) ) {
+		countsX.push_back(n);
+		countsY.push_back(m);
+		offsets.push_back(total);
+		n = (n+1)/2;
+		m = (m+1)/2;
+		total += 3*n*m;
+	}
+	size_t levels = countsX.size();
+
+	extvec * details = create_extvec(total, 0, false); // don't fill
+	for (i = 0; i < levels; i++)
+		_decomp2d(values, countsX[i], countsY[i], details->begin() + offsets[i], srf->undef_value, (i % 2 == 1));
+
+	bool res = true;
+	bool op;
+
+	op = df->writeTag("surf");		res = (res && op);
+	if (srf->getName()) {
+		op = df->writeString("name", srf->getName()); res = (res && op);
+	}
+	op = srf->grd->writeTags(df);		res = (res && op);
+	op = df->writeReal("undef_value", srf->undef_value); res = (res && op);
+	op = df->writeInt("wavelet_levels", (int)levels); res = (res && op);
+	op = df->writeRealArray("wavelet_approx", values, n); res = (res && op);
+
+	// coarse levels first
+	std::vector<char> stream;
+	for (i = levels; i > 0; i--) {
+		size_t level = i-1;
+		size_t cnt = 3*((countsX[level]+1)/2)*((countsY[level]+1)/2);
+		// each level adds at most 3*step/2 to the error
+		REAL step = REAL(2)*eps*REAL(cnt)/(REAL(3)*REAL(total));
+
+		surf_wavelet_header header;
+		memcpy(header.magic, SURF_WAVELET_MAGIC, 4);
+		header.countX = (unsigned int)countsX[level];
+		header.countY = (unsigned int)countsY[level];
+		header.step = step;
+		const char * bytes = (const char *)&header;
+		stream.assign(bytes, bytes + sizeof(header));
+		wavelet_encode(details->const_begin() + offsets[level], cnt, step, srf->undef_value, stream);
+
+		op = df->writeByteArray("wavelet_details", stream); res = (res && op);
+	}
+
+	op = df->writeEndTag();			res = (res && op);
+
+	details->release();
+	values->release();
+	return res;
+};
+
+bool _surf_save_wavelet(const d_surf * srf, const char * filename, REAL eps) {
+
+	datafile *df = new datafile(filename, DF_MODE_WRITE); // write
+	if (!df->condition()) {
+		delete df;
+		return false;
+	}
+
+	bool res = _surf_save_wavelet_df(srf, df, eps);
+
+	bool op = df->writeEof();		res = ( op && res );
+
+	delete df;
+	return res;
+};
+
+bool _surf_wavelet_decode(extvec * coeff, d_grid * grd, size_t levels,
+			  const std::vector< std::vector<char> > & details, REAL undef_value)
+{
+	char error[] = "surf_load : wrong wavelet details";
+
+	size_t loaded = details.size();
+	size_t i;
+
+	// grid of the last loaded level
+	for (i = loaded; i < levels; i++) {
+		size_t n = grd->getCountX();
+		size_t m = grd->getCountY();
+		grd->startX += grd->stepX/REAL(2);
+		grd->stepX  *= REAL(2);
+		grd->endX    = grd->startX + ((n+1)/2 - 1)*grd->stepX;
+		grd->startY += grd->stepY/REAL(2);
+		grd->stepY  *= REAL(2);
+		grd->endY    = grd->startY + ((m+1)/2 - 1)*grd->stepY;
+	}
+
+	for (i = 0; i < loaded; i++) {
+		const std::vector<char> & stream = details[i];
+		surf_wavelet_header header;
+		if ( (stream.size() < sizeof(header)) || (memcmp(&stream[0], SURF_WAVELET_MAGIC, 4) != 0) ) {
+			writelog(LOG_ERROR, error);
+			return false;
+		}
+		memcpy(&header, &stream[0], sizeof(header));
+
+		size_t N = header.countX;
+		size_t M = header.countY;
+		size_t size = ((N+1)/2)*((M+1)/2);
+		if (coeff->size() != size) {
+			writelog(LOG_ERROR, error);
+			return false;
+		}
+
+		extvec * buf = create_extvec(3*size, 0, false); // don't fill
+		const char * begin = &stream[0] + sizeof(header);
+		const char * end = &stream[0] + stream.size();
+		if ( !wavelet_decode(begin, end, (REAL)header.step, undef_value, buf->begin(), 3*size) ) {
+			writelog(LOG_ERROR, error);
+			buf->release();
+			return false;
+		}
+
+		// levels are numbered from the fine level when decomposed
+		size_t level = levels - 1 - i;
+		_recons2d(coeff, N, M, buf->const_begin(), undef_value, (level % 2 == 1));
+		buf->release();
+	}
+
+	if (coeff->size() != grd->getCountX()*grd->getCountY()) {
+		writelog(LOG_ERROR, error);
+		return false;
+	}
+
+	return true;
+};
+
+}; // namespace surfit;
+
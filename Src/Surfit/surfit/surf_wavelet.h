@@ -0,0 +1,86 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__surf_wavelet__
+#define __surfit__surf_wavelet__
+
+#include <vector>
+
+/*! \file
+    \brief lossy storage of surfaces as quantized wavelet coefficients
+
+    Surface values are decomposed with \ref _decomp2d until the approximation is small.
+    The approximation is saved as is, details of each level are quantized with
+    a uniform step and saved as a byte stream: zero runs, undefined values and
+    variable-length integers. Steps of levels are chosen so that the error of
+    reconstructed values doesn't exceed the given bound: each level adds at most
+    3*step/2, and the bound is shared between levels by amounts of their details.
+
+    Levels are saved in the "surf" tag from the coarse to the fine one, so a
+    preview is loaded by reading the first levels and skipping the others.
+*/
+
+namespace surfit {
+
+class d_surf;
+class d_grid;
+class datafile;
+
+//! signature of encoded details level
+#define SURF_WAVELET_MAGIC "WL01"
+
+//! header of encoded details level
+struct surf_wavelet_header
+{
+	//! SURF_WAVELET_MAGIC
+	char magic[4];
+	//! amount of columns of reconstructed values
+	unsigned int countX;
+	//! amount of rows of reconstructed values
+	unsigned int countY;
+	//! quantization step
+	double step;
+};
+
+/*! \brief writes \ref d_surf tag with wavelet-compressed values to \ref datafile
+    \param srf surface
+    \param df datafile
+    \param eps maximum absolute error of values (should be positive)
+*/
+SURFIT_EXPORT
+bool _surf_save_wavelet_df(const d_surf * srf, datafile * df, REAL eps);
+
+//! saves \ref d_surf with wavelet-compressed values to surfit \ref datafile
+SURFIT_EXPORT
+bool _surf_save_wavelet(const d_surf * srf, const char * filename, REAL eps);
+
+/*! \brief reconstructs values of wavelet-compressed surface
+    \param coeff approximation (replaced with reconstructed values)
+    \param grd grid of the surface (changed to the grid of reconstructed values, if only some levels are given)
+    \param levels amount of levels in datafile
+    \param details encoded levels, from the coarse level
+    \param undef_value undefined value
+*/
+SURFIT_EXPORT
+bool _surf_wavelet_decode(extvec * coeff, d_grid * grd, size_t levels,
+			  const std::vector< std::vector<char> > & details, REAL undef_value);
+
+}; // namespace surfit;
+
+#endif
+
@@ -36,6 +36,7 @@ class boolvec;
     \Phi(u_{1,1},\ldots,u_{N,M}) = \sum_{i,j} \left( u_{i,j} - z(x_i, y_j) \right)^2,
     \f]
     where (i,j) - indices of the cells, \f$z(x_i, y_j)\f$ - surface value for the (i,j) cell.
+    See also \ref surf_cell_means variable.
 */
 SURFIT_EXPORT
 boolvec * surface(const char * surface_name = "*");
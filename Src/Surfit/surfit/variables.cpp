@@ -59,6 +59,10 @@ bool stop_execution = false;
 int reproject_faults = 1;
 int reproject_undef_areas = 0;
 int process_isolated_areas = 1;
+int points_morton_order = 0;
+int surf_float_storage = 0;
+int surf_pyramid = 0;
+int surf_cell_means = 0;
 
 size_t penalty_max_iter = 99;
 REAL penalty_weight = 1; //0.0001;
@@ -116,6 +120,10 @@ void surfit_init_all() {
 	reproject_faults = 1;
 	reproject_undef_areas = 0;
 	process_isolated_areas = 1;
+	points_morton_order = 0;
+	surf_float_storage = 0;
+	surf_pyramid = 0;
+	surf_cell_means = 0;
 	tol = float(1e-5);
 	undef_value = FLT_MAX;
 	write_mat = false;
@@ -221,6 +229,69 @@ const char * datafile_append()
 	return datafile_mode();
 };
 
+const char * datafile_read_mode()
+{
+	if (datafile_mmap == 1)
+		return "datafile_read_mapped";
+	if (datafile_mmap == 0)
+		return "datafile_read_copied";
+	return NULL;
+};
+
+const char * datafile_read_mapped()
+{
+	datafile_mmap = 1;
+	return datafile_read_mode();
+};
+
+const char * datafile_read_copied()
+{
+	datafile_mmap = 0;
+	return datafile_read_mode();
+};
+
+const char * datafile_write_mode()
+{
+	if (datafile_parallel == 1)
+		return "datafile_write_parallel";
+	if (datafile_parallel == 0)
+		return "datafile_write_serial";
+	return NULL;
+};
+
+const char * datafile_write_parallel()
+{
+	datafile_parallel = 1;
+	return datafile_write_mode();
+};
+
+const char * datafile_write_serial()
+{
+	datafile_parallel = 0;
+	return datafile_write_mode();
+};
+
+const char * datafile_arrays_mode()
+{
+	if (datafile_compress == 1)
+		return "datafile_arrays_compressed";
+	if (datafile_compress == 0)
+		return "datafile_arrays_raw";
+	return NULL;
+};
+
+const char * datafile_arrays_compressed()
+{
+	datafile_compress = 1;
+	return datafile_arrays_mode();
+};
+
+const char * datafile_arrays_raw()
+{
+	datafile_compress = 0;
+	return datafile_arrays_mode();
+};
+
 }; // namespace surfit;
 
 
@@ -75,6 +75,34 @@ namespace surfit {
 	*/
 	extern SURFIT_EXPORT int process_isolated_areas;
 
+	/*! \ingroup surfit_variables
+	    enables/disables binding of scattered points to grids with points values 
+	    sorted in Z-order (Morton order) of cells
+	*/
+	extern SURFIT_EXPORT int points_morton_order;
+
+	/*! \ingroup surfit_variables
+	    if surf_float_storage=1, then surfaces produced by \ref surfit are stored 
+	    in float precision (see \ref surf_store_float). Solver works in REAL precision.
+	    Points are always stored in REAL precision: their coordinates need more 
+	    than 7 significant digits.
+	*/
+	extern SURFIT_EXPORT int surf_float_storage;
+
+	/*! \ingroup surfit_variables
+	    if surf_pyramid=1, then \ref surfit keeps solutions of all intermediate phases
+	    as surfaces named "map_name_phaseN" (pyramid levels, see \ref surf_save_pyramid)
+	*/
+	extern SURFIT_EXPORT int surf_pyramid;
+
+	/*! \ingroup surfit_variables
+	    if surf_cell_means=1, then \ref surface rule uses mean values of surface nodes 
+	    in the cell on phases with cells larger than surface cells; otherwise surface is 
+	    interpolated at cell centers. Coarse solutions are used as initial approximations 
+	    for the next phases, so the resulting surface may differ.
+	*/
+	extern SURFIT_EXPORT int surf_cell_means;
+
 	/*! \ingroup surfit_variables
 	    number of maximum iterations for \ref penalty "penalty algorithm"
 	*/
@@ -0,0 +1,77 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__solvers_xxl__
+#define __surfit__solvers_xxl__
+
+/*! \file
+    \brief vector operations for solvers in XXL build
+
+    Operations go block by block over \ref extvec "external vectors", so 
+    every block is read from the cache once.
+*/
+
+#include "vec_xxl.h"
+
+namespace surfit {
+
+//! returns scalar product of two vectors
+inline
+REAL times_xxl(const extvec & a, const extvec & b) {
+	REAL res = REAL(0);
+	size_t blk, i;
+	for (blk = 0; blk < a.blocks(); blk++) {
+		size_t n = a.block_size(blk);
+		const REAL * pa = a.block(blk, false);
+		const REAL * pb = b.block(blk, false);
+		for (i = 0; i < n; i++)
+			res += pa[i]*pb[i];
+	}
+	return res;
+};
+
+//! y = x + a*y
+inline
+void xpay_xxl(REAL a, const extvec & x, extvec & y) {
+	size_t blk, i;
+	for (blk = 0; blk < x.blocks(); blk++) {
+		size_t n = x.block_size(blk);
+		const REAL * px = x.block(blk, false);
+		REAL * py = y.block(blk, true);
+		for (i = 0; i < n; i++)
+			py[i] = px[i] + a*py[i];
+	}
+};
+
+//! y = y + a*x
+inline
+void axpy_xxl(REAL a, const extvec & x, extvec & y) {
+	size_t blk, i;
+	for (blk = 0; blk < x.blocks(); blk++) {
+		size_t n = x.block_size(blk);
+		const REAL * px = x.block(blk, false);
+		REAL * py = y.block(blk, true);
+		for (i = 0; i < n; i++)
+			py[i] += a*px[i];
+	}
+};
+
+}; // namespace surfit
+
+#endif
+
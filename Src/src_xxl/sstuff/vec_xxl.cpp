@@ -0,0 +1,437 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#include "../../Surfit/sstuff/sstuff_ie.h"
+
+#ifdef XXL
+
+#include "../../Surfit/sstuff/vec.h"
+#include "../../Surfit/sstuff/fileio.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <string>
+
+namespace surfit {
+
+/*! \struct extvec_cache
+    \brief blocks cache shared by all extvec objects
+*/
+struct extvec_cache
+{
+	extvec_cache()
+	{
+		tick = 0;
+		max_slots = 0;
+		const char * env = getenv("SURFIT_XXL_CACHE");
+		size_t bytes = 256*1024*1024;
+		if (env && (atoi(env) > 0))
+			bytes = (size_t)atoi(env)*1024*1024;
+		set_size(bytes);
+		env = getenv("SURFIT_XXL_DIR");
+		if (env)
+			dir = env;
+	};
+
+	~extvec_cache()
+	{
+		size_t s;
+		for (s = 0; s < data.size(); s++)
+			free(data[s]);
+	};
+
+	void set_size(size_t bytes)
+	{
+		max_slots = MAX(EXTVEC_MIN_SLOTS, bytes/(EXTVEC_BLOCK*sizeof(REAL)));
+		// blocks over the new size are dropped
+		while (data.size() > max_slots) {
+			size_t s = data.size()-1;
+			if (owner[s])
+				owner[s]->drop_block(block[s], s, dirty[s]);
+			free(data[s]);
+			data.pop_back();
+			owner.pop_back();
+			block.pop_back();
+			dirty.pop_back();
+			stamp.pop_back();
+		}
+	};
+
+	//! returns free slot for block b of vector v, dropping the least recently used block
+	int take(const extvec * v, size_t b)
+	{
+		size_t s, res = data.size();
+		// free slots
+		for (s = 0; s < data.size(); s++) {
+			if (owner[s] == NULL) {
+				res = s;
+				break;
+			}
+		}
+		if ((res == data.size()) && (data.size() < max_slots)) {
+			REAL * ptr = (REAL *)malloc(EXTVEC_BLOCK*sizeof(REAL));
+			if (ptr == NULL)
+				throw "out of memory";
+			data.push_back(ptr);
+			owner.push_back(NULL);
+			block.push_back(0);
+			dirty.push_back(false);
+			stamp.push_back(0);
+		}
+		if (res == data.size()) {
+			// the last used blocks of vectors are dropped only if there are no other blocks
+			size_t best = data.size(), best_last = data.size();
+			for (s = 0; s < data.size(); s++) {
+				bool last = (owner[s]->last_slot == (int)s);
+				size_t & b = last ? best_last : best;
+				if ((b == data.size()) || (stamp[s] < stamp[b]))
+					b = s;
+			}
+			res = (best != data.size()) ? best : best_last;
+			owner[res]->drop_block(block[res], res, dirty[res]);
+		}
+		owner[res] = v;
+		block[res] = b;
+		dirty[res] = false;
+		stamp[res] = ++tick;
+		return (int)res;
+	};
+
+	//! values of blocks
+	std::vector<REAL *> data;
+	//! vectors of blocks (NULL for free slots)
+	std::vector<const extvec *> owner;
+	//! blocks numbers
+	std::vector<size_t> block;
+	//! modified blocks
+	std::vector<bool> dirty;
+	//! usage times
+	std::vector<size_t> stamp;
+	//! usage time counter
+	size_t tick;
+	//! maximum amount of blocks in the cache
+	size_t max_slots;
+	//! directory for temporary files
+	std::string dir;
+};
+
+static extvec_cache & get_cache() {
+	static extvec_cache cache;
+	return cache;
+};
+
+void extvec_set_cache_size(size_t bytes) {
+	get_cache().set_size(bytes);
+};
+
+void extvec_set_dir(const char * dir) {
+	get_cache().dir = dir ? dir : "";
+};
+
+void extvec_flush_all() {
+	extvec_cache & cache = get_cache();
+	size_t s;
+	for (s = 0; s < cache.data.size(); s++) {
+		if (cache.owner[s] && cache.dirty[s]) {
+			cache.owner[s]->flush();
+		}
+	}
+};
+
+extvec * create_extvec(size_t size, REAL default_value, bool fill_default, size_t grow_by) {
+	return new extvec(size, default_value, fill_default);
+};
+
+extvec * create_extvec(const extvec & in) {
+	extvec * res = new extvec(in.size(), 0, false);
+	size_t b;
+	for (b = 0; b < in.blocks(); b++) {
+		const REAL * src = in.block(b, false);
+		REAL * dst = res->block(b, true);
+		memcpy(dst, src, in.block_size(b)*sizeof(REAL));
+	}
+	return res;
+};
+
+extvec * create_extvec(const vec & in) {
+	extvec * res = new extvec(in.size(), 0, false);
+	size_t b;
+	for (b = 0; b < res->blocks(); b++) {
+		REAL * dst = res->block(b, true);
+		memcpy(dst, in.const_begin() + b*EXTVEC_BLOCK, res->block_size(b)*sizeof(REAL));
+	}
+	return res;
+};
+
+extvec::extvec(size_t size, REAL default_value, bool fill_default) {
+	datasize = size;
+	// blocks, which were never written, are filled on reading
+	fill_value = fill_default ? default_value : REAL(0);
+	file = -1;
+	slots.resize(blocks(), -1);
+	on_disk.resize(blocks(), false);
+	last_block = (size_t)-1;
+	last_slot = -1;
+	last_data = NULL;
+	last_write = false;
+	last_miss = (size_t)-1;
+	read_ahead = 0;
+};
+
+extvec::~extvec() {
+	drop_data();
+};
+
+void extvec::release() {
+	delete this;
+};
+
+size_t extvec::block_size(size_t b) const {
+	size_t from = b*EXTVEC_BLOCK;
+	return MIN(EXTVEC_BLOCK, datasize - from);
+};
+
+bool extvec::open_file() const {
+	if (file != -1)
+		return true;
+	const std::string & dir = get_cache().dir;
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+	char * name = _tempnam(dir.empty() ? NULL : dir.c_str(), "sxxl");
+	if (name) {
+		// file is deleted when closed
+		file = _open(name, _O_CREAT | _O_EXCL | _O_RDWR | _O_BINARY | _O_TEMPORARY, _S_IREAD | _S_IWRITE);
+		free(name);
+	}
+#else
+	std::string name = dir;
+	if (name.empty()) {
+		const char * tmp = getenv("TMPDIR");
+		name = tmp ? tmp : "/tmp";
+	}
+	name += "/surfit_xxl_XXXXXX";
+	std::vector<char> buf(name.begin(), name.end());
+	buf.push_back('\0');
+	file = mkstemp(&(buf[0]));
+	// file is deleted when closed
+	if (file != -1)
+		unlink(&(buf[0]));
+#endif
+	if (file == -1) {
+		writelog(LOG_ERROR, "Can't create temporary file for external vector : %s", strerror( errno ));
+		return false;
+	}
+	return true;
+};
+
+void extvec::load_block(size_t b, REAL * dst) const {
+	size_t n = block_size(b);
+	if (!on_disk[b]) {
+		std::fill(dst, dst + n, fill_value);
+		return;
+	}
+	__int64 pos = (__int64)b*EXTVEC_BLOCK*sizeof(REAL);
+	size_t bytes = n*sizeof(REAL);
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+	bool ok = (_lseeki64(file, pos, SEEK_SET) != -1) && ((size_t)_read(file, dst, (unsigned int)bytes) == bytes);
+#else
+	bool ok = ((size_t)pread(file, dst, bytes, pos) == bytes);
+#endif
+	if (!ok)
+		throw "can't read external vector from temporary file";
+};
+
+void extvec::drop_block(size_t b, size_t slot, bool dirty) const {
+	extvec_cache & cache = get_cache();
+	if (dirty && (b < slots.size())) {
+		if (!open_file())
+			throw "can't write external vector to temporary file";
+		__int64 pos = (__int64)b*EXTVEC_BLOCK*sizeof(REAL);
+		size_t bytes = block_size(b)*sizeof(REAL);
+		const REAL * src = cache.data[slot];
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+		bool ok = (_lseeki64(file, pos, SEEK_SET) != -1) && ((size_t)_write(file, src, (unsigned int)bytes) == bytes);
+#else
+		bool ok = ((size_t)pwrite(file, src, bytes, pos) == bytes);
+#endif
+		if (!ok) {
+			writelog(LOG_ERROR, "Can't write external vector to temporary file : %s", strerror( errno ));
+			throw "can't write external vector to temporary file";
+		}
+		on_disk[b] = true;
+	}
+	if (b < slots.size())
+		slots[b] = -1;
+	cache.owner[slot] = NULL;
+	cache.dirty[slot] = false;
+	if (last_slot == (int)slot) {
+		last_block = (size_t)-1;
+		last_slot = -1;
+		last_data = NULL;
+		last_write = false;
+	}
+};
+
+REAL * extvec::block(size_t b, bool write) const {
+	extvec_cache & cache = get_cache();
+	int s = slots[b];
+	if (s < 0) {
+		s = cache.take(this, b);
+		slots[b] = s;
+		load_block(b, cache.data[s]);
+
+		// sequential access: the following blocks are read ahead
+		if ((last_miss != (size_t)-1) && (b == last_miss + 1))
+			read_ahead = MIN(EXTVEC_READ_AHEAD, MAX(1, read_ahead*2));
+		else
+			read_ahead = 0;
+		last_miss = b;
+#if !(defined(_WIN32) || defined(__WIN32__) || defined(WIN32)) && defined(POSIX_FADV_WILLNEED)
+		if (read_ahead && (b + 1 < on_disk.size()) && on_disk[b+1]) {
+			// kernel reads the following blocks while the current block is processed
+			size_t to = MIN(on_disk.size(), b + 1 + read_ahead);
+			posix_fadvise(file, (off_t)(b+1)*EXTVEC_BLOCK*sizeof(REAL),
+				      (off_t)(to-b-1)*EXTVEC_BLOCK*sizeof(REAL), POSIX_FADV_WILLNEED);
+		}
+#endif
+	} else
+		cache.stamp[s] = ++cache.tick;
+
+	if (write)
+		cache.dirty[s] = true;
+
+	last_block = b;
+	last_slot = s;
+	last_data = cache.data[s];
+	last_write = cache.dirty[s];
+	return cache.data[s];
+};
+
+void extvec::flush() const {
+	extvec_cache & cache = get_cache();
+	size_t b;
+	for (b = 0; b < slots.size(); b++) {
+		int s = slots[b];
+		if ((s < 0) || !cache.dirty[s])
+			continue;
+		// block stays in the cache
+		drop_block(b, s, true);
+		cache.owner[s] = this;
+		slots[b] = s;
+	}
+};
+
+void extvec::resize(size_t newsize, REAL default_value, bool fill_default) {
+	extvec_cache & cache = get_cache();
+	size_t oldsize = datasize;
+	size_t old_blocks = blocks();
+	size_t new_blocks = (newsize + EXTVEC_BLOCK - 1) >> EXTVEC_BLOCK_BITS;
+	size_t b;
+	// blocks after the end are dropped without writing
+	for (b = new_blocks; b < old_blocks; b++) {
+		if (slots[b] >= 0)
+			drop_block(b, slots[b], false);
+	}
+	datasize = newsize;
+	slots.resize(new_blocks, -1);
+	on_disk.resize(new_blocks, false);
+	if (!fill_default || (newsize <= oldsize))
+		return;
+
+	// new elements of the last old block
+	size_t i, to = MIN(newsize, old_blocks*EXTVEC_BLOCK);
+	for (i = oldsize; i < to; i++)
+		(*this)(i) = default_value;
+	// new blocks are filled with fill_value on reading
+	if (default_value != fill_value) {
+		for (i = to; i < newsize; i++)
+			(*this)(i) = default_value;
+	}
+};
+
+void extvec::push_back(const REAL & value) {
+	REAL val = value;
+	resize(datasize+1, 0, false);
+	(*this)(datasize-1) = val;
+};
+
+void extvec::swap(size_t i, size_t j) {
+	REAL a = (*this)(i);
+	REAL b = (*this)(j);
+	(*this)(i) = b;
+	(*this)(j) = a;
+};
+
+void extvec::drop_data() {
+	size_t b;
+	for (b = 0; b < slots.size(); b++) {
+		if (slots[b] >= 0)
+			drop_block(b, slots[b], false);
+	}
+	slots.clear();
+	on_disk.clear();
+	datasize = 0;
+	last_miss = (size_t)-1;
+	read_ahead = 0;
+	if (file != -1)
+		close(file);
+	file = -1;
+};
+
+size_t extvec::write_file(int dst, size_t size) const {
+	size_t res = 0;
+	size_t b;
+	for (b = 0; (b < blocks()) && (b*EXTVEC_BLOCK < size); b++) {
+		size_t n = MIN(block_size(b), size - b*EXTVEC_BLOCK);
+		const REAL * ptr = block(b, false);
+		size_t r = write(dst, ptr, (unsigned int)(n*sizeof(REAL)));
+		if (r != n*sizeof(REAL))
+			break;
+		res += r;
+	}
+	return res;
+};
+
+size_t extvec::read_file(int src, size_t size) {
+	size_t res = 0;
+	size_t b;
+	for (b = 0; (b < blocks()) && (b*EXTVEC_BLOCK < size); b++) {
+		size_t n = MIN(block_size(b), size - b*EXTVEC_BLOCK);
+		REAL * ptr = block(b, true);
+		size_t r = read(src, ptr, (unsigned int)(n*sizeof(REAL)));
+		if (r != n*sizeof(REAL))
+			break;
+		res += r;
+	}
+	return res;
+};
+
+}; // namespace surfit;
+
+#endif
+
@@ -0,0 +1,281 @@
+/*------------------------------------------------------------------------------
+ *	$Id$
+ *
+ *	Copyright (c) 2002-2006 by M. V. Dmitrievsky and V. N. Kutrunov
+ *	See COPYING file for copying and redistribution conditions.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; version 2 of the License.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	Contact info: surfit.sourceforge.net
+ *----------------------------------------------------------------------------*/
+
+#ifndef __surfit__vec_xxl__
+#define __surfit__vec_xxl__
+
+/*! \file
+    \brief extvec class (array of REAL values stored in file) declaration for XXL build
+*/
+
+#include <stddef.h>
+#include <iterator>
+#include <vector>
+
+#if !(defined(_WIN32) || defined(__WIN32__) || defined(WIN32))
+// 64-bit file positions (off_t is 64-bit on 64-bit systems)
+#include <sys/types.h>
+#include <unistd.h>
+typedef long long __int64;
+#define _lseeki64 lseek
+#endif
+
+namespace surfit {
+
+class vec;
+class extvec;
+
+//! log2 of extvec block size (in elements)
+#define EXTVEC_BLOCK_BITS 16
+//! extvec block size in elements (512 Kb of REALs)
+#define EXTVEC_BLOCK ((size_t)1 << EXTVEC_BLOCK_BITS)
+//! minimum amount of blocks in the cache
+#define EXTVEC_MIN_SLOTS 32
+//! maximum amount of blocks to read ahead
+#define EXTVEC_READ_AHEAD 16
+
+// default arguments are given in vec.h
+SSTUFF_EXPORT
+extvec * create_extvec(size_t size, REAL default_value, bool fill_default, size_t grow_by);
+
+//! creates extvec object (makes a copy)
+SSTUFF_EXPORT
+extvec * create_extvec(const extvec & in);
+
+//! creates extvec object (makes a copy of vec)
+SSTUFF_EXPORT
+extvec * create_extvec(const vec & in);
+
+/*! \brief sets the memory size for the blocks cache shared by all extvec objects
+    \param bytes cache size (at least EXTVEC_MIN_SLOTS blocks are kept in memory)
+
+    Default cache size is 256 Mb, or SURFIT_XXL_CACHE environment variable (in Mb).
+*/
+SSTUFF_EXPORT
+void extvec_set_cache_size(size_t bytes);
+
+/*! \brief sets directory for extvec temporary files
+
+    Default directory is SURFIT_XXL_DIR environment variable, or the system
+    temporary directory.
+*/
+SSTUFF_EXPORT
+void extvec_set_dir(const char * dir);
+
+//! writes all modified blocks of all extvec objects to their files
+SSTUFF_EXPORT
+void extvec_flush_all();
+
+/*! \class extvec_iterator
+    \brief random access iterator for \ref extvec
+*/
+template <class V, class R>
+class extvec_iterator {
+public:
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef REAL value_type;
+	typedef ptrdiff_t difference_type;
+	typedef R * pointer;
+	typedef R & reference;
+
+	extvec_iterator() : v(NULL), pos(0) {};
+	extvec_iterator(V * iv, size_t ipos) : v(iv), pos(ipos) {};
+	//! conversion from iterator to const_iterator
+	template <class V2, class R2>
+	extvec_iterator(const extvec_iterator<V2, R2> & it) : v(it.v), pos(it.pos) {};
+
+	reference operator*() const { return (*v)(pos); };
+	reference operator[](difference_type n) const { return (*v)(pos + n); };
+
+	extvec_iterator & operator++() { pos++; return *this; };
+	extvec_iterator operator++(int) { extvec_iterator res(*this); pos++; return res; };
+	extvec_iterator & operator--() { pos--; return *this; };
+	extvec_iterator operator--(int) { extvec_iterator res(*this); pos--; return res; };
+	extvec_iterator & operator+=(difference_type n) { pos += n; return *this; };
+	extvec_iterator & operator-=(difference_type n) { pos -= n; return *this; };
+	extvec_iterator operator+(difference_type n) const { return extvec_iterator(v, pos + n); };
+	extvec_iterator operator-(difference_type n) const { return extvec_iterator(v, pos - n); };
+	difference_type operator-(const extvec_iterator & it) const { return (difference_type)pos - (difference_type)it.pos; };
+
+	bool operator==(const extvec_iterator & it) const { return pos == it.pos; };
+	bool operator!=(const extvec_iterator & it) const { return pos != it.pos; };
+	bool operator<(const extvec_iterator & it) const { return pos < it.pos; };
+	bool operator>(const extvec_iterator & it) const { return pos > it.pos; };
+	bool operator<=(const extvec_iterator & it) const { return pos <= it.pos; };
+	bool operator>=(const extvec_iterator & it) const { return pos >= it.pos; };
+
+	//! vector
+	V * v;
+	//! position in vector
+	size_t pos;
+};
+
+/*! \class extvec
+    \brief vector of REAL's, stored in temporary file (external vector)
+
+    Values are divided into blocks of EXTVEC_BLOCK elements. Blocks are read
+    from file into the cache, which is shared by all extvec objects. When the
+    cache is full, the least recently used block is dropped, and modified
+    blocks are written back to file. Blocks, which were never written to file,
+    don't use disk space, so small vectors stay in memory.
+
+    When blocks are accessed one after another (as in solvers, which sweep
+    vectors from the first to the last element), the following blocks are
+    read ahead.
+
+    The last used block of each vector is not dropped from the cache, so 
+    references returned by operator() and iterators stay valid while a few 
+    other blocks are accessed. Vectors are not thread-safe (XXL build uses 
+    one thread).
+*/
+class SSTUFF_EXPORT extvec {
+public:
+
+	//! iterator type for extvec
+	typedef extvec_iterator<extvec, REAL> iterator;
+	//! reference type for extvec
+	typedef REAL & reference;
+	//! const_iterator type for extvec
+	typedef extvec_iterator<const extvec, const REAL> const_iterator;
+	//! const_reference type for extvec
+	typedef const REAL & const_reference;
+
+protected:
+	//! constructor
+	extvec(size_t size, REAL default_value, bool fill_default);
+	//! destructor
+	~extvec();
+
+public:
+	//! constructor
+	friend SSTUFF_EXPORT
+	extvec * create_extvec(size_t size, REAL default_value, bool fill_default, size_t grow_by);
+
+	//! copy constructor
+	friend SSTUFF_EXPORT
+	extvec * create_extvec(const extvec & in);
+
+	//! copy constructor
+	friend SSTUFF_EXPORT
+	extvec * create_extvec(const vec & in);
+
+	//! destructor
+	void release();
+
+	//! returns iterator to the first element
+	iterator begin() { return iterator(this, 0); };
+	//! returns const iterator to the first element
+	const_iterator const_begin() const { return const_iterator(this, 0); };
+	//! returns iterator to the element after the last
+	iterator end() { return iterator(this, datasize); };
+	//! returns const iterator to the element after the last
+	const_iterator const_end() const { return const_iterator(this, datasize); };
+
+	//! returns vector size
+	size_t size() const { return datasize; };
+
+	//! returns reference to i'th element
+	REAL & operator()(size_t i) {
+		if ( ((i >> EXTVEC_BLOCK_BITS) == last_block) && last_write )
+			return last_data[i & (EXTVEC_BLOCK-1)];
+		return block(i >> EXTVEC_BLOCK_BITS, true)[i & (EXTVEC_BLOCK-1)];
+	};
+
+	//! returns const reference to i'th element
+	const REAL & operator()(size_t i) const {
+		if ( (i >> EXTVEC_BLOCK_BITS) == last_block )
+			return last_data[i & (EXTVEC_BLOCK-1)];
+		return block(i >> EXTVEC_BLOCK_BITS, false)[i & (EXTVEC_BLOCK-1)];
+	};
+
+	//! resizes vector
+	void resize(size_t newsize, REAL default_value = REAL(0), bool fill_default = true);
+
+	//! adds one element at the end of array
+	void push_back(const REAL & value);
+
+	//! swaps two elements
+	void swap(size_t i, size_t j);
+
+	//! forgets all values
+	void drop_data();
+
+	//! writes size elements to the file (from the current position)
+	size_t write_file(int file, size_t size) const;
+	//! reads size elements from the file (from the current position)
+	size_t read_file(int file, size_t size);
+
+	//! returns amount of blocks
+	size_t blocks() const { return (datasize + EXTVEC_BLOCK - 1) >> EXTVEC_BLOCK_BITS; };
+
+	//! returns amount of elements in block b
+	size_t block_size(size_t b) const;
+
+	/*! \brief returns block values in the cache
+	    \param b block number
+	    \param write block will be modified
+	    Pointer is valid until the block is dropped from the cache
+	*/
+	REAL * block(size_t b, bool write) const;
+
+	//! writes modified blocks to file
+	void flush() const;
+
+private:
+
+	friend struct extvec_cache;
+
+	//! removes block from the cache (writing it if modified)
+	void drop_block(size_t b, size_t slot, bool dirty) const;
+
+	//! opens temporary file
+	bool open_file() const;
+
+	//! reads block from file (or fills it with default value)
+	void load_block(size_t b, REAL * dst) const;
+
+	//! vector size
+	size_t datasize;
+	//! value for blocks which were never written
+	REAL fill_value;
+	//! temporary file (-1 if not opened)
+	mutable int file;
+	//! cache slot for each block (-1 for blocks not in the cache)
+	mutable std::vector<int> slots;
+	//! blocks which were written to file
+	mutable std::vector<bool> on_disk;
+
+	//! last used block
+	mutable size_t last_block;
+	//! cache slot of last used block
+	mutable int last_slot;
+	//! values of last used block
+	mutable REAL * last_data;
+	//! last used block is marked as modified
+	mutable bool last_write;
+
+	//! last block read from file (for read ahead)
+	mutable size_t last_miss;
+	//! amount of blocks to read ahead
+	mutable size_t read_ahead;
+};
+
+}; // namespace surfit
+
+#endif
+